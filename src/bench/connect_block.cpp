@@ -0,0 +1,68 @@
+// Copyright (c) 2023 datos
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <consensus/consensus.h>
+#include <consensus/validation.h>
+#include <key.h>
+#include <keystore.h>
+#include <script/sign.h>
+#include <script/standard.h>
+#include <test/util.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <vector>
+
+// Full contextual validation of a block spending NUM_TXS signed P2PKH coins
+// on top of the regtest chainstate: TestBlockValidity() runs ConnectBlock()
+// against a throwaway view, including the script checks.
+static void ConnectBlock(benchmark::Bench& bench)
+{
+    constexpr int NUM_TXS{100};
+
+    CKey key;
+    key.MakeNewKey(true);
+    CBasicKeyStore keystore;
+    keystore.AddKey(key);
+    const CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+    std::vector<CTxIn> coinbases;
+    for (int b = 0; b < NUM_TXS + COINBASE_MATURITY; ++b) {
+        coinbases.push_back(MineBlock(scriptPubKey));
+    }
+    coinbases.resize(NUM_TXS);
+
+    {
+        LOCK(cs_main);
+        for (const CTxIn& in : coinbases) {
+            const Coin& coin = ::ChainstateActive().CoinsTip().AccessCoin(in.prevout);
+            CMutableTransaction tx;
+            tx.vin.push_back(in);
+            tx.vout.emplace_back(coin.out.nValue - 1000, scriptPubKey);
+            bool ret = SignSignature(keystore, coin.out.scriptPubKey, tx, 0, coin.out.nValue, SIGHASH_ALL);
+            assert(ret);
+
+            CValidationState state;
+            ret = AcceptToMemoryPool(::mempool, state, MakeTransactionRef(tx), nullptr /* pfMissingInputs */, false /* bypass_limits */, /* nAbsurdFee */ 0);
+            assert(ret);
+        }
+    }
+
+    const auto block = PrepareBlock(scriptPubKey);
+    assert(block->vtx.size() == NUM_TXS + 1);
+
+    LOCK(cs_main);
+    CBlockIndex* pindexPrev = ::ChainActive().Tip();
+    bench.unit("block").run([&] {
+        CValidationState state;
+        bool ret = TestBlockValidity(state, Params(), *block, pindexPrev, false /* fCheckPOW */, true /* fCheckMerkleRoot */);
+        assert(ret);
+    });
+
+    ::mempool.clear();
+}
+
+BENCHMARK(ConnectBlock);
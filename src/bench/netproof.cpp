@@ -0,0 +1,101 @@
+// Copyright (c) 2023 datos
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <key.h>
+#include <random.h>
+#include <storage/behavior.h>
+#include <storage/manager.h>
+#include <storage/netproof.h>
+#include <streams.h>
+#include <validation.h>
+#include <version.h>
+
+// Storage node count of the synthetic proofs; scale with -asymptote=100,1000,10000
+static int ProofNodeCount(benchmark::Bench& bench)
+{
+    if (bench.complexityN() > 1) {
+        return static_cast<int>(bench.complexityN());
+    }
+    return 1000;
+}
+
+static CNetworkProof CreateNetworkProof(FastRandomContext& rand, int height, int nodeCount)
+{
+    CNetworkProof netproof;
+    netproof.height = height;
+    for (int i = 0; i < nodeCount; ++i) {
+        StorageNode node;
+        node.id = i;
+        node.ip = 0x0a000001 + i; // 10.0.0.1 upwards
+        node.mode = 1;
+        node.stat = 1;
+        node.reg = 1;
+        node.load = rand.randrange(100);
+        node.chunks = 1 + rand.randrange(100000);
+        node.errcnt = 0;
+        node.space = 1 + rand.randrange(4096);
+        netproof.proof.nodes.push_back(node);
+    }
+    netproof.CalculateHash();
+    return netproof;
+}
+
+// Receiving a netproof off the wire: deserialize, Check() and Validate(),
+// against a full proof cache so AlreadyHave() scans all of it.
+static void NetworkProofValidate(benchmark::Bench& bench)
+{
+    const int nodeCount = ProofNodeCount(bench);
+    const int height = Params().GetConsensus().nLastPoWBlock + MAX_NETWORKPROOF + 1;
+    FastRandomContext rand{true};
+
+    for (int i = 0; i < MAX_NETWORKPROOF; ++i) {
+        proofs.push_back(CreateNetworkProof(rand, height - MAX_NETWORKPROOF + i, 1));
+    }
+
+    // The regtest proof key is not available here, so the signature recovers
+    // to a different key and Validate() rejects the proof after the full
+    // check; that leaves the cache untouched between iterations.
+    CKey key;
+    key.MakeNewKey(true);
+    CNetworkProof netproof = CreateNetworkProof(rand, height, nodeCount);
+    key.SignCompact(netproof.hash, netproof.vchProofSig);
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << netproof;
+
+    bench.unit("proof").run([&] {
+        CDataStream ssProof(stream);
+        CNetworkProof received;
+        ssProof >> received;
+        bool ret = received.Check();
+        assert(ret);
+        proofManager.Validate(received);
+    });
+
+    proofs.clear();
+}
+
+// Scoring the storage nodes of a connected block, with every node already
+// known from earlier proofs.
+static void NodeBehaviorAddProof(benchmark::Bench& bench)
+{
+    const int nodeCount = ProofNodeCount(bench);
+    FastRandomContext rand{true};
+
+    CNodeBehavior behavior;
+    const CNetworkProof netproof = CreateNetworkProof(rand, 1, nodeCount);
+    behavior.AddProof(netproof);
+
+    // AddProof() skips heights it has seen, present it as a new one each time
+    CNetworkProof next = netproof;
+    bench.unit("proof").run([&] {
+        ++next.height;
+        behavior.AddProof(next);
+    });
+}
+
+BENCHMARK(NetworkProofValidate);
+BENCHMARK(NodeBehaviorAddProof);
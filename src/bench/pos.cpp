@@ -0,0 +1,96 @@
+// Copyright (c) 2023 datos
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <arith_uint256.h>
+#include <chainparams.h>
+#include <consensus/consensus.h>
+#include <consensus/merkle.h>
+#include <consensus/validation.h>
+#include <key.h>
+#include <keystore.h>
+#include <pos/kernel.h>
+#include <pos/signature.h>
+#include <script/sign.h>
+#include <script/standard.h>
+#include <test/util.h>
+#include <validation.h>
+
+// Mine enough blocks to a P2PK key that the first coinbase is stakeable and
+// build a signed coinstake spending it, as the minter would.
+static CMutableTransaction CreateCoinStake(const CKey& key, int64_t& nTime)
+{
+    const CScript scriptPubKey = GetScriptForRawPubKey(key.GetPubKey());
+
+    const CTxIn kernel = MineBlock(scriptPubKey);
+    for (int i = 0; i < COINBASE_MATURITY; ++i) {
+        MineBlock(scriptPubKey);
+    }
+
+    Coin coin;
+    {
+        LOCK(cs_main);
+        bool found = ::ChainstateActive().CoinsTip().GetCoin(kernel.prevout, coin);
+        assert(found);
+        nTime = (::ChainActive()[coin.nHeight]->GetBlockTime() + Params().GetConsensus().nStakeMinAge + nStakeTimestampMask + 1) & ~nStakeTimestampMask;
+    }
+
+    CMutableTransaction txCoinStake;
+    txCoinStake.vin.emplace_back(kernel.prevout);
+    txCoinStake.vout.emplace_back(0, CScript());
+    txCoinStake.vout.emplace_back(coin.out.nValue, scriptPubKey);
+
+    CBasicKeyStore keystore;
+    keystore.AddKey(key);
+    bool signed_ok = SignSignature(keystore, coin.out.scriptPubKey, txCoinStake, 0, coin.out.nValue, SIGHASH_ALL);
+    assert(signed_ok);
+
+    return txCoinStake;
+}
+
+static void PosCheckProofOfStake(benchmark::Bench& bench)
+{
+    CKey key;
+    key.MakeNewKey(true);
+
+    int64_t nTime;
+    const CTransaction txCoinStake(CreateCoinStake(key, nTime));
+    const Consensus::Params& params = Params().GetConsensus();
+    const unsigned int nBits = UintToArith256(params.posLimit).GetCompact();
+
+    LOCK(cs_main);
+    const CBlockIndex* pindexPrev = ::ChainActive().Tip();
+
+    // Whether the kernel meets the target is down to chance, the coin lookup,
+    // script verification and kernel hash run either way.
+    bench.unit("coinstake").run([&] {
+        CValidationState state;
+        uint256 hashProofOfStake, targetProofOfStake;
+        CheckProofOfStake(state, pindexPrev, txCoinStake, nTime, nBits, hashProofOfStake, targetProofOfStake, params);
+    });
+}
+
+static void PosCheckBlockSignature(benchmark::Bench& bench)
+{
+    CKey key;
+    key.MakeNewKey(true);
+
+    int64_t nTime;
+    CMutableTransaction txCoinStake = CreateCoinStake(key, nTime);
+
+    CBlock block = *PrepareBlock(GetScriptForRawPubKey(key.GetPubKey()));
+    block.nTime = nTime;
+    block.vtx.insert(block.vtx.begin() + 1, MakeTransactionRef(txCoinStake));
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    bool signed_ok = SignBlockWithKey(block, key);
+    assert(signed_ok);
+
+    bench.unit("block").run([&] {
+        bool ret = CheckBlockSignature(block);
+        assert(ret);
+    });
+}
+
+BENCHMARK(PosCheckProofOfStake);
+BENCHMARK(PosCheckBlockSignature);
@@ -0,0 +1,182 @@
+// Copyright (c) 2023 datos
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <consensus/merkle.h>
+#include <index/txindex.h>
+#include <key.h>
+#include <pow.h>
+#include <random.h>
+#include <script/standard.h>
+#include <test/util.h>
+#include <test/util/setup_common.h>
+#include <tinyformat.h>
+#include <token/issuances.h>
+#include <token/token.h>
+#include <token/verify.h>
+#include <txmempool.h>
+#include <util/time.h>
+#include <validation.h>
+
+static const int NUM_KNOWN_ISSUANCES = 1000;
+static const int NUM_MEMPOOL_ISSUANCES = 200;
+
+static CScript TokenScript(uint16_t type, uint64_t id, std::string name, const CScript& scriptPubKey)
+{
+    CScript script;
+    CScript owner = scriptPubKey;
+    BuildTokenScript(script, CToken::CURRENT_VERSION, type, id, name, owner);
+    return script;
+}
+
+static CTransactionRef TokenTx(const COutPoint& prevout, uint16_t type, uint64_t id, const std::string& name, const CScript& scriptPubKey)
+{
+    CMutableTransaction tx;
+    tx.vin.emplace_back(prevout);
+    tx.vout.emplace_back(1 * COIN, TokenScript(type, id, name, scriptPubKey));
+    return MakeTransactionRef(tx);
+}
+
+static void AddToMempool(const CTransactionRef& tx) EXCLUSIVE_LOCKS_REQUIRED(cs_main, mempool.cs)
+{
+    TestMemPoolEntryHelper entry;
+    mempool.addUnchecked(entry.FromTx(tx));
+}
+
+// Mine a block on the tip that also includes txs
+static void MineBlockWith(const std::vector<CTransactionRef>& txs)
+{
+    const CScript scriptPubKey = CScript() << OP_TRUE;
+    auto block = PrepareBlock(scriptPubKey);
+    block->vtx.insert(block->vtx.end(), txs.begin(), txs.end());
+    block->hashMerkleRoot = BlockMerkleRoot(*block);
+
+    while (!CheckProofOfWork(block->GetHash(), block->nBits, Params().GetConsensus())) {
+        ++block->nNonce;
+        assert(block->nNonce);
+    }
+
+    bool processed{ProcessNewBlock(Params(), block, true, nullptr)};
+    assert(processed);
+}
+
+static void WaitForTxIndex()
+{
+    while (!g_txindex->BlockUntilSyncedToCurrentChain()) {
+        UninterruptibleSleep(std::chrono::milliseconds{10});
+    }
+}
+
+// A token chain past the token activation height: a mined funding tx, a mined
+// issuance spending it with TOKEN_MINCONFS confirmations and a transfer of that
+// issuance, next to other pending issuances in the mempool and a populated set
+// of known issuances. Mined prevouts are looked up through -txindex, as on a
+// token node.
+struct TokenFixture {
+    CTransactionRef funding;
+    CTransactionRef issuance;
+    CTransactionRef transfer;
+    CTransactionRef newIssuance;
+
+    TokenFixture()
+    {
+        const CScript scriptPubKey = CScript() << OP_TRUE;
+        const CTxIn coinbase = MineBlock(scriptPubKey);
+        while (WITH_LOCK(cs_main, return ::ChainActive().Height()) < Params().GetConsensus().nTokenHeight) {
+            MineBlock(scriptPubKey);
+        }
+
+        CKey key;
+        key.MakeNewKey(true);
+        const CScript owner = GetScriptForDestination(key.GetPubKey().GetID());
+
+        for (int i = 0; i < NUM_KNOWN_ISSUANCES; ++i) {
+            CToken token;
+            token.setType(CToken::ISSUANCE);
+            token.setId(ISSUANCE_ID_BEGIN + 1 + i);
+            token.setName(strprintf("KNOWN%d", i));
+            token.setOriginTx(GetRandHash());
+            AddToIssuances(token);
+        }
+
+        CMutableTransaction txFunding;
+        txFunding.vin.push_back(coinbase);
+        txFunding.vout.emplace_back(1 * COIN, scriptPubKey);
+        txFunding.vout.emplace_back(1 * COIN, scriptPubKey);
+        funding = MakeTransactionRef(txFunding);
+
+        const uint64_t id = ISSUANCE_ID_BEGIN + NUM_KNOWN_ISSUANCES + 1;
+        issuance = TokenTx(COutPoint(funding->GetHash(), 0), CToken::ISSUANCE, id, "BENCH", owner);
+        transfer = TokenTx(COutPoint(issuance->GetHash(), 0), CToken::TRANSFER, id, "BENCH", owner);
+        newIssuance = TokenTx(COutPoint(funding->GetHash(), 1), CToken::ISSUANCE, id + 1, "NEWBENCH", owner);
+
+        // Connecting the issuance looks up the funding tx through the index
+        MineBlockWith({funding});
+        g_txindex = MakeUnique<TxIndex>(1 << 20, true);
+        g_txindex->Start();
+        WaitForTxIndex();
+        MineBlockWith({issuance});
+        for (int i = 0; i < TOKEN_MINCONFS; ++i) {
+            MineBlock(scriptPubKey);
+        }
+        WaitForTxIndex();
+
+        LOCK2(cs_main, mempool.cs);
+        for (int i = 0; i < NUM_MEMPOOL_ISSUANCES; ++i) {
+            AddToMempool(TokenTx(COutPoint(GetRandHash(), 0), CToken::ISSUANCE, id + 2 + i, strprintf("PENDING%d", i), owner));
+        }
+    }
+
+    ~TokenFixture()
+    {
+        mempool.clear();
+        KnownIssuances.clear();
+        g_txindex->Stop();
+        g_txindex.reset();
+    }
+};
+
+static void TokenCheck(benchmark::Bench& bench, bool fTransfer)
+{
+    TokenFixture fixture;
+    const CTransactionRef& tx = fTransfer ? fixture.transfer : fixture.issuance;
+    const Consensus::Params& params = Params().GetConsensus();
+
+    LOCK(cs_main);
+    const CBlockIndex* pindex = ::ChainActive().Tip();
+    const CCoinsViewCache& view = ::ChainstateActive().CoinsTip();
+
+    bench.unit("tx").run([&] {
+        std::string strError;
+        bool ret = CheckToken(tx, pindex, view, strError, params, true);
+        assert(ret);
+    });
+}
+
+static void TokenCheckIssuance(benchmark::Bench& bench)
+{
+    TokenCheck(bench, false);
+}
+
+static void TokenCheckTransfer(benchmark::Bench& bench)
+{
+    TokenCheck(bench, true);
+}
+
+static void TokenCheckMempool(benchmark::Bench& bench)
+{
+    TokenFixture fixture;
+
+    LOCK(cs_main);
+    bench.unit("tx").run([&] {
+        std::string strError;
+        bool ret = CheckTokenMempool(mempool, fixture.newIssuance, strError);
+        assert(ret);
+    });
+}
+
+BENCHMARK(TokenCheckIssuance);
+BENCHMARK(TokenCheckTransfer);
+BENCHMARK(TokenCheckMempool);
@@ -203,6 +203,8 @@ ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<
     if (vtx_missing.size() != tx_missing_offset)
         return READ_STATUS_INVALID;
 
+    block.Memoize();
+
     CValidationState state;
     if (!CheckBlock(block, state, Params().GetConsensus(), true, true, true, false)) {
         // TODO: We really want to just check merkle tree manually here,
@@ -64,6 +64,10 @@ uint256 ComputeMerkleRoot(std::vector<uint256> hashes, bool* mutated) {
 
 uint256 BlockMerkleRoot(const CBlock& block, bool* mutated)
 {
+    if (const auto* memo = block.merkleRootMemo.Get()) {
+        if (mutated) *mutated = memo->second;
+        return memo->first;
+    }
     std::vector<uint256> leaves;
     leaves.resize(block.vtx.size());
     for (size_t s = 0; s < block.vtx.size(); s++) {
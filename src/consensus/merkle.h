@@ -15,6 +15,7 @@ uint256 ComputeMerkleRoot(std::vector<uint256> hashes, bool* mutated = nullptr);
 /*
  * Compute the Merkle root of the transactions in a block.
  * *mutated is set to true if a duplicated subtree was found.
+ * Memoized blocks return the root computed by CBlock::Memoize().
  */
 uint256 BlockMerkleRoot(const CBlock& block, bool* mutated = nullptr);
 
@@ -6,6 +6,7 @@
 
 #include <memory>
 #include <random.h>
+#include <util/strencodings.h>
 
 #include <leveldb/cache.h>
 #include <leveldb/env.h>
@@ -13,6 +14,10 @@
 #include <memenv.h>
 #include <stdint.h>
 #include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
 
 class CBitcoinLevelDBLogger : public leveldb::Logger {
 public:
@@ -97,12 +102,42 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
              options->max_open_files, default_open_files);
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+/** LRU block cache that counts lookup hits and misses */
+class CountingCache : public leveldb::Cache
+{
+private:
+    std::unique_ptr<leveldb::Cache> m_cache;
+    std::atomic<uint64_t>& m_hits;
+    std::atomic<uint64_t>& m_misses;
+
+public:
+    CountingCache(size_t capacity, std::atomic<uint64_t>& hits, std::atomic<uint64_t>& misses)
+        : m_cache(leveldb::NewLRUCache(capacity)), m_hits(hits), m_misses(misses) {}
+
+    Handle* Insert(const leveldb::Slice& key, void* value, size_t charge, void (*deleter)(const leveldb::Slice& key, void* value)) override
+    {
+        return m_cache->Insert(key, value, charge, deleter);
+    }
+    Handle* Lookup(const leveldb::Slice& key) override
+    {
+        Handle* handle = m_cache->Lookup(key);
+        (handle ? m_hits : m_misses).fetch_add(1, std::memory_order_relaxed);
+        return handle;
+    }
+    void Release(Handle* handle) override { m_cache->Release(handle); }
+    void* Value(Handle* handle) override { return m_cache->Value(handle); }
+    void Erase(const leveldb::Slice& key) override { m_cache->Erase(key); }
+    uint64_t NewId() override { return m_cache->NewId(); }
+    void Prune() override { m_cache->Prune(); }
+    size_t TotalCharge() const override { return m_cache->TotalCharge(); }
+};
+
+static leveldb::Options GetOptions(size_t nCacheSize, int nBloomBits, std::atomic<uint64_t>& cache_hits, std::atomic<uint64_t>& cache_misses)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
+    options.block_cache = new CountingCache(nCacheSize / 2, cache_hits, cache_misses);
     options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    options.filter_policy = nBloomBits > 0 ? leveldb::NewBloomFilterPolicy(nBloomBits) : nullptr;
     options.compression = leveldb::kNoCompression;
     options.info_log = new CBitcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
@@ -114,6 +149,87 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
+namespace {
+/** Cache assignments, -dboptions overrides and the set of open databases */
+struct DBResources {
+    std::mutex mutex;
+    std::map<std::string, size_t> cache_sizes;
+    std::map<std::string, DBTuning> tuning;
+    std::set<const CDBWrapper*> open;
+};
+
+DBResources& GetDBResources()
+{
+    static DBResources* resources = new DBResources();
+    return *resources;
+}
+} // namespace
+
+bool ParseDBTuning(const std::vector<std::string>& args, std::string& error)
+{
+    std::map<std::string, DBTuning> tuning;
+    for (const std::string& arg : args) {
+        const size_t colon = arg.find(':');
+        if (colon == std::string::npos || colon == 0) {
+            error = strprintf("Invalid -dboptions entry '%s', expected <db>:<key>=<value>[,...]", arg);
+            return false;
+        }
+        DBTuning& entry = tuning[arg.substr(0, colon)];
+        size_t pos = colon + 1;
+        while (pos <= arg.size()) {
+            size_t end = arg.find(',', pos);
+            if (end == std::string::npos) end = arg.size();
+            const std::string option = arg.substr(pos, end - pos);
+            const size_t eq = option.find('=');
+            int32_t value;
+            if (eq == std::string::npos || !ParseInt32(option.substr(eq + 1), &value) || value < 0) {
+                error = strprintf("Invalid -dboptions setting '%s' in '%s'", option, arg);
+                return false;
+            }
+            const std::string key = option.substr(0, eq);
+            if (key == "cache") {
+                entry.nCacheSize = (int64_t)value << 20;
+            } else if (key == "bloom") {
+                entry.nBloomBits = value;
+            } else {
+                error = strprintf("Unknown -dboptions setting '%s' in '%s', expected cache or bloom", key, arg);
+                return false;
+            }
+            pos = end + 1;
+        }
+    }
+    DBResources& resources = GetDBResources();
+    std::lock_guard<std::mutex> lock(resources.mutex);
+    resources.tuning = std::move(tuning);
+    return true;
+}
+
+void SetDBCacheSize(const std::string& name, size_t nCacheSize)
+{
+    DBResources& resources = GetDBResources();
+    std::lock_guard<std::mutex> lock(resources.mutex);
+    resources.cache_sizes[name] = nCacheSize;
+}
+
+void UnsetDBCacheSize(const std::string& name)
+{
+    DBResources& resources = GetDBResources();
+    std::lock_guard<std::mutex> lock(resources.mutex);
+    resources.cache_sizes.erase(name);
+}
+
+std::vector<DBStats> GetDBStats()
+{
+    DBResources& resources = GetDBResources();
+    std::lock_guard<std::mutex> lock(resources.mutex);
+    std::vector<DBStats> stats;
+    for (const CDBWrapper* db : resources.open) {
+        stats.push_back(db->GetStats());
+    }
+    std::sort(stats.begin(), stats.end(), [](const DBStats& a, const DBStats& b) { return a.path < b.path; });
+    return stats;
+}
+
 CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
     : m_name{path.stem().string()}
 {
@@ -122,7 +238,22 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    m_path = fMemory ? "" : path.string();
+    DBTuning tuning;
+    {
+        DBResources& resources = GetDBResources();
+        std::lock_guard<std::mutex> lock(resources.mutex);
+        if (!fMemory) {
+            auto it_size = resources.cache_sizes.find(m_name);
+            if (it_size != resources.cache_sizes.end()) nCacheSize = it_size->second;
+            auto it_tuning = resources.tuning.find(m_name);
+            if (it_tuning != resources.tuning.end()) tuning = it_tuning->second;
+        }
+    }
+    if (tuning.nCacheSize >= 0) nCacheSize = tuning.nCacheSize;
+    m_cache_size = nCacheSize;
+    m_bloom_bits = tuning.nBloomBits;
+    options = GetOptions(nCacheSize, m_bloom_bits, m_cache_hits, m_cache_misses);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -164,10 +295,19 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     }
 
     LogPrintf("Using obfuscation key for %s: %s\n", path.string(), HexStr(obfuscate_key));
+
+    DBResources& resources = GetDBResources();
+    std::lock_guard<std::mutex> lock(resources.mutex);
+    resources.open.insert(this);
 }
 
 CDBWrapper::~CDBWrapper()
 {
+    {
+        DBResources& resources = GetDBResources();
+        std::lock_guard<std::mutex> lock(resources.mutex);
+        resources.open.erase(this);
+    }
     delete pdb;
     pdb = nullptr;
     delete options.filter_policy;
@@ -187,7 +327,15 @@ bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
     if (log_memory) {
         mem_before = DynamicMemoryUsage() / 1024.0 / 1024;
     }
+    const auto nStart = std::chrono::steady_clock::now();
     leveldb::Status status = pdb->Write(fSync ? syncoptions : writeoptions, &batch.batch);
+    const uint64_t nMicros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - nStart).count();
+    m_writes++;
+    m_write_micros += nMicros;
+    uint64_t nMax = m_max_write_micros.load(std::memory_order_relaxed);
+    while (nMicros > nMax && !m_max_write_micros.compare_exchange_weak(nMax, nMicros)) {}
+    // Synced writes are slow because of the fsync, only unsynced ones reveal throttling
+    if (!fSync && (int64_t)nMicros >= DBWRAPPER_SLOW_WRITE_MICROS) m_slow_writes++;
     dbwrapper_private::HandleError(status);
     if (log_memory) {
         double mem_after = DynamicMemoryUsage() / 1024.0 / 1024;
@@ -206,6 +354,40 @@ size_t CDBWrapper::DynamicMemoryUsage() const {
     return stoul(memory);
 }
 
+DBStats CDBWrapper::GetStats() const
+{
+    DBStats stats;
+    stats.name = m_name;
+    stats.path = m_path;
+    stats.nCacheSize = m_cache_size;
+    stats.nBloomBits = m_bloom_bits;
+    stats.nCacheHits = m_cache_hits;
+    stats.nCacheMisses = m_cache_misses;
+    stats.nCacheUsage = options.block_cache->TotalCharge();
+    stats.nMemoryUsage = DynamicMemoryUsage();
+    stats.nWrites = m_writes;
+    stats.nWriteMicros = m_write_micros;
+    stats.nMaxWriteMicros = m_max_write_micros;
+    stats.nSlowWrites = m_slow_writes;
+
+    // One line per non-empty level after a three line header, see DBImpl::GetProperty
+    std::string table;
+    if (pdb->GetProperty("leveldb.stats", &table)) {
+        size_t pos = 0;
+        for (int line = 0; pos < table.size(); ++line) {
+            size_t end = table.find('\n', pos);
+            if (end == std::string::npos) end = table.size();
+            DBStats::Level level;
+            if (line >= 3 && sscanf(table.substr(pos, end - pos).c_str(), "%d %d %lf %lf %lf %lf", &level.nLevel, &level.nFiles,
+                                    &level.dSizeMB, &level.dCompactionSec, &level.dCompactionReadMB, &level.dCompactionWriteMB) == 6) {
+                stats.vLevels.push_back(level);
+            }
+            pos = end + 1;
+        }
+    }
+    return stats;
+}
+
 // Prefixed with null character to avoid collisions with other keys
 //
 // We must use a string constructor which specifies length so that we copy
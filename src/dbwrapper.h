@@ -12,6 +12,7 @@
 #include <util/system.h>
 #include <util/strencodings.h>
 
+#include <atomic>
 #include <typeindex>
 
 #include <leveldb/db.h>
@@ -19,6 +20,8 @@
 
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
+//! Unsynced writes taking longer than this were most likely throttled by LevelDB (microseconds)
+static const int64_t DBWRAPPER_SLOW_WRITE_MICROS = 1000;
 
 class dbwrapper_error : public std::runtime_error
 {
@@ -193,6 +196,47 @@ public:
 
 };
 
+/** Per-database LevelDB settings, from -dboptions */
+struct DBTuning {
+    int64_t nCacheSize{-1}; //!< cache size in bytes, -1 to use the size assigned from -dbcache
+    int nBloomBits{10};     //!< bloom filter bits per key, 0 disables the filter
+};
+
+/** Parse -dboptions entries of the form <db>:<key>=<value>[,<key>=<value>...] */
+bool ParseDBTuning(const std::vector<std::string>& args, std::string& error);
+/** Assign the cache size of a database by name, used instead of the size its owner asks for */
+void SetDBCacheSize(const std::string& name, size_t nCacheSize);
+/** Drop the cache size assigned to a database, so the size its owner asks for is used again */
+void UnsetDBCacheSize(const std::string& name);
+
+/** LevelDB statistics of one open database */
+struct DBStats {
+    struct Level {
+        int nLevel;
+        int nFiles;
+        double dSizeMB;
+        double dCompactionSec;
+        double dCompactionReadMB;
+        double dCompactionWriteMB;
+    };
+    std::string name;
+    std::string path;
+    size_t nCacheSize{0};
+    int nBloomBits{0};
+    uint64_t nCacheHits{0};
+    uint64_t nCacheMisses{0};
+    size_t nCacheUsage{0};
+    size_t nMemoryUsage{0};
+    uint64_t nWrites{0};
+    uint64_t nWriteMicros{0};
+    uint64_t nMaxWriteMicros{0};
+    uint64_t nSlowWrites{0};
+    std::vector<Level> vLevels;
+};
+
+/** Statistics of all open databases */
+std::vector<DBStats> GetDBStats();
+
 class CDBWrapper
 {
     friend const std::vector<unsigned char>& dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
@@ -221,6 +265,21 @@ private:
     //! the name of this database
     std::string m_name;
 
+    //! location of this database, empty for in-memory databases
+    std::string m_path;
+
+    size_t m_cache_size;
+    int m_bloom_bits;
+
+    //! block cache lookups, counted by the cache wrapper in options.block_cache
+    std::atomic<uint64_t> m_cache_hits{0};
+    std::atomic<uint64_t> m_cache_misses{0};
+
+    std::atomic<uint64_t> m_writes{0};
+    std::atomic<uint64_t> m_write_micros{0};
+    std::atomic<uint64_t> m_max_write_micros{0};
+    std::atomic<uint64_t> m_slow_writes{0};
+
     //! a key used for optional XOR-obfuscation of the database
     std::vector<unsigned char> obfuscate_key;
 
@@ -344,6 +403,8 @@ public:
     // Get an estimate of LevelDB memory usage (in bytes).
     size_t DynamicMemoryUsage() const;
 
+    DBStats GetStats() const;
+
     CDBIterator *NewIterator()
     {
         return new CDBIterator(*this, pdb->NewIterator(iteroptions));
@@ -39,6 +39,7 @@ void DummyWalletInit::AddWalletOptions() const
         "-keypool=<n>",
         "-maxtxfee=<amt>",
         "-rescan=<mode>",
+        "-rescanblockfilter",
         "-salvagewallet",
         "-spendzeroconfchange",
         "-upgradewallet",
@@ -12,6 +12,9 @@
 #include <wallet/walletdb.h>
 #endif
 
+#include <atomic>
+#include <thread>
+
 bool CHDChain::SetNull()
 {
     LOCK(cs);
@@ -202,6 +205,60 @@ void CHDChain::DeriveChildExtKey(uint32_t nAccountIndex, bool fInternal, uint32_
 #endif
 }
 
+void CHDChain::DeriveChildExtKeys(uint32_t nAccountIndex, bool fInternal, uint32_t nFirstChildIndex, size_t nCount, std::vector<CExtKey>& vExtKeysRet, std::vector<CExtPubKey>& vExtPubKeysRet, std::vector<CKeyMetadata>& vMetadata)
+{
+    assert(vMetadata.size() == nCount);
+    CExtKey masterKey;
+    CExtKey changeKey;
+    {
+        LOCK(cs);
+        // m / purpose' / coin_type' / account' / change is the same for all of them
+        CExtKey purposeKey;
+        CExtKey cointypeKey;
+        CExtKey accountKey;
+        masterKey.SetSeed(vchSeed.data(), vchSeed.size());
+        masterKey.Derive(purposeKey, 44 | 0x80000000);
+        purposeKey.Derive(cointypeKey, Params().ExtCoinType() | 0x80000000);
+        cointypeKey.Derive(accountKey, nAccountIndex | 0x80000000);
+        accountKey.Derive(changeKey, fInternal ? 1 : 0);
+    }
+#ifdef ENABLE_WALLET
+    const CKeyID master_id = masterKey.key.GetPubKey().GetID();
+#endif
+
+    vExtKeysRet.resize(nCount);
+    vExtPubKeysRet.resize(nCount);
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < nCount; i = next++) {
+            const uint32_t nChildIndex = nFirstChildIndex + i;
+            changeKey.Derive(vExtKeysRet[i], nChildIndex);
+            vExtPubKeysRet[i] = vExtKeysRet[i].Neuter();
+#ifdef ENABLE_WALLET
+            CKeyMetadata& metadata = vMetadata[i];
+            assert(!metadata.has_key_origin);
+            assert(metadata.key_origin.path.empty());
+            metadata.key_origin.path.push_back(44 | 0x80000000);
+            metadata.key_origin.path.push_back(Params().ExtCoinType() | 0x80000000);
+            metadata.key_origin.path.push_back(nAccountIndex | 0x80000000);
+            metadata.key_origin.path.push_back(fInternal ? 1 : 0);
+            metadata.key_origin.path.push_back(nChildIndex);
+            std::copy(master_id.begin(), master_id.begin() + 4, metadata.key_origin.fingerprint);
+            metadata.has_key_origin = true;
+#endif
+        }
+    };
+    std::vector<std::thread> threads;
+    const size_t nThreads = std::min<size_t>(std::max(GetNumCores(), 1), nCount);
+    for (size_t i = 1; i < nThreads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
 void CHDChain::AddAccount()
 {
     LOCK(cs);
@@ -111,6 +111,8 @@ public:
 
     uint256 GetSeedHash();
     void DeriveChildExtKey(uint32_t nAccountIndex, bool fInternal, uint32_t nChildIndex, CExtKey& extKeyRet, CKeyMetadata& metadata);
+    //! Same as DeriveChildExtKey for nCount consecutive child indexes, the last derivation step runs on several threads
+    void DeriveChildExtKeys(uint32_t nAccountIndex, bool fInternal, uint32_t nFirstChildIndex, size_t nCount, std::vector<CExtKey>& vExtKeysRet, std::vector<CExtPubKey>& vExtPubKeysRet, std::vector<CKeyMetadata>& vMetadata);
 
     void AddAccount();
     bool GetAccount(uint32_t nAccountIndex, CHDAccount& hdAccountRet);
@@ -7,6 +7,7 @@
 #include <chainparams.h>
 #include <crypto/hmac_sha256.h>
 #include <httpserver.h>
+#include <rpc/jsonstream.h>
 #include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <ui_interface.h>
@@ -145,6 +146,15 @@ static bool RPCAuthorized(const std::string& strAuth, std::string& strAuthUserna
     return multiUserAuthorized(strUserPass);
 }
 
+//! An error after part of a streamed result was sent can't be replied anymore,
+//! the client sees a truncated reply instead
+static bool AbortStreamedReply(HTTPRequest* req, const JSONRPCRequest& jreq, const std::string& strError)
+{
+    LogPrintf("%s: %s failed while streaming its result: %s\n", __func__, jreq.strMethod, strError);
+    req->WriteReplyEnd();
+    return false;
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -175,6 +185,20 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         return false;
     }
 
+    // Handlers of large results may write them into a chunked reply as they
+    // go. The reply is started with the first chunk, until then an error can
+    // still be replied normally.
+    bool fReplyStarted = false;
+    JSONStreamWriter streamWriter([&](const std::string& chunk) {
+        if (!fReplyStarted) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->WriteReplyStart(HTTP_OK);
+            req->WriteReplyChunk("{\"result\":");
+            fReplyStarted = true;
+        }
+        req->WriteReplyChunk(chunk);
+    });
+
     try {
         // Parse request
         UniValue valRequest;
@@ -188,9 +212,18 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         // singleton request
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
+            jreq.streamWriter = &streamWriter;
 
             UniValue result = tableRPC.execute(jreq);
 
+            if (!streamWriter.IsEmpty()) {
+                // Same as JSONRPCReply, around the streamed result
+                streamWriter.Raw(",\"error\":null,\"id\":" + jreq.id.write() + "}\n");
+                streamWriter.Flush();
+                req->WriteReplyEnd();
+                return true;
+            }
+
             // Send reply
             strReply = JSONRPCReply(result, NullUniValue, jreq.id);
 
@@ -203,9 +236,15 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         req->WriteHeader("Content-Type", "application/json");
         req->WriteReply(HTTP_OK, strReply);
     } catch (const UniValue& objError) {
+        if (fReplyStarted) {
+            return AbortStreamedReply(req, jreq, objError.write());
+        }
         JSONErrorReply(req, objError, jreq.id);
         return false;
     } catch (const std::exception& e) {
+        if (fReplyStarted) {
+            return AbortStreamedReply(req, jreq, e.what());
+        }
         JSONErrorReply(req, JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
         return false;
     }
@@ -514,12 +514,17 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* _req) : req(_req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       replyStarted(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (replyStarted && !replySent) {
+        // The handler bailed out in the middle of the reply, the client gets a truncated body
+        LogPrintf("%s: Unfinished reply\n", __func__);
+        WriteReplyEnd();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL_SERVER_ERROR, "Unhandled request");
@@ -600,6 +605,122 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = nullptr; // transferred back to main thread
 }
 
+/** Chunked reply bytes handed to the main http thread and not yet written to the client */
+struct HTTPReplyBacklog
+{
+    Mutex cs;
+    std::condition_variable cond;
+    //! Queued by the worker and not known to be written yet
+    size_t nPending GUARDED_BY(cs){0};
+    //! Handed to libevent since its output buffer last drained
+    size_t nInOutput GUARDED_BY(cs){0};
+    //! The client stopped reading, the rest of the reply is dropped
+    bool fAbandoned GUARDED_BY(cs){false};
+};
+
+/** Called by libevent once the output buffer of the connection is written out */
+static void HTTPReplyDrained(struct evhttp_connection* conn, void* arg)
+{
+    HTTPReplyBacklog* backlog = static_cast<HTTPReplyBacklog*>(arg);
+    {
+        LOCK(backlog->cs);
+        backlog->nPending -= backlog->nInOutput;
+        backlog->nInOutput = 0;
+    }
+    backlog->cond.notify_all();
+}
+
+void HTTPRequest::WriteReplyStart(int nStatus)
+{
+    assert(!replySent && !replyStarted && req);
+    if (ShutdownRequested()) {
+        WriteHeader("Connection", "close");
+    }
+    // The request stays with this thread until WriteReplyEnd, the events
+    // only touch it on the main http thread, in the order they were triggered
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
+        evhttp_send_reply_start(req_copy, nStatus, nullptr);
+    });
+    ev->trigger(nullptr);
+    replyStarted = true;
+    replyBacklog = std::make_shared<HTTPReplyBacklog>();
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(replyStarted && !replySent && req);
+    if (strChunk.empty()) {
+        // An empty chunk would end the chunked body
+        return;
+    }
+    HTTPReplyBacklog& backlog = *replyBacklog;
+    {
+        // Wait for the client to take what was sent so far, so a slow client
+        // doesn't make libevent buffer the whole reply
+        const std::chrono::seconds timeout{gArgs.GetArg("-rpcservertimeout", DEFAULT_HTTP_SERVER_TIMEOUT)};
+        WAIT_LOCK(backlog.cs, lock);
+        auto lastProgress = std::chrono::steady_clock::now();
+        size_t nLastPending = backlog.nPending;
+        while (!backlog.fAbandoned && backlog.nPending >= MAX_REPLY_BACKLOG) {
+            backlog.cond.wait_for(lock, std::chrono::seconds{1});
+            const auto now = std::chrono::steady_clock::now();
+            if (backlog.nPending < nLastPending) {
+                nLastPending = backlog.nPending;
+                lastProgress = now;
+            }
+            if (ShutdownRequested() || now - lastProgress > timeout) {
+                LogPrint(BCLog::HTTP, "%s: client stopped reading, dropping the rest of the reply\n", __func__);
+                backlog.fAbandoned = true;
+            }
+        }
+        if (backlog.fAbandoned) {
+            return;
+        }
+        backlog.nPending += strChunk.size();
+    }
+
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    auto req_copy = req;
+    auto backlog_copy = replyBacklog;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, evb, backlog_copy]{
+        {
+            LOCK(backlog_copy->cs);
+            backlog_copy->nInOutput += evbuffer_get_length(evb);
+        }
+        // libevent calls back once the connection's output buffer is empty again
+        evhttp_send_reply_chunk_with_cb(req_copy, evb, HTTPReplyDrained, backlog_copy.get());
+        evbuffer_free(evb);
+    });
+    ev->trigger(nullptr);
+}
+
+void HTTPRequest::WriteReplyEnd()
+{
+    assert(replyStarted && !replySent && req);
+    auto req_copy = req;
+    // keeps the backlog alive until evhttp_send_reply_end replaced the drain callback
+    auto backlog_copy = replyBacklog;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, backlog_copy]{
+        evhttp_send_reply_end(req_copy);
+        // Re-enable reading from the socket, as in WriteReply.
+        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+            evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+            if (conn) {
+                bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+                if (bev) {
+                    bufferevent_enable(bev, EV_READ | EV_WRITE);
+                }
+            }
+        }
+    });
+    ev->trigger(nullptr);
+    replySent = true;
+    req = nullptr; // transferred back to main thread
+}
+
 CService HTTPRequest::GetPeer() const
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
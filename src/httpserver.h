@@ -5,17 +5,21 @@
 #ifndef BITCOIN_HTTPSERVER_H
 #define BITCOIN_HTTPSERVER_H
 
+#include <memory>
 #include <string>
 #include <functional>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+/** Bytes of a chunked reply that may wait to be written to the client before the producer blocks */
+static const size_t MAX_REPLY_BACKLOG = 256 * 1024;
 
 struct evhttp_request;
 struct event_base;
 class CService;
 class HTTPRequest;
+struct HTTPReplyBacklog;
 
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
@@ -58,6 +62,9 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool replyStarted;
+    //! Chunks of a started reply not written to the client yet
+    std::shared_ptr<HTTPReplyBacklog> replyBacklog;
 
 public:
     explicit HTTPRequest(struct evhttp_request* req);
@@ -113,6 +120,30 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a chunked HTTP reply, for a body that is sent while it is being
+     * produced. Follow with any number of WriteReplyChunk calls and finish
+     * with WriteReplyEnd.
+     *
+     * @note Headers have to be written before, the status can't be changed later.
+     */
+    void WriteReplyStart(int nStatus);
+
+    /**
+     * Send the next part of a reply started with WriteReplyStart. Blocks while
+     * more than MAX_REPLY_BACKLOG bytes of the reply are waiting to be written
+     * to the client. A client which stops reading for -rpcservertimeout
+     * doesn't get the rest of the reply.
+     */
+    void WriteReplyChunk(const std::string& strChunk);
+
+    /**
+     * Finish a reply started with WriteReplyStart.
+     *
+     * @note As with WriteReply, do not call any other HTTPRequest methods after calling this.
+     */
+    void WriteReplyEnd();
 };
 
 /** Event handler closure.
@@ -54,6 +54,7 @@
 #include "slogger.h"
 
 #include "mfsnode/init.h"
+#include <util/trace.h>
 
 #define PRESERVE_BLOCK 1
 
@@ -2875,7 +2876,7 @@ void hdd_precache_data(uint64_t chunkid, uint32_t offset, uint32_t size)
 #endif
 }
 
-int hdd_read(uint64_t chunkid, uint32_t version, uint16_t blocknum, uint8_t* buffer, uint32_t offset, uint32_t size, uint8_t* crcbuff)
+static int hdd_int_read(uint64_t chunkid, uint32_t version, uint16_t blocknum, uint8_t* buffer, uint32_t offset, uint32_t size, uint8_t* crcbuff)
 {
     chunk* c;
     int ret;
@@ -3032,7 +3033,16 @@ int hdd_read(uint64_t chunkid, uint32_t version, uint16_t blocknum, uint8_t* buf
     return MFS_STATUS_OK;
 }
 
-int hdd_write(uint64_t chunkid, uint32_t version, uint16_t blocknum, const uint8_t* buffer, uint32_t offset, uint32_t size, const uint8_t* crcbuff)
+int hdd_read(uint64_t chunkid, uint32_t version, uint16_t blocknum, uint8_t* buffer, uint32_t offset, uint32_t size, uint8_t* crcbuff)
+{
+    int status;
+    TRACE5(chunkserver, hdd_read_start, chunkid, version, blocknum, offset, size);
+    status = hdd_int_read(chunkid, version, blocknum, buffer, offset, size, crcbuff);
+    TRACE3(chunkserver, hdd_read_done, chunkid, blocknum, status);
+    return status;
+}
+
+static int hdd_int_write(uint64_t chunkid, uint32_t version, uint16_t blocknum, const uint8_t* buffer, uint32_t offset, uint32_t size, const uint8_t* crcbuff)
 {
     chunk* c;
     int ret;
@@ -3347,6 +3357,15 @@ int hdd_write(uint64_t chunkid, uint32_t version, uint16_t blocknum, const uint8
     return MFS_STATUS_OK;
 }
 
+int hdd_write(uint64_t chunkid, uint32_t version, uint16_t blocknum, const uint8_t* buffer, uint32_t offset, uint32_t size, const uint8_t* crcbuff)
+{
+    int status;
+    TRACE5(chunkserver, hdd_write_start, chunkid, version, blocknum, offset, size);
+    status = hdd_int_write(chunkid, version, blocknum, buffer, offset, size, crcbuff);
+    TRACE3(chunkserver, hdd_write_done, chunkid, blocknum, status);
+    return status;
+}
+
 int hdd_get_blocks(uint64_t chunkid, uint32_t version, uint8_t* blocks_buff)
 {
     chunk* c;
@@ -33,6 +33,7 @@
 #include "mfsstrerr.h"
 #include "slogger.h"
 #include "sockets.h"
+#include <util/trace.h>
 
 #define CONNMSECTO 5000
 #define SENDMSECTO 5000
@@ -432,7 +433,7 @@ static void rep_cleanup(replication* r)
 }
 
 /* srcs: srccnt * (chunkid:64 version:32 ip:32 port:16) */
-uint8_t replicate(uint64_t chunkid, uint32_t version, const uint32_t xormasks[4], uint8_t srccnt, const uint8_t* srcs)
+static uint8_t rep_replicate(uint64_t chunkid, uint32_t version, const uint32_t xormasks[4], uint8_t srccnt, const uint8_t* srcs)
 {
     replication r;
     uint8_t status, i, j, vbuffs, first;
@@ -841,3 +842,12 @@ uint8_t replicate(uint64_t chunkid, uint32_t version, const uint32_t xormasks[4]
     rep_cleanup(&r);
     return MFS_STATUS_OK;
 }
+
+uint8_t replicate(uint64_t chunkid, uint32_t version, const uint32_t xormasks[4], uint8_t srccnt, const uint8_t* srcs)
+{
+    uint8_t status;
+    TRACE3(chunkserver, replicate_start, chunkid, version, srccnt);
+    status = rep_replicate(chunkid, version, xormasks, srccnt, srcs);
+    TRACE2(chunkserver, replicate_done, chunkid, status);
+    return status;
+}
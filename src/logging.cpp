@@ -8,6 +8,9 @@
 #include <util/threadnames.h>
 #include <util/time.h>
 
+#include <algorithm>
+#include <cstdlib>
+
 const char * const DEFAULT_DEBUGLOGFILE = "debug.log";
 
 BCLog::Logger& LogInstance()
@@ -33,6 +36,28 @@ BCLog::Logger& LogInstance()
 
 bool fLogIPs = DEFAULT_LOGIPS;
 
+namespace BCLog {
+/** Bounded single-producer/single-consumer queue of one logging thread */
+struct LogRing
+{
+    struct Entry {
+        uint64_t seq;
+        std::string str;
+        std::string thread_name;
+        int64_t time_micros;
+    };
+    explicit LogRing(const Logger* owner_in) : owner(owner_in) {}
+
+    const Logger* const owner;
+    std::vector<Entry> slots{LOG_ASYNC_RING_SIZE};
+    std::atomic<uint64_t> head{0}; //!< next slot to fill, written by the owning thread
+    std::atomic<uint64_t> tail{0}; //!< next slot to drain, written by the writer thread
+    std::atomic<uint64_t> dropped{0};
+};
+} // namespace BCLog
+
+static thread_local std::shared_ptr<BCLog::LogRing> t_log_ring;
+
 static int FileWriteStr(const std::string &str, FILE *fp)
 {
     return fwrite(str.data(), 1, str.size(), fp);
@@ -74,11 +99,31 @@ bool BCLog::Logger::StartLogging()
     }
     if (m_print_to_console) fflush(stdout);
 
+    if (m_log_async && !m_async_running) {
+        m_async_running = true;
+        m_async_thread = std::thread(&BCLog::Logger::AsyncWriterThread, this);
+        static std::once_flag register_flush;
+        std::call_once(register_flush, [] { std::atexit([] { LogInstance().StopAsyncLogging(); }); });
+    }
+
     return true;
 }
 
+void BCLog::Logger::StopAsyncLogging()
+{
+    if (!m_async_running.exchange(false)) return;
+    m_async_wake_cv.notify_all();
+    if (m_async_thread.joinable()) m_async_thread.join();
+    // Messages pushed by threads that saw m_async_running just before it was cleared
+    while (m_async_inflight.load() != 0) {
+        std::this_thread::yield();
+    }
+    DrainAsync();
+}
+
 void BCLog::Logger::DisconnectTestLogger()
 {
+    StopAsyncLogging();
     StdLockGuard scoped_lock(m_cs);
     m_buffering = true;
     if (m_fileout != nullptr) fclose(m_fileout);
@@ -248,7 +293,7 @@ std::string ListActiveLogCategoriesString()
     return ret;
 }
 
-std::string BCLog::Logger::LogTimestampStr(const std::string& str)
+std::string BCLog::Logger::LogTimestampStr(const std::string& str, int64_t nTimeMicros)
 {
     std::string strStamped;
 
@@ -256,7 +301,6 @@ std::string BCLog::Logger::LogTimestampStr(const std::string& str)
         return str;
 
     if (m_started_new_line) {
-        int64_t nTimeMicros = GetTimeMicros();
         strStamped = FormatISO8601DateTime(nTimeMicros/1000000);
         if (m_log_time_micros) {
             strStamped.pop_back();
@@ -295,26 +339,24 @@ namespace BCLog {
     }
 }
 
-void BCLog::Logger::LogPrintStr(const std::string& str)
+std::string BCLog::Logger::FormatLogStr(const std::string& str_escaped, const std::string& thread_name, int64_t nTimeMicros)
 {
-    StdLockGuard scoped_lock(m_cs);
-    std::string str_prefixed = LogEscapeMessage(str);
+    std::string str_prefixed = str_escaped;
 
     if (m_log_threadnames && m_started_new_line) {
         // 16 chars total, "datos-" is 5 of them and another 1 is a NUL terminator
-        str_prefixed.insert(0, "[" + strprintf("%10s", util::ThreadGetInternalName()) + "] ");
+        str_prefixed.insert(0, "[" + strprintf("%10s", thread_name) + "] ");
     }
 
-    str_prefixed = LogTimestampStr(str_prefixed);
+    str_prefixed = LogTimestampStr(str_prefixed, nTimeMicros);
 
-    m_started_new_line = !str.empty() && str[str.size()-1] == '\n';
+    m_started_new_line = !str_escaped.empty() && str_escaped[str_escaped.size()-1] == '\n';
 
-    if (m_buffering) {
-        // buffer if we haven't started logging yet
-        m_msgs_before_open.push_back(str_prefixed);
-        return;
-    }
+    return str_prefixed;
+}
 
+void BCLog::Logger::WriteLogStr(const std::string& str_prefixed)
+{
     if (m_print_to_console) {
         // print to console
         fwrite(str_prefixed.data(), 1, str_prefixed.size(), stdout);
@@ -340,6 +382,100 @@ void BCLog::Logger::LogPrintStr(const std::string& str)
     }
 }
 
+bool BCLog::Logger::PushAsync(std::string&& str_escaped)
+{
+    if (!t_log_ring || t_log_ring->owner != this) {
+        t_log_ring = std::make_shared<LogRing>(this);
+        StdLockGuard scoped_lock(m_async_cs);
+        m_async_rings.push_back(t_log_ring);
+    }
+    LogRing& ring = *t_log_ring;
+    const uint64_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= LOG_ASYNC_RING_SIZE) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    LogRing::Entry& entry = ring.slots[head % LOG_ASYNC_RING_SIZE];
+    entry.seq = m_async_seq.fetch_add(1, std::memory_order_relaxed);
+    entry.str = std::move(str_escaped);
+    entry.thread_name = m_log_threadnames ? util::ThreadGetInternalName() : std::string();
+    entry.time_micros = GetTimeMicros();
+    ring.head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+void BCLog::Logger::DrainAsync()
+{
+    std::vector<LogRing::Entry> batch;
+    uint64_t dropped = 0;
+    {
+        StdLockGuard scoped_lock(m_async_cs);
+        for (auto it = m_async_rings.begin(); it != m_async_rings.end();) {
+            LogRing& ring = **it;
+            const uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+            const uint64_t head = ring.head.load(std::memory_order_acquire);
+            for (uint64_t i = tail; i != head; ++i) {
+                batch.push_back(std::move(ring.slots[i % LOG_ASYNC_RING_SIZE]));
+            }
+            ring.tail.store(head, std::memory_order_release);
+            dropped += ring.dropped.exchange(0, std::memory_order_relaxed);
+            // The owning thread has exited once we hold the only reference
+            if (it->use_count() == 1 && head == ring.head.load(std::memory_order_acquire)) {
+                it = m_async_rings.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    if (batch.empty() && dropped == 0) return;
+
+    // Rings are drained one after another, restore the order messages were logged in
+    std::sort(batch.begin(), batch.end(), [](const LogRing::Entry& a, const LogRing::Entry& b) { return a.seq < b.seq; });
+
+    StdLockGuard scoped_lock(m_cs);
+    for (const LogRing::Entry& entry : batch) {
+        WriteLogStr(FormatLogStr(entry.str, entry.thread_name, entry.time_micros));
+    }
+    if (dropped != 0) {
+        WriteLogStr(FormatLogStr(strprintf("Logging queue full, dropped %u messages\n", dropped), util::ThreadGetInternalName(), GetTimeMicros()));
+    }
+}
+
+void BCLog::Logger::AsyncWriterThread()
+{
+    util::ThreadRename("logwriter");
+    while (m_async_running) {
+        DrainAsync();
+        std::unique_lock<std::mutex> lock(m_async_wake_mutex);
+        m_async_wake_cv.wait_for(lock, std::chrono::milliseconds(10), [this] { return !m_async_running; });
+    }
+    DrainAsync();
+}
+
+void BCLog::Logger::LogPrintStr(const std::string& str)
+{
+    if (m_async_running.load(std::memory_order_relaxed)) {
+        ++m_async_inflight;
+        if (m_async_running) {
+            PushAsync(LogEscapeMessage(str));
+            --m_async_inflight;
+            return;
+        }
+        --m_async_inflight;
+    }
+
+    StdLockGuard scoped_lock(m_cs);
+    std::string str_prefixed = FormatLogStr(LogEscapeMessage(str), util::ThreadGetInternalName(), GetTimeMicros());
+
+    if (m_buffering) {
+        // buffer if we haven't started logging yet
+        m_msgs_before_open.push_back(str_prefixed);
+        return;
+    }
+
+    WriteLogStr(str_prefixed);
+}
+
 void BCLog::Logger::ShrinkDebugFile()
 {
     // Amount of debug.log to save at end when shrinking (must fit in memory)
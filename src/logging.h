@@ -11,16 +11,22 @@
 #include <threadsafety.h>
 
 #include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 static const bool DEFAULT_LOGTIMEMICROS  = false;
 static const bool DEFAULT_LOGIPS         = false;
 static const bool DEFAULT_LOGTIMESTAMPS  = true;
 static const bool DEFAULT_LOGTHREADNAMES = false;
+static const bool DEFAULT_LOGASYNC       = false;
+//! Messages each logging thread can queue in async mode before new ones are dropped
+static const size_t LOG_ASYNC_RING_SIZE  = 4096;
 extern const char * const DEFAULT_DEBUGLOGFILE;
 
 extern bool fLogThreadNames;
@@ -82,6 +88,8 @@ namespace BCLog {
         ALL         = ~(uint64_t)0,
     };
 
+    struct LogRing;
+
     class Logger
     {
     private:
@@ -94,16 +102,41 @@ namespace BCLog {
         /**
          * m_started_new_line is a state variable that will suppress printing of
          * the timestamp when multiple calls are made that don't end in a
-         * newline.
+         * newline. Async mode updates it on the writer thread, in the order
+         * messages are written.
          */
-        std::atomic_bool m_started_new_line{true};
+        bool m_started_new_line GUARDED_BY(m_cs) = true;
 
         /** Log categories bitfield. */
         std::atomic<uint64_t> m_categories{0};
 
-        std::string LogTimestampStr(const std::string& str);
+        std::string LogTimestampStr(const std::string& str, int64_t nTimeMicros) EXCLUSIVE_LOCKS_REQUIRED(m_cs);
         std::string LogThreadNameStr(const std::string &str);
 
+        /** Prefix an escaped message with the thread name and time it was logged at, if it starts a line */
+        std::string FormatLogStr(const std::string& str_escaped, const std::string& thread_name, int64_t nTimeMicros) EXCLUSIVE_LOCKS_REQUIRED(m_cs);
+        /** Write a formatted message to all outputs */
+        void WriteLogStr(const std::string& str_prefixed) EXCLUSIVE_LOCKS_REQUIRED(m_cs);
+
+        /**
+         * Async mode: each logging thread pushes escaped messages into its own
+         * single-producer ring, and m_async_thread drains all rings, restores the
+         * global order, prefixes and writes them out. Logging threads never block
+         * on m_cs or on file I/O.
+         */
+        StdMutex m_async_cs;
+        std::vector<std::shared_ptr<LogRing>> m_async_rings GUARDED_BY(m_async_cs);
+        std::thread m_async_thread;
+        std::atomic<bool> m_async_running{false};
+        std::atomic<int> m_async_inflight{0};
+        std::atomic<uint64_t> m_async_seq{0};
+        std::mutex m_async_wake_mutex;
+        std::condition_variable m_async_wake_cv;
+
+        bool PushAsync(std::string&& str_escaped);
+        void DrainAsync();
+        void AsyncWriterThread();
+
         /** Slots that connect to the print signal */
         std::list<std::function<void(const std::string&)>> m_print_callbacks /* GUARDED_BY(m_cs) */ {};
 
@@ -114,6 +147,7 @@ namespace BCLog {
         bool m_log_timestamps = DEFAULT_LOGTIMESTAMPS;
         bool m_log_time_micros = DEFAULT_LOGTIMEMICROS;
         bool m_log_threadnames = DEFAULT_LOGTHREADNAMES;
+        bool m_log_async = DEFAULT_LOGASYNC;
 
         fs::path m_file_path;
         std::atomic<bool> m_reopen_file{false};
@@ -145,6 +179,8 @@ namespace BCLog {
 
         /** Start logging (and flush all buffered messages) */
         bool StartLogging();
+        /** Write out all queued async messages and return to synchronous logging */
+        void StopAsyncLogging();
         /** Only for testing */
         void DisconnectTestLogger();
 
@@ -33,6 +33,7 @@
 #include <masternode/payments.h>
 
 #include <algorithm>
+#include <functional>
 #include <utility>
 
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev)
@@ -53,11 +54,13 @@ int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParam
 BlockAssembler::Options::Options() {
     blockMinFeeRate = CFeeRate(DEFAULT_BLOCK_MIN_TX_FEE);
     nBlockMaxSize = DEFAULT_BLOCK_MAX_SIZE;
+    fIncrementalTemplate = false;
 }
 
 BlockAssembler::BlockAssembler(const CChainParams& params, const Options& options) : chainparams(params)
 {
     blockMinFeeRate = options.blockMinFeeRate;
+    fIncrementalTemplate = options.fIncrementalTemplate;
     // Limit size to between 1K and MaxBlockSize()-1K for sanity:
     nBlockMaxSize = std::max((unsigned int)1000, std::min((unsigned int)(MaxBlockSize(fDIP0001ActiveAtTip) - 1000), (unsigned int)options.nBlockMaxSize));
 }
@@ -76,6 +79,7 @@ static BlockAssembler::Options DefaultOptions()
     } else {
         options.blockMinFeeRate = CFeeRate(DEFAULT_BLOCK_MIN_TX_FEE);
     }
+    options.fIncrementalTemplate = gArgs.GetBoolArg("-incrementaltemplate", DEFAULT_INCREMENTAL_TEMPLATE);
     return options;
 }
 
@@ -84,6 +88,11 @@ BlockAssembler::BlockAssembler(const CChainParams& params) : BlockAssembler(para
 void BlockAssembler::resetBlock()
 {
     inBlock.clear();
+    fSizeLimited = false;
+    fBelowMinFee = false;
+    notFinalTx.clear();
+    minPackageScore = nullopt;
+    belowMinFeeScore = nullopt;
 
     // Reserve space for coinbase tx
     nBlockSize = 1000;
@@ -155,7 +164,12 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
-    addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    if (fIncrementalTemplate) {
+        static BlockTemplateCandidate candidate(mempool);
+        addCandidateTxs(candidate, nPackagesSelected, nDescendantsUpdated);
+    } else {
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    }
 
     int64_t nTime1 = GetTimeMicros();
 
@@ -422,21 +436,28 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
         uint64_t packageSize = iter->GetSizeWithAncestors();
         CAmount packageFees = iter->GetModFeesWithAncestors();
         unsigned int packageSigOps = iter->GetSigOpCountWithAncestors();
+        PackageScore score;
         if (fUsingModified) {
             packageSize = modit->nSizeWithAncestors;
             packageFees = modit->nModFeesWithAncestors;
             packageSigOps = modit->nSigOpCountWithAncestors;
+            CompareTxMemPoolEntryByAncestorFee().GetModFeeAndSize(*modit, score.dFees, score.dSize);
+        } else {
+            CompareTxMemPoolEntryByAncestorFee().GetModFeeAndSize(*iter, score.dFees, score.dSize);
         }
 
         if (packageFees < blockMinFeeRate.GetFee(packageSize)) {
             CAmount pseudoTokenFees = TokentxInMempool() * 1000;
             // Everything else we might consider has a lower fee rate
             if (packageFees + pseudoTokenFees < blockMinFeeRate.GetFee(packageSize)) {
+                fBelowMinFee = true;
+                belowMinFeeScore = score;
                 return;
             }
         }
 
         if (!TestPackage(packageSize, packageSigOps)) {
+            fSizeLimited = true;
             if (fUsingModified) {
                 // Since we always look at the best entry in mapModifiedTx,
                 // we must erase failed entries so that we can consider the
@@ -464,6 +485,7 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
 
         // Test if all tx's are Final and safe
         if (!TestPackageTransactions(ancestors)) {
+            notFinalTx.insert(iter);
             if (fUsingModified) {
                 mapModifiedTx.get<ancestor_score>().erase(modit);
                 failedTx.insert(iter);
@@ -485,12 +507,247 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
         }
 
         ++nPackagesSelected;
+        if (!minPackageScore || *minPackageScore > score) minPackageScore = score;
 
         // Update transactions that depend on each of these
         nDescendantsUpdated += UpdatePackagesForAdded(ancestors, mapModifiedTx);
     }
 }
 
+BlockTemplateCandidate::BlockTemplateCandidate(CTxMemPool& pool)
+{
+    m_connNotifyEntryAdded = pool.NotifyEntryAdded.connect(std::bind(&BlockTemplateCandidate::TransactionAddedToMempool, this, std::placeholders::_1));
+    m_connNotifyEntryRemoved = pool.NotifyEntryRemoved.connect(std::bind(&BlockTemplateCandidate::TransactionRemovedFromMempool, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+void BlockTemplateCandidate::TransactionAddedToMempool(CTransactionRef tx)
+{
+    LOCK(cs);
+    ++nNotifications;
+    if (!fValid) return;
+    vAdded.emplace_back(tx->GetHash());
+    fTokenTxChanged |= IsTokenOnlyTx(*tx);
+}
+
+void BlockTemplateCandidate::TransactionRemovedFromMempool(CTransactionRef tx, MemPoolRemovalReason reason)
+{
+    LOCK(cs);
+    ++nNotifications;
+    // A block was connected, the candidate is made anew for the new tip anyway
+    if (!fValid || reason == MemPoolRemovalReason::BLOCK) return;
+    setRemoved.emplace(tx->GetHash());
+    fTokenTxChanged |= IsTokenOnlyTx(*tx);
+}
+
+void BlockAssembler::addCandidateTxs(BlockTemplateCandidate& candidate, int &nPackagesSelected, int &nDescendantsUpdated)
+{
+    LOCK(candidate.cs);
+
+    const uint64_t nReservedSize = nBlockSize;
+    const size_t nReservedTx = pblocktemplate->block.vtx.size();
+    const unsigned int nReservedSigOps = nBlockSigOps;
+    if (!UpdateCandidate(candidate, nPackagesSelected, nDescendantsUpdated)) {
+        // Undo what was added before the candidate turned out unusable
+        auto& vtx = pblocktemplate->block.vtx;
+        vtx.resize(nReservedTx);
+        pblocktemplate->vTxFees.resize(nReservedTx);
+        pblocktemplate->vTxSigOps.resize(nReservedTx);
+        nBlockTx -= inBlock.size();
+        nBlockSize = nReservedSize;
+        nBlockSigOps = nReservedSigOps;
+        nFees = 0;
+        inBlock.clear();
+        nPackagesSelected = 0;
+        nDescendantsUpdated = 0;
+
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+
+        candidate.fValid = true;
+        candidate.hashTip = ::ChainActive().Tip()->GetBlockHash();
+        candidate.nBlockMaxSize = nBlockMaxSize;
+        candidate.blockMinFeeRate = blockMinFeeRate;
+        candidate.nReservedSize = nReservedSize;
+        candidate.vSelected.clear();
+        for (size_t i = nReservedTx; i < vtx.size(); i++) {
+            candidate.vSelected.emplace_back(vtx[i]->GetHash());
+        }
+        candidate.setDeferred.clear();
+        for (CTxMemPool::txiter it : notFinalTx) {
+            if (!inBlock.count(it)) candidate.setDeferred.emplace(it->GetTx().GetHash());
+        }
+        candidate.fSizeLimited = fSizeLimited;
+        candidate.fBelowMinFee = fBelowMinFee;
+        candidate.minSelectedScore = minPackageScore;
+        candidate.belowMinFeeScore = belowMinFeeScore;
+    }
+
+    candidate.vAdded.clear();
+    candidate.setRemoved.clear();
+    candidate.fTokenTxChanged = false;
+    candidate.nTransactionsUpdated = mempool.GetTransactionsUpdated();
+    candidate.nNotifications = 0;
+}
+
+bool BlockAssembler::UpdateCandidate(BlockTemplateCandidate& candidate, int &nPackagesSelected, int &nDescendantsUpdated)
+{
+    if (!candidate.fValid ||
+        candidate.hashTip != ::ChainActive().Tip()->GetBlockHash() ||
+        candidate.nBlockMaxSize != nBlockMaxSize ||
+        candidate.blockMinFeeRate != blockMinFeeRate ||
+        candidate.nReservedSize != nBlockSize ||
+        mempool.GetTransactionsUpdated() != candidate.nTransactionsUpdated + candidate.nNotifications) {
+        return false;
+    }
+    // Freed space or a changed token pseudo fee could let in packages
+    // that were left out, without them showing up as added
+    if (candidate.fSizeLimited && !candidate.setRemoved.empty()) return false;
+    if (candidate.fBelowMinFee && candidate.fTokenTxChanged) return false;
+
+    // Keep the previous selection, minus what left the mempool. A removed
+    // transaction takes its descendants with it, so the rest stays in order.
+    std::vector<uint256> vSelected;
+    vSelected.reserve(candidate.vSelected.size());
+    for (const uint256& hash : candidate.vSelected) {
+        if (candidate.setRemoved.count(hash)) continue;
+        CTxMemPool::txiter it = mempool.mapTx.find(hash);
+        if (it == mempool.mapTx.end()) return false;
+        // The lock time cutoff and whether a transaction is safe to mine
+        // can change without the mempool changing
+        if (!TestPackageTransactions({it})) return false;
+        AddToBlock(it);
+        vSelected.emplace_back(hash);
+    }
+    candidate.vSelected = std::move(vSelected);
+
+    // Packages of the new and the deferred transactions, best first like in
+    // addPackageTxs. Their scores leave out ancestors already in the block.
+    struct QueuedPackage {
+        PackageScore score;
+        CTxMemPool::txiter iter;
+        bool operator<(const QueuedPackage& other) const
+        {
+            if (score > other.score) return true;
+            if (other.score > score) return false;
+            return iter->GetTx().GetHash() < other.iter->GetTx().GetHash();
+        }
+    };
+    std::set<QueuedPackage> queue;
+    std::map<CTxMemPool::txiter, PackageScore, CompareIteratorByHash> mapQueued;
+    auto calculatePackage = [&](CTxMemPool::txiter iter, CTxMemPool::setEntries& ancestors, uint64_t& packageSize, CAmount& packageFees, unsigned int& packageSigOps) {
+        uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+        std::string dummy;
+        mempool.CalculateMemPoolAncestors(*iter, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+        onlyUnconfirmed(ancestors);
+        ancestors.insert(iter);
+
+        packageSize = 0;
+        packageFees = 0;
+        packageSigOps = 0;
+        for (CTxMemPool::txiter it : ancestors) {
+            packageSize += it->GetTxSize();
+            packageFees += it->GetModifiedFee();
+            packageSigOps += it->GetSigOpCount();
+        }
+        // the lower of the package's and the transaction's own fee rate
+        PackageScore score{(double)packageFees, (double)packageSize};
+        const PackageScore own{(double)iter->GetModifiedFee(), (double)iter->GetTxSize()};
+        return score > own ? own : score;
+    };
+    auto enqueue = [&](CTxMemPool::txiter iter) {
+        if (inBlock.count(iter)) return;
+        auto qit = mapQueued.find(iter);
+        if (qit != mapQueued.end()) {
+            queue.erase({qit->second, iter});
+            mapQueued.erase(qit);
+        }
+        CTxMemPool::setEntries ancestors;
+        uint64_t packageSize;
+        CAmount packageFees;
+        unsigned int packageSigOps;
+        const PackageScore score = calculatePackage(iter, ancestors, packageSize, packageFees, packageSigOps);
+        queue.insert({score, iter});
+        mapQueued.emplace(iter, score);
+    };
+    for (const uint256& hash : candidate.vAdded) {
+        CTxMemPool::txiter it = mempool.mapTx.find(hash);
+        if (it != mempool.mapTx.end()) enqueue(it);
+    }
+    for (auto dit = candidate.setDeferred.begin(); dit != candidate.setDeferred.end(); ) {
+        CTxMemPool::txiter it = mempool.mapTx.find(*dit);
+        if (it == mempool.mapTx.end()) {
+            dit = candidate.setDeferred.erase(dit);
+            continue;
+        }
+        enqueue(it);
+        ++dit;
+    }
+
+    Optional<CAmount> pseudoTokenFees;
+    while (!queue.empty()) {
+        const QueuedPackage best = *queue.begin();
+        queue.erase(queue.begin());
+        mapQueued.erase(best.iter);
+        CTxMemPool::txiter iter = best.iter;
+
+        // A full selection stops at the package below the minimum fee rate
+        if (candidate.belowMinFeeScore && !(best.score > *candidate.belowMinFeeScore)) {
+            if (*candidate.belowMinFeeScore > best.score) break;
+            return false;
+        }
+
+        CTxMemPool::setEntries ancestors;
+        uint64_t packageSize;
+        CAmount packageFees;
+        unsigned int packageSigOps;
+        calculatePackage(iter, ancestors, packageSize, packageFees, packageSigOps);
+
+        // Skipped by a full selection as well, wherever it comes in the order
+        if (!TestPackageTransactions(ancestors)) {
+            candidate.setDeferred.emplace(iter->GetTx().GetHash());
+            continue;
+        }
+
+        // A full selection takes a package at least as good as a selected one before it
+        if (candidate.minSelectedScore && !(*candidate.minSelectedScore > best.score)) return false;
+
+        if (packageFees < blockMinFeeRate.GetFee(packageSize)) {
+            if (!pseudoTokenFees) pseudoTokenFees = TokentxInMempool() * 1000;
+            // Everything else we might consider has a lower fee rate
+            if (packageFees + *pseudoTokenFees < blockMinFeeRate.GetFee(packageSize)) {
+                candidate.fBelowMinFee = true;
+                candidate.belowMinFeeScore = best.score;
+                break;
+            }
+        }
+
+        // The package might only fit in place of selected ones, which is
+        // for the full selection to decide
+        if (!TestPackage(packageSize, packageSigOps)) return false;
+
+        std::vector<CTxMemPool::txiter> sortedEntries;
+        SortForBlock(ancestors, sortedEntries);
+        for (CTxMemPool::txiter it : sortedEntries) {
+            AddToBlock(it);
+            candidate.vSelected.emplace_back(it->GetTx().GetHash());
+            candidate.setDeferred.erase(it->GetTx().GetHash());
+        }
+        ++nPackagesSelected;
+        candidate.minSelectedScore = best.score;
+
+        // Descendants left out before may qualify now that their ancestors are in
+        for (CTxMemPool::txiter it : ancestors) {
+            CTxMemPool::setEntries descendants;
+            mempool.CalculateDescendants(it, descendants);
+            for (CTxMemPool::txiter desc : descendants) {
+                if (inBlock.count(desc)) continue;
+                ++nDescendantsUpdated;
+                enqueue(desc);
+            }
+        }
+    }
+    return true;
+}
+
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
@@ -12,6 +12,7 @@
 #include <validation.h>
 
 #include <memory>
+#include <set>
 #include <stdint.h>
 
 #include <boost/multi_index_container.hpp>
@@ -25,6 +26,7 @@ class CScript;
 namespace Consensus { struct Params; };
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+static const bool DEFAULT_INCREMENTAL_TEMPLATE = true;
 
 struct CBlockTemplate
 {
@@ -125,6 +127,68 @@ struct update_for_parent_inclusion
     CTxMemPool::txiter iter;
 };
 
+/** Fee and size addPackageTxs orders a package by, see CompareTxMemPoolEntryByAncestorFee */
+struct PackageScore {
+    double dFees{0};
+    double dSize{1};
+
+    bool operator>(const PackageScore& other) const { return dFees * other.dSize > other.dFees * dSize; }
+};
+
+/**
+ * The transactions selected for the last block template, kept in sync with
+ * the mempool in between templates. The mempool notifications only record
+ * which transactions came and went; the next CreateNewBlock drops the removed
+ * ones and selects the packages of the added ones (and of their descendants)
+ * on top of the previous selection, instead of walking the whole mempool.
+ */
+class BlockTemplateCandidate
+{
+public:
+    explicit BlockTemplateCandidate(CTxMemPool& pool);
+
+private:
+    friend class BlockAssembler;
+
+    void TransactionAddedToMempool(CTransactionRef tx);
+    void TransactionRemovedFromMempool(CTransactionRef tx, MemPoolRemovalReason reason);
+
+    Mutex cs;
+
+    boost::signals2::scoped_connection m_connNotifyEntryAdded;
+    boost::signals2::scoped_connection m_connNotifyEntryRemoved;
+
+    //! Whether the fields below describe a selection at all
+    bool fValid GUARDED_BY(cs){false};
+    //! What the selection was made for; it is started over if any of these change
+    uint256 hashTip GUARDED_BY(cs);
+    unsigned int nBlockMaxSize GUARDED_BY(cs){0};
+    CFeeRate blockMinFeeRate GUARDED_BY(cs);
+    uint64_t nReservedSize GUARDED_BY(cs){0};
+    //! Selected transactions in block order
+    std::vector<uint256> vSelected GUARDED_BY(cs);
+    //! Transactions that were not final or not safe to mine yet, retried every time
+    std::set<uint256> setDeferred GUARDED_BY(cs);
+    //! A package did not fit, so new ones could displace selected transactions
+    bool fSizeLimited GUARDED_BY(cs){false};
+    //! A package was below the minimum fee rate, which depends on the token transactions in the mempool
+    bool fBelowMinFee GUARDED_BY(cs){false};
+    //! Lowest score of the selected packages; new packages are appended only
+    //! below it, a better one goes before selected ones in a full selection
+    Optional<PackageScore> minSelectedScore GUARDED_BY(cs);
+    //! Score of the package the selection stopped at for the minimum fee rate
+    Optional<PackageScore> belowMinFeeScore GUARDED_BY(cs);
+
+    //! Mempool changes since the selection was made
+    std::vector<uint256> vAdded GUARDED_BY(cs);
+    std::set<uint256> setRemoved GUARDED_BY(cs);
+    bool fTokenTxChanged GUARDED_BY(cs){false};
+    //! Mempool update counter when the selection was made. Changes we are not
+    //! notified of (fee deltas, a cleared mempool) show up as a mismatch.
+    unsigned int nTransactionsUpdated GUARDED_BY(cs){0};
+    unsigned int nNotifications GUARDED_BY(cs){0};
+};
+
 /** Generate a new block, without valid proof-of-work */
 class BlockAssembler
 {
@@ -135,6 +199,7 @@ private:
     // Configuration parameters for the block size
     unsigned int nBlockMaxSize;
     CFeeRate blockMinFeeRate;
+    bool fIncrementalTemplate;
 
     // Information on the current status of the block
     uint64_t nBlockSize;
@@ -143,6 +208,13 @@ private:
     CAmount nFees;
     CTxMemPool::setEntries inBlock;
 
+    // Why packages were left out, for the template candidate
+    bool fSizeLimited;
+    bool fBelowMinFee;
+    CTxMemPool::setEntries notFinalTx;
+    Optional<PackageScore> minPackageScore;
+    Optional<PackageScore> belowMinFeeScore;
+
     // Chain context for the block
     int nHeight;
     int64_t nLockTimeCutoff;
@@ -153,6 +225,8 @@ public:
         Options();
         size_t nBlockMaxSize;
         CFeeRate blockMinFeeRate;
+        //! Update the shared template candidate instead of selecting from scratch
+        bool fIncrementalTemplate;
     };
 
     explicit BlockAssembler(const CChainParams& params);
@@ -196,6 +270,14 @@ private:
       * state updated assuming given transactions are inBlock. Returns number
       * of updated descendants. */
     int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
+
+    /** Add the transactions of the template candidate, updated for the mempool
+      * changes since it was made, or fall back to addPackageTxs and make a new
+      * candidate from its result. */
+    void addCandidateTxs(BlockTemplateCandidate& candidate, int &nPackagesSelected, int &nDescendantsUpdated) EXCLUSIVE_LOCKS_REQUIRED(cs_main, mempool.cs);
+    /** Try to update the candidate for the recorded mempool changes, adding its
+      * transactions to the block. Returns false if it has to be made anew. */
+    bool UpdateCandidate(BlockTemplateCandidate& candidate, int &nPackagesSelected, int &nDescendantsUpdated) EXCLUSIVE_LOCKS_REQUIRED(cs_main, mempool.cs, candidate.cs);
 };
 
 /** Modify the extranonce in a block */
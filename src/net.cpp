@@ -35,6 +35,7 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <sys/uio.h>
 #endif
 
 #ifdef USE_POLL
@@ -59,6 +60,9 @@ static constexpr int DUMP_PEERS_INTERVAL = 15 * 60;
 /** Number of DNS seeds to query when the number of connections is low. */
 static constexpr int DNSSEEDS_TO_QUERY_AT_ONCE = 3;
 
+/** Maximum number of queued send buffers passed to a single sendmsg() call. */
+static constexpr size_t MAX_SEND_IOVECS = 64;
+
 // We add a random period time (0 to 1 seconds) to feeler connections to prevent synchronization.
 #define FEELER_SLEEP_WINDOW 1
 
@@ -630,6 +634,25 @@ void CNode::copyStats(CNodeStats &stats, const std::vector<bool> &m_asmap)
 }
 #undef X
 
+/** Interned per-message-type statsd counters, unknown commands are accounted as NET_MESSAGE_COMMAND_OTHER */
+static const statsd::MetricFamily& NetMsgStatsRecvBytes()
+{
+    static const statsd::MetricFamily family(statsClient, "bandwidth.message.", getAllNetMessageTypes(), ".bytesReceived", statsd::MetricType::COUNTER, NET_MESSAGE_COMMAND_OTHER);
+    return family;
+}
+
+static const statsd::MetricFamily& NetMsgStatsSentBytes()
+{
+    static const statsd::MetricFamily family(statsClient, "bandwidth.message.", getAllNetMessageTypes(), ".bytesSent", statsd::MetricType::COUNTER, NET_MESSAGE_COMMAND_OTHER);
+    return family;
+}
+
+static const statsd::MetricFamily& NetMsgStatsSent()
+{
+    static const statsd::MetricFamily family(statsClient, "message.sent.", getAllNetMessageTypes(), "", statsd::MetricType::COUNTER, NET_MESSAGE_COMMAND_OTHER);
+    return family;
+}
+
 bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete)
 {
     complete = false;
@@ -656,7 +679,7 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
                 i = mapRecvBytesPerMsgCmd.find(NET_MESSAGE_COMMAND_OTHER);
             assert(i != mapRecvBytesPerMsgCmd.end());
             i->second += msg.m_raw_message_size;
-            statsClient.count("bandwidth.message." + std::string(msg.m_command) + ".bytesReceived", msg.m_raw_message_size, 1.0f);
+            statsClient.count(NetMsgStatsRecvBytes().get(i->first), msg.m_raw_message_size);
 
             // push the message to the process queue,
             vRecvMsg.push_back(std::move(msg));
@@ -694,6 +717,91 @@ int CNode::GetSendVersion() const
     return nSendVersion;
 }
 
+int CRecvBufferPool::SizeClass(size_t nSize)
+{
+    int nBits = MIN_BUFFER_BITS;
+    while ((size_t{1} << nBits) < nSize) {
+        nBits++;
+    }
+    return nBits - MIN_BUFFER_BITS;
+}
+
+CSerializeData CRecvBufferPool::Acquire(size_t nSize)
+{
+    assert(nSize <= MAX_BUFFER_SIZE);
+    const int nClass = SizeClass(nSize);
+    {
+        LOCK(cs);
+        if (!vFree[nClass].empty()) {
+            CSerializeData buf = std::move(vFree[nClass].back());
+            vFree[nClass].pop_back();
+            return buf;
+        }
+    }
+    CSerializeData buf;
+    buf.reserve(size_t{1} << (nClass + MIN_BUFFER_BITS));
+    return buf;
+}
+
+void CRecvBufferPool::Release(CSerializeData&& buf)
+{
+    const size_t nCapacity = buf.capacity();
+    // only take back what Acquire() handed out
+    if (nCapacity < MIN_BUFFER_SIZE || nCapacity > MAX_BUFFER_SIZE || (nCapacity & (nCapacity - 1)) != 0) {
+        return;
+    }
+    const int nClass = SizeClass(nCapacity);
+    buf.clear();
+    LOCK(cs);
+    if ((vFree[nClass].size() + 1) * nCapacity <= MAX_POOLED_BYTES) {
+        vFree[nClass].push_back(std::move(buf));
+    }
+}
+
+size_t CRecvBufferPool::GetPooledBytes() const
+{
+    LOCK(cs);
+    size_t nBytes = 0;
+    for (size_t i = 0; i < vFree.size(); i++) {
+        nBytes += vFree[i].size() * (size_t{1} << (i + MIN_BUFFER_BITS));
+    }
+    return nBytes;
+}
+
+CRecvBufferPool& CRecvBufferPool::Get()
+{
+    static CRecvBufferPool pool;
+    return pool;
+}
+
+CNetMessage& CNetMessage::operator=(CNetMessage&& other)
+{
+    if (this != &other) {
+        ReleaseBuffer();
+        m_recv = std::move(other.m_recv);
+        m_time = other.m_time;
+        m_valid_netmagic = other.m_valid_netmagic;
+        m_valid_header = other.m_valid_header;
+        m_valid_checksum = other.m_valid_checksum;
+        m_message_size = other.m_message_size;
+        m_raw_message_size = other.m_raw_message_size;
+        m_command = std::move(other.m_command);
+    }
+    return *this;
+}
+
+CNetMessage::~CNetMessage()
+{
+    ReleaseBuffer();
+}
+
+void CNetMessage::ReleaseBuffer()
+{
+    CSerializeData buf;
+    m_recv.swap_buffer(buf);
+    CRecvBufferPool::Get().Release(std::move(buf));
+}
+
 int V1TransportDeserializer::readHeader(const char *pch, unsigned int nBytes)
 {
     // copy data to temporary parsing buffer
@@ -720,6 +828,14 @@ int V1TransportDeserializer::readHeader(const char *pch, unsigned int nBytes)
         return -1;
     }
 
+    // get a buffer large enough for the whole payload, larger messages are
+    // only allocated as their data arrives (see readData)
+    if (hdr.nMessageSize <= CRecvBufferPool::MAX_BUFFER_SIZE) {
+        CSerializeData buf = CRecvBufferPool::Get().Acquire(hdr.nMessageSize);
+        vRecv.swap_buffer(buf);
+        CRecvBufferPool::Get().Release(std::move(buf));
+    }
+
     // switch state to reading message data
     in_data = true;
 
@@ -781,12 +897,10 @@ CNetMessage V1TransportDeserializer::GetMessage(const CMessageHeader::MessageSta
     return msg;
 }
 
-void V1TransportSerializer::prepareForTransport(CSerializedNetMsg& msg, std::vector<unsigned char>& header) {
-    // create dbl-sha256 checksum
-    uint256 hash = Hash(msg.data.begin(), msg.data.end());
-
+static void MakeV1Header(const std::string& command, size_t nSize, const uint256& hash, std::vector<unsigned char>& header)
+{
     // create header
-    CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), msg.data.size());
+    CMessageHeader hdr(Params().MessageStart(), command.c_str(), nSize);
     memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
     // serialize header
@@ -794,33 +908,76 @@ void V1TransportSerializer::prepareForTransport(CSerializedNetMsg& msg, std::vec
     CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, header, 0, hdr};
 }
 
+void V1TransportSerializer::prepareForTransport(CSerializedNetMsg& msg, std::vector<unsigned char>& header) {
+    // create dbl-sha256 checksum
+    uint256 hash = Hash(msg.data.begin(), msg.data.end());
+    MakeV1Header(msg.command, msg.data.size(), hash, header);
+}
+
+void V1TransportSerializer::prepareForTransport(const CSharedNetMsg& msg, std::vector<unsigned char>& header) {
+    // the checksum was computed once when the message was serialized
+    MakeV1Header(msg.command, msg.data.size(), msg.hash, header);
+}
+
+CSharedNetMsg::CSharedNetMsg(CSerializedNetMsg&& msg) :
+    data(std::move(msg.data)),
+    command(std::move(msg.command)),
+    hash(Hash(data.begin(), data.end()))
+{
+}
+
 size_t CConnman::SocketSendData(CNode *pnode) EXCLUSIVE_LOCKS_REQUIRED(pnode->cs_vSend)
 {
     auto it = pnode->vSendMsg.begin();
     size_t nSentSize = 0;
 
     while (it != pnode->vSendMsg.end()) {
-        const auto &data = *it;
-        assert(data.size() > pnode->nSendOffset);
+        assert(it->Size() > pnode->nSendOffset);
+        // Hand as many queued buffers as possible to the kernel in one call
+        size_t nToSend = 0;
         int nBytes = 0;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 break;
-            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+#ifdef WIN32
+            nToSend = it->Size() - pnode->nSendOffset;
+            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(it->Data()) + pnode->nSendOffset, nToSend, MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+            struct iovec iov[MAX_SEND_IOVECS];
+            size_t nIov = 0;
+            for (auto jt = it; jt != pnode->vSendMsg.end() && nIov < MAX_SEND_IOVECS; ++jt, ++nIov) {
+                const size_t nOffset = nIov == 0 ? pnode->nSendOffset : 0;
+                iov[nIov].iov_base = const_cast<unsigned char*>(jt->Data()) + nOffset;
+                iov[nIov].iov_len = jt->Size() - nOffset;
+                nToSend += iov[nIov].iov_len;
+            }
+            struct msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = nIov;
+            nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
         }
         if (nBytes > 0) {
             pnode->nLastSend = GetSystemTimeInSeconds();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             nSentSize += nBytes;
-            if (pnode->nSendOffset == data.size()) {
+            // drop the buffers which were sent completely
+            size_t nRemaining = nBytes;
+            while (nRemaining > 0) {
+                const size_t nLeft = it->Size() - pnode->nSendOffset;
+                if (nRemaining < nLeft) {
+                    pnode->nSendOffset += nRemaining;
+                    break;
+                }
+                nRemaining -= nLeft;
                 pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
-                pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+                pnode->nSendSize -= it->Size();
                 it++;
-            } else {
-                // could not send full message; stop sending more
+            }
+            pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+            if ((size_t)nBytes < nToSend) {
+                // could not send everything; stop sending more
                 pnode->fCanSendData = false;
                 break;
             }
@@ -1903,6 +2060,53 @@ void CConnman::ThreadSocketHandler()
     }
 }
 
+void CConnman::QueueMessageToWorker(CNode* pnode, CNetMessage&& msg)
+{
+    assert(!vMessageWorkers.empty());
+    CMessageWorker& worker = *vMessageWorkers[pnode->GetId() % vMessageWorkers.size()];
+    pnode->AddRef();
+    pnode->nPendingWorkerMessages++;
+    {
+        LOCK(worker.cs);
+        worker.queue.emplace_back(pnode, std::move(msg));
+    }
+    worker.cond.notify_one();
+}
+
+void CConnman::ThreadMessageWorker(CMessageWorker& worker)
+{
+    while (!flagInterruptMsgProc) {
+        std::list<std::pair<CNode*, CNetMessage>> items;
+        {
+            WAIT_LOCK(worker.cs, lock);
+            worker.cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(worker.cs) { return flagInterruptMsgProc || !worker.queue.empty(); });
+            if (flagInterruptMsgProc) {
+                return;
+            }
+            items.splice(items.begin(), worker.queue, worker.queue.begin());
+        }
+
+        ProcessWorkerItem(items.front().first, items.front().second);
+        // messages of this peer that need the main handler may be waiting for us
+        WakeMessageHandler();
+    }
+}
+
+void CConnman::ProcessWorkerItem(CNode* pnode, CNetMessage& msg)
+{
+    if (!pnode->fDisconnect) {
+        m_msgproc->ProcessWorkerMessage(pnode, msg, flagInterruptMsgProc);
+    }
+    {
+        // the message counted against -maxreceivebuffer until it was processed
+        LOCK(pnode->cs_vProcessMsg);
+        pnode->nProcessQueueSize -= msg.m_raw_message_size;
+        pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
+    }
+    pnode->nPendingWorkerMessages--;
+    pnode->Release();
+}
+
 void CConnman::WakeMessageHandler()
 {
     {
@@ -2604,6 +2808,7 @@ void CConnman::ThreadMessageHandler()
 
     while (!flagInterruptMsgProc)
     {
+        const int64_t nLoopStart = GetTimeMicros();
         std::vector<CNode*> vNodesCopy = CopyNodeVector();
 
         bool fMoreWork = false;
@@ -2626,8 +2831,10 @@ void CConnman::ThreadMessageHandler()
                 return;
             // Send messages
             if (!fSkipSendMessagesForMasternodes || !pnode->m_masternode_connection) {
+                const int64_t nSendStart = GetTimeMicros();
                 LOCK(pnode->cs_sendProcessing);
                 m_msgproc->SendMessages(pnode);
+                m_msg_stats.RecordSendMessages(GetNetMsgPeerClass(pnode), GetTimeMicros() - nSendStart);
             }
 
             if (flagInterruptMsgProc)
@@ -2636,11 +2843,15 @@ void CConnman::ThreadMessageHandler()
 
         ReleaseNodeVector(vNodesCopy);
 
-        WAIT_LOCK(mutexMsgProc, lock);
-        if (!fMoreWork) {
-            condMsgProc.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100), [this]() EXCLUSIVE_LOCKS_REQUIRED(mutexMsgProc) { return fMsgProcWake; });
+        const int64_t nBusyEnd = GetTimeMicros();
+        {
+            WAIT_LOCK(mutexMsgProc, lock);
+            if (!fMoreWork) {
+                condMsgProc.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100), [this]() EXCLUSIVE_LOCKS_REQUIRED(mutexMsgProc) { return fMsgProcWake; });
+            }
+            fMsgProcWake = false;
         }
-        fMsgProcWake = false;
+        m_msg_stats.RecordHandlerLoop(nBusyEnd - nLoopStart, GetTimeMicros() - nBusyEnd);
     }
 }
 
@@ -3018,9 +3229,14 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
 
     // Process messages
     threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
+    for (int i = 0; i < nMessageWorkerThreads; i++) {
+        vMessageWorkers.emplace_back(std::make_unique<CMessageWorker>());
+        CMessageWorker& worker = *vMessageWorkers.back();
+        worker.thread = std::thread(&TraceThread<std::function<void()> >, strprintf("msgwork.%d", i), std::function<void()>(std::bind(&CConnman::ThreadMessageWorker, this, std::ref(worker))));
+    }
 
     // Dump network addresses
-    scheduler.scheduleEvery(std::bind(&CConnman::DumpAddresses, this), DUMP_PEERS_INTERVAL * 1000);
+    scheduler.scheduleEvery(std::bind(&CConnman::DumpAddresses, this), DUMP_PEERS_INTERVAL * 1000, CScheduler::Priority::LOW, "dumpaddresses");
 
     return true;
 }
@@ -3055,6 +3271,11 @@ void CConnman::Interrupt()
         flagInterruptMsgProc = true;
     }
     condMsgProc.notify_all();
+    for (auto& worker : vMessageWorkers) {
+        // take the lock so a worker can't miss the interrupt between checking it and waiting
+        WITH_LOCK(worker->cs, );
+        worker->cond.notify_all();
+    }
 
     interruptNet();
     InterruptSocks5(true);
@@ -3076,6 +3297,17 @@ void CConnman::Stop()
 {
     if (threadMessageHandler.joinable())
         threadMessageHandler.join();
+    for (auto& worker : vMessageWorkers) {
+        if (worker->thread.joinable())
+            worker->thread.join();
+        LOCK(worker->cs);
+        for (auto& item : worker->queue) {
+            item.first->nPendingWorkerMessages--;
+            item.first->Release();
+        }
+        worker->queue.clear();
+    }
+    vMessageWorkers.clear();
     if (threadOpenMasternodeConnections.joinable())
         threadOpenMasternodeConnections.join();
     if (threadOpenConnections.joinable())
@@ -3510,18 +3742,22 @@ void CConnman::RelayInvFiltered(CInv &inv, const uint256& relatedTxHash, const i
 
 void CConnman::RecordBytesRecv(uint64_t bytes)
 {
+    static const statsd::MetricHandle statsBytesReceived = statsClient.intern("bandwidth.bytesReceived", statsd::MetricType::COUNTER);
+    static const statsd::MetricHandle statsTotalBytesReceived = statsClient.intern("bandwidth.totalBytesReceived", statsd::MetricType::GAUGE);
     LOCK(cs_totalBytesRecv);
     nTotalBytesRecv += bytes;
-    statsClient.count("bandwidth.bytesReceived", bytes, 0.1f);
-    statsClient.gauge("bandwidth.totalBytesReceived", nTotalBytesRecv, 0.01f);
+    statsClient.count(statsBytesReceived, bytes);
+    statsClient.gauge(statsTotalBytesReceived, nTotalBytesRecv);
 }
 
 void CConnman::RecordBytesSent(uint64_t bytes)
 {
+    static const statsd::MetricHandle statsBytesSent = statsClient.intern("bandwidth.bytesSent", statsd::MetricType::COUNTER);
+    static const statsd::MetricHandle statsTotalBytesSent = statsClient.intern("bandwidth.totalBytesSent", statsd::MetricType::GAUGE);
     LOCK(cs_totalBytesSent);
     nTotalBytesSent += bytes;
-    statsClient.count("bandwidth.bytesSent", bytes, 0.01f);
-    statsClient.gauge("bandwidth.totalBytesSent", nTotalBytesSent, 0.01f);
+    statsClient.count(statsBytesSent, bytes);
+    statsClient.gauge(statsTotalBytesSent, nTotalBytesSent);
 
     uint64_t now = GetTime();
     if (nMaxOutboundCycleStartTime + nMaxOutboundTimeframe < now)
@@ -3688,9 +3924,25 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
     std::vector<unsigned char> serializedHeader;
     pnode->m_serializer->prepareForTransport(msg, serializedHeader);
 
-    size_t nTotalSize = nMessageSize + serializedHeader.size();
-    statsClient.count("bandwidth.message." + SanitizeString(msg.command.c_str()) + ".bytesSent", nTotalSize, 1.0f);
-    statsClient.inc("message.sent." + SanitizeString(msg.command.c_str()), 1.0f);
+    PushMessageBuffers(pnode, msg.command, std::move(serializedHeader), CSendBuffer(std::move(msg.data)), nMessageSize);
+}
+
+void CConnman::PushMessage(CNode* pnode, const CSharedNetMsgRef& msg)
+{
+    size_t nMessageSize = msg->data.size();
+    LogPrint(BCLog::NET, "sending %s (%d bytes, shared) peer=%d\n", SanitizeString(msg->command), nMessageSize, pnode->GetId());
+
+    std::vector<unsigned char> serializedHeader;
+    pnode->m_serializer->prepareForTransport(*msg, serializedHeader);
+
+    PushMessageBuffers(pnode, msg->command, std::move(serializedHeader), CSendBuffer(msg), nMessageSize);
+}
+
+void CConnman::PushMessageBuffers(CNode* pnode, const std::string& command, std::vector<unsigned char>&& header, CSendBuffer&& payload, size_t nPayloadSize)
+{
+    size_t nTotalSize = nPayloadSize + header.size();
+    statsClient.count(NetMsgStatsSentBytes().get(command), nTotalSize);
+    statsClient.inc(NetMsgStatsSent().get(command));
 
     size_t nBytesSent = 0;
     {
@@ -3698,14 +3950,14 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
         bool hasPendingData = !pnode->vSendMsg.empty();
 
         //log total amount of bytes per command
-        pnode->mapSendBytesPerMsgCmd[msg.command] += nTotalSize;
+        pnode->mapSendBytesPerMsgCmd[command] += nTotalSize;
         pnode->nSendSize += nTotalSize;
 
         if (pnode->nSendSize > nSendBufferMaxSize)
             pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
-        if (nMessageSize)
-            pnode->vSendMsg.push_back(std::move(msg.data));
+        pnode->vSendMsg.emplace_back(std::move(header));
+        if (nPayloadSize)
+            pnode->vSendMsg.push_back(std::move(payload));
         pnode->nSendMsgSize = pnode->vSendMsg.size();
 
         {
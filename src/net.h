@@ -15,6 +15,7 @@
 #include <hash.h>
 #include <limitedmap.h>
 #include <netaddress.h>
+#include <net_msgstats.h>
 #include <net_permissions.h>
 #include <policy/feerate.h>
 #include <protocol.h>
@@ -81,6 +82,9 @@ static const bool DEFAULT_LISTEN = true;
  *  Masternodes are forced to accept at least this many connections
  */
 static const unsigned int DEFAULT_MAX_PEER_CONNECTIONS = 125;
+/** Number of threads processing messages which don't need cs_main, next to the main message handler */
+static const int DEFAULT_MESSAGE_WORKER_THREADS = 2;
+static const int MAX_MESSAGE_WORKER_THREADS = 16;
 /** The default for -maxuploadtarget. 0 = Unlimited */
 static const uint64_t DEFAULT_MAX_UPLOAD_TARGET = 0;
 /** The default timeframe for -maxuploadtarget. 1 day. */
@@ -130,8 +134,42 @@ struct CSerializedNetMsg
     std::string command;
 };
 
+/**
+ * A serialized message which is queued to many peers without being serialized
+ * or copied again for each of them, e.g. a new block announced to all peers.
+ */
+struct CSharedNetMsg
+{
+    explicit CSharedNetMsg(CSerializedNetMsg&& msg);
+
+    const std::vector<unsigned char> data;
+    const std::string command;
+    //! dbl-sha256 of data, used for the message header checksum
+    const uint256 hash;
+};
+typedef std::shared_ptr<const CSharedNetMsg> CSharedNetMsgRef;
+
+static inline CSharedNetMsgRef MakeSharedNetMsg(CSerializedNetMsg&& msg) { return std::make_shared<const CSharedNetMsg>(std::move(msg)); }
+
+/** A buffer queued for sending, either owned by the peer or shared with other peers */
+class CSendBuffer
+{
+public:
+    explicit CSendBuffer(std::vector<unsigned char>&& dataIn) : data(std::move(dataIn)) {}
+    explicit CSendBuffer(const CSharedNetMsgRef& sharedIn) : shared(sharedIn) {}
+
+    const unsigned char* Data() const { return shared ? shared->data.data() : data.data(); }
+    size_t Size() const { return shared ? shared->data.size() : data.size(); }
+
+private:
+    std::vector<unsigned char> data;
+    CSharedNetMsgRef shared;
+};
+
 
 class NetEventsInterface;
+class CNetMessage;
+struct CMessageWorker;
 class CConnman
 {
 friend class CNode;
@@ -179,6 +217,7 @@ public:
         std::vector<std::string> m_added_nodes;
         SocketEventsMode socketEventsMode = SOCKETEVENTS_SELECT;
         std::vector<bool> m_asmap;
+        int nMessageWorkerThreads = 0;
     };
 
     void Init(const Options& connOptions) {
@@ -206,6 +245,7 @@ public:
             vAddedNodes = connOptions.m_added_nodes;
         }
         socketEventsMode = connOptions.socketEventsMode;
+        nMessageWorkerThreads = connOptions.nMessageWorkerThreads;
     }
 
     CConnman(uint64_t seed0, uint64_t seed1);
@@ -271,6 +311,7 @@ public:
     bool IsMasternodeOrDisconnectRequested(const CService& addr);
 
     void PushMessage(CNode* pnode, CSerializedNetMsg&& msg);
+    void PushMessage(CNode* pnode, const CSharedNetMsgRef& msg);
 
     template<typename Condition, typename Callable>
     bool ForEachNodeContinueIf(const Condition& cond, Callable&& func)
@@ -460,6 +501,19 @@ public:
     uint64_t GetTotalBytesRecv();
     uint64_t GetTotalBytesSent();
 
+    CNetMsgStats& GetMsgStats() { return m_msg_stats; }
+
+    /** Whether messages can be handed off to the message worker threads */
+    bool HasMessageWorkers() const { return !vMessageWorkers.empty(); }
+    /**
+     * Hand a message off to the message worker threads. All messages of one
+     * peer go to the same worker and are processed in the order they were
+     * queued. Until they are done CNode::nPendingWorkerMessages is non-zero,
+     * and the message still counts towards the peer's nProcessQueueSize so a
+     * peer can't get around -maxreceivebuffer by flooding worker messages.
+     */
+    void QueueMessageToWorker(CNode* pnode, CNetMessage&& msg);
+
     void SetBestHeight(int height);
     int GetBestHeight() const;
 
@@ -497,6 +551,8 @@ private:
     void ProcessOneShot();
     void ThreadOpenConnections(std::vector<std::string> connect);
     void ThreadMessageHandler();
+    void ThreadMessageWorker(CMessageWorker& worker);
+    void ProcessWorkerItem(CNode* pnode, CNetMessage& msg);
     void AcceptConnection(const ListenSocket& hListenSocket);
     void DisconnectNodes();
     void NotifyNumConnectionsChanged();
@@ -535,6 +591,7 @@ private:
     NodeId GetNewNodeId();
 
     size_t SocketSendData(CNode *pnode);
+    void PushMessageBuffers(CNode* pnode, const std::string& command, std::vector<unsigned char>&& header, CSendBuffer&& payload, size_t nPayloadSize);
     size_t SocketRecvData(CNode* pnode);
     void DumpAddresses();
 
@@ -628,6 +685,12 @@ private:
 
     CThreadInterrupt interruptNet;
 
+    /** Where the message handler spends its time, see getnetmsgstats */
+    CNetMsgStats m_msg_stats;
+
+    int nMessageWorkerThreads{0};
+    std::vector<std::unique_ptr<CMessageWorker>> vMessageWorkers;
+
 #ifdef USE_WAKEUP_PIPE
     /** a pipe which is added to select() calls to wakeup before the timeout */
     int wakeupPipe[2]{-1,-1};
@@ -692,6 +755,7 @@ class NetEventsInterface
 {
 public:
     virtual bool ProcessMessages(CNode* pnode, std::atomic<bool>& interrupt) = 0;
+    virtual void ProcessWorkerMessage(CNode* pnode, CNetMessage& msg, std::atomic<bool>& interrupt) = 0;
     virtual bool SendMessages(CNode* pnode) = 0;
     virtual void InitializeNode(CNode* pnode) = 0;
     virtual void FinalizeNode(NodeId id, bool& update_connection_time) = 0;
@@ -794,7 +858,38 @@ public:
     bool m_masternode_connection;
 };
 
+/**
+ * Recycles the payload buffers of received messages. Messages up to
+ * MAX_BUFFER_SIZE get a buffer of the next power of two size at or above their
+ * header's payload length, so the payload is read without growing the buffer
+ * and without a new allocation for every message.
+ */
+class CRecvBufferPool
+{
+public:
+    static constexpr size_t MIN_BUFFER_SIZE = 256;
+    static constexpr size_t MAX_BUFFER_SIZE = 256 * 1024;
+    //! Free buffers kept per size class, in bytes
+    static constexpr size_t MAX_POOLED_BYTES = 1024 * 1024;
+
+    //! Get an empty buffer with room for nSize bytes, nSize must not exceed MAX_BUFFER_SIZE
+    CSerializeData Acquire(size_t nSize);
+    //! Return a buffer for reuse, buffers which weren't acquired from a pool are freed
+    void Release(CSerializeData&& buf);
+    size_t GetPooledBytes() const;
+
+    static CRecvBufferPool& Get();
 
+private:
+    static constexpr int MIN_BUFFER_BITS = 8;
+    static constexpr int MAX_BUFFER_BITS = 18;
+    static_assert(MIN_BUFFER_SIZE == size_t{1} << MIN_BUFFER_BITS && MAX_BUFFER_SIZE == size_t{1} << MAX_BUFFER_BITS, "pool size classes");
+
+    static int SizeClass(size_t nSize);
+
+    mutable Mutex cs;
+    std::array<std::vector<CSerializeData>, MAX_BUFFER_BITS - MIN_BUFFER_BITS + 1> vFree GUARDED_BY(cs);
+};
 
 /** Transport protocol agnostic message container.
  * Ideally it should only contain receive time, payload,
@@ -812,11 +907,28 @@ public:
     std::string m_command;
 
     CNetMessage(CDataStream&& recv_in) : m_recv(std::move(recv_in)) {}
+    CNetMessage(CNetMessage&&) = default;
+    // hands the payload buffer being replaced back to the receive buffer pool
+    CNetMessage& operator=(CNetMessage&& other);
+    // hands the payload buffer back to the receive buffer pool
+    ~CNetMessage();
 
     void SetVersion(int nVersionIn)
     {
         m_recv.SetVersion(nVersionIn);
     }
+
+private:
+    void ReleaseBuffer();
+};
+
+/** Messages handed off to one message worker thread, see CConnman::QueueMessageToWorker */
+struct CMessageWorker
+{
+    Mutex cs;
+    std::condition_variable cond;
+    std::list<std::pair<CNode*, CNetMessage>> queue GUARDED_BY(cs);
+    std::thread thread;
 };
 
 /** The TransportDeserializer takes care of holding and deserializing the
@@ -894,12 +1006,15 @@ class TransportSerializer {
 public:
     // prepare message for transport (header construction, error-correction computation, payload encryption, etc.)
     virtual void prepareForTransport(CSerializedNetMsg& msg, std::vector<unsigned char>& header) = 0;
+    // prepare a message shared with other peers, its payload is sent as is
+    virtual void prepareForTransport(const CSharedNetMsg& msg, std::vector<unsigned char>& header) = 0;
     virtual ~TransportSerializer() {}
 };
 
 class V1TransportSerializer  : public TransportSerializer {
 public:
     void prepareForTransport(CSerializedNetMsg& msg, std::vector<unsigned char>& header) override;
+    void prepareForTransport(const CSharedNetMsg& msg, std::vector<unsigned char>& header) override;
 };
 
 /** Information about a peer */
@@ -916,7 +1031,7 @@ public:
     size_t nSendSize{0}; // total size of all vSendMsg entries
     size_t nSendOffset{0}; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes GUARDED_BY(cs_vSend){0};
-    std::list<std::vector<unsigned char>> vSendMsg GUARDED_BY(cs_vSend);
+    std::list<CSendBuffer> vSendMsg GUARDED_BY(cs_vSend);
     std::atomic<size_t> nSendMsgSize{0};
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
@@ -925,6 +1040,8 @@ public:
     CCriticalSection cs_vProcessMsg;
     std::list<CNetMessage> vProcessMsg GUARDED_BY(cs_vProcessMsg);
     size_t nProcessQueueSize{0};
+    // messages handed to the message worker threads and not yet processed
+    std::atomic<int> nPendingWorkerMessages{0};
 
     CCriticalSection cs_sendProcessing;
 
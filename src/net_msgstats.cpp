@@ -0,0 +1,191 @@
+// Copyright (c) 2023 datos
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <net_msgstats.h>
+
+#include <net.h>
+#include <protocol.h>
+#include <util/time.h>
+
+#include <univalue.h>
+
+#include <algorithm>
+
+NetMsgPeerClass GetNetMsgPeerClass(const CNode* pnode)
+{
+    if (pnode->m_masternode_connection) return NetMsgPeerClass::MASTERNODE;
+    if (pnode->fInbound) return NetMsgPeerClass::INBOUND;
+    return NetMsgPeerClass::OUTBOUND;
+}
+
+std::string NetMsgPeerClassToString(NetMsgPeerClass peerClass)
+{
+    switch (peerClass) {
+    case NetMsgPeerClass::INBOUND: return "inbound";
+    case NetMsgPeerClass::OUTBOUND: return "outbound";
+    case NetMsgPeerClass::MASTERNODE: return "masternode";
+    case NetMsgPeerClass::MAX_CLASS: break;
+    }
+    assert(false);
+}
+
+static size_t HistogramBucket(int64_t nTime)
+{
+    size_t nBucket = 0;
+    while (nTime > 0 && nBucket < NET_MSG_HISTOGRAM_BUCKETS - 1) {
+        nTime >>= 1;
+        ++nBucket;
+    }
+    return nBucket;
+}
+
+void CNetMsgTypeStats::Add(int64_t nProcessTime, int64_t nQueueTime, int64_t nLockWait)
+{
+    ++nCount;
+    nProcessTimeTotal += nProcessTime;
+    nProcessTimeMax = std::max(nProcessTimeMax, nProcessTime);
+    nQueueTimeTotal += nQueueTime;
+    nQueueTimeMax = std::max(nQueueTimeMax, nQueueTime);
+    nLockWaitTotal += nLockWait;
+    ++vProcessTimeHistogram[HistogramBucket(nProcessTime)];
+}
+
+void CNetMsgTypeStats::Merge(const CNetMsgTypeStats& other)
+{
+    nCount += other.nCount;
+    nProcessTimeTotal += other.nProcessTimeTotal;
+    nProcessTimeMax = std::max(nProcessTimeMax, other.nProcessTimeMax);
+    nQueueTimeTotal += other.nQueueTimeTotal;
+    nQueueTimeMax = std::max(nQueueTimeMax, other.nQueueTimeMax);
+    nLockWaitTotal += other.nLockWaitTotal;
+    for (size_t i = 0; i < NET_MSG_HISTOGRAM_BUCKETS; ++i) {
+        vProcessTimeHistogram[i] += other.vProcessTimeHistogram[i];
+    }
+}
+
+UniValue CNetMsgTypeStats::ToJson() const
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("count", nCount);
+    obj.pushKV("process_time_total", nProcessTimeTotal);
+    obj.pushKV("process_time_avg", nCount ? nProcessTimeTotal / (int64_t)nCount : 0);
+    obj.pushKV("process_time_max", nProcessTimeMax);
+    obj.pushKV("queue_time_avg", nCount ? nQueueTimeTotal / (int64_t)nCount : 0);
+    obj.pushKV("queue_time_max", nQueueTimeMax);
+    obj.pushKV("lock_wait_total", nLockWaitTotal);
+
+    // keyed by the exclusive upper bound of each bucket, empty buckets are skipped
+    UniValue histogram(UniValue::VOBJ);
+    for (size_t i = 0; i < NET_MSG_HISTOGRAM_BUCKETS; ++i) {
+        if (vProcessTimeHistogram[i] == 0) continue;
+        std::string strBound = i == NET_MSG_HISTOGRAM_BUCKETS - 1 ? "inf" : std::to_string(int64_t{1} << i);
+        histogram.pushKV(strBound, vProcessTimeHistogram[i]);
+    }
+    obj.pushKV("process_time_histogram", histogram);
+    return obj;
+}
+
+CNetMsgStats::CNetMsgStats() :
+    vTypes(getAllNetMessageTypes()),
+    statsProcessTime(statsClient, "message.processTime_us.", getAllNetMessageTypes(), "", statsd::MetricType::TIMING, NET_MESSAGE_COMMAND_OTHER),
+    statsQueueTime(statsClient, "message.queueTime_us.", getAllNetMessageTypes(), "", statsd::MetricType::TIMING, NET_MESSAGE_COMMAND_OTHER),
+    statsLockWait(statsClient, "message.lockWait_us.", getAllNetMessageTypes(), "", statsd::MetricType::COUNTER, NET_MESSAGE_COMMAND_OTHER)
+{
+    vTypes.emplace_back(NET_MESSAGE_COMMAND_OTHER);
+    for (size_t i = 0; i < vTypes.size(); ++i) {
+        mapTypeIndex.emplace(vTypes[i], i);
+    }
+    Reset();
+}
+
+size_t CNetMsgStats::GetTypeIndex(const std::string& msg_type) const
+{
+    auto it = mapTypeIndex.find(msg_type);
+    if (it == mapTypeIndex.end()) {
+        return vTypes.size() - 1;
+    }
+    return it->second;
+}
+
+void CNetMsgStats::RecordMessage(const std::string& msg_type, NetMsgPeerClass peerClass, int64_t nProcessTime, int64_t nQueueTime, int64_t nLockWait)
+{
+    nQueueTime = std::max<int64_t>(nQueueTime, 0);
+    {
+        LOCK(cs);
+        vStats[GetTypeIndex(msg_type)][(size_t)peerClass].Add(nProcessTime, nQueueTime, nLockWait);
+    }
+    statsClient.timing(statsProcessTime.get(msg_type), nProcessTime);
+    statsClient.timing(statsQueueTime.get(msg_type), nQueueTime);
+    if (nLockWait > 0) {
+        statsClient.count(statsLockWait.get(msg_type), nLockWait);
+    }
+}
+
+void CNetMsgStats::RecordSendMessages(NetMsgPeerClass peerClass, int64_t nTime)
+{
+    LOCK(cs);
+    vSendMessagesTime[(size_t)peerClass] += nTime;
+}
+
+void CNetMsgStats::RecordHandlerLoop(int64_t nBusyTime, int64_t nIdleTime)
+{
+    static const statsd::MetricHandle statsBusy = statsClient.intern("message.handler.busy_us", statsd::MetricType::COUNTER);
+    static const statsd::MetricHandle statsIdle = statsClient.intern("message.handler.idle_us", statsd::MetricType::COUNTER);
+    {
+        LOCK(cs);
+        nHandlerBusyTime += nBusyTime;
+        nHandlerIdleTime += nIdleTime;
+    }
+    statsClient.count(statsBusy, nBusyTime);
+    statsClient.count(statsIdle, nIdleTime);
+}
+
+UniValue CNetMsgStats::ToJson(const std::string& strFilter) const
+{
+    LOCK(cs);
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("period", GetTimeMicros() - nStartTime);
+
+    UniValue handler(UniValue::VOBJ);
+    handler.pushKV("busy_time", nHandlerBusyTime);
+    handler.pushKV("idle_time", nHandlerIdleTime);
+    UniValue sendMessages(UniValue::VOBJ);
+    for (size_t i = 0; i < (size_t)NetMsgPeerClass::MAX_CLASS; ++i) {
+        sendMessages.pushKV(NetMsgPeerClassToString((NetMsgPeerClass)i), vSendMessagesTime[i]);
+    }
+    handler.pushKV("sendmessages_time", sendMessages);
+    obj.pushKV("handler", handler);
+
+    UniValue messages(UniValue::VOBJ);
+    for (size_t i = 0; i < vTypes.size(); ++i) {
+        if (!strFilter.empty() && vTypes[i] != strFilter) continue;
+
+        CNetMsgTypeStats total;
+        UniValue byClass(UniValue::VOBJ);
+        for (size_t j = 0; j < (size_t)NetMsgPeerClass::MAX_CLASS; ++j) {
+            const CNetMsgTypeStats& stats = vStats[i][j];
+            if (stats.nCount == 0) continue;
+            total.Merge(stats);
+            byClass.pushKV(NetMsgPeerClassToString((NetMsgPeerClass)j), stats.ToJson());
+        }
+        if (total.nCount == 0) continue;
+
+        UniValue entry = total.ToJson();
+        entry.pushKV("peers", byClass);
+        messages.pushKV(vTypes[i], entry);
+    }
+    obj.pushKV("messages", messages);
+    return obj;
+}
+
+void CNetMsgStats::Reset()
+{
+    LOCK(cs);
+    vStats.assign(vTypes.size(), {});
+    vSendMessagesTime.fill(0);
+    nHandlerBusyTime = 0;
+    nHandlerIdleTime = 0;
+    nStartTime = GetTimeMicros();
+}
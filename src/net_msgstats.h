@@ -0,0 +1,86 @@
+// Copyright (c) 2023 datos
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NET_MSGSTATS_H
+#define BITCOIN_NET_MSGSTATS_H
+
+#include <statsd_client.h>
+#include <sync.h>
+
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+
+class CNode;
+class UniValue;
+
+/** Coarse classification of peers used to split message processing statistics */
+enum class NetMsgPeerClass : uint8_t {
+    INBOUND,
+    OUTBOUND,
+    MASTERNODE,
+    MAX_CLASS,
+};
+
+NetMsgPeerClass GetNetMsgPeerClass(const CNode* pnode);
+std::string NetMsgPeerClassToString(NetMsgPeerClass peerClass);
+
+/** Number of power of two buckets in the processing time histogram, the last one is open ended */
+static constexpr size_t NET_MSG_HISTOGRAM_BUCKETS = 24;
+
+/** Processing statistics of one message type received from one class of peers, times in microseconds */
+struct CNetMsgTypeStats {
+    uint64_t nCount{0};
+    int64_t nProcessTimeTotal{0};
+    int64_t nProcessTimeMax{0};
+    int64_t nQueueTimeTotal{0};
+    int64_t nQueueTimeMax{0};
+    int64_t nLockWaitTotal{0};
+    std::array<uint64_t, NET_MSG_HISTOGRAM_BUCKETS> vProcessTimeHistogram{};
+
+    void Add(int64_t nProcessTime, int64_t nQueueTime, int64_t nLockWait);
+    void Merge(const CNetMsgTypeStats& other);
+    UniValue ToJson() const;
+};
+
+/**
+ * Accounts where the message handler spends its time: per message type and
+ * peer class processing time histograms, how long messages waited in the
+ * receive queue and how much of the processing was spent blocked on locks.
+ * Also published to statsd, per message type. Owned by CConnman.
+ */
+class CNetMsgStats
+{
+public:
+    CNetMsgStats();
+
+    void RecordMessage(const std::string& msg_type, NetMsgPeerClass peerClass, int64_t nProcessTime, int64_t nQueueTime, int64_t nLockWait);
+    void RecordSendMessages(NetMsgPeerClass peerClass, int64_t nTime);
+    void RecordHandlerLoop(int64_t nBusyTime, int64_t nIdleTime);
+
+    /** @param[in] strFilter   only report this message type if not empty */
+    UniValue ToJson(const std::string& strFilter) const;
+    void Reset();
+
+private:
+    size_t GetTypeIndex(const std::string& msg_type) const;
+
+    // immutable after construction
+    std::vector<std::string> vTypes;
+    std::map<std::string, size_t> mapTypeIndex;
+
+    mutable Mutex cs;
+    std::vector<std::array<CNetMsgTypeStats, (size_t)NetMsgPeerClass::MAX_CLASS>> vStats GUARDED_BY(cs);
+    std::array<int64_t, (size_t)NetMsgPeerClass::MAX_CLASS> vSendMessagesTime GUARDED_BY(cs){};
+    int64_t nHandlerBusyTime GUARDED_BY(cs){0};
+    int64_t nHandlerIdleTime GUARDED_BY(cs){0};
+    int64_t nStartTime GUARDED_BY(cs){0};
+
+    statsd::MetricFamily statsProcessTime;
+    statsd::MetricFamily statsQueueTime;
+    statsd::MetricFamily statsLockWait;
+};
+
+#endif // BITCOIN_NET_MSGSTATS_H
@@ -29,6 +29,7 @@
 #include <tinyformat.h>
 #include <index/txindex.h>
 #include <txmempool.h>
+#include <txreconciliation.h>
 #include <util/system.h>
 #include <util/strencodings.h>
 #include <util/validation.h>
@@ -85,6 +86,8 @@ static const unsigned int MAX_GETDATA_SZ = 1000;
 static constexpr int64_t ORPHAN_TX_EXPIRE_TIME = 20 * 60;
 /** Minimum time between orphan transactions expire time checks in seconds */
 static constexpr int64_t ORPHAN_TX_EXPIRE_INTERVAL = 5 * 60;
+/** Maximum number of orphan transactions accepted to the mempool together, bounds how long one call holds cs_main */
+static constexpr size_t MAX_ORPHAN_TX_BATCH = 10;
 /** Headers download timeout expressed in microseconds
  *  Timeout = base + per_header * (expected number of headers) */
 static constexpr int64_t HEADERS_DOWNLOAD_TIMEOUT_BASE = 15 * 60 * 1000000; // 15 minutes
@@ -205,6 +208,9 @@ namespace {
     std::unique_ptr<CRollingBloomFilter> recentRejects GUARDED_BY(cs_main);
     uint256 hashRecentRejectsChainTip GUARDED_BY(cs_main);
 
+    /** Peers we reconcile transaction announcements with, null unless -txreconciliation is set */
+    std::unique_ptr<TxReconciliationTracker> g_txreconciliation;
+
     /** Blocks that are in flight, and that are in the queue to be downloaded. */
     struct QueuedBlock {
         uint256 hash;
@@ -912,6 +918,9 @@ void PeerLogicValidation::InitializeNode(CNode *pnode) {
 
 void PeerLogicValidation::FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTime) {
     fUpdateConnectionTime = false;
+    if (g_txreconciliation) {
+        g_txreconciliation->ForgetPeer(nodeid);
+    }
     LOCK(cs_main);
     CNodeState *state = State(nodeid);
     assert(state != nullptr);
@@ -1167,6 +1176,9 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, BanMan* banman, CS
     : connman(connmanIn), m_banman(banman), m_stale_tip_check_time(0), m_enable_bip61(enable_bip61) {
     // Initialize global variables that cannot be constructed at startup.
     recentRejects.reset(new CRollingBloomFilter(120000, 0.000001));
+    if (gArgs.GetBoolArg("-txreconciliation", DEFAULT_TXRECONCILIATION_ENABLE)) {
+        g_txreconciliation = MakeUnique<TxReconciliationTracker>();
+    }
 
     const Consensus::Params& consensusParams = Params().GetConsensus();
     // Stale tip checking and peer eviction are on two different timers, but we
@@ -1174,7 +1186,7 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, BanMan* banman, CS
     // combine them in one function and schedule at the quicker (peer-eviction)
     // timer.
     static_assert(EXTRA_PEER_CHECK_INTERVAL < STALE_CHECK_INTERVAL, "peer eviction timer should be less than stale tip check timer");
-    scheduler.scheduleEvery(std::bind(&PeerLogicValidation::CheckForStaleTipAndEvictPeers, this, consensusParams), EXTRA_PEER_CHECK_INTERVAL * 1000);
+    scheduler.scheduleEvery(std::bind(&PeerLogicValidation::CheckForStaleTipAndEvictPeers, this, consensusParams), EXTRA_PEER_CHECK_INTERVAL * 1000, CScheduler::Priority::NORMAL, "staletip");
 }
 
 /**
@@ -1233,6 +1245,9 @@ static CCriticalSection cs_most_recent_block;
 static std::shared_ptr<const CBlock> most_recent_block GUARDED_BY(cs_most_recent_block);
 static std::shared_ptr<const CBlockHeaderAndShortTxIDs> most_recent_compact_block GUARDED_BY(cs_most_recent_block);
 static uint256 most_recent_block_hash GUARDED_BY(cs_most_recent_block);
+// The most recent block serialized as a BLOCK message, created when the first peer asks for it
+static CSharedNetMsgRef most_recent_block_msg GUARDED_BY(cs_most_recent_block);
+static int most_recent_block_msg_version GUARDED_BY(cs_most_recent_block){0};
 
 /**
  * Maintain state about the best-seen block and fast-announce a compact block
@@ -1256,11 +1271,13 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
         most_recent_block_hash = hashBlock;
         most_recent_block = pblock;
         most_recent_compact_block = pcmpctblock;
+        most_recent_block_msg.reset();
     }
 
-    connman->ForEachNode([this, &pcmpctblock, pindex, &msgMaker, &hashBlock](CNode* pnode) {
+    // serialized once, when the first peer needs it
+    CSharedNetMsgRef cmpctblock_msg;
+    connman->ForEachNode([this, &pcmpctblock, &cmpctblock_msg, pindex, &msgMaker, &hashBlock](CNode* pnode) {
         AssertLockHeld(cs_main);
-        // TODO: Avoid the repeated-serialization here
         if (pnode->fDisconnect)
             return;
         ProcessBlockAvailability(pnode->GetId());
@@ -1272,7 +1289,10 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
 
             LogPrint(BCLog::NET, "%s sending header-and-ids %s to peer=%d\n", "PeerLogicValidation::NewPoWValidBlock",
                     hashBlock.ToString(), pnode->GetId());
-            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+            if (!cmpctblock_msg) {
+                cmpctblock_msg = MakeSharedNetMsg(msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+            }
+            connman->PushMessage(pnode, cmpctblock_msg);
             state.pindexBestHeaderSent = pindex;
         }
     });
@@ -1499,6 +1519,40 @@ static void RelayAddress(const CAddress& addr, bool fReachable, CConnman* connma
     connman->ForEachNodeThen(std::move(sortfunc), std::move(pushfunc));
 }
 
+/**
+ * A new netproof is requested by every masternode it is relayed to, keep the
+ * last one serialized so it is shared by all of them.
+ */
+static CSharedNetMsgRef GetNetProofMsg(const CNetworkProof& netproof, const CNetMsgMaker& msgMaker)
+{
+    static Mutex cs_recent_netproof;
+    static CSharedNetMsgRef recent_netproof_msg GUARDED_BY(cs_recent_netproof);
+    static uint256 recent_netproof_hash GUARDED_BY(cs_recent_netproof);
+    static int recent_netproof_version GUARDED_BY(cs_recent_netproof){0};
+
+    LOCK(cs_recent_netproof);
+    if (!recent_netproof_msg || recent_netproof_hash != netproof.hash || recent_netproof_version != msgMaker.GetVersion()) {
+        recent_netproof_msg = MakeSharedNetMsg(msgMaker.Make(NetMsgType::NETPROOF, netproof));
+        recent_netproof_hash = netproof.hash;
+        recent_netproof_version = msgMaker.GetVersion();
+    }
+    return recent_netproof_msg;
+}
+
+static CSharedNetMsgRef GetRecentBlockMsg(const std::shared_ptr<const CBlock>& pblock, const CNetMsgMaker& msgMaker)
+{
+    LOCK(cs_most_recent_block);
+    if (pblock != most_recent_block) {
+        // replaced in the meantime, don't cache it
+        return MakeSharedNetMsg(msgMaker.Make(NetMsgType::BLOCK, *pblock));
+    }
+    if (!most_recent_block_msg || most_recent_block_msg_version != msgMaker.GetVersion()) {
+        most_recent_block_msg = MakeSharedNetMsg(msgMaker.Make(NetMsgType::BLOCK, *pblock));
+        most_recent_block_msg_version = msgMaker.GetVersion();
+    }
+    return most_recent_block_msg;
+}
+
 void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, const CInv& inv, CConnman* connman)
 {
     bool send = false;
@@ -1578,9 +1632,14 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
             pblock = pblockRead;
         }
         if (pblock) {
-            if (inv.type == MSG_BLOCK)
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
-            else if (inv.type == MSG_FILTERED_BLOCK) {
+            if (inv.type == MSG_BLOCK) {
+                if (pblock == a_recent_block) {
+                    // many peers ask for a new block at about the same time, serialize it only once
+                    connman->PushMessage(pfrom, GetRecentBlockMsg(a_recent_block, msgMaker));
+                } else {
+                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
+                }
+            } else if (inv.type == MSG_FILTERED_BLOCK) {
                 bool sendMerkleBlock = false;
                 CMerkleBlock merkleBlock;
                 {
@@ -1800,7 +1859,7 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
             if (!push && (inv.type == MSG_NETPROOF)) {
                 CNetworkProof netproof;
                 if (proofManager.GetProofByHash(inv.hash, netproof)) {
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::NETPROOF, netproof));
+                    connman->PushMessage(pfrom, GetNetProofMsg(netproof, msgMaker));
                     push = true;
                 }
             }
@@ -2088,53 +2147,62 @@ void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_se
     std::set<NodeId> setMisbehaving;
     bool done = false;
     while (!done && !orphan_work_set.empty()) {
-        const uint256 orphanHash = *orphan_work_set.begin();
-        orphan_work_set.erase(orphan_work_set.begin());
-
-        auto orphan_it = mapOrphanTransactions.find(orphanHash);
-        if (orphan_it == mapOrphanTransactions.end()) continue;
-
-        const CTransactionRef porphanTx = orphan_it->second.tx;
-        const CTransaction& orphanTx = *porphanTx;
-        NodeId fromPeer = orphan_it->second.fromPeer;
-        bool fMissingInputs2 = false;
-        // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
+        // Orphans which may have become valid are accepted together, so
+        // independent ones share a single pass over the mempool
+        std::vector<CTransactionRef> vOrphans;
+        std::vector<NodeId> vFromPeer;
+        while (!orphan_work_set.empty() && vOrphans.size() < MAX_ORPHAN_TX_BATCH) {
+            const uint256 orphanHash = *orphan_work_set.begin();
+            orphan_work_set.erase(orphan_work_set.begin());
+
+            auto orphan_it = mapOrphanTransactions.find(orphanHash);
+            if (orphan_it == mapOrphanTransactions.end()) continue;
+            if (setMisbehaving.count(orphan_it->second.fromPeer)) continue;
+            vOrphans.push_back(orphan_it->second.tx);
+            vFromPeer.push_back(orphan_it->second.fromPeer);
+        }
+        if (vOrphans.empty()) break;
+
+        // The states are never reported back, so someone can't setup nodes to counter-DoS based on orphan
         // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
         // anyone relaying LegitTxX banned)
-        CValidationState stateDummy;
-
-        if (setMisbehaving.count(fromPeer)) continue;
-        if (AcceptToMemoryPool(mempool, stateDummy, porphanTx, &fMissingInputs2 /* pfMissingInputs */,
-                false /* bypass_limits */, 0 /* nAbsurdFee */)) {
-            LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n", orphanHash.ToString());
-            RelayTransaction(orphanTx.GetHash(), *connman);
-            for (unsigned int i = 0; i < orphanTx.vout.size(); i++) {
-                auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(orphanHash, i));
-                if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
-                    for (const auto& elem : it_by_prev->second) {
-                        orphan_work_set.insert(elem->first);
+        const std::vector<MempoolAcceptResult> results = AcceptToMemoryPoolBatch(mempool, vOrphans, {} /* vAbsurdFee */, false /* bypass_limits */);
+        for (size_t i = 0; i < vOrphans.size(); i++) {
+            const CTransaction& orphanTx = *vOrphans[i];
+            const uint256& orphanHash = orphanTx.GetHash();
+            const NodeId fromPeer = vFromPeer[i];
+            const CValidationState& stateDummy = results[i].state;
+            if (results[i].fAccepted) {
+                LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n", orphanHash.ToString());
+                RelayTransaction(orphanHash, *connman);
+                for (unsigned int j = 0; j < orphanTx.vout.size(); j++) {
+                    auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(orphanHash, j));
+                    if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
+                        for (const auto& elem : it_by_prev->second) {
+                            orphan_work_set.insert(elem->first);
+                        }
                     }
                 }
+                EraseOrphanTx(orphanHash);
+                done = true;
+            } else if (!results[i].fMissingInputs) {
+                int nDos = 0;
+                if (stateDummy.IsInvalid(nDos) && nDos > 0 && !setMisbehaving.count(fromPeer)) {
+                    // Punish peer that gave us an invalid orphan tx
+                    Misbehaving(fromPeer, nDos);
+                    setMisbehaving.insert(fromPeer);
+                    LogPrint(BCLog::MEMPOOL, "   invalid orphan tx %s\n", orphanHash.ToString());
+                }
+                // Has inputs but not accepted to mempool
+                // Probably non-standard or insufficient fee
+                LogPrint(BCLog::MEMPOOL, "   removed orphan tx %s\n", orphanHash.ToString());
+                if (!stateDummy.CorruptionPossible()) {
+                    assert(recentRejects);
+                    recentRejects->insert(orphanHash);
+                }
+                EraseOrphanTx(orphanHash);
+                done = true;
             }
-            EraseOrphanTx(orphanHash);
-            done = true;
-        } else if (!fMissingInputs2) {
-            int nDos = 0;
-            if (stateDummy.IsInvalid(nDos) && nDos > 0) {
-                // Punish peer that gave us an invalid orphan tx
-                Misbehaving(fromPeer, nDos);
-                setMisbehaving.insert(fromPeer);
-                LogPrint(BCLog::MEMPOOL, "   invalid orphan tx %s\n", orphanHash.ToString());
-            }
-            // Has inputs but not accepted to mempool
-            // Probably non-standard or insufficient fee
-            LogPrint(BCLog::MEMPOOL, "   removed orphan tx %s\n", orphanHash.ToString());
-            if (!stateDummy.CorruptionPossible()) {
-                assert(recentRejects);
-                recentRejects->insert(orphanHash);
-            }
-            EraseOrphanTx(orphanHash);
-            done = true;
         }
         mempool.check(&::ChainstateActive().CoinsTip());
     }
@@ -2423,10 +2491,63 @@ std::pair<bool /*ret*/, bool /*do_return*/> static ValidateDSTX(CCoinJoinBroadca
     return {true, false};
 }
 
+static const statsd::MetricFamily& MessageReceivedStats()
+{
+    static const statsd::MetricFamily statsReceived(statsClient, "message.received.", getAllNetMessageTypes(), "", statsd::MetricType::COUNTER, NET_MESSAGE_COMMAND_OTHER);
+    return statsReceived;
+}
+
+/**
+ * Messages which are handled by the message worker threads instead of the main
+ * message handler. Their handlers only take their own locks on the normal path
+ * and don't touch block or transaction state.
+ */
+static bool IsWorkerMessageType(const std::string& msg_type)
+{
+    return msg_type == NetMsgType::QSIGSESANN ||
+           msg_type == NetMsgType::QSIGSHARESINV ||
+           msg_type == NetMsgType::QGETSIGSHARES ||
+           msg_type == NetMsgType::QBSIGSHARES ||
+           msg_type == NetMsgType::QSIGSHARE ||
+           msg_type == NetMsgType::QCONTRIB ||
+           msg_type == NetMsgType::QCOMPLAINT ||
+           msg_type == NetMsgType::QJUSTIFICATION ||
+           msg_type == NetMsgType::QPCOMMITMENT;
+}
+
+/**
+ * Announce the result of a transaction reconciliation. Transactions went
+ * through the same checks as flooded announcements when they were queued, but
+ * may have left the mempool or stopped matching the peer's filter since.
+ */
+static void PushReconciledInv(CNode* pto, const std::vector<CInv>& vAnnounce, const CNetMsgMaker& msgMaker, CConnman* connman)
+{
+    std::vector<CInv> vInv;
+    vInv.reserve(std::min<size_t>(vAnnounce.size(), MAX_INV_SZ));
+    LOCK2(mempool.cs, pto->cs_filter);
+    for (const CInv& inv : vAnnounce) {
+        if (inv.type == MSG_TX || inv.type == MSG_DSTX) {
+            if (!pto->fRelayTxes) continue;
+            // Not in the mempool anymore? don't bother sending it.
+            auto txinfo = mempool.info(inv.hash);
+            if (!txinfo.tx) continue;
+            if (pto->pfilter && !pto->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
+        }
+        vInv.push_back(inv);
+        if (vInv.size() == MAX_INV_SZ) {
+            connman->PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
+            vInv.clear();
+        }
+    }
+    if (!vInv.empty()) {
+        connman->PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
+    }
+}
+
 bool static ProcessMessage(CNode* pfrom, const std::string& msg_type, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc, bool enable_bip61)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(msg_type), vRecv.size(), pfrom->GetId());
-    statsClient.inc("message.received." + SanitizeString(msg_type), 1.0f);
+    statsClient.inc(MessageReceivedStats().get(msg_type));
 
     if (gArgs.IsArgSet("-dropmessagestest") && GetRand(gArgs.GetArg("-dropmessagestest", 0)) == 0)
     {
@@ -2728,6 +2849,12 @@ bool static ProcessMessage(CNode* pfrom, const std::string& msg_type, CDataStrea
         // Tell our peer that he should send us CoinJoin queue messages
         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDDSQUEUE, true));
 
+        // Offer transaction reconciliation to peers which want transactions from us
+        if (g_txreconciliation && g_relay_txes && pfrom->CanRelay() && WITH_LOCK(pfrom->cs_filter, return pfrom->fRelayTxes)) {
+            const uint64_t nSalt = g_txreconciliation->PreRegisterPeer(pfrom->GetId());
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDRECON, TXRECONCILIATION_VERSION, nSalt));
+        }
+
         if (llmq::CLLMQUtils::IsWatchQuorumsEnabled() && connman->IsMasternodeQuorumNode(pfrom)) {
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::QWATCH));
         }
@@ -2874,6 +3001,76 @@ bool static ProcessMessage(CNode* pfrom, const std::string& msg_type, CDataStrea
         return true;
     }
 
+    if (msg_type == NetMsgType::SENDRECON) {
+        if (!g_txreconciliation) {
+            return true;
+        }
+        uint32_t nPeerVersion;
+        uint64_t nPeerSalt;
+        vRecv >> nPeerVersion >> nPeerSalt;
+        const auto result = g_txreconciliation->RegisterPeer(pfrom->GetId(), pfrom->fInbound, nPeerVersion, nPeerSalt);
+        if (result == ReconciliationRegisterResult::ALREADY_REGISTERED || result == ReconciliationRegisterResult::PROTOCOL_VIOLATION) {
+            LogPrint(BCLog::NET, "invalid sendrecon from peer=%d; disconnecting\n", pfrom->GetId());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+        return true;
+    }
+
+    if (msg_type == NetMsgType::REQRECON) {
+        if (!g_txreconciliation) {
+            return true;
+        }
+        uint16_t nPeerSetSize, nPeerQ;
+        vRecv >> nPeerSetSize >> nPeerQ;
+        CReconSketch sketch;
+        if (!g_txreconciliation->HandleReconciliationRequest(pfrom->GetId(), nPeerSetSize, nPeerQ, GetTime<std::chrono::microseconds>(), sketch)) {
+            LogPrint(BCLog::NET, "unexpected reqrecon from peer=%d; disconnecting\n", pfrom->GetId());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SKETCH, sketch));
+        return true;
+    }
+
+    if (msg_type == NetMsgType::SKETCH) {
+        if (!g_txreconciliation) {
+            return true;
+        }
+        CReconSketch sketch;
+        vRecv >> sketch;
+        std::vector<CInv> vAnnounce;
+        std::vector<uint32_t> vAskFor;
+        bool fSuccess;
+        if (!g_txreconciliation->HandleSketch(pfrom->GetId(), sketch, vAnnounce, vAskFor, fSuccess)) {
+            LogPrint(BCLog::NET, "unexpected sketch from peer=%d; disconnecting\n", pfrom->GetId());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+        LogPrint(BCLog::NET, "reconciled with peer=%d: %s, announcing %d, asking for %d\n", pfrom->GetId(),
+                 fSuccess ? "success" : "failed", vAnnounce.size(), vAskFor.size());
+        PushReconciledInv(pfrom, vAnnounce, msgMaker, connman);
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::RECONCILDIFF, fSuccess, vAskFor));
+        return true;
+    }
+
+    if (msg_type == NetMsgType::RECONCILDIFF) {
+        if (!g_txreconciliation) {
+            return true;
+        }
+        bool fSuccess;
+        std::vector<uint32_t> vAskFor;
+        vRecv >> fSuccess >> vAskFor;
+        std::vector<CInv> vAnnounce;
+        if (!g_txreconciliation->HandleReconciliationDiff(pfrom->GetId(), fSuccess, vAskFor, vAnnounce)) {
+            LogPrint(BCLog::NET, "unexpected reconcildiff from peer=%d; disconnecting\n", pfrom->GetId());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+        PushReconciledInv(pfrom, vAnnounce, msgMaker, connman);
+        return true;
+    }
+
     if (msg_type == NetMsgType::INV) {
         std::vector<CInv> vInv;
         vRecv >> vInv;
@@ -2906,6 +3103,11 @@ bool static ProcessMessage(CNode* pfrom, const std::string& msg_type, CDataStrea
 
             bool fAlreadyHave = AlreadyHave(inv);
             LogPrint(BCLog::NET, "got inv: %s  %s peer=%d\n", inv.ToString(), fAlreadyHave ? "have" : "new", pfrom->GetId());
+
+            // no need to reconcile what the peer just told us about
+            if (g_txreconciliation && IsReconcilableInv(inv)) {
+                g_txreconciliation->RemoveFromSet(pfrom->GetId(), inv);
+            }
             statsClient.inc(strprintf("message.received.inv_%s", inv.GetCommand()), 1.0f);
 
             if (inv.type == MSG_BLOCK) {
@@ -3686,6 +3888,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& msg_type, CDataStrea
                 vRecv >> headers[n];
                 ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
                 ReadCompactSize(vRecv); // needed for vchBlockSig.
+                headers[n].Memoize();
             }
         } else if (msg_type == NetMsgType::HEADERS2) {
             std::list<int32_t> last_unique_versions;
@@ -3694,6 +3897,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& msg_type, CDataStrea
                 vRecv >> block_header_compressed;
                 block_header_compressed.Uncompress(headers, last_unique_versions);
                 headers.push_back(block_header_compressed);
+                headers.back().Memoize();
             }
         }
 
@@ -3715,6 +3919,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& msg_type, CDataStrea
 
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
         vRecv >> *pblock;
+        pblock->Memoize();
 
         LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom->GetId());
 
@@ -4020,7 +4225,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& msg_type, CDataStrea
             return false;
         }
 
-        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::NETPROOF, netproof));
+        connman->PushMessage(pfrom, GetNetProofMsg(netproof, msgMaker));
         LogPrint(BCLog::NET, "sent netproof for height %d to peer=%d\n", askheight, pfrom->GetId());
 
         return true;
@@ -4158,14 +4363,26 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         return false;
 
     std::list<CNetMessage> msgs;
+    bool fWorkerMessage = false;
     {
         LOCK(pfrom->cs_vProcessMsg);
         if (pfrom->vProcessMsg.empty())
             return false;
+        // Keep the order of this peer's messages: wait for the workers to finish
+        // before processing anything they don't handle
+        if (pfrom->nPendingWorkerMessages > 0 && !IsWorkerMessageType(pfrom->vProcessMsg.front().m_command))
+            return false;
+        const CNetMessage& front = pfrom->vProcessMsg.front();
+        fWorkerMessage = connman->HasMessageWorkers() && pfrom->fSuccessfullyConnected && IsWorkerMessageType(front.m_command) &&
+                         front.m_valid_netmagic && front.m_valid_header && front.m_valid_checksum;
         // Just take one message
         msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
-        pfrom->nProcessQueueSize -= msgs.front().m_raw_message_size;
-        pfrom->fPauseRecv = pfrom->nProcessQueueSize > connman->GetReceiveFloodSize();
+        // A message handed to a worker keeps counting against the receive
+        // buffer until the worker is done with it
+        if (!fWorkerMessage) {
+            pfrom->nProcessQueueSize -= msgs.front().m_raw_message_size;
+            pfrom->fPauseRecv = pfrom->nProcessQueueSize > connman->GetReceiveFloodSize();
+        }
         fMoreWork = !pfrom->vProcessMsg.empty();
     }
     CNetMessage& msg(msgs.front());
@@ -4198,7 +4415,14 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         return fMoreWork;
     }
 
+    if (fWorkerMessage) {
+        connman->QueueMessageToWorker(pfrom, std::move(msg));
+        return fMoreWork;
+    }
+
     // Process message
+    const int64_t nProcessStart = GetTimeMicros();
+    const int64_t nLockWaitStart = GetThreadLockWaitMicros();
     bool fRet = false;
     try
     {
@@ -4235,6 +4459,9 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         PrintExceptionContinue(std::current_exception(), "ProcessMessages()");
     }
 
+    connman->GetMsgStats().RecordMessage(msg_type, GetNetMsgPeerClass(pfrom), GetTimeMicros() - nProcessStart,
+                                         nProcessStart - msg.m_time, GetThreadLockWaitMicros() - nLockWaitStart);
+
     if (!fRet) {
         LogPrint(BCLog::NET, "%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(msg_type), nMessageSize, pfrom->GetId());
     }
@@ -4245,6 +4472,28 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     return fMoreWork;
 }
 
+void PeerLogicValidation::ProcessWorkerMessage(CNode* pfrom, CNetMessage& msg, std::atomic<bool>& interruptMsgProc)
+{
+    const std::string& msg_type = msg.m_command;
+    CDataStream& vRecv = msg.m_recv;
+    LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(msg_type), vRecv.size(), pfrom->GetId());
+    statsClient.inc(MessageReceivedStats().get(msg_type));
+
+    const int64_t nProcessStart = GetTimeMicros();
+    const int64_t nLockWaitStart = GetThreadLockWaitMicros();
+    try {
+        llmq::quorumDKGSessionManager->ProcessMessage(pfrom, msg_type, vRecv);
+        llmq::quorumSigSharesManager->ProcessMessage(pfrom, msg_type, vRecv);
+    } catch (const std::ios_base::failure& e) {
+        LogPrint(BCLog::NET, "%s(%s, %u bytes): Exception '%s' caught\n", __func__, SanitizeString(msg_type), msg.m_message_size, e.what());
+    } catch (...) {
+        PrintExceptionContinue(std::current_exception(), "ProcessWorkerMessage()");
+    }
+
+    connman->GetMsgStats().RecordMessage(msg_type, GetNetMsgPeerClass(pfrom), GetTimeMicros() - nProcessStart,
+                                         nProcessStart - msg.m_time, GetThreadLockWaitMicros() - nLockWaitStart);
+}
+
 void PeerLogicValidation::ConsiderEviction(CNode *pto, int64_t time_in_seconds)
 {
     AssertLockHeld(cs_main);
@@ -4730,6 +4979,18 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                 }
             };
 
+            // Reconciling peers only get announcements flooded to them if they are one of
+            // the few flooding peers, the others learn about them in the next reconciliation
+            const bool fReconcile = g_txreconciliation && !g_txreconciliation->ShouldFloodTo(pto->GetId());
+            auto queueOrReconcileInv = [pto, fReconcile, &queueAndMaybePushInv](const CInv& invIn) {
+                AssertLockHeld(pto->cs_inventory);
+                if (fReconcile && IsReconcilableInv(invIn) && g_txreconciliation->AddToSet(pto->GetId(), invIn)) {
+                    pto->filterInventoryKnown.insert(invIn.hash);
+                    return;
+                }
+                queueAndMaybePushInv(invIn);
+            };
+
             // Respond to BIP35 mempool requests
             if (fSendTrickle && pto->fSendMempool) {
                 auto vtxinfo = mempool.infoAll();
@@ -4812,7 +5073,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                         }
                     }
                     int nInvType = CCoinJoin::GetDSTX(hash) ? MSG_DSTX : MSG_TX;
-                    queueAndMaybePushInv(CInv(nInvType, hash));
+                    queueOrReconcileInv(CInv(nInvType, hash));
                 }
             }
 
@@ -4821,13 +5082,24 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                 if (pto->filterInventoryKnown.contains(inv.hash)) {
                     continue;
                 }
-                queueAndMaybePushInv(inv);
+                queueOrReconcileInv(inv);
             }
             pto->vInventoryOtherToSend.clear();
         }
         if (!vInv.empty())
             connman->PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
 
+        // Ask reconciling peers for the announcements they held back for us
+        if (g_txreconciliation) {
+            std::vector<CInv> vExpired;
+            if (g_txreconciliation->ExpireReconciliation(pto->GetId(), current_time, vExpired)) {
+                PushReconciledInv(pto, vExpired, msgMaker, connman);
+            }
+            if (const auto request = g_txreconciliation->MaybeRequestReconciliation(pto->GetId(), current_time)) {
+                connman->PushMessage(pto, msgMaker.Make(NetMsgType::REQRECON, request->first, request->second));
+            }
+        }
+
         // Detect whether we're stalling
         current_time = GetTime<std::chrono::microseconds>();
         // nNow is the current system time (GetTimeMicros is not mockable) and
@@ -61,6 +61,14 @@ public:
     */
     bool ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt) override;
     /**
+    * Process a message handed to a message worker thread by ProcessMessages
+    *
+    * @param[in]   pfrom           The node which we have received the message from.
+    * @param[in]   msg             The message, already checked for a valid header and checksum.
+    * @param[in]   interrupt       Interrupt condition for processing threads
+    */
+    void ProcessWorkerMessage(CNode* pfrom, CNetMessage& msg, std::atomic<bool>& interrupt) override;
+    /**
     * Send queued protocol messages to be sent to a give node.
     *
     * @param[in]   pto             The node which we are sending messages to.
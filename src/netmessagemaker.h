@@ -30,6 +30,8 @@ public:
         return Make(0, std::move(sCommand), std::forward<Args>(args)...);
     }
 
+    int GetVersion() const { return nVersion; }
+
 private:
     const int nVersion;
 };
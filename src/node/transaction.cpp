@@ -82,3 +82,78 @@ TransactionError BroadcastTransaction(const CTransactionRef tx, std::string& err
 
     return TransactionError::OK;
 }
+
+void BroadcastTransactions(const std::vector<CTransactionRef>& txs, std::vector<TransactionError>& errors, std::vector<std::string>& err_strings,
+                           const std::vector<CAmount>& max_tx_fees, bool relay, bool wait_callback, bool bypass_limits)
+{
+    assert(g_connman);
+    assert(max_tx_fees.size() == txs.size());
+    errors.assign(txs.size(), TransactionError::OK);
+    err_strings.assign(txs.size(), "");
+    std::promise<void> promise;
+    bool callback_set = false;
+
+    { // cs_main scope
+    LOCK(cs_main);
+    std::vector<size_t> vSubmitted;
+    std::vector<CTransactionRef> vSubmit;
+    std::vector<CAmount> vSubmitFees;
+    CCoinsViewCache &view = ::ChainstateActive().CoinsTip();
+    for (size_t i = 0; i < txs.size(); i++) {
+        const CTransactionRef& tx = txs[i];
+        // If the transaction is already confirmed in the chain, don't do anything.
+        for (size_t o = 0; o < tx->vout.size(); o++) {
+            // IsSpent does not mean the coin is spent, it means the output does not exist.
+            // So if the output does exist, then this transaction exists in the chain.
+            if (!view.AccessCoin(COutPoint(tx->GetHash(), o)).IsSpent()) {
+                errors[i] = TransactionError::ALREADY_IN_CHAIN;
+                break;
+            }
+        }
+        if (errors[i] == TransactionError::OK && !mempool.exists(tx->GetHash())) {
+            vSubmitted.push_back(i);
+            vSubmit.push_back(tx);
+            vSubmitFees.push_back(max_tx_fees[i]);
+        }
+    }
+
+    const std::vector<MempoolAcceptResult> results = AcceptToMemoryPoolBatch(mempool, vSubmit, vSubmitFees, bypass_limits);
+    for (size_t j = 0; j < results.size(); j++) {
+        const size_t i = vSubmitted[j];
+        const MempoolAcceptResult& result = results[j];
+        if (result.fAccepted) {
+            continue;
+        }
+        if (result.state.IsInvalid()) {
+            errors[i] = TransactionError::MEMPOOL_REJECTED;
+            err_strings[i] = FormatStateMessage(result.state);
+        } else if (result.fMissingInputs) {
+            errors[i] = TransactionError::MISSING_INPUTS;
+        } else {
+            errors[i] = TransactionError::MEMPOOL_ERROR;
+            err_strings[i] = FormatStateMessage(result.state);
+        }
+    }
+
+    if (wait_callback && !vSubmit.empty()) {
+        // see BroadcastTransaction, one callback covers the whole batch
+        CallFunctionInValidationInterfaceQueue([&promise] {
+            promise.set_value();
+        });
+        callback_set = true;
+    }
+
+    } // cs_main
+
+    if (callback_set) {
+        promise.get_future().wait();
+    }
+
+    if (relay) {
+        for (size_t i = 0; i < txs.size(); i++) {
+            if (errors[i] == TransactionError::OK) {
+                RelayTransaction(txs[i]->GetHash(), *g_connman);
+            }
+        }
+    }
+}
@@ -9,6 +9,8 @@
 #include <primitives/transaction.h>
 #include <util/error.h>
 
+#include <vector>
+
 /**
  * Submit a transaction to the mempool and (optionally) relay it to all P2P peers.
  *
@@ -27,4 +29,17 @@
  */
 [[nodiscard]] TransactionError BroadcastTransaction(CTransactionRef tx, std::string& err_string, const CAmount& highfee, bool relay, bool wait_callback, bool bypass_limits = false);
 
+/**
+ * Submit a batch of transactions to the mempool and (optionally) relay the
+ * accepted ones to all P2P peers. Same as BroadcastTransaction for each of them,
+ * but the transactions are validated together with AcceptToMemoryPoolBatch.
+ *
+ * @param[in]  txs the transactions to broadcast
+ * @param[out] errors the result for each transaction, in order
+ * @param[out] err_strings the error string for each transaction, if available
+ * @param[in]  max_tx_fees the fee limit for each transaction (if 0, accept any fee)
+ */
+void BroadcastTransactions(const std::vector<CTransactionRef>& txs, std::vector<TransactionError>& errors, std::vector<std::string>& err_strings,
+                           const std::vector<CAmount>& max_tx_fees, bool relay, bool wait_callback, bool bypass_limits = false);
+
 #endif // BITCOIN_NODE_TRANSACTION_H
@@ -21,6 +21,7 @@
 #include <sync.h>
 #include <net.h>
 #include <util/moneystr.h>
+#include <util/trace.h>
 #include <validation.h>
 #include <wallet/wallet.h>
 
@@ -48,42 +49,49 @@ extern double GetDifficulty(const CBlockIndex* blockindex = nullptr);
 
 bool CheckStake(CBlock *pblock)
 {
+    // The block is final once signed, hash it only once for all checks below
+    std::shared_ptr<CBlock> shared_pblock = std::make_shared<CBlock>(*pblock);
+    shared_pblock->Memoize();
+    const CBlock& block = *shared_pblock;
+
     uint256 proofHash, hashTarget;
-    uint256 hashBlock = pblock->GetHash();
+    uint256 hashBlock = block.GetHash();
     const Consensus::Params& params = Params().GetConsensus();
 
-    if (!pblock->IsProofOfStake()) {
+    if (!block.IsProofOfStake()) {
         return error("%s: %s is not a proof-of-stake block.", __func__, hashBlock.GetHex());
     }
 
-    if (!CheckStakeUnique(*pblock, false)) {
+    if (!CheckStakeUnique(block, false)) {
         return error("%s: %s CheckStakeUnique failed.", __func__, hashBlock.GetHex());
     }
 
     {
-        BlockMap::const_iterator mi = BlockIndex().find(pblock->hashPrevBlock);
+        BlockMap::const_iterator mi = BlockIndex().find(block.hashPrevBlock);
         if (mi == BlockIndex().end()) {
-            return error("%s: %s prev block not found: %s.", __func__, hashBlock.GetHex(), pblock->hashPrevBlock.GetHex());
+            return error("%s: %s prev block not found: %s.", __func__, hashBlock.GetHex(), block.hashPrevBlock.GetHex());
         }
 
         if (!::ChainActive().Contains(mi->second)) {
-            return error("%s: %s prev block in active chain: %s.", __func__, hashBlock.GetHex(), pblock->hashPrevBlock.GetHex());
+            return error("%s: %s prev block in active chain: %s.", __func__, hashBlock.GetHex(), block.hashPrevBlock.GetHex());
         }
 
         CValidationState state;
-        if (!CheckProofOfStake(state, mi->second, *pblock->vtx[1], pblock->nTime, pblock->nBits, proofHash, hashTarget, params)) {
+        if (!CheckProofOfStake(state, mi->second, *block.vtx[1], block.nTime, block.nBits, proofHash, hashTarget, params)) {
             return error("%s: proof-of-stake checking failed.", __func__);
         }
 
-        if (pblock->hashPrevBlock != ::ChainActive().Tip()->GetBlockHash()) {
+        if (block.hashPrevBlock != ::ChainActive().Tip()->GetBlockHash()) {
             return error("%s: Generated block is stale.", __func__);
         }
     }
 
     LogPrint(BCLog::POS, "%s: New proof-of-stake block found  \n  hash: %s \nproofhash: %s  \ntarget: %s\n", __func__, hashBlock.GetHex(), proofHash.GetHex(), hashTarget.GetHex());
+    TRACE3(staking, block_found, hashBlock.data(), proofHash.data(), (uint64_t)block.vtx.size());
 
-    std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(*pblock);
-    if (!ProcessNewBlock(Params(), shared_pblock, true, nullptr)) {
+    const bool fAccepted = ProcessNewBlock(Params(), shared_pblock, true, nullptr);
+    TRACE2(staking, block_submitted, hashBlock.data(), fAccepted);
+    if (!fAccepted) {
         return error("%s: Block not accepted.", __func__);
     }
 
@@ -306,7 +314,10 @@ void ThreadStakeMiner(size_t nThreadID, CWallet* pwallet)
             pwallet->m_is_staking = IS_STAKING;
             nWaitFor = nMinerSleep;
             fIsStaking = true;
-            if (wallet.SignBlock(pblocktemplate.get(), nBestHeight + 1, nSearchTime)) {
+            TRACE3(staking, search_start, i, nBestHeight + 1, nSearchTime);
+            const bool fSigned = wallet.SignBlock(pblocktemplate.get(), nBestHeight + 1, nSearchTime);
+            TRACE3(staking, search_done, i, nBestHeight + 1, fSigned);
+            if (fSigned) {
                 if (CheckStake(pblock)) {
                      nTimeLastStake = GetTime();
                      continue;
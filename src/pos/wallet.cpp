@@ -351,18 +351,7 @@ void CStakeWallet::AbandonOrphanedCoinstakes() const
         return;
     }
 
-    auto locked_chain = wallet->chain().lock();
-    for (std::pair<const uint256, CWalletTx>& item : wallet->mapWallet) {
-        const uint256& wtxid = item.first;
-        CWalletTx& wtx = item.second;
-        assert(wtx.GetHash() == wtxid);
-        if (wtx.GetDepthInMainChain(*locked_chain) == 0 && !wtx.isAbandoned() && wtx.IsCoinStake()) {
-            LogPrint(BCLog::POS, "Abandoning coinstake wtx %s\n", wtx.GetHash().ToString());
-            if (!wallet->AbandonTransaction(*locked_chain, wtxid)) {
-                LogPrint(BCLog::POS, "Failed to abandon coinstake tx %s\n", wtx.GetHash().ToString());
-            }
-        }
-    }
+    wallet->AbandonOrphanedCoinstakes();
 }
 
 bool CStakeWallet::SignBlock(CBlockTemplate* pblocktemplate, int nHeight, int64_t nSearchTime)
@@ -5,6 +5,7 @@
 
 #include <primitives/block.h>
 
+#include <consensus/merkle.h>
 #include <hash.h>
 #include <streams.h>
 #include <tinyformat.h>
@@ -12,9 +13,18 @@
 
 uint256 CBlockHeader::GetHash() const
 {
+    if (const uint256* hash = hashMemo.Get()) {
+        return *hash;
+    }
     return SerializeHash(*this);
 }
 
+void CBlockHeader::Memoize()
+{
+    hashMemo.Clear();
+    hashMemo.Set(GetHash());
+}
+
 bool CBlockHeader::IsProofOfWork() const
 {
     return !(nNonce == 0);
@@ -25,6 +35,15 @@ bool CBlockHeader::IsProofOfStake() const
     return !IsProofOfWork();
 }
 
+void CBlock::Memoize()
+{
+    CBlockHeader::Memoize();
+    bool mutated;
+    merkleRootMemo.Clear();
+    const uint256 root = BlockMerkleRoot(*this, &mutated);
+    merkleRootMemo.Set(std::make_pair(root, mutated));
+}
+
 std::string CBlock::ToString() const
 {
     std::stringstream s;
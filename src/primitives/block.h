@@ -16,6 +16,26 @@
 
 class CNetworkProof;
 
+/** Memory-only memo of a value derived from a block that will not change anymore.
+ * Copies start out empty, so a copy that gets modified never reports a stale value.
+ * Only set it before the block is shared with other threads.
+ */
+template <typename T>
+class BlockMemo
+{
+    T m_value{};
+    bool m_set{false};
+
+public:
+    BlockMemo() = default;
+    BlockMemo(const BlockMemo&) {}
+    BlockMemo& operator=(const BlockMemo&) { m_set = false; return *this; }
+
+    void Set(const T& value) { m_value = value; m_set = true; }
+    void Clear() { m_set = false; }
+    const T* Get() const { return m_set ? &m_value : nullptr; }
+};
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -35,6 +55,9 @@ public:
     uint32_t nNonce;
     uint256 nProof;
 
+    // memory only
+    BlockMemo<uint256> hashMemo;
+
     CBlockHeader()
     {
         SetNull();
@@ -42,6 +65,7 @@ public:
 
     SERIALIZE_METHODS(CBlockHeader, obj)
     {
+        SER_READ(obj, obj.hashMemo.Clear());
         READWRITE(obj.nVersion);
         READWRITE(obj.hashPrevBlock);
         READWRITE(obj.hashMerkleRoot);
@@ -62,6 +86,7 @@ public:
         nBits = 0;
         nNonce = 0;
         nProof.SetNull();
+        hashMemo.Clear();
     }
 
     bool IsNull() const
@@ -70,6 +95,8 @@ public:
     }
 
     uint256 GetHash() const;
+    //! Compute the hash once and serve it from memory from now on. The header must not be modified afterwards.
+    void Memoize();
     bool IsProofOfWork() const;
     bool IsProofOfStake() const;
 
@@ -165,8 +192,7 @@ struct CompressibleBlockHeader : CBlockHeader {
 
     explicit CompressibleBlockHeader(CBlockHeader&& block_header)
     {
-        static_assert(std::is_trivially_copyable_v<CBlockHeader>, "If CBlockHeader is not trivially copyable, please consider using std::move on the next line");
-        *static_cast<CBlockHeader*>(this) = block_header;
+        *static_cast<CBlockHeader*>(this) = std::move(block_header);
 
         // When we create this from a block header, mark everything as uncompressed
         bit_field.SetVersionOffset(0);
@@ -215,6 +241,7 @@ public:
 
     // memory only
     mutable bool fChecked;
+    BlockMemo<std::pair<uint256, bool>> merkleRootMemo; //!< Merkle root and whether the tree was mutated
 
     CBlock()
     {
@@ -229,6 +256,7 @@ public:
 
     SERIALIZE_METHODS(CBlock, obj)
     {
+        SER_READ(obj, obj.merkleRootMemo.Clear());
         READWRITEAS(CBlockHeader, obj);
         READWRITE(obj.vtx);
         READWRITE(obj.vchBlockSig);
@@ -242,6 +270,7 @@ public:
         CBlockHeader::SetNull();
         vtx.clear();
         fChecked = false;
+        merkleRootMemo.Clear();
         vchBlockSig.clear();
         netProof.SetNull();
     }
@@ -256,9 +285,15 @@ public:
         block.nBits          = nBits;
         block.nNonce         = nNonce;
         block.nProof         = nProof;
+        if (const uint256* hash = hashMemo.Get()) {
+            block.hashMemo.Set(*hash);
+        }
         return block;
     }
 
+    //! Memoize the header hash and the Merkle root. The block must not be modified afterwards.
+    void Memoize();
+
     bool IsProofOfStake() const
     {
         return (vtx.size() > 1 && vtx[1]->IsCoinStake());
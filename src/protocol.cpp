@@ -94,6 +94,10 @@ MAKE_MSG(QUORUMROTATIONINFO, "qrinfo");
 // storage related message types
 MAKE_MSG(NETPROOF, "netproof");
 MAKE_MSG(ASKPROOF, "askproof");
+MAKE_MSG(SENDRECON, "sendrecon");
+MAKE_MSG(REQRECON, "reqrecon");
+MAKE_MSG(SKETCH, "sketch");
+MAKE_MSG(RECONCILDIFF, "reconcildiff");
 }; // namespace NetMsgType
 
 /** All known message types. Keep this in the same order as the list of
@@ -177,7 +181,11 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::HEADERS2,
     // storage related message types
     NetMsgType::NETPROOF,
-    NetMsgType::ASKPROOF
+    NetMsgType::ASKPROOF,
+    NetMsgType::SENDRECON,
+    NetMsgType::REQRECON,
+    NetMsgType::SKETCH,
+    NetMsgType::RECONCILDIFF,
 };
 const static std::vector<std::string> allNetMessageTypesVec(allNetMessageTypes, allNetMessageTypes+ARRAYLEN(allNetMessageTypes));
 
@@ -305,6 +305,16 @@ extern const char *QUORUMROTATIONINFO;
 // Datosdrive message types
 extern const char *NETPROOF;
 extern const char *ASKPROOF;
+
+/**
+ * Transaction reconciliation (see txreconciliation.h). SENDRECON offers it to a
+ * peer after VERACK, REQRECON asks the peer for a SKETCH of the announcements
+ * it queued for us and RECONCILDIFF tells it what we are missing.
+ */
+extern const char *SENDRECON;
+extern const char *REQRECON;
+extern const char *SKETCH;
+extern const char *RECONCILDIFF;
 };
 
 /* Get a vector of all valid message types (see above) */
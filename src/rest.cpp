@@ -11,6 +11,7 @@
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <rpc/blockchain.h>
+#include <rpc/jsonstream.h>
 #include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <streams.h>
@@ -64,6 +65,14 @@ static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, std::string me
     return false;
 }
 
+/** Start a chunked JSON reply, for a result written into the returned stream */
+static JSONStreamWriter StreamJSONReply(HTTPRequest* req)
+{
+    req->WriteHeader("Content-Type", "application/json");
+    req->WriteReplyStart(HTTP_OK);
+    return JSONStreamWriter([req](const std::string& chunk) { req->WriteReplyChunk(chunk); });
+}
+
 static RetFormat ParseDataFormat(std::string& param, const std::string& strReq)
 {
     const std::string::size_type pos = strReq.rfind('.');
@@ -202,6 +211,8 @@ static bool rest_block(HTTPRequest* req,
     CBlock block;
     CBlockIndex* pblockindex = nullptr;
     CBlockIndex* tip = nullptr;
+    UniValue header;
+    bool chainLock = false;
     {
         LOCK(cs_main);
         tip = ::ChainActive().Tip();
@@ -215,6 +226,10 @@ static bool rest_block(HTTPRequest* req,
 
         if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+
+        if (rf == RetFormat::JSON) {
+            header = blockToJSONWithoutTxs(block, tip, pblockindex, chainLock);
+        }
     }
 
     switch (rf) {
@@ -237,10 +252,11 @@ static bool rest_block(HTTPRequest* req,
     }
 
     case RetFormat::JSON: {
-        UniValue objBlock = blockToJSON(block, tip, pblockindex, showTxDetails);
-        std::string strJSON = objBlock.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        JSONStreamWriter writer = StreamJSONReply(req);
+        blockToJSON(block, header, chainLock, showTxDetails, writer);
+        writer.Raw("\n");
+        writer.Flush();
+        req->WriteReplyEnd();
         return true;
     }
 
@@ -317,11 +333,11 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RetFormat::JSON: {
-        UniValue mempoolObject = MempoolToJSON(::mempool, true);
-
-        std::string strJSON = mempoolObject.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        JSONStreamWriter writer = StreamJSONReply(req);
+        MempoolToJSON(::mempool, true, writer);
+        writer.Raw("\n");
+        writer.Flush();
+        req->WriteReplyEnd();
         return true;
     }
     default: {
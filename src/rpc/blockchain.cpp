@@ -23,6 +23,7 @@
 #include <pos/minter.h>
 #include <pos/wallet.h>
 #include <primitives/transaction.h>
+#include <rpc/jsonstream.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <script/descriptor.h>
@@ -129,7 +130,20 @@ UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails)
+static UniValue blockTxToJSON(const CTransaction& tx, bool txDetails, bool chainLock)
+{
+    if (!txDetails) {
+        return tx.GetHash().GetHex();
+    }
+    UniValue objTx(UniValue::VOBJ);
+    TxToUniv(tx, uint256(), objTx, true);
+    bool fLocked = llmq::quorumInstantSendManager->IsLocked(tx.GetHash());
+    objTx.pushKV("instantlock", fLocked || chainLock);
+    objTx.pushKV("instantlock_internal", fLocked);
+    return objTx;
+}
+
+UniValue blockToJSONWithoutTxs(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool& chainLock)
 {
     UniValue result(UniValue::VOBJ);
     result.pushKV("hash", blockindex->GetBlockHash().GetHex());
@@ -141,23 +155,8 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIn
     result.pushKV("version", block.nVersion);
     result.pushKV("versionHex", strprintf("%08x", block.nVersion));
     result.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
-    bool chainLock = llmq::chainLocksHandler->HasChainLock(blockindex->nHeight, blockindex->GetBlockHash());
-    UniValue txs(UniValue::VARR);
-    for(const auto& tx : block.vtx)
-    {
-        if(txDetails)
-        {
-            UniValue objTx(UniValue::VOBJ);
-            TxToUniv(*tx, uint256(), objTx, true);
-            bool fLocked = llmq::quorumInstantSendManager->IsLocked(tx->GetHash());
-            objTx.pushKV("instantlock", fLocked || chainLock);
-            objTx.pushKV("instantlock_internal", fLocked);
-            txs.push_back(objTx);
-        }
-        else
-            txs.push_back(tx->GetHash().GetHex());
-    }
-    result.pushKV("tx", txs);
+    chainLock = llmq::chainLocksHandler->HasChainLock(blockindex->nHeight, blockindex->GetBlockHash());
+    result.pushKV("tx", UniValue(UniValue::VARR));
     if (!block.vtx[0]->vExtraPayload.empty()) {
         CCbTx cbTx;
         if (GetTxPayload(block.vtx[0]->vExtraPayload, cbTx)) {
@@ -188,6 +187,39 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIn
     return result;
 }
 
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails)
+{
+    bool chainLock;
+    UniValue result = blockToJSONWithoutTxs(block, tip, blockindex, chainLock);
+    UniValue txs(UniValue::VARR);
+    for(const auto& tx : block.vtx)
+    {
+        txs.push_back(blockTxToJSON(*tx, txDetails, chainLock));
+    }
+    result.pushKV("tx", txs);
+    return result;
+}
+
+void blockToJSON(const CBlock& block, const UniValue& header, bool chainLock, bool txDetails, JSONStreamWriter& writer)
+{
+    const std::vector<std::string>& keys = header.getKeys();
+    const std::vector<UniValue>& values = header.getValues();
+    writer.BeginObject();
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (keys[i] != "tx") {
+            writer.KeyValue(keys[i], values[i]);
+            continue;
+        }
+        writer.Key(keys[i]);
+        writer.BeginArray();
+        for (const auto& tx : block.vtx) {
+            writer.Value(blockTxToJSON(*tx, txDetails, chainLock));
+        }
+        writer.EndArray();
+    }
+    writer.EndObject();
+}
+
 static UniValue getblockcount(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -592,6 +624,45 @@ UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose)
     }
 }
 
+void MempoolToJSON(const CTxMemPool& pool, bool verbose, JSONStreamWriter& writer)
+{
+    if (verbose) {
+        std::vector<uint256> vtxid;
+        pool.queryHashes(vtxid);
+
+        // The writer may block on a slow client, so the entries are described under
+        // pool.cs a batch at a time and written out after releasing it
+        writer.BeginObject();
+        std::vector<std::pair<std::string, UniValue>> batch;
+        for (size_t start = 0; start < vtxid.size(); start += MEMPOOL_JSON_BATCH) {
+            const size_t end = std::min(vtxid.size(), start + MEMPOOL_JSON_BATCH);
+            batch.clear();
+            {
+                LOCK(pool.cs);
+                for (size_t i = start; i < end; ++i) {
+                    auto it = pool.mapTx.find(vtxid[i]);
+                    if (it == pool.mapTx.end()) continue; // removed since queryHashes
+                    UniValue info(UniValue::VOBJ);
+                    entryToJSON(pool, info, *it);
+                    batch.emplace_back(vtxid[i].ToString(), std::move(info));
+                }
+            }
+            for (const auto& entry : batch) {
+                writer.KeyValue(entry.first, entry.second);
+            }
+        }
+        writer.EndObject();
+    } else {
+        std::vector<uint256> vtxid;
+        pool.queryHashes(vtxid);
+
+        writer.BeginArray();
+        for (const uint256& hash : vtxid)
+            writer.Value(hash.ToString());
+        writer.EndArray();
+    }
+}
+
 static UniValue getrawmempool(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 1)
@@ -624,6 +695,10 @@ static UniValue getrawmempool(const JSONRPCRequest& request)
     if (!request.params[0].isNull())
         fVerbose = request.params[0].get_bool();
 
+    if (request.streamWriter) {
+        MempoolToJSON(::mempool, fVerbose, *request.streamWriter);
+        return NullUniValue;
+    }
     return MempoolToJSON(::mempool, fVerbose);
 }
 
@@ -1193,8 +1268,6 @@ static UniValue getblock(const JSONRPCRequest& request)
                 },
             }.ToString());
 
-    LOCK(cs_main);
-
     std::string strHash = request.params[0].get_str();
     uint256 hash(uint256S(strHash));
 
@@ -1206,22 +1279,36 @@ static UniValue getblock(const JSONRPCRequest& request)
             verbosity = request.params[1].get_bool() ? 1 : 0;
     }
 
-    const CBlockIndex* pblockindex = LookupBlockIndex(hash);
-    if (!pblockindex) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-    }
+    CBlock block;
+    UniValue header;
+    bool chainLock;
+    {
+        LOCK(cs_main);
 
-    const CBlock block = GetBlockChecked(pblockindex);
+        const CBlockIndex* pblockindex = LookupBlockIndex(hash);
+        if (!pblockindex) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
 
-    if (verbosity <= 0)
-    {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock);
-        return strHex;
+        block = GetBlockChecked(pblockindex);
+
+        if (verbosity <= 0)
+        {
+            CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+            ssBlock << block;
+            std::string strHex = HexStr(ssBlock);
+            return strHex;
+        }
+
+        if (!request.streamWriter) {
+            return blockToJSON(block, ::ChainActive().Tip(), pblockindex, verbosity >= 2);
+        }
+        header = blockToJSONWithoutTxs(block, ::ChainActive().Tip(), pblockindex, chainLock);
     }
 
-    return blockToJSON(block, ::ChainActive().Tip(), pblockindex, verbosity >= 2);
+    // The writer may block on a slow client, so stream without cs_main
+    blockToJSON(block, header, chainLock, verbosity >= 2, *request.streamWriter);
+    return NullUniValue;
 }
 
 static UniValue pruneblockchain(const JSONRPCRequest& request)
@@ -12,6 +12,7 @@
 class CBlock;
 class CBlockIndex;
 class CTxMemPool;
+class JSONStreamWriter;
 class UniValue;
 
 static constexpr int NUM_GETBLOCKSTATS_PERCENTILES = 5;
@@ -29,12 +30,22 @@ void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 
 /** Block description to JSON */
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails = false);
+/** blockToJSON with an empty "tx" array; needs cs_main like blockToJSON */
+UniValue blockToJSONWithoutTxs(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool& chainLock);
+/** Block description to JSON from the result of blockToJSONWithoutTxs, written into a stream one
+ *  transaction at a time. Must not be called under cs_main: the stream may block on the client. */
+void blockToJSON(const CBlock& block, const UniValue& header, bool chainLock, bool txDetails, JSONStreamWriter& writer);
 
 /** Mempool information to JSON */
 UniValue MempoolInfoToJSON(const CTxMemPool& pool);
 
 /** Mempool to JSON */
 UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose = false);
+/** Number of verbose mempool entries described under pool.cs at a time by the streaming MempoolToJSON */
+static const size_t MEMPOOL_JSON_BATCH = 1000;
+/** Same as above, written into a stream a batch of entries at a time. Takes pool.cs only while
+ *  describing a batch, so it must not be called with pool.cs or cs_main held. */
+void MempoolToJSON(const CTxMemPool& pool, bool verbose, JSONStreamWriter& writer);
 
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex);
@@ -114,6 +114,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "sendrawtransaction", 1, "maxfeerate" },
     { "sendrawtransaction", 2, "instantsend" },
     { "sendrawtransaction", 3, "bypasslimits" },
+    { "sendrawtransactions", 0, "rawtxs" },
+    { "sendrawtransactions", 1, "maxfeerate" },
+    { "sendrawtransactions", 2, "bypasslimits" },
     { "testmempoolaccept", 0, "rawtxs" },
     { "testmempoolaccept", 1, "allowhighfees" },
     { "testmempoolaccept", 1, "maxfeerate" },
@@ -163,6 +166,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "setcoinjoinamount", 0, "amount" },
     { "getmempoolancestors", 1, "verbose" },
     { "getmempooldescendants", 1, "verbose" },
+    { "getlockstats", 0, "count" },
+    { "getlockstats", 1, "reset" },
+    { "getlockstats", 2, "enable" },
     { "logging", 0, "include" },
     { "logging", 1, "exclude" },
     { "setstaking", 0, "mode" },
@@ -199,6 +205,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "createwallet", 1, "disable_private_keys"},
     { "createwallet", 2, "blank"},
     { "getnodeaddresses", 0, "count"},
+    { "getnetmsgstats", 1, "reset" },
     { "stop", 0, "wait" },
 };
 // clang-format on
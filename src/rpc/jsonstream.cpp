@@ -0,0 +1,107 @@
+// Copyright (c) 2023 datos
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/jsonstream.h>
+
+#include <univalue.h>
+
+#include <cassert>
+
+JSONStreamWriter::JSONStreamWriter(ChunkFn fnChunk, size_t nChunkSize) :
+    m_chunk_fn(std::move(fnChunk)), m_chunk_size(nChunkSize)
+{
+    m_buffer.reserve(m_chunk_size);
+}
+
+void JSONStreamWriter::BeginValue()
+{
+    m_empty = false;
+    if (m_after_key) {
+        m_after_key = false;
+        return;
+    }
+    if (!m_first.empty()) {
+        if (!m_first.back()) {
+            m_buffer += ',';
+        }
+        m_first.back() = false;
+    }
+}
+
+void JSONStreamWriter::EndValue()
+{
+    if (m_buffer.size() >= m_chunk_size) {
+        Flush();
+    }
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    BeginValue();
+    m_buffer += '{';
+    m_first.push_back(true);
+}
+
+void JSONStreamWriter::EndObject()
+{
+    assert(!m_first.empty() && !m_after_key);
+    m_first.pop_back();
+    m_buffer += '}';
+    EndValue();
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    BeginValue();
+    m_buffer += '[';
+    m_first.push_back(true);
+}
+
+void JSONStreamWriter::EndArray()
+{
+    assert(!m_first.empty() && !m_after_key);
+    m_first.pop_back();
+    m_buffer += ']';
+    EndValue();
+}
+
+void JSONStreamWriter::Key(const std::string& key)
+{
+    assert(!m_first.empty() && !m_after_key);
+    BeginValue();
+    // A string value is written quoted and escaped
+    m_buffer += UniValue(key).write();
+    m_buffer += ':';
+    m_after_key = true;
+}
+
+void JSONStreamWriter::Value(const UniValue& val)
+{
+    BeginValue();
+    m_buffer += val.write();
+    EndValue();
+}
+
+void JSONStreamWriter::KeyValue(const std::string& key, const UniValue& val)
+{
+    Key(key);
+    Value(val);
+}
+
+void JSONStreamWriter::Raw(const std::string& json)
+{
+    m_empty = false;
+    m_buffer += json;
+    EndValue();
+}
+
+void JSONStreamWriter::Flush()
+{
+    if (m_buffer.empty()) {
+        return;
+    }
+    m_flushed = true;
+    m_chunk_fn(m_buffer);
+    m_buffer.clear();
+}
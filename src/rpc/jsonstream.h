@@ -0,0 +1,74 @@
+// Copyright (c) 2023 datos
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_JSONSTREAM_H
+#define BITCOIN_RPC_JSONSTREAM_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class UniValue;
+
+//! Size at which the text written so far is handed out
+static const size_t JSON_STREAM_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Writes a JSON document piece by piece and hands the text out in chunks as
+ * it grows, so a large result never exists as a whole, neither as a UniValue
+ * tree nor as a string. The output is the same as UniValue::write() without
+ * indentation.
+ *
+ * Containers are opened and closed explicitly, members and elements are
+ * written as (small) UniValue values:
+ *
+ *     writer.BeginObject();
+ *     writer.KeyValue("height", nHeight);
+ *     writer.Key("tx");
+ *     writer.BeginArray();
+ *     for (...) writer.Value(txToJSON(tx));
+ *     writer.EndArray();
+ *     writer.EndObject();
+ */
+class JSONStreamWriter
+{
+public:
+    using ChunkFn = std::function<void(const std::string& chunk)>;
+
+    explicit JSONStreamWriter(ChunkFn fnChunk, size_t nChunkSize = JSON_STREAM_CHUNK_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    /** Start an object member. Has to be followed by its value. */
+    void Key(const std::string& key);
+    void Value(const UniValue& val);
+    void KeyValue(const std::string& key, const UniValue& val);
+    /** Write JSON text as is, e.g. a reply envelope around a streamed result */
+    void Raw(const std::string& json);
+
+    /** Hand out what was written and not handed out yet */
+    void Flush();
+
+    /** Whether anything was written at all */
+    bool IsEmpty() const { return m_empty; }
+    /** Whether a chunk was handed out already, so the output can't be taken back */
+    bool HasFlushed() const { return m_flushed; }
+
+private:
+    void BeginValue();
+    void EndValue();
+
+    const ChunkFn m_chunk_fn;
+    const size_t m_chunk_size;
+    std::string m_buffer;
+    //! For each open container, whether nothing was written into it yet
+    std::vector<bool> m_first;
+    bool m_after_key{false};
+    bool m_empty{true};
+    bool m_flushed{false};
+};
+
+#endif // BITCOIN_RPC_JSONSTREAM_H
@@ -760,6 +760,7 @@ static UniValue submitblock(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block does not start with a coinbase");
     }
 
+    block.Memoize();
     uint256 hash = block.GetHash();
     {
         LOCK(cs_main);
@@ -6,6 +6,7 @@
 
 #include <chainparams.h>
 #include <consensus/consensus.h>
+#include <dbwrapper.h>
 #include <evo/mnauth.h>
 #include <httpserver.h>
 #include <key_io.h>
@@ -1178,6 +1179,170 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
     }
 }
 
+static UniValue getlockstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 3)
+        throw std::runtime_error(
+            RPCHelpMan{"getlockstats",
+                "Returns the lock acquisition sites that had to wait the longest for a lock, while lock profiling\n"
+                "is on (-lockprofile or the enable argument). Only contended acquisitions are recorded.\n",
+                {
+                    {"count", RPCArg::Type::NUM, /* default */ "20", "Maximum number of sites to return, 0 for all"},
+                    {"reset", RPCArg::Type::BOOL, /* default */ "false", "Clear the recorded statistics after returning them"},
+                    {"enable", RPCArg::Type::BOOL, RPCArg::Optional::OMITTED, "Turn lock profiling on or off from now on, it stays as it is if omitted"},
+                },
+                RPCResult{
+                    RPCResult::Type::ARR, "", "",
+                    {
+                        {RPCResult::Type::OBJ, "", "",
+                        {
+                            {RPCResult::Type::STR, "lock", "The lock expression, e.g. cs_main"},
+                            {RPCResult::Type::STR, "site", "File and line that waited for the lock"},
+                            {RPCResult::Type::NUM, "contentions", "Number of acquisitions that had to wait"},
+                            {RPCResult::Type::NUM, "total_wait_us", "Total time spent waiting, in microseconds"},
+                            {RPCResult::Type::NUM, "max_wait_us", "Longest single wait, in microseconds"},
+                            {RPCResult::Type::OBJ_DYN, "wait_histogram", "Number of waits by upper bound in microseconds, empty buckets omitted",
+                            {
+                                {RPCResult::Type::NUM, "bound", "Number of waits shorter than bound"},
+                            }},
+                            {RPCResult::Type::OBJ_DYN, "holders", "Sites that held the lock while this site waited",
+                            {
+                                {RPCResult::Type::NUM, "site", "Number of waits on this holder"},
+                            }},
+                        }},
+                    }
+                },
+                RPCExamples{
+                    HelpExampleCli("getlockstats", "")
+            + HelpExampleCli("getlockstats", "0 true")
+            + HelpExampleCli("getlockstats", "0 true true")
+            + HelpExampleRpc("getlockstats", "10, false")
+                },
+            }.ToString());
+
+    const int count = request.params[0].isNull() ? 20 : request.params[0].get_int();
+    if (count < 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "count must be non-negative");
+    }
+    const bool reset = !request.params[1].isNull() && request.params[1].get_bool();
+    if (!request.params[2].isNull()) {
+        const bool enable = request.params[2].get_bool();
+        if (g_lock_profiling.exchange(enable) != enable) {
+            LogPrintf("Lock profiling turned %s\n", enable ? "on" : "off");
+        }
+    }
+
+    std::vector<LockContentionStats> stats = GetLockContentionStats();
+    if (reset) {
+        ResetLockContentionStats();
+    }
+
+    UniValue result(UniValue::VARR);
+    for (const LockContentionStats& site : stats) {
+        if (count != 0 && result.size() >= (size_t)count) break;
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("lock", site.name);
+        obj.pushKV("site", site.site);
+        obj.pushKV("contentions", site.nContentions);
+        obj.pushKV("total_wait_us", site.nTotalWaitMicros);
+        obj.pushKV("max_wait_us", site.nMaxWaitMicros);
+        UniValue histogram(UniValue::VOBJ);
+        for (size_t b = 0; b < site.vWaitHistogram.size(); ++b) {
+            if (site.vWaitHistogram[b] == 0) continue;
+            const std::string bound = b + 1 < site.vWaitHistogram.size() ? strprintf("%d", (int64_t)1 << b) : "inf";
+            histogram.pushKV(bound, site.vWaitHistogram[b]);
+        }
+        obj.pushKV("wait_histogram", histogram);
+        UniValue holders(UniValue::VOBJ);
+        for (const auto& holder : site.vHolders) {
+            holders.pushKV(holder.first, holder.second);
+        }
+        obj.pushKV("holders", holders);
+        result.push_back(obj);
+    }
+    return result;
+}
+
+static UniValue getdbstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 0)
+        throw std::runtime_error(
+            RPCHelpMan{"getdbstats",
+                "Returns cache, write and compaction statistics of all open LevelDB databases.\n",
+                {},
+                RPCResult{
+                    RPCResult::Type::ARR, "", "",
+                    {
+                        {RPCResult::Type::OBJ, "", "",
+                        {
+                            {RPCResult::Type::STR, "name", "The database name, e.g. chainstate or isdb"},
+                            {RPCResult::Type::STR, "path", "The database location, empty for in-memory databases"},
+                            {RPCResult::Type::NUM, "cache_size", "Configured cache size in bytes"},
+                            {RPCResult::Type::NUM, "bloom_bits", "Bloom filter bits per key, 0 if disabled"},
+                            {RPCResult::Type::NUM, "cache_usage", "Bytes currently held by the block cache"},
+                            {RPCResult::Type::NUM, "cache_hits", "Block cache lookups that hit"},
+                            {RPCResult::Type::NUM, "cache_misses", "Block cache lookups that missed"},
+                            {RPCResult::Type::NUM, "cache_hit_rate", "cache_hits / (cache_hits + cache_misses)"},
+                            {RPCResult::Type::NUM, "memory_usage", "Approximate memory used by the block cache and memtables in bytes"},
+                            {RPCResult::Type::NUM, "writes", "Number of write batches"},
+                            {RPCResult::Type::NUM, "write_time_us", "Total time spent writing batches, in microseconds"},
+                            {RPCResult::Type::NUM, "max_write_us", "Longest batch write, in microseconds"},
+                            {RPCResult::Type::NUM, "slow_writes", "Unsynced batch writes that took at least 1ms, usually because LevelDB throttled them while compacting"},
+                            {RPCResult::Type::ARR, "levels", "Non-empty levels",
+                            {
+                                {RPCResult::Type::OBJ, "", "",
+                                {
+                                    {RPCResult::Type::NUM, "level", "The level"},
+                                    {RPCResult::Type::NUM, "files", "Number of SST files"},
+                                    {RPCResult::Type::NUM, "size_mb", "Size of the SST files in MiB"},
+                                    {RPCResult::Type::NUM, "compaction_time_s", "Time spent compacting into this level, in seconds"},
+                                    {RPCResult::Type::NUM, "compaction_read_mb", "MiB read by compactions into this level"},
+                                    {RPCResult::Type::NUM, "compaction_write_mb", "MiB written by compactions into this level"},
+                                }},
+                            }},
+                        }},
+                    }
+                },
+                RPCExamples{
+                    HelpExampleCli("getdbstats", "")
+            + HelpExampleRpc("getdbstats", "")
+                },
+            }.ToString());
+
+    UniValue result(UniValue::VARR);
+    for (const DBStats& stats : GetDBStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("name", stats.name);
+        obj.pushKV("path", stats.path);
+        obj.pushKV("cache_size", (uint64_t)stats.nCacheSize);
+        obj.pushKV("bloom_bits", stats.nBloomBits);
+        obj.pushKV("cache_usage", (uint64_t)stats.nCacheUsage);
+        obj.pushKV("cache_hits", stats.nCacheHits);
+        obj.pushKV("cache_misses", stats.nCacheMisses);
+        const uint64_t lookups = stats.nCacheHits + stats.nCacheMisses;
+        obj.pushKV("cache_hit_rate", lookups ? (double)stats.nCacheHits / lookups : 0.0);
+        obj.pushKV("memory_usage", (uint64_t)stats.nMemoryUsage);
+        obj.pushKV("writes", stats.nWrites);
+        obj.pushKV("write_time_us", stats.nWriteMicros);
+        obj.pushKV("max_write_us", stats.nMaxWriteMicros);
+        obj.pushKV("slow_writes", stats.nSlowWrites);
+        UniValue levels(UniValue::VARR);
+        for (const DBStats::Level& level : stats.vLevels) {
+            UniValue entry(UniValue::VOBJ);
+            entry.pushKV("level", level.nLevel);
+            entry.pushKV("files", level.nFiles);
+            entry.pushKV("size_mb", level.dSizeMB);
+            entry.pushKV("compaction_time_s", level.dCompactionSec);
+            entry.pushKV("compaction_read_mb", level.dCompactionReadMB);
+            entry.pushKV("compaction_write_mb", level.dCompactionWriteMB);
+            levels.push_back(entry);
+        }
+        obj.pushKV("levels", levels);
+        result.push_back(obj);
+    }
+    return result;
+}
+
 static void EnableOrDisableLogCategories(UniValue cats, bool enable) {
     cats = cats.get_array();
     for (unsigned int i = 0; i < cats.size(); ++i) {
@@ -1318,6 +1483,8 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "debug",                  &debug,                  {} },
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
+    { "control",            "getlockstats",           &getlockstats,           {"count", "reset", "enable"} },
+    { "control",            "getdbstats",             &getdbstats,             {} },
     { "control",            "logging",                &logging,                {"include", "exclude"}},
     { "util",               "validateaddress",        &validateaddress,        {"address"} },
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys"} },
@@ -453,6 +453,75 @@ static UniValue getnettotals(const JSONRPCRequest& request)
     return obj;
 }
 
+static UniValue getnetmsgstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 2)
+        throw std::runtime_error(
+            RPCHelpMan{"getnetmsgstats",
+                "\nReturns where the message handler spends its time, per message type and class of peers\n"
+                "(inbound, outbound, masternode). All times are in microseconds.\n",
+                {
+                    {"command", RPCArg::Type::STR, /* default */ "\"\"", "Only report this message type"},
+                    {"reset", RPCArg::Type::BOOL, /* default */ "false", "Reset all statistics after reporting them"},
+                },
+                RPCResult{
+                   RPCResult::Type::OBJ, "", "",
+                   {
+                       {RPCResult::Type::NUM, "period", "Time since the statistics were started or reset"},
+                       {RPCResult::Type::OBJ, "handler", "",
+                       {
+                           {RPCResult::Type::NUM, "busy_time", "Time the message handler thread was working"},
+                           {RPCResult::Type::NUM, "idle_time", "Time the message handler thread was waiting for work"},
+                           {RPCResult::Type::OBJ_DYN, "sendmessages_time", "Time spent in SendMessages, per class of peers",
+                           {
+                               {RPCResult::Type::NUM, "class", "Time spent for this class of peers"},
+                           }},
+                       }},
+                       {RPCResult::Type::OBJ_DYN, "messages", "",
+                       {
+                           {RPCResult::Type::OBJ, "command", "Statistics of this message type, over all peers",
+                           {
+                               {RPCResult::Type::NUM, "count", "Number of processed messages"},
+                               {RPCResult::Type::NUM, "process_time_total", "Total processing time"},
+                               {RPCResult::Type::NUM, "process_time_avg", "Average processing time"},
+                               {RPCResult::Type::NUM, "process_time_max", "Maximum processing time"},
+                               {RPCResult::Type::NUM, "queue_time_avg", "Average time between receiving and processing a message"},
+                               {RPCResult::Type::NUM, "queue_time_max", "Maximum time between receiving and processing a message"},
+                               {RPCResult::Type::NUM, "lock_wait_total", "Time spent blocked on contended locks while processing"},
+                               {RPCResult::Type::OBJ_DYN, "process_time_histogram", "Number of messages per processing time bucket",
+                               {
+                                   {RPCResult::Type::NUM, "bound", "Messages processed in less than this time"},
+                               }},
+                               {RPCResult::Type::OBJ_DYN, "peers", "The same statistics per class of peers",
+                               {
+                                   {RPCResult::Type::ELISION, "", ""},
+                               }},
+                           }},
+                       }},
+                   }
+                },
+                RPCExamples{
+                    HelpExampleCli("getnetmsgstats", "")
+            + HelpExampleCli("getnetmsgstats", "\"qsigshare\"")
+            + HelpExampleRpc("getnetmsgstats", "\"\", true")
+                },
+            }.ToString());
+    if(!g_connman)
+        throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
+
+    std::string strFilter;
+    if (!request.params[0].isNull()) {
+        strFilter = request.params[0].get_str();
+    }
+
+    CNetMsgStats& stats = g_connman->GetMsgStats();
+    UniValue ret = stats.ToJson(strFilter);
+    if (!request.params[1].isNull() && request.params[1].get_bool()) {
+        stats.Reset();
+    }
+    return ret;
+}
+
 static UniValue GetNetworksInfo()
 {
     UniValue networks(UniValue::VARR);
@@ -828,6 +897,7 @@ static const CRPCCommand commands[] =
     { "network",            "disconnectnode",         &disconnectnode,         {"address", "nodeid"} },
     { "network",            "getaddednodeinfo",       &getaddednodeinfo,       {"node"} },
     { "network",            "getnettotals",           &getnettotals,           {} },
+    { "network",            "getnetmsgstats",         &getnetmsgstats,         {"command", "reset"} },
     { "network",            "getnetworkinfo",         &getnetworkinfo,         {} },
     { "network",            "setban",                 &setban,                 {"subnet", "command", "bantime", "absolute"} },
     { "network",            "listbanned",             &listbanned,             {} },
@@ -31,6 +31,7 @@
 #include <util/bip32.h>
 #include <util/moneystr.h>
 #include <util/strencodings.h>
+#include <util/translation.h>
 #include <util/validation.h>
 #include <validation.h>
 #include <validationinterface.h>
@@ -41,6 +42,7 @@
 #include <llmq/instantsend.h>
 
 #include <numeric>
+#include <optional>
 #include <stdint.h>
 
 #include <univalue.h>
@@ -846,6 +848,98 @@ UniValue sendrawtransaction(const JSONRPCRequest& request)
     return tx->GetHash().GetHex();
 }
 
+static UniValue sendrawtransactions(const JSONRPCRequest& request)
+{
+    const RPCHelpMan help{"sendrawtransactions",
+                "\nSubmit a batch of raw transactions (serialized, hex-encoded) to local node and network.\n"
+                "\nThe transactions are validated together, which is much faster than submitting them one\n"
+                "by one with sendrawtransaction. Transactions may spend outputs of earlier ones in the array.\n"
+                "A transaction listed more than once is submitted once, all its entries get the same result.\n"
+                "\nSee sendrawtransaction call.\n",
+                {
+                    {"rawtxs", RPCArg::Type::ARR, RPCArg::Optional::NO, "An array of hex strings of raw transactions.",
+                        {
+                            {"rawtx", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED, ""},
+                        },
+                        },
+                    {"maxfeerate", RPCArg::Type::AMOUNT, /* default */ FormatMoney(DEFAULT_MAX_RAW_TX_FEE), "Reject transactions whose fee rate is higher than the specified value, expressed in " + CURRENCY_UNIT + "/kB\n"},
+                    {"bypasslimits", RPCArg::Type::BOOL, /* default_val */ "false", "Bypass transaction policy limits"},
+                },
+                RPCResult{
+                    RPCResult::Type::ARR, "", "The result for each raw transaction in the input array.",
+                    {
+                        {RPCResult::Type::OBJ, "", "",
+                        {
+                            {RPCResult::Type::STR_HEX, "txid", "The transaction hash in hex"},
+                            {RPCResult::Type::BOOL, "accepted", "If the transaction is in the mempool and was relayed"},
+                            {RPCResult::Type::STR, "error", "Rejection string (only present when 'accepted' is false)"},
+                        }},
+                    }
+                },
+                RPCExamples{
+                    HelpExampleCli("sendrawtransactions", R"('["signedhex1","signedhex2"]')") +
+                    HelpExampleRpc("sendrawtransactions", "[\"signedhex1\",\"signedhex2\"]")
+                },
+    };
+
+    if (request.fHelp || !help.IsValidNumArgs(request.params.size())) {
+        throw std::runtime_error(help.ToString());
+    }
+
+    RPCTypeCheck(request.params, {
+        UniValue::VARR,
+        UniValue::VNUM,
+        UniValue::VBOOL
+    }, true);
+    if (request.params[0].isNull()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "rawtxs must be an array");
+    }
+
+    const UniValue& rawtxs = request.params[0].get_array();
+    std::optional<CFeeRate> max_raw_tx_feerate;
+    if (!request.params[1].isNull()) {
+        max_raw_tx_feerate = CFeeRate(AmountFromValue(request.params[1]));
+    }
+
+    std::vector<CTransactionRef> txs;
+    std::vector<CAmount> max_tx_fees;
+    // a transaction listed more than once is submitted once and shares the result of its first entry
+    std::map<uint256, size_t> mapSubmitted;
+    std::vector<size_t> vSubmitted;
+    for (size_t i = 0; i < rawtxs.size(); i++) {
+        CMutableTransaction mtx;
+        if (!DecodeHexTx(mtx, rawtxs[i].get_str())) {
+            throw JSONRPCError(RPC_DESERIALIZATION_ERROR, strprintf("TX decode failed for transaction %d", i));
+        }
+        CTransactionRef tx = MakeTransactionRef(std::move(mtx));
+        const auto it = mapSubmitted.emplace(tx->GetHash(), txs.size()).first;
+        vSubmitted.push_back(it->second);
+        if (it->second < txs.size()) continue;
+        max_tx_fees.push_back(max_raw_tx_feerate ? max_raw_tx_feerate->GetFee(GetVirtualTransactionSize(*tx)) :
+                                                   DEFAULT_MAX_RAW_TX_FEE);
+        txs.push_back(std::move(tx));
+    }
+
+    bool bypass_limits = false;
+    if (!request.params[2].isNull()) bypass_limits = request.params[2].get_bool();
+    std::vector<TransactionError> errors;
+    std::vector<std::string> err_strings;
+    AssertLockNotHeld(cs_main);
+    BroadcastTransactions(txs, errors, err_strings, max_tx_fees, /* relay */ true, /* wait_callback */ true, bypass_limits);
+
+    UniValue result(UniValue::VARR);
+    for (const size_t i : vSubmitted) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("txid", txs[i]->GetHash().GetHex());
+        entry.pushKV("accepted", errors[i] == TransactionError::OK);
+        if (errors[i] != TransactionError::OK) {
+            entry.pushKV("error", err_strings[i].empty() ? TransactionErrorString(errors[i]).original : err_strings[i]);
+        }
+        result.push_back(std::move(entry));
+    }
+    return result;
+}
+
 static UniValue testmempoolaccept(const JSONRPCRequest& request)
 {
     const RPCHelpMan help{"testmempoolaccept",
@@ -1571,6 +1665,7 @@ static const CRPCCommand commands[] =
     { "rawtransactions",    "decoderawtransaction",         &decoderawtransaction,      {"hexstring"} },
     { "rawtransactions",    "decodescript",                 &decodescript,              {"hexstring"} },
     { "rawtransactions",    "sendrawtransaction",           &sendrawtransaction,        {"hexstring","allowhighfees|maxfeerate","instantsend","bypasslimits"} },
+    { "rawtransactions",    "sendrawtransactions",          &sendrawtransactions,       {"rawtxs","maxfeerate","bypasslimits"} },
     { "rawtransactions",    "combinerawtransaction",        &combinerawtransaction,     {"txs"} },
     { "rawtransactions",    "signrawtransactionwithkey",    &signrawtransactionwithkey, {"hexstring","privkeys","prevtxs","sighashtype"} },
     { "rawtransactions",    "testmempoolaccept",            &testmempoolaccept,         {"rawtxs","allowhighfees|maxfeerate"} },
@@ -10,6 +10,8 @@
 
 #include <univalue.h>
 
+class JSONStreamWriter;
+
 UniValue JSONRPCRequestObj(const std::string& strMethod, const UniValue& params, const UniValue& id);
 UniValue JSONRPCReplyObj(const UniValue& result, const UniValue& error, const UniValue& id);
 std::string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValue& id);
@@ -34,8 +36,14 @@ public:
     std::string URI;
     std::string authUser;
     std::string peerAddr;
-
-    JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false) {}
+    /**
+     * Set when the caller can take the result as a stream. Handlers of large
+     * results may then write the result into it instead of returning it, see
+     * JSONStreamWriter. The returned value is ignored if anything was written.
+     */
+    JSONStreamWriter* streamWriter;
+
+    JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false), streamWriter(nullptr) {}
     void parse(const UniValue& valRequest);
 };
 
@@ -16,6 +16,7 @@
 #include <masternode/meta.h>
 #include <messagesigner.h>
 #include <netbase.h>
+#include <rpc/jsonstream.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <util/moneystr.h>
@@ -1060,17 +1061,27 @@ static UniValue protx_list(const JSONRPCRequest& request)
             protx_list_help(request);
         }
 
-        LOCK(cs_main);
-
         bool detailed = !request.params[2].isNull() ? ParseBoolV(request.params[2], "detailed") : false;
 
-        int height = !request.params[3].isNull() ? ParseInt32V(request.params[3], "height") : ::ChainActive().Height();
-        if (height < 1 || height > ::ChainActive().Height()) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid height specified");
+        CDeterministicMNList mnList;
+        {
+            LOCK(cs_main);
+            int height = !request.params[3].isNull() ? ParseInt32V(request.params[3], "height") : ::ChainActive().Height();
+            if (height < 1 || height > ::ChainActive().Height()) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid height specified");
+            }
+            mnList = deterministicMNManager->GetListForBlock(::ChainActive()[height]);
         }
-
-        CDeterministicMNList mnList = deterministicMNManager->GetListForBlock(::ChainActive()[height]);
         bool onlyValid = type == "valid";
+        if (request.streamWriter) {
+            // The list is a snapshot, so it is streamed without cs_main: the writer may block on the client
+            request.streamWriter->BeginArray();
+            mnList.ForEachMN(onlyValid, [&](const auto& dmn) {
+                request.streamWriter->Value(BuildDMNListEntry(pwallet, dmn, detailed));
+            });
+            request.streamWriter->EndArray();
+            return NullUniValue;
+        }
         mnList.ForEachMN(onlyValid, [&](const auto& dmn) {
             ret.push_back(BuildDMNListEntry(pwallet, dmn, detailed));
         });
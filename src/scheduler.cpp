@@ -4,8 +4,10 @@
 
 #include <scheduler.h>
 
+#include <optional.h>
 #include <random.h>
 
+#include <algorithm>
 #include <assert.h>
 #include <utility>
 
@@ -19,6 +21,25 @@ CScheduler::~CScheduler()
 }
 
 
+bool CScheduler::queuesEmpty() const
+{
+    for (const TaskQueue& queue : taskQueues) {
+        if (!queue.empty()) return false;
+    }
+    return true;
+}
+
+bool CScheduler::canRun(Priority priority) const
+{
+    // A single worker runs everything in lane order
+    if (priority == Priority::HIGH || nThreadsServicingQueue <= 1) return true;
+    const int nRunningLow = nThreadsRunning[size_t(Priority::LOW)];
+    // Keep one worker free for HIGH tasks
+    if (nThreadsRunning[size_t(Priority::NORMAL)] + nRunningLow + 1 >= nThreadsServicingQueue) return false;
+    // and, with three or more, one for NORMAL tasks too
+    return priority != Priority::LOW || nRunningLow == 0 || nRunningLow + 2 < nThreadsServicingQueue;
+}
+
 void CScheduler::serviceQueue()
 {
     WAIT_LOCK(newTaskMutex, lock);
@@ -27,23 +48,37 @@ void CScheduler::serviceQueue()
     // newTaskMutex is locked throughout this loop EXCEPT
     // when the thread is waiting or when the user's function
     // is called.
+    Optional<size_t> running;
     while (!shouldStop()) {
         try {
-            if (!shouldStop() && taskQueue.empty()) {
+            if (!shouldStop() && queuesEmpty()) {
                 REVERSE_LOCK(lock);
                 // Use this chance to get more entropy
                 RandAddSeedSleep();
             }
-            while (!shouldStop() && taskQueue.empty()) {
+            while (!shouldStop() && queuesEmpty()) {
                 // Wait until there is something to do.
                 newTaskScheduled.wait(lock);
             }
 
             // Wait until either there is a new task, or until
-            // the time of the first item on the queue:
+            // the time of the first runnable item on the queues:
 
-            while (!shouldStop() && !taskQueue.empty()) {
-                std::chrono::system_clock::time_point timeToWaitFor = taskQueue.begin()->first;
+            while (!shouldStop() && !queuesEmpty()) {
+                bool fRunnable = false;
+                std::chrono::system_clock::time_point timeToWaitFor;
+                for (size_t i = 0; i < NUM_PRIORITIES; ++i) {
+                    if (taskQueues[i].empty() || !canRun(Priority(i))) continue;
+                    if (!fRunnable || taskQueues[i].begin()->first < timeToWaitFor) {
+                        timeToWaitFor = taskQueues[i].begin()->first;
+                    }
+                    fRunnable = true;
+                }
+                if (!fRunnable) {
+                    // Only tasks held back for HIGH (or NORMAL) work are queued
+                    newTaskScheduled.wait(lock);
+                    continue;
+                }
                 if (newTaskScheduled.wait_until(lock, timeToWaitFor) == std::cv_status::timeout) {
                     break; // Exit loop after timeout, it means we reached the time of the event
                 }
@@ -51,19 +86,47 @@ void CScheduler::serviceQueue()
 
             // If there are multiple threads, the queue can empty while we're waiting (another
             // thread may service the task we were waiting on).
-            if (shouldStop() || taskQueue.empty())
+            if (shouldStop() || queuesEmpty())
                 continue;
 
-            Function f = taskQueue.begin()->second;
-            taskQueue.erase(taskQueue.begin());
+            // Take the most urgent lane that has a task due
+            const auto now = std::chrono::system_clock::now();
+            size_t lane = NUM_PRIORITIES;
+            for (size_t i = 0; i < NUM_PRIORITIES; ++i) {
+                if (!taskQueues[i].empty() && taskQueues[i].begin()->first <= now && canRun(Priority(i))) {
+                    lane = i;
+                    break;
+                }
+            }
+            if (lane == NUM_PRIORITIES)
+                continue;
+
+            Task task = std::move(taskQueues[lane].begin()->second);
+            taskQueues[lane].erase(taskQueues[lane].begin());
+            running = lane;
+            ++nThreadsRunning[lane];
 
+            const auto nStart = std::chrono::steady_clock::now();
             {
                 // Unlock before calling f, so it can reschedule itself or another task
                 // without deadlocking:
                 REVERSE_LOCK(lock);
-                f();
+                task.f();
+            }
+            const int64_t nMicros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - nStart).count();
+
+            --nThreadsRunning[lane];
+            running = nullopt;
+            if (Priority(lane) != Priority::HIGH) {
+                // A task that was held back may be able to run now
+                newTaskScheduled.notify_all();
             }
+            TaskStats& stats = mapTaskStats[task.name ? task.name : "other"];
+            stats.nRuns++;
+            stats.nTotalMicros += nMicros;
+            stats.nMaxMicros = std::max(stats.nMaxMicros, nMicros);
         } catch (...) {
+            if (running) --nThreadsRunning[*running];
             --nThreadsServicingQueue;
             throw;
         }
@@ -84,39 +147,41 @@ void CScheduler::stop(bool drain)
     newTaskScheduled.notify_all();
 }
 
-void CScheduler::schedule(CScheduler::Function f, std::chrono::system_clock::time_point t)
+void CScheduler::schedule(CScheduler::Function f, std::chrono::system_clock::time_point t, Priority priority, const char* name)
 {
     {
         LOCK(newTaskMutex);
-        taskQueue.insert(std::make_pair(t, f));
+        taskQueues[size_t(priority)].insert(std::make_pair(t, Task{std::move(f), name}));
     }
     newTaskScheduled.notify_one();
 }
 
-void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds)
+void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds, Priority priority, const char* name)
 {
-    schedule(f, std::chrono::system_clock::now() + std::chrono::milliseconds(deltaMilliSeconds));
+    schedule(std::move(f), std::chrono::system_clock::now() + std::chrono::milliseconds(deltaMilliSeconds), priority, name);
 }
 
-static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds)
+static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds, CScheduler::Priority priority, const char* name)
 {
     f();
-    s->scheduleFromNow(std::bind(&Repeat, s, f, deltaMilliSeconds), deltaMilliSeconds);
+    s->scheduleFromNow(std::bind(&Repeat, s, f, deltaMilliSeconds, priority, name), deltaMilliSeconds, priority, name);
 }
 
-void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaMilliSeconds)
+void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaMilliSeconds, Priority priority, const char* name)
 {
-    scheduleFromNow(std::bind(&Repeat, this, f, deltaMilliSeconds), deltaMilliSeconds);
+    scheduleFromNow(std::bind(&Repeat, this, f, deltaMilliSeconds, priority, name), deltaMilliSeconds, priority, name);
 }
 
 size_t CScheduler::getQueueInfo(std::chrono::system_clock::time_point &first,
                              std::chrono::system_clock::time_point &last) const
 {
     LOCK(newTaskMutex);
-    size_t result = taskQueue.size();
-    if (!taskQueue.empty()) {
-        first = taskQueue.begin()->first;
-        last = taskQueue.rbegin()->first;
+    size_t result = 0;
+    for (const TaskQueue& queue : taskQueues) {
+        if (queue.empty()) continue;
+        if (result == 0 || queue.begin()->first < first) first = queue.begin()->first;
+        if (result == 0 || queue.rbegin()->first > last) last = queue.rbegin()->first;
+        result += queue.size();
     }
     return result;
 }
@@ -126,6 +191,12 @@ bool CScheduler::AreThreadsServicingQueue() const {
     return nThreadsServicingQueue;
 }
 
+std::map<std::string, CScheduler::TaskStats> CScheduler::getTaskStats() const
+{
+    LOCK(newTaskMutex);
+    return mapTaskStats;
+}
+
 
 void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue() {
     {
@@ -136,7 +207,7 @@ void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue() {
         if (m_are_callbacks_running) return;
         if (m_callbacks_pending.empty()) return;
     }
-    m_pscheduler->schedule(std::bind(&SingleThreadedSchedulerClient::ProcessQueue, this), std::chrono::system_clock::now());
+    m_pscheduler->schedule(std::bind(&SingleThreadedSchedulerClient::ProcessQueue, this), std::chrono::system_clock::now(), m_priority, "serialclient");
 }
 
 void SingleThreadedSchedulerClient::ProcessQueue() {
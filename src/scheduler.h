@@ -5,10 +5,12 @@
 #ifndef BITCOIN_SCHEDULER_H
 #define BITCOIN_SCHEDULER_H
 
+#include <array>
 #include <condition_variable>
 #include <functional>
 #include <list>
 #include <map>
+#include <string>
 
 #include <sync.h>
 
@@ -23,6 +25,11 @@
 // s->scheduleFromNow(std::bind(Class::func, this, argument), 3);
 // std::thread* t = new std::thread([&] { s->serviceQueue(); });
 //
+// Several threads may run serviceQueue. Tasks are picked by priority lane first
+// and due time second. NORMAL and LOW tasks never occupy the last worker, so
+// HIGH work always finds one, and LOW tasks also leave one worker to NORMAL
+// tasks when there are at least three.
+//
 // ... then at program shutdown, make sure to call stop() to clean up the thread(s) running serviceQueue:
 // s->stop();
 // t->join();
@@ -30,6 +37,10 @@
 // delete s; // Must be done after thread is interrupted/joined.
 //
 
+// Two workers: HIGH tasks get their own, NORMAL and LOW maintenance still run one at a time
+static const int DEFAULT_SCHEDULER_THREADS = 2;
+static const int MAX_SCHEDULER_THREADS = 8;
+
 class CScheduler
 {
 public:
@@ -38,18 +49,33 @@ public:
 
     typedef std::function<void()> Function;
 
-    // Call func at/after time t
-    void schedule(Function f, std::chrono::system_clock::time_point t);
+    enum class Priority : uint8_t {
+        HIGH,   //!< Latency sensitive work, e.g. validation interface callbacks
+        NORMAL,
+        LOW,    //!< Slow maintenance and dumps to disk
+    };
+    static constexpr size_t NUM_PRIORITIES = 3;
+
+    //! Runtime accounting of all tasks scheduled under one name
+    struct TaskStats {
+        uint64_t nRuns{0};
+        int64_t nTotalMicros{0};
+        int64_t nMaxMicros{0};
+    };
+
+    // Call func at/after time t. name must be a string literal, runtimes
+    // are accounted per name.
+    void schedule(Function f, std::chrono::system_clock::time_point t, Priority priority = Priority::NORMAL, const char* name = nullptr);
 
     // Convenience method: call f once deltaMilliSeconds from now
-    void scheduleFromNow(Function f, int64_t deltaMilliSeconds);
+    void scheduleFromNow(Function f, int64_t deltaMilliSeconds, Priority priority = Priority::NORMAL, const char* name = nullptr);
 
     // Another convenience method: call f approximately
     // every deltaMilliSeconds forever, starting deltaMilliSeconds from now.
     // To be more precise: every time f is finished, it
     // is rescheduled to run deltaMilliSeconds later. If you
     // need more accurate scheduling, don't use this method.
-    void scheduleEvery(Function f, int64_t deltaMilliSeconds);
+    void scheduleEvery(Function f, int64_t deltaMilliSeconds, Priority priority = Priority::NORMAL, const char* name = nullptr);
 
     // To keep things as simple as possible, there is no unschedule.
 
@@ -70,14 +96,30 @@ public:
     // Returns true if there are threads actively running in serviceQueue()
     bool AreThreadsServicingQueue() const;
 
+    // Returns runtime accounting per task name, unnamed tasks are reported as "other"
+    std::map<std::string, TaskStats> getTaskStats() const;
+
 private:
+    struct Task {
+        Function f;
+        const char* name;
+    };
+    typedef std::multimap<std::chrono::system_clock::time_point, Task> TaskQueue;
+
     mutable Mutex newTaskMutex;
     std::condition_variable newTaskScheduled;
-    std::multimap<std::chrono::system_clock::time_point, Function> taskQueue GUARDED_BY(newTaskMutex);
+    std::array<TaskQueue, NUM_PRIORITIES> taskQueues GUARDED_BY(newTaskMutex);
     int nThreadsServicingQueue GUARDED_BY(newTaskMutex);
+    //! Workers busy with a task, per lane
+    std::array<int, NUM_PRIORITIES> nThreadsRunning GUARDED_BY(newTaskMutex){};
     bool stopRequested GUARDED_BY(newTaskMutex);
     bool stopWhenEmpty GUARDED_BY(newTaskMutex);
-    bool shouldStop() const EXCLUSIVE_LOCKS_REQUIRED(newTaskMutex) { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
+    std::map<std::string, TaskStats> mapTaskStats GUARDED_BY(newTaskMutex);
+
+    bool queuesEmpty() const EXCLUSIVE_LOCKS_REQUIRED(newTaskMutex);
+    //! Whether a task of this priority may start now without starving higher lanes
+    bool canRun(Priority priority) const EXCLUSIVE_LOCKS_REQUIRED(newTaskMutex);
+    bool shouldStop() const EXCLUSIVE_LOCKS_REQUIRED(newTaskMutex) { return stopRequested || (stopWhenEmpty && queuesEmpty()); }
 };
 
 /**
@@ -93,6 +135,7 @@ private:
 class SingleThreadedSchedulerClient {
 private:
     CScheduler *m_pscheduler;
+    CScheduler::Priority m_priority;
 
     CCriticalSection m_cs_callbacks_pending;
     std::list<std::function<void ()>> m_callbacks_pending GUARDED_BY(m_cs_callbacks_pending);
@@ -102,7 +145,7 @@ private:
     void ProcessQueue();
 
 public:
-    explicit SingleThreadedSchedulerClient(CScheduler *pschedulerIn) : m_pscheduler(pschedulerIn) {}
+    explicit SingleThreadedSchedulerClient(CScheduler *pschedulerIn, CScheduler::Priority priority = CScheduler::Priority::HIGH) : m_pscheduler(pschedulerIn), m_priority(priority) {}
 
     /**
      * Add a callback to be executed. Callbacks are executed serially
@@ -35,8 +35,12 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <random.h>
 #include <util/system.h>
 
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
 
 statsd::StatsdClient statsClient;
 
@@ -61,6 +65,71 @@ inline bool should_send(float sample_rate)
     return sample_rate > p;
 }
 
+struct Shard {
+    alignas(64) std::atomic<int64_t> value{0};
+    // timing histogram, allocated by the first thread recording into this shard
+    std::atomic<std::atomic<uint64_t>*> buckets{nullptr};
+
+    ~Shard() { delete[] buckets.load(); }
+
+    std::atomic<uint64_t>* GetBuckets()
+    {
+        std::atomic<uint64_t>* ret = buckets.load(std::memory_order_acquire);
+        if (ret != nullptr) return ret;
+        std::atomic<uint64_t>* fresh = new std::atomic<uint64_t>[TIMING_BUCKETS];
+        for (size_t i = 0; i < TIMING_BUCKETS; ++i) {
+            fresh[i].store(0, std::memory_order_relaxed);
+        }
+        if (buckets.compare_exchange_strong(ret, fresh, std::memory_order_acq_rel)) {
+            return fresh;
+        }
+        delete[] fresh;
+        return ret;
+    }
+};
+
+struct Metric {
+    Metric(const std::string& keyIn, MetricType typeIn) : key(keyIn), type(typeIn) {}
+
+    const std::string key;
+    const MetricType type;
+
+    // gauges keep only the last value, doubles are stored bitwise
+    std::atomic<bool> fGaugeSet{false};
+    std::atomic<int64_t> nGauge{0};
+
+    // counters and timings are sharded so concurrent writers don't share a cache line
+    std::array<Shard, METRIC_SHARDS> shards;
+};
+
+static size_t ThreadShard()
+{
+    static std::atomic<size_t> nNextShard{0};
+    thread_local const size_t nShard = nNextShard.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+    return nShard;
+}
+
+size_t TimingBucket(int64_t value)
+{
+    if (value <= 0) return 0;
+    uint64_t v = std::min<uint64_t>(value, (uint64_t{1} << (MAX_TIMING_EXP + 1)) - 1);
+    if (v < (1 << TIMING_SUB_BUCKET_BITS)) return v;
+    int exp = 63 - __builtin_clzll(v);
+    int shift = exp - TIMING_SUB_BUCKET_BITS;
+    size_t sub = (v >> shift) & ((1 << TIMING_SUB_BUCKET_BITS) - 1);
+    return ((size_t)(shift + 1) << TIMING_SUB_BUCKET_BITS) + sub;
+}
+
+int64_t TimingBucketValue(size_t bucket)
+{
+    if (bucket < (1 << TIMING_SUB_BUCKET_BITS)) return bucket;
+    int shift = (bucket >> TIMING_SUB_BUCKET_BITS) - 1;
+    int64_t sub = bucket & ((1 << TIMING_SUB_BUCKET_BITS) - 1);
+    int64_t lower = ((int64_t{1} << TIMING_SUB_BUCKET_BITS) | sub) << shift;
+    // middle of [lower, lower + 2^shift)
+    return lower + (((int64_t{1} << shift) - 1) / 2);
+}
+
 struct _StatsdClientData {
     SOCKET  sock;
     struct  sockaddr_in server;
@@ -96,10 +165,15 @@ void StatsdClient::config(const std::string& host, int port, const std::string&
     CloseSocket(d->sock);
 }
 
-int StatsdClient::init()
+bool StatsdClient::enabled()
 {
     static bool fEnabled = gArgs.GetBoolArg("-statsenabled", DEFAULT_STATSD_ENABLE);
-    if (!fEnabled) return -3;
+    return fEnabled;
+}
+
+int StatsdClient::init()
+{
+    if (!enabled()) return -3;
 
     if ( d->init ) return 0;
 
@@ -140,6 +214,21 @@ void StatsdClient::cleanup(std::string& key)
     }
 }
 
+std::string StatsdClient::wireKey(const std::string& key) const
+{
+    std::string ret = d->ns + key;
+    // partition stats by node name if set
+    if (!d->nodename.empty())
+        ret += "." + d->nodename;
+    cleanup(ret);
+    return ret;
+}
+
+// The string based calls below go through the registry as well, so they are
+// aggregated and batched like everything else. They still pay for building
+// and looking up the key though, hot paths should keep a MetricHandle.
+// Should the registry be full we fall back to sending right away.
+
 int StatsdClient::dec(const std::string& key, float sample_rate)
 {
     return count(key, -1, sample_rate);
@@ -152,22 +241,183 @@ int StatsdClient::inc(const std::string& key, float sample_rate)
 
 int StatsdClient::count(const std::string& key, size_t value, float sample_rate)
 {
-    return send(key, value, "c", sample_rate);
+    if (!enabled()) return -3;
+    MetricHandle handle = intern(key, MetricType::COUNTER);
+    if (!handle.IsValid()) return send(key, value, "c", sample_rate);
+    count(handle, (int64_t)value);
+    return 0;
 }
 
 int StatsdClient::gauge(const std::string& key, size_t value, float sample_rate)
 {
-    return send(key, value, "g", sample_rate);
+    if (!enabled()) return -3;
+    MetricHandle handle = intern(key, MetricType::GAUGE);
+    if (!handle.IsValid()) return send(key, value, "g", sample_rate);
+    gauge(handle, (int64_t)value);
+    return 0;
 }
 
 int StatsdClient::gaugeDouble(const std::string& key, double value, float sample_rate)
 {
-    return sendDouble(key, value, "g", sample_rate);
+    if (!enabled()) return -3;
+    MetricHandle handle = intern(key, MetricType::GAUGE_DOUBLE);
+    if (!handle.IsValid()) return sendDouble(key, value, "g", sample_rate);
+    gaugeDouble(handle, value);
+    return 0;
 }
 
 int StatsdClient::timing(const std::string& key, size_t ms, float sample_rate)
 {
-    return send(key, ms, "ms", sample_rate);
+    if (!enabled()) return -3;
+    MetricHandle handle = intern(key, MetricType::TIMING);
+    if (!handle.IsValid()) return send(key, ms, "ms", sample_rate);
+    timing(handle, (int64_t)ms);
+    return 0;
+}
+
+MetricHandle StatsdClient::intern(const std::string& key, MetricType type)
+{
+    LOCK(cs_registry);
+    auto& mapType = mapMetrics[static_cast<size_t>(type)];
+    auto it = mapType.find(key);
+    if (it != mapType.end()) {
+        return MetricHandle(it->second);
+    }
+    if (vMetrics.size() >= MAX_METRICS) {
+        return MetricHandle();
+    }
+    vMetrics.emplace_back(std::make_unique<Metric>(key, type));
+    Metric* metric = vMetrics.back().get();
+    mapType.emplace(key, metric);
+    return MetricHandle(metric);
+}
+
+void StatsdClient::count(const MetricHandle& handle, int64_t value)
+{
+    if (!handle.IsValid()) return;
+    assert(handle.m->type == MetricType::COUNTER);
+    handle.m->shards[ThreadShard()].value.fetch_add(value, std::memory_order_relaxed);
+}
+
+void StatsdClient::gauge(const MetricHandle& handle, int64_t value)
+{
+    if (!handle.IsValid()) return;
+    assert(handle.m->type == MetricType::GAUGE);
+    handle.m->nGauge.store(value, std::memory_order_relaxed);
+    handle.m->fGaugeSet.store(true, std::memory_order_release);
+}
+
+void StatsdClient::gaugeDouble(const MetricHandle& handle, double value)
+{
+    if (!handle.IsValid()) return;
+    assert(handle.m->type == MetricType::GAUGE_DOUBLE);
+    int64_t bits;
+    static_assert(sizeof(bits) == sizeof(value), "unexpected double size");
+    memcpy(&bits, &value, sizeof(bits));
+    handle.m->nGauge.store(bits, std::memory_order_relaxed);
+    handle.m->fGaugeSet.store(true, std::memory_order_release);
+}
+
+void StatsdClient::timing(const MetricHandle& handle, int64_t value)
+{
+    if (!handle.IsValid()) return;
+    assert(handle.m->type == MetricType::TIMING);
+    handle.m->shards[ThreadShard()].GetBuckets()[TimingBucket(value)].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<std::string> StatsdClient::collect()
+{
+    std::vector<std::string> vDatagrams;
+    std::string strDatagram;
+    auto append = [&](const std::string& line) {
+        if (!strDatagram.empty() && strDatagram.size() + 1 + line.size() > MAX_DATAGRAM_SIZE) {
+            vDatagrams.emplace_back(std::move(strDatagram));
+            strDatagram.clear();
+        }
+        if (!strDatagram.empty()) strDatagram += '\n';
+        strDatagram += line;
+    };
+
+    LOCK(cs_registry);
+    for (const auto& metric : vMetrics) {
+        switch (metric->type) {
+        case MetricType::COUNTER: {
+            int64_t nTotal = 0;
+            for (auto& shard : metric->shards) {
+                nTotal += shard.value.exchange(0, std::memory_order_relaxed);
+            }
+            if (nTotal != 0) {
+                append(strprintf("%s:%d|c", wireKey(metric->key), nTotal));
+            }
+            break;
+        }
+        case MetricType::GAUGE:
+        case MetricType::GAUGE_DOUBLE: {
+            if (!metric->fGaugeSet.exchange(false, std::memory_order_acquire)) break;
+            int64_t bits = metric->nGauge.load(std::memory_order_relaxed);
+            if (metric->type == MetricType::GAUGE) {
+                append(strprintf("%s:%d|g", wireKey(metric->key), bits));
+            } else {
+                double value;
+                memcpy(&value, &bits, sizeof(value));
+                append(strprintf("%s:%f|g", wireKey(metric->key), value));
+            }
+            break;
+        }
+        case MetricType::TIMING: {
+            std::array<uint64_t, TIMING_BUCKETS> counts{};
+            uint64_t nTotal = 0;
+            for (auto& shard : metric->shards) {
+                std::atomic<uint64_t>* buckets = shard.buckets.load(std::memory_order_acquire);
+                if (buckets == nullptr) continue;
+                for (size_t i = 0; i < TIMING_BUCKETS; ++i) {
+                    const uint64_t nCount = buckets[i].exchange(0, std::memory_order_relaxed);
+                    counts[i] += nCount;
+                    nTotal += nCount;
+                }
+            }
+            if (nTotal == 0) break;
+            // one summary per period instead of the samples themselves: the values are the
+            // representative ones of each bucket, so mean and percentiles are within its ~12%
+            double dSum = 0;
+            for (size_t i = 0; i < TIMING_BUCKETS; ++i) {
+                dSum += (double)counts[i] * TimingBucketValue(i);
+            }
+            append(strprintf("%s:%d|g", wireKey(metric->key + ".count"), nTotal));
+            append(strprintf("%s:%d|g", wireKey(metric->key + ".mean"), (int64_t)(dSum / nTotal)));
+            for (const auto& [nPercent, strSuffix] : {std::make_pair(50, ".p50"), std::make_pair(95, ".p95"), std::make_pair(99, ".p99")}) {
+                // smallest bucket that covers at least nPercent of the samples
+                const uint64_t nRank = (nTotal * nPercent + 99) / 100;
+                uint64_t nSeen = 0;
+                size_t i = 0;
+                for (; i < TIMING_BUCKETS - 1; ++i) {
+                    nSeen += counts[i];
+                    if (nSeen >= nRank) break;
+                }
+                append(strprintf("%s:%d|g", wireKey(metric->key + strSuffix), TimingBucketValue(i)));
+            }
+            break;
+        }
+        }
+    }
+    if (!strDatagram.empty()) {
+        vDatagrams.emplace_back(std::move(strDatagram));
+    }
+    return vDatagrams;
+}
+
+int StatsdClient::flush()
+{
+    int ret = init();
+    if ( ret )
+    {
+        return ret;
+    }
+    for (const auto& datagram : collect()) {
+        ret = send(datagram);
+        if ( ret ) return ret;
+    }
+    return 0;
 }
 
 int StatsdClient::send(std::string key, size_t value, const std::string& type, float sample_rate)
@@ -245,4 +495,22 @@ const char* StatsdClient::errmsg()
     return d->errmsg;
 }
 
+MetricFamily::MetricFamily(StatsdClient& client, const std::string& prefix, const std::vector<std::string>& names,
+        const std::string& suffix, MetricType type, const std::string& fallback)
+{
+    for (const auto& name : names) {
+        mapHandles.emplace(name, client.intern(prefix + name + suffix, type));
+    }
+    fallbackHandle = client.intern(prefix + fallback + suffix, type);
+}
+
+MetricHandle MetricFamily::get(const std::string& name) const
+{
+    auto it = mapHandles.find(name);
+    if (it == mapHandles.end()) {
+        return fallbackHandle;
+    }
+    return it->second;
+}
+
 } // namespace statsd
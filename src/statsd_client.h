@@ -1,8 +1,15 @@
 #ifndef BITCOIN_STATSD_CLIENT_H
 #define BITCOIN_STATSD_CLIENT_H
 
-#include <string>
+#include <sync.h>
+
+#include <array>
+#include <atomic>
+#include <map>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 static const bool DEFAULT_STATSD_ENABLE = false;
 static const int DEFAULT_STATSD_PORT = 8125;
@@ -17,7 +24,48 @@ static const int MAX_STATSD_PERIOD = 60 * 60;
 
 namespace statsd {
 
+/** Number of shards every aggregated metric is split into, threads are spread over them */
+static constexpr size_t METRIC_SHARDS = 8;
+/** Upper bound on interned metrics, keys derived from network data must not grow the registry forever */
+static constexpr size_t MAX_METRICS = 4096;
+/** Log-linear histogram layout used for timings: 4 sub-buckets per power of two */
+static constexpr int TIMING_SUB_BUCKET_BITS = 2;
+static constexpr int MAX_TIMING_EXP = 40;
+static constexpr size_t TIMING_BUCKETS = (MAX_TIMING_EXP - TIMING_SUB_BUCKET_BITS + 2) << TIMING_SUB_BUCKET_BITS;
+/** Keep batched datagrams below a typical path MTU so they are never fragmented */
+static constexpr size_t MAX_DATAGRAM_SIZE = 1432;
+
+enum class MetricType : uint8_t {
+    COUNTER,
+    GAUGE,
+    GAUGE_DOUBLE,
+    TIMING,
+};
+
 struct _StatsdClientData;
+struct Metric;
+
+/**
+ * Interned metric. Obtained once from StatsdClient::intern() and then updated
+ * without any string handling, locking or syscalls; values are aggregated
+ * until the next StatsdClient::flush().
+ */
+class MetricHandle {
+    friend class StatsdClient;
+
+    public:
+        MetricHandle() = default;
+        bool IsValid() const { return m != nullptr; }
+
+    private:
+        explicit MetricHandle(Metric* metric) : m(metric) {}
+        Metric* m{nullptr};
+};
+
+/** Maps bucket index to the representative value reported for it */
+int64_t TimingBucketValue(size_t bucket);
+/** Maps a timing value to its histogram bucket */
+size_t TimingBucket(int64_t value);
 
 class StatsdClient {
     public:
@@ -37,6 +85,27 @@ class StatsdClient {
         int gaugeDouble(const std::string& key, double value, float sample_rate = 1.0);
         int timing(const std::string& key, size_t ms, float sample_rate = 1.0);
 
+    public:
+        /**
+         * Registry API. Metrics are interned once and aggregated in memory
+         * over the -statsperiod window, flush() then emits all of them in as
+         * few datagrams as possible. Aggregation is exact, so there is no
+         * sample rate. Returns an invalid handle once MAX_METRICS is reached.
+         */
+        MetricHandle intern(const std::string& key, MetricType type);
+        void count(const MetricHandle& handle, int64_t value);
+        void inc(const MetricHandle& handle) { count(handle, 1); }
+        void gauge(const MetricHandle& handle, int64_t value);
+        void gaugeDouble(const MetricHandle& handle, double value);
+        void timing(const MetricHandle& handle, int64_t value);
+
+        /** Collect and reset everything aggregated so far, packed into datagrams */
+        std::vector<std::string> collect();
+        /** Send everything aggregated so far */
+        int flush();
+
+        static bool enabled();
+
     public:
         /**
          * (Low Level Api) manually send a message
@@ -55,9 +124,31 @@ class StatsdClient {
     protected:
         int init();
         static void cleanup(std::string& key);
+        std::string wireKey(const std::string& key) const;
 
     protected:
         std::unique_ptr<struct _StatsdClientData> d;
+
+        Mutex cs_registry;
+        std::array<std::unordered_map<std::string, Metric*>, 4> mapMetrics GUARDED_BY(cs_registry);
+        std::vector<std::unique_ptr<Metric>> vMetrics GUARDED_BY(cs_registry);
+};
+
+/**
+ * A fixed family of metrics sharing a prefix and suffix, e.g. one counter per
+ * P2P message type. Built once, lookups afterwards are lock-free. Names outside
+ * the family are accounted under `fallback`.
+ */
+class MetricFamily {
+    public:
+        MetricFamily(StatsdClient& client, const std::string& prefix, const std::vector<std::string>& names,
+                const std::string& suffix, MetricType type, const std::string& fallback);
+
+        MetricHandle get(const std::string& name) const;
+
+    private:
+        std::map<std::string, MetricHandle> mapHandles;
+        MetricHandle fallbackHandle;
 };
 
 } // namespace statsd
@@ -15,6 +15,7 @@
 #include <tinyformat.h>
 #include <util/strencodings.h>
 #include <util/system.h>
+#include <util/trace.h>
 #include <validation.h>
 
 CNodeBehavior scoreManager;
@@ -114,6 +115,7 @@ void CNodeBehavior::AddProof(const CNetworkProof& netproof)
     if (HaveSeen(height)) {
         return;
     }
+    TRACE2(storage, proof_add_start, netproof.hash.data(), height);
 
     proof = netproof.proof;
     for (struct StorageNode& in : proof.nodes)
@@ -164,6 +166,13 @@ void CNodeBehavior::AddProof(const CNetworkProof& netproof)
              LogPrint(BCLog::STORAGE, "%s: height %d, ip %s, score %d (unknown)\n", __func__, height, ipaddress, l.health);
          }
     }
+
+    TRACE5(storage, proof_added,
+        netproof.hash.data(),
+        height,
+        (uint64_t)proof.nodes.size(),
+        (uint64_t)seen_nodes.size(),
+        (uint64_t)nodes.size());
 }
 
 void CNodeBehavior::GetNodeScore(CService& mnAddress, int& score, int& space)
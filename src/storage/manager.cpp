@@ -14,6 +14,7 @@
 #include <tinyformat.h>
 #include <util/strencodings.h>
 #include <util/system.h>
+#include <util/trace.h>
 #include <validation.h>
 
 CProofManager proofManager;
@@ -149,30 +150,36 @@ bool CProofManager::Validate(CNetworkProof& netproof) const
 {
     int height = netproof.height;
     const Consensus::Params& params = Params().GetConsensus();
+    TRACE2(storage, proof_validate_start, netproof.hash.data(), height);
 
     if (height == 0 || netproof.hash == uint256()) {
         LogPrint(BCLog::STORAGE, "%s: incomplete proof\n", __func__);
+        TRACE4(storage, proof_validated, netproof.hash.data(), height, false, "incomplete");
         return false;
     }
 
     if (!IsProofRequired(height, params)) {
         LogPrint(BCLog::STORAGE, "%s: proof not required for height %d\n", __func__, height);
+        TRACE4(storage, proof_validated, netproof.hash.data(), height, true, "not-required");
         return true;
     }
 
     if (AlreadyHave(netproof.hash)) {
         LogPrint(BCLog::STORAGE, "%s: already have proof hash %s\n", __func__, netproof.hash.ToString());
+        TRACE4(storage, proof_validated, netproof.hash.data(), height, true, "already-have");
         return true;
     }
 
     std::string strError;
     if (!CheckSig(netproof.hash, netproof.vchProofSig, strError)) {
         LogPrint(BCLog::STORAGE, "%s: invalid netproof (error: %s)\n", __func__, strError);
+        TRACE4(storage, proof_validated, netproof.hash.data(), height, false, strError.c_str());
         return false;
     }
 
     proofs.push_back(netproof);
     LogPrint(BCLog::STORAGE, "%s: proof accepted for height %d\n", __func__, height);
+    TRACE4(storage, proof_validated, netproof.hash.data(), height, true, "accepted");
 
     return true;
 }
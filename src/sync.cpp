@@ -14,6 +14,8 @@
 #include <util/threadnames.h>
 
 
+#include <algorithm>
+#include <array>
 #include <map>
 #include <set>
 #include <system_error>
@@ -32,6 +34,176 @@ void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 }
 #endif /* DEBUG_LOCKCONTENTION */
 
+static thread_local int64_t g_thread_lock_wait_micros = 0;
+
+std::atomic<bool> g_lock_profiling{DEFAULT_LOCK_PROFILING};
+
+namespace {
+using SiteKey = std::pair<const char*, int>;
+
+struct SiteKeyHasher {
+    size_t operator()(const SiteKey& key) const { return std::hash<const char*>()(key.first) ^ ((size_t)key.second << 1); }
+};
+
+struct LockSiteRecord {
+    const char* pszName;
+    uint64_t nContentions{0};
+    int64_t nTotalWaitMicros{0};
+    int64_t nMaxWaitMicros{0};
+    std::array<uint64_t, LOCK_WAIT_BUCKETS> waitHistogram{};
+    std::map<SiteKey, uint64_t> holders;
+};
+
+/**
+ * Contention records, split into shards by acquisition site so that threads
+ * waiting at different sites do not serialize on one mutex. Plain std::mutex:
+ * recording must not recurse into the annotated locks being profiled.
+ */
+static constexpr size_t LOCK_STATS_SHARDS = 16;
+
+struct LockStatsShard {
+    std::mutex mutex;
+    std::unordered_map<SiteKey, LockSiteRecord, SiteKeyHasher> sites;
+};
+
+LockStatsShard* GetLockStatsShards()
+{
+    // Leaked like the logger: locks may be taken during static destruction
+    static LockStatsShard* shards = new LockStatsShard[LOCK_STATS_SHARDS];
+    return shards;
+}
+
+size_t LockWaitBucket(int64_t nWaitMicros)
+{
+    size_t bucket = 0;
+    while (nWaitMicros > 0 && bucket + 1 < LOCK_WAIT_BUCKETS) {
+        nWaitMicros >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+/** A contended acquisition, buffered until the thread released the lock */
+struct LockWait {
+    const char* pszName;
+    const char* pszFile;
+    int nLine;
+    int64_t nWaitMicros;
+    LockSite holder;
+};
+
+struct LockWaitBuffer {
+    std::array<LockWait, 32> waits;
+    size_t nWaits{0};
+    //! Locks the thread had to wait for and still holds, the waits are merged once none is left
+    int nHeld{0};
+};
+
+thread_local LockWaitBuffer g_thread_lock_waits;
+
+void MergeLockWaits(LockWaitBuffer& buffer)
+{
+    for (size_t i = 0; i < buffer.nWaits; ++i) {
+        const LockWait& wait = buffer.waits[i];
+        const SiteKey key{wait.pszFile, wait.nLine};
+        LockStatsShard& shard = GetLockStatsShards()[SiteKeyHasher()(key) % LOCK_STATS_SHARDS];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        LockSiteRecord& record = shard.sites.emplace(key, LockSiteRecord{wait.pszName}).first->second;
+        record.nContentions++;
+        record.nTotalWaitMicros += wait.nWaitMicros;
+        record.nMaxWaitMicros = std::max(record.nMaxWaitMicros, wait.nWaitMicros);
+        record.waitHistogram[LockWaitBucket(wait.nWaitMicros)]++;
+        record.holders[{wait.holder.file, wait.holder.line}]++;
+    }
+    buffer.nWaits = 0;
+}
+
+std::string FormatLockSite(const SiteKey& key)
+{
+    if (key.first == nullptr) return "unknown";
+    return strprintf("%s:%d", key.first, key.second);
+}
+} // namespace
+
+void RecordLockWait(const char* pszName, const char* pszFile, int nLine, int64_t nWaitMicros, const LockSite& holder)
+{
+    g_thread_lock_wait_micros += nWaitMicros;
+
+    // counted even while profiling is off, it may be turned on before the lock is released
+    LockWaitBuffer& buffer = g_thread_lock_waits;
+    ++buffer.nHeld;
+
+    if (!g_lock_profiling.load(std::memory_order_relaxed)) return;
+
+    if (buffer.nWaits == buffer.waits.size()) {
+        // nested too deep to buffer, merge the oldest waits now
+        MergeLockWaits(buffer);
+    }
+    buffer.waits[buffer.nWaits++] = {pszName, pszFile, nLine, nWaitMicros, holder};
+}
+
+void FlushLockWaits()
+{
+    LockWaitBuffer& buffer = g_thread_lock_waits;
+    // an outer lock the thread waited for is still held
+    if (buffer.nHeld > 0 && --buffer.nHeld > 0) return;
+    MergeLockWaits(buffer);
+}
+
+std::vector<LockContentionStats> GetLockContentionStats()
+{
+    // Header-defined locks can report the same site through different __FILE__ pointers
+    std::map<std::string, LockContentionStats> merged;
+    for (size_t i = 0; i < LOCK_STATS_SHARDS; ++i) {
+        LockStatsShard& shard = GetLockStatsShards()[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto& entry : shard.sites) {
+            const LockSiteRecord& record = entry.second;
+            LockContentionStats& stats = merged[FormatLockSite(entry.first)];
+            stats.name = record.pszName;
+            stats.site = FormatLockSite(entry.first);
+            stats.nContentions += record.nContentions;
+            stats.nTotalWaitMicros += record.nTotalWaitMicros;
+            stats.nMaxWaitMicros = std::max(stats.nMaxWaitMicros, record.nMaxWaitMicros);
+            stats.vWaitHistogram.resize(LOCK_WAIT_BUCKETS);
+            for (size_t b = 0; b < LOCK_WAIT_BUCKETS; ++b) {
+                stats.vWaitHistogram[b] += record.waitHistogram[b];
+            }
+            for (const auto& holder : record.holders) {
+                stats.vHolders.emplace_back(FormatLockSite(holder.first), holder.second);
+            }
+        }
+    }
+
+    std::vector<LockContentionStats> result;
+    result.reserve(merged.size());
+    for (auto& entry : merged) {
+        std::map<std::string, uint64_t> holders;
+        for (const auto& holder : entry.second.vHolders) {
+            holders[holder.first] += holder.second;
+        }
+        entry.second.vHolders.assign(holders.begin(), holders.end());
+        std::sort(entry.second.vHolders.begin(), entry.second.vHolders.end(), [](const std::pair<std::string, uint64_t>& a, const std::pair<std::string, uint64_t>& b) { return a.second > b.second; });
+        result.push_back(std::move(entry.second));
+    }
+    std::sort(result.begin(), result.end(), [](const LockContentionStats& a, const LockContentionStats& b) { return a.nTotalWaitMicros > b.nTotalWaitMicros; });
+    return result;
+}
+
+void ResetLockContentionStats()
+{
+    for (size_t i = 0; i < LOCK_STATS_SHARDS; ++i) {
+        LockStatsShard& shard = GetLockStatsShards()[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.sites.clear();
+    }
+}
+
+int64_t GetThreadLockWaitMicros()
+{
+    return g_thread_lock_wait_micros;
+}
+
 #ifdef DEBUG_LOCKORDER
 //
 // Early deadlock detection.
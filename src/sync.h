@@ -9,10 +9,15 @@
 #include <threadsafety.h>
 #include <util/macros.h>
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 
 /////////////////////////////////////////////////
 //                                             //
@@ -77,6 +82,17 @@ inline bool LockStackEmpty() { return true; }
 #define AssertLockHeld(cs) AssertLockHeldInternal(#cs, __FILE__, __LINE__, &cs)
 #define AssertLockNotHeld(cs) AssertLockNotHeldInternal(#cs, __FILE__, __LINE__, &cs)
 
+static const bool DEFAULT_LOCK_PROFILING = false;
+
+/** Whether contended acquisitions are recorded per lock site, see -lockprofile */
+extern std::atomic<bool> g_lock_profiling;
+
+/** Source location that acquired a lock */
+struct LockSite {
+    const char* file{nullptr};
+    int line{0};
+};
+
 /**
  * Template mixin that adds -Wthread-safety locking annotations and lock order
  * checking to a subset of the mutex API.
@@ -84,7 +100,24 @@ inline bool LockStackEmpty() { return true; }
 template <typename PARENT>
 class LOCKABLE AnnotatedMixin : public PARENT
 {
+private:
+    //! Last site that acquired the lock through LOCK(), reported when another thread
+    //! has to wait for it. Best effort: the two fields are not updated atomically together.
+    std::atomic<const char*> m_holder_file{nullptr};
+    std::atomic<int> m_holder_line{0};
+
 public:
+    void SetHolderSite(const char* pszFile, int nLine)
+    {
+        m_holder_file.store(pszFile, std::memory_order_relaxed);
+        m_holder_line.store(nLine, std::memory_order_relaxed);
+    }
+
+    LockSite GetHolderSite() const
+    {
+        return {m_holder_file.load(std::memory_order_relaxed), m_holder_line.load(std::memory_order_relaxed)};
+    }
+
     ~AnnotatedMixin() {
         DeleteLock((void*)this);
     }
@@ -127,22 +160,63 @@ typedef AnnotatedMixin<std::mutex> Mutex;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/**
+ * Account time the calling thread spent blocked on a contended lock held by holder. The
+ * per-site record is only buffered for the calling thread, the caller still holds the lock.
+ */
+void RecordLockWait(const char* pszName, const char* pszFile, int nLine, int64_t nWaitMicros, const LockSite& holder);
+/**
+ * Called when a lock acquired after RecordLockWait was released. The waits buffered on the
+ * calling thread are merged once it holds no lock it had to wait for anymore.
+ */
+void FlushLockWaits();
+/** Total time in microseconds the calling thread has spent blocked on contended locks */
+int64_t GetThreadLockWaitMicros();
+
+/** Number of power-of-two wait time buckets, the last one collects everything above 2^(n-2)us */
+static constexpr size_t LOCK_WAIT_BUCKETS = 26;
+
+/** Contention recorded for one lock acquisition site */
+struct LockContentionStats {
+    std::string name;
+    std::string site;
+    uint64_t nContentions{0};
+    int64_t nTotalWaitMicros{0};
+    int64_t nMaxWaitMicros{0};
+    //! Bucket 0 counts waits below 1us, bucket i waits in [2^(i-1), 2^i) us
+    std::vector<uint64_t> vWaitHistogram;
+    //! Sites that held the lock while this one waited, with counts
+    std::vector<std::pair<std::string, uint64_t>> vHolders;
+};
+
+/** Snapshot of all recorded contention, sorted by total wait time */
+std::vector<LockContentionStats> GetLockContentionStats();
+void ResetLockContentionStats();
+
 /** Wrapper around std::unique_lock style lock for Mutex. */
 template <typename Mutex, typename Base = typename Mutex::UniqueLock>
 class SCOPED_LOCKABLE UniqueLock : public Base
 {
 private:
+    //! This acquisition had to wait, its record is merged once the lock is released
+    bool m_waited{false};
+
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(Base::mutex()));
-#ifdef DEBUG_LOCKCONTENTION
         if (!Base::try_lock()) {
+#ifdef DEBUG_LOCKCONTENTION
             PrintLockContention(pszName, pszFile, nLine);
 #endif
+            const LockSite holder = g_lock_profiling.load(std::memory_order_relaxed) ? static_cast<Mutex*>(Base::mutex())->GetHolderSite() : LockSite{};
+            const auto nStart = std::chrono::steady_clock::now();
             Base::lock();
-#ifdef DEBUG_LOCKCONTENTION
+            RecordLockWait(pszName, pszFile, nLine, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - nStart).count(), holder);
+            m_waited = true;
+        }
+        if (g_lock_profiling.load(std::memory_order_relaxed)) {
+            static_cast<Mutex*>(Base::mutex())->SetHolderSite(pszFile, nLine);
         }
-#endif
     }
 
     bool TryEnter(const char* pszName, const char* pszFile, int nLine)
@@ -151,6 +225,8 @@ private:
         Base::try_lock();
         if (!Base::owns_lock())
             LeaveCritical();
+        else if (g_lock_profiling.load(std::memory_order_relaxed))
+            static_cast<Mutex*>(Base::mutex())->SetHolderSite(pszFile, nLine);
         return Base::owns_lock();
     }
 
@@ -176,8 +252,11 @@ public:
 
     ~UniqueLock() UNLOCK_FUNCTION()
     {
-        if (Base::owns_lock())
+        if (Base::owns_lock()) {
             LeaveCritical();
+            if (m_waited) Base::unlock();
+        }
+        if (m_waited) FlushLockWaits();
     }
 
     operator bool()
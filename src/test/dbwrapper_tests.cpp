@@ -7,6 +7,7 @@
 #include <test/util/setup_common.h>
 #include <util/memory.h>
 
+#include <algorithm>
 #include <memory>
 
 #include <boost/test/unit_test.hpp>
@@ -42,6 +43,46 @@ BOOST_AUTO_TEST_CASE(dbwrapper)
     }
 }
 
+//! Restore the default database settings when the test ends, even on failure
+struct DBTuningReset {
+    ~DBTuningReset()
+    {
+        UnsetDBCacheSize("tuned");
+        std::string error;
+        ParseDBTuning({}, error);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(dbwrapper_tuning_and_stats)
+{
+    DBTuningReset reset;
+    std::string error;
+    BOOST_CHECK(!ParseDBTuning({"nocolon"}, error));
+    BOOST_CHECK(!ParseDBTuning({"tuned:cache"}, error));
+    BOOST_CHECK(!ParseDBTuning({"tuned:cache=-1"}, error));
+    BOOST_CHECK(!ParseDBTuning({"tuned:compression=1"}, error));
+    BOOST_CHECK(ParseDBTuning({"tuned:cache=2,bloom=0"}, error));
+
+    fs::path ph = GetDataDir() / "tuned";
+    {
+        SetDBCacheSize("tuned", 1 << 20);
+        CDBWrapper dbw(ph, 8 << 20, false, true);
+        BOOST_CHECK(dbw.Write('k', InsecureRand256()));
+        BOOST_CHECK(dbw.Write('l', InsecureRand256(), true));
+
+        const std::vector<DBStats> all_stats = GetDBStats();
+        auto it = std::find_if(all_stats.begin(), all_stats.end(), [](const DBStats& stats) { return stats.name == "tuned"; });
+        BOOST_REQUIRE(it != all_stats.end());
+        // -dboptions wins over both the assigned and the requested cache size
+        BOOST_CHECK_EQUAL(it->nCacheSize, 2U << 20);
+        BOOST_CHECK_EQUAL(it->nBloomBits, 0);
+        BOOST_CHECK_EQUAL(it->nWrites, 2U);
+    }
+    // Closed databases are no longer reported
+    const std::vector<DBStats> all_stats = GetDBStats();
+    BOOST_CHECK(std::none_of(all_stats.begin(), all_stats.end(), [](const DBStats& stats) { return stats.name == "tuned"; }));
+}
+
 BOOST_AUTO_TEST_CASE(dbwrapper_basic_data)
 {
     // Perform tests both obfuscated and non-obfuscated.
@@ -36,6 +36,20 @@ struct CConnmanTest : public CConnman {
         }
         vNodes.clear();
     }
+    void AddMessageWorker()
+    {
+        vMessageWorkers.emplace_back(MakeUnique<CMessageWorker>());
+    }
+    void DrainMessageWorkers()
+    {
+        for (auto& worker : vMessageWorkers) {
+            std::list<std::pair<CNode*, CNetMessage>> items;
+            WITH_LOCK(worker->cs, items.swap(worker->queue));
+            for (auto& item : items) {
+                ProcessWorkerItem(item.first, item.second);
+            }
+        }
+    }
 };
 
 // Tests these internal-to-net_processing.cpp methods:
@@ -217,6 +231,58 @@ BOOST_AUTO_TEST_CASE(stale_tip_peer_management)
     connman->ClearNodes();
 }
 
+BOOST_AUTO_TEST_CASE(worker_messages_count_against_receive_buffer)
+{
+    auto connman = MakeUnique<CConnmanTest>(0x1337, 0x1337);
+    auto peerLogic = MakeUnique<PeerLogicValidation>(connman.get(), nullptr, scheduler, false);
+
+    CConnman::Options options;
+    options.m_msgproc = peerLogic.get();
+    options.nReceiveFloodSize = 1000;
+    connman->Init(options);
+    connman->AddMessageWorker();
+
+    CAddress addr(ip(0xa0b0c001), NODE_NONE);
+    CNode dummyNode(id++, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", true);
+    dummyNode.SetSendVersion(PROTOCOL_VERSION);
+    peerLogic->InitializeNode(&dummyNode);
+    dummyNode.nVersion = 1;
+    dummyNode.fSuccessfullyConnected = true;
+
+    // Queue more signature shares than the receive buffer allows
+    {
+        LOCK(dummyNode.cs_vProcessMsg);
+        for (int i = 0; i < 3; i++) {
+            CNetMessage msg(CDataStream(SER_NETWORK, PROTOCOL_VERSION));
+            msg.m_command = NetMsgType::QSIGSHARE;
+            msg.m_valid_netmagic = msg.m_valid_header = msg.m_valid_checksum = true;
+            msg.m_raw_message_size = 500;
+            dummyNode.vProcessMsg.push_back(std::move(msg));
+            dummyNode.nProcessQueueSize += 500;
+        }
+        dummyNode.fPauseRecv = dummyNode.nProcessQueueSize > connman->GetReceiveFloodSize();
+    }
+    BOOST_CHECK(dummyNode.fPauseRecv);
+
+    // Handing them off to the worker doesn't free up the receive buffer...
+    std::atomic<bool> interruptDummy(false);
+    while (peerLogic->ProcessMessages(&dummyNode, interruptDummy)) {}
+    BOOST_CHECK(WITH_LOCK(dummyNode.cs_vProcessMsg, return dummyNode.vProcessMsg.empty()));
+    BOOST_CHECK_EQUAL(dummyNode.nPendingWorkerMessages.load(), 3);
+    BOOST_CHECK_EQUAL(dummyNode.nProcessQueueSize, 1500U);
+    BOOST_CHECK(dummyNode.fPauseRecv);
+
+    // ...only the worker finishing them does. Disconnecting skips the LLMQ handlers.
+    dummyNode.fDisconnect = true;
+    connman->DrainMessageWorkers();
+    BOOST_CHECK_EQUAL(dummyNode.nPendingWorkerMessages.load(), 0);
+    BOOST_CHECK_EQUAL(dummyNode.nProcessQueueSize, 0U);
+    BOOST_CHECK(!dummyNode.fPauseRecv);
+
+    bool dummy;
+    peerLogic->FinalizeNode(dummyNode.GetId(), dummy);
+}
+
 BOOST_AUTO_TEST_CASE(DoS_banning)
 {
     auto banman = MakeUnique<BanMan>(GetDataDir() / "banlist.dat", nullptr, DEFAULT_MISBEHAVING_BANTIME);
@@ -0,0 +1,73 @@
+// Copyright (c) 2023 datos
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/jsonstream.h>
+#include <test/util/setup_common.h>
+
+#include <univalue.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(jsonstream_tests, BasicTestingSetup)
+
+// Write val into the stream the way a streaming RPC would, container by container
+static void WriteStreamed(JSONStreamWriter& writer, const UniValue& val)
+{
+    if (val.isObject()) {
+        writer.BeginObject();
+        for (size_t i = 0; i < val.size(); i++) {
+            writer.Key(val.getKeys()[i]);
+            WriteStreamed(writer, val.getValues()[i]);
+        }
+        writer.EndObject();
+    } else if (val.isArray()) {
+        writer.BeginArray();
+        for (size_t i = 0; i < val.size(); i++) {
+            WriteStreamed(writer, val[i]);
+        }
+        writer.EndArray();
+    } else {
+        writer.Value(val);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_matches_univalue)
+{
+    UniValue val;
+    BOOST_REQUIRE(val.read("{\"a\":[],\"b\":{},\"c\":[1,\"two\",{\"x\":null,\"y\":true}],"
+                           "\"esc\\\"aped\":\"line\\nbreak\",\"d\":[[[]],[{}]],\"e\":-1.5}"));
+
+    for (size_t nChunkSize : {size_t{1}, size_t{7}, JSON_STREAM_CHUNK_SIZE}) {
+        std::string strOut;
+        size_t nChunks = 0;
+        JSONStreamWriter writer([&](const std::string& chunk) {
+            BOOST_CHECK(!chunk.empty());
+            strOut += chunk;
+            ++nChunks;
+        }, nChunkSize);
+        BOOST_CHECK(writer.IsEmpty());
+        WriteStreamed(writer, val);
+        BOOST_CHECK(!writer.IsEmpty());
+        writer.Flush();
+        BOOST_CHECK_EQUAL(strOut, val.write());
+        // chunks are handed out as soon as they are large enough
+        BOOST_CHECK(nChunkSize == JSON_STREAM_CHUNK_SIZE ? nChunks == 1 : nChunks > 1);
+    }
+
+    // a whole subtree can be written as a single value
+    std::string strOut;
+    JSONStreamWriter writer([&](const std::string& chunk) { strOut += chunk; });
+    writer.Raw("{\"result\":");
+    writer.BeginArray();
+    writer.Value(val);
+    writer.Value("x");
+    writer.EndArray();
+    writer.Raw("}");
+    BOOST_CHECK(!writer.HasFlushed());
+    writer.Flush();
+    BOOST_CHECK(writer.HasFlushed());
+    BOOST_CHECK_EQUAL(strOut, "{\"result\":[" + val.write() + ",\"x\"]}");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
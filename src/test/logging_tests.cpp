@@ -7,6 +7,9 @@
 #include <test/util/setup_common.h>
 
 #include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <boost/test/unit_test.hpp>
 
@@ -33,4 +36,63 @@ BOOST_AUTO_TEST_CASE(logging_timer)
     SetMockTime(0);
 }
 
+BOOST_AUTO_TEST_CASE(logging_async)
+{
+    BCLog::Logger logger;
+    logger.m_log_timestamps = false;
+    logger.m_log_async = true;
+    std::vector<std::string> lines;
+    logger.PushBackCallback([&lines](const std::string& s) { lines.push_back(s); });
+    BOOST_CHECK(logger.StartLogging());
+
+    const int threads = 4;
+    const int per_thread = 1000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&logger, t] {
+            for (int i = 0; i < per_thread; ++i) {
+                logger.LogPrintStr(strprintf("%d %d\n", t, i));
+            }
+        });
+    }
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    logger.StopAsyncLogging();
+
+    // Nothing is dropped below the ring size, and each thread's messages keep their order
+    BOOST_CHECK_EQUAL(lines.size(), (size_t)threads * per_thread);
+    std::vector<int> next(threads, 0);
+    for (const std::string& line : lines) {
+        int t, i;
+        BOOST_REQUIRE(sscanf(line.c_str(), "%d %d", &t, &i) == 2);
+        BOOST_CHECK_EQUAL(i, next[t]++);
+    }
+
+    // Back in synchronous mode
+    logger.LogPrintStr("sync\n");
+    BOOST_CHECK_EQUAL(lines.back(), "sync\n");
+}
+
+BOOST_AUTO_TEST_CASE(logging_async_partial_lines)
+{
+    BCLog::Logger logger;
+    logger.m_log_timestamps = true;
+    logger.m_log_async = true;
+    std::vector<std::string> lines;
+    logger.PushBackCallback([&lines](const std::string& s) { lines.push_back(s); });
+    BOOST_CHECK(logger.StartLogging());
+
+    logger.LogPrintStr("first ");
+    logger.LogPrintStr("part\n");
+    logger.LogPrintStr("second\n");
+    logger.StopAsyncLogging();
+
+    // Only messages starting a line are timestamped
+    BOOST_REQUIRE_EQUAL(lines.size(), 3U);
+    BOOST_CHECK(lines[0] != "first " && lines[0].size() > 6 && lines[0].compare(lines[0].size() - 6, 6, "first ") == 0);
+    BOOST_CHECK_EQUAL(lines[1], "part\n");
+    BOOST_CHECK(lines[2] != "second\n" && lines[2].size() > 7 && lines[2].compare(lines[2].size() - 7, 7, "second\n") == 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
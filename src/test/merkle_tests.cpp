@@ -3,7 +3,9 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <consensus/merkle.h>
+#include <streams.h>
 #include <test/util/setup_common.h>
+#include <version.h>
 
 #include <boost/test/unit_test.hpp>
 
@@ -327,4 +329,44 @@ BOOST_AUTO_TEST_CASE(merkle_test_LeftSubtreeRightSubtree)
     BOOST_CHECK_EQUAL(root, rootOfLR);
 }
 
+BOOST_AUTO_TEST_CASE(merkle_test_BlockMemoize)
+{
+    CBlock block;
+    block.nBits = 0x207fffff;
+    block.vtx.resize(3);
+    for (std::size_t pos = 0; pos < block.vtx.size(); pos++) {
+        CMutableTransaction mtx;
+        mtx.nLockTime = pos;
+        block.vtx[pos] = MakeTransactionRef(std::move(mtx));
+    }
+    const uint256 hash = block.GetHash();
+    const uint256 root = BlockMerkleRoot(block);
+
+    block.Memoize();
+    bool mutated = true;
+    BOOST_CHECK_EQUAL(block.GetHash(), hash);
+    BOOST_CHECK_EQUAL(BlockMerkleRoot(block, &mutated), root);
+    BOOST_CHECK(!mutated);
+    BOOST_CHECK_EQUAL(block.GetBlockHeader().GetHash(), hash);
+
+    // Copies do not inherit the memo, so modifying them is safe
+    CBlock copy = block;
+    copy.nTime++;
+    copy.vtx.pop_back();
+    BOOST_CHECK(copy.GetHash() != hash);
+    BOOST_CHECK(BlockMerkleRoot(copy) != root);
+
+    // Deserializing over a memoized block drops the memo too
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << copy;
+    CBlock read = block;
+    read.Memoize();
+    ss >> read;
+    BOOST_CHECK_EQUAL(read.GetHash(), copy.GetHash());
+    BOOST_CHECK_EQUAL(BlockMerkleRoot(read), BlockMerkleRoot(copy));
+
+    block.SetNull();
+    BOOST_CHECK(block.GetHash() != hash);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
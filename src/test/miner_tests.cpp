@@ -20,6 +20,7 @@
 #include <test/util/setup_common.h>
 
 #include <memory>
+#include <set>
 
 #include <boost/test/unit_test.hpp>
 
@@ -194,6 +195,86 @@ static void TestPackageSelection(const CChainParams& chainparams, const CScript&
     BOOST_CHECK(pblocktemplate->block.vtx[8]->GetHash() == hashLowFeeTx2);
 }
 
+static std::vector<uint256> TemplateTxs(const CBlockTemplate& blocktemplate)
+{
+    std::vector<uint256> txs;
+    for (size_t i = 1; i < blocktemplate.block.vtx.size(); i++) {
+        txs.emplace_back(blocktemplate.block.vtx[i]->GetHash());
+    }
+    return txs;
+}
+
+// Check that a template built on the previous one, updated for the mempool
+// changes in between, selects the same transactions in the same order as a
+// full selection.
+static void TestIncrementalTemplate(const CChainParams& chainparams, const CScript& scriptPubKey, const std::vector<CTransactionRef>& txFirst) EXCLUSIVE_LOCKS_REQUIRED(cs_main, ::mempool.cs)
+{
+    BlockAssembler::Options options;
+    options.nBlockMaxSize = DEFAULT_BLOCK_MAX_SIZE;
+    options.blockMinFeeRate = blockMinFeeRate;
+    options.fIncrementalTemplate = true;
+    auto checkTemplate = [&]() {
+        std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(chainparams, options).CreateNewBlock(scriptPubKey);
+        std::unique_ptr<CBlockTemplate> pfulltemplate = AssemblerForTest(chainparams).CreateNewBlock(scriptPubKey);
+        BOOST_CHECK(TemplateTxs(*pblocktemplate) == TemplateTxs(*pfulltemplate));
+        return pblocktemplate;
+    };
+
+    TestMemPoolEntryHelper entry;
+    checkTemplate();
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vin[0].prevout.hash = txFirst[0]->GetHash();
+    tx.vin[0].prevout.n = 0;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 5000000000LL - 10000;
+    CTransactionRef txMediumFee = MakeTransactionRef(tx);
+    mempool.addUnchecked(entry.Fee(10000).Time(GetTime()).SpendsCoinbase(true).FromTx(txMediumFee));
+
+    // Below the minimum fee rate on its own
+    tx.vin[0].prevout.hash = txFirst[1]->GetHash();
+    tx.vout[0].nValue = 5000000000LL;
+    CTransactionRef txNoFee = MakeTransactionRef(tx);
+    mempool.addUnchecked(entry.Fee(0).Time(GetTime()).SpendsCoinbase(true).FromTx(txNoFee));
+
+    std::unique_ptr<CBlockTemplate> pblocktemplate = checkTemplate();
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 2U);
+
+    // A child paying for its parent takes the parent in
+    tx.vin[0].prevout.hash = txNoFee->GetHash();
+    tx.vout[0].nValue = 5000000000LL - 50000;
+    CTransactionRef txChild = MakeTransactionRef(tx);
+    mempool.addUnchecked(entry.Fee(50000).Time(GetTime()).SpendsCoinbase(false).FromTx(txChild));
+
+    // and goes before the selected transaction with a lower fee rate
+    pblocktemplate = checkTemplate();
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 4U);
+    BOOST_CHECK(pblocktemplate->block.vtx[1]->GetHash() == txNoFee->GetHash());
+    BOOST_CHECK(pblocktemplate->block.vtx[2]->GetHash() == txChild->GetHash());
+    BOOST_CHECK(pblocktemplate->block.vtx[3]->GetHash() == txMediumFee->GetHash());
+
+    // A lower fee rate than everything selected goes last
+    tx.vin[0].prevout.hash = txFirst[2]->GetHash();
+    tx.vout[0].nValue = 5000000000LL - 5000;
+    CTransactionRef txLowFee = MakeTransactionRef(tx);
+    mempool.addUnchecked(entry.Fee(5000).Time(GetTime()).SpendsCoinbase(true).FromTx(txLowFee));
+    pblocktemplate = checkTemplate();
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 5U);
+    BOOST_CHECK(pblocktemplate->block.vtx[4]->GetHash() == txLowFee->GetHash());
+
+    // Removed transactions leave the template
+    mempool.removeRecursive(*txMediumFee, MemPoolRemovalReason::CONFLICT);
+    pblocktemplate = checkTemplate();
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 4U);
+
+    // Fee deltas aren't notified, the selection is started over
+    mempool.PrioritiseTransaction(txChild->GetHash(), -50000);
+    pblocktemplate = checkTemplate();
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 2U);
+}
+
 // NOTE: These tests rely on CreateNewBlock doing its own self-validation!
 BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
 {
@@ -533,6 +614,9 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     LOCK2(cs_main, ::mempool.cs);
     TestPackageSelection(chainparams, scriptPubKey, txFirst);
 
+    mempool.clear();
+    TestIncrementalTemplate(chainparams, scriptPubKey, txFirst);
+
     fCheckpointsEnabled = true;
 }
 
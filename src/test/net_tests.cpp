@@ -13,6 +13,7 @@
 #include <streams.h>
 #include <net.h>
 #include <netbase.h>
+#include <netmessagemaker.h>
 #include <chainparams.h>
 #include <util/memory.h>
 #include <util/system.h>
@@ -192,6 +193,112 @@ BOOST_AUTO_TEST_CASE(cnode_simple_test)
     BOOST_CHECK(pnode2->fFeeler == false);
 }
 
+BOOST_AUTO_TEST_CASE(shared_net_msg)
+{
+    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+    const std::vector<unsigned char> payload(1000, 0x42);
+    V1TransportSerializer serializer;
+
+    CSerializedNetMsg msg = msgMaker.Make(NetMsgType::BLOCK, payload);
+    const std::vector<unsigned char> data = msg.data;
+    std::vector<unsigned char> header;
+    serializer.prepareForTransport(msg, header);
+
+    // a shared message is sent with the same header and payload
+    CSharedNetMsgRef shared = MakeSharedNetMsg(msgMaker.Make(NetMsgType::BLOCK, payload));
+    std::vector<unsigned char> sharedHeader;
+    serializer.prepareForTransport(*shared, sharedHeader);
+    BOOST_CHECK(sharedHeader == header);
+    BOOST_CHECK(shared->data == data);
+    BOOST_CHECK_EQUAL(shared->command, NetMsgType::BLOCK);
+
+    CSendBuffer buffer(shared);
+    BOOST_CHECK_EQUAL(buffer.Size(), data.size());
+    BOOST_CHECK(buffer.Data() == shared->data.data());
+    CSendBuffer owned{std::vector<unsigned char>(data)};
+    BOOST_CHECK_EQUAL(owned.Size(), data.size());
+    BOOST_CHECK(std::equal(data.begin(), data.end(), owned.Data()));
+}
+
+BOOST_AUTO_TEST_CASE(recv_buffer_pool)
+{
+    CRecvBufferPool pool;
+    CSerializeData buf = pool.Acquire(1000);
+    BOOST_CHECK(buf.empty());
+    BOOST_CHECK_EQUAL(buf.capacity(), 1024U);
+    const char* data = buf.data();
+    buf.resize(1000);
+    pool.Release(std::move(buf));
+    BOOST_CHECK_EQUAL(pool.GetPooledBytes(), 1024U);
+
+    // the same size class gets the recycled buffer back
+    CSerializeData buf2 = pool.Acquire(600);
+    BOOST_CHECK(buf2.empty());
+    BOOST_CHECK(buf2.data() == data);
+    BOOST_CHECK_EQUAL(pool.GetPooledBytes(), 0U);
+
+    // buffers not handed out by a pool are not kept
+    CSerializeData other(3000);
+    pool.Release(std::move(other));
+    BOOST_CHECK_EQUAL(pool.GetPooledBytes(), 0U);
+
+    // the pool is bounded
+    for (int i = 0; i < 10; i++) {
+        CSerializeData big;
+        big.reserve(CRecvBufferPool::MAX_BUFFER_SIZE);
+        pool.Release(std::move(big));
+    }
+    BOOST_CHECK_EQUAL(pool.GetPooledBytes(), CRecvBufferPool::MAX_POOLED_BYTES);
+}
+
+BOOST_AUTO_TEST_CASE(net_message_move_assign_releases_buffer)
+{
+    CRecvBufferPool& pool = CRecvBufferPool::Get();
+    CSerializeData buf = pool.Acquire(2000);
+    const char* data = buf.data();
+    CDataStream recv(SER_NETWORK, PROTOCOL_VERSION);
+    recv.swap_buffer(buf);
+    CNetMessage msg(std::move(recv));
+    msg.m_command = "first";
+    const size_t nPooledBefore = pool.GetPooledBytes();
+
+    // the buffer being replaced goes back to the pool instead of being freed
+    msg = CNetMessage(CDataStream(SER_NETWORK, PROTOCOL_VERSION));
+    BOOST_CHECK_EQUAL(pool.GetPooledBytes(), nPooledBefore + 2048);
+    BOOST_CHECK(msg.m_command.empty());
+    CSerializeData reused = pool.Acquire(2000);
+    BOOST_CHECK(reused.data() == data);
+}
+
+BOOST_AUTO_TEST_CASE(v1_deserializer_pooled_buffers)
+{
+    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+    V1TransportSerializer serializer;
+    V1TransportDeserializer deserializer(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+
+    for (size_t nSize : {0, 10, 1000, 300 * 1000}) {
+        CSerializedNetMsg msg = msgMaker.Make(NetMsgType::BLOCK, std::vector<unsigned char>(nSize, 0x42));
+        const std::vector<unsigned char> payload = msg.data;
+        std::vector<unsigned char> wire;
+        serializer.prepareForTransport(msg, wire);
+        wire.insert(wire.end(), payload.begin(), payload.end());
+
+        // feed the message in small pieces, the checksum is computed as they arrive
+        size_t nPos = 0;
+        while (nPos < wire.size()) {
+            const int nRead = deserializer.Read((const char*)wire.data() + nPos, std::min<size_t>(wire.size() - nPos, 777));
+            BOOST_REQUIRE(nRead > 0);
+            nPos += nRead;
+        }
+        BOOST_REQUIRE(deserializer.Complete());
+        CNetMessage received = deserializer.GetMessage(Params().MessageStart(), 0);
+        BOOST_CHECK(received.m_valid_header);
+        BOOST_CHECK(received.m_valid_checksum);
+        BOOST_CHECK_EQUAL(received.m_message_size, payload.size());
+        BOOST_CHECK(std::equal(payload.begin(), payload.end(), (const unsigned char*)received.m_recv.data()));
+    }
+}
+
 BOOST_AUTO_TEST_CASE(PoissonNextSend)
 {
     g_mock_deterministic_tests = true;
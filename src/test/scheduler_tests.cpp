@@ -11,6 +11,8 @@
 #include <boost/thread.hpp>
 #include <boost/test/unit_test.hpp>
 
+#include <atomic>
+#include <future>
 #include <mutex>
 
 BOOST_AUTO_TEST_SUITE(scheduler_tests)
@@ -164,4 +166,43 @@ BOOST_AUTO_TEST_CASE(singlethreadedscheduler_ordered)
     BOOST_CHECK_EQUAL(counter2, 100);
 }
 
+BOOST_AUTO_TEST_CASE(priority_lanes)
+{
+    CScheduler scheduler;
+    boost::thread_group threads;
+    for (int i = 0; i < 2; ++i) {
+        threads.create_thread(std::bind(&CScheduler::serviceQueue, &scheduler));
+    }
+
+    std::promise<void> release_background;
+    std::shared_future<void> released = release_background.get_future().share();
+    std::atomic<int> background_running{0};
+    std::atomic<int> background_max{0};
+    auto background_task = [&] {
+        int running = ++background_running;
+        if (running > background_max) background_max = running;
+        released.wait();
+        --background_running;
+    };
+    const auto now = std::chrono::system_clock::now();
+    scheduler.schedule(background_task, now, CScheduler::Priority::LOW, "low");
+    scheduler.schedule(background_task, now, CScheduler::Priority::LOW, "low");
+    scheduler.schedule(background_task, now, CScheduler::Priority::NORMAL, "normal");
+
+    // Only one of the two workers may be tied up by NORMAL and LOW tasks
+    std::promise<void> high_done;
+    scheduler.schedule([&] { high_done.set_value(); }, now, CScheduler::Priority::HIGH, "high");
+    BOOST_CHECK(high_done.get_future().wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+
+    release_background.set_value();
+    scheduler.stop(true);
+    threads.join_all();
+
+    BOOST_CHECK_EQUAL(background_max, 1);
+    const std::map<std::string, CScheduler::TaskStats> stats = scheduler.getTaskStats();
+    BOOST_CHECK_EQUAL(stats.at("low").nRuns, 2U);
+    BOOST_CHECK_EQUAL(stats.at("normal").nRuns, 1U);
+    BOOST_CHECK_EQUAL(stats.at("high").nRuns, 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,95 @@
+// Copyright (c) 2023 datos
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <statsd_client.h>
+#include <test/util/setup_common.h>
+
+#include <algorithm>
+#include <thread>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(statsd_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(timing_buckets)
+{
+    for (size_t i = 0; i < statsd::TIMING_BUCKETS; ++i) {
+        BOOST_CHECK_EQUAL(statsd::TimingBucket(statsd::TimingBucketValue(i)), i);
+    }
+    BOOST_CHECK_EQUAL(statsd::TimingBucket(-5), 0U);
+    BOOST_CHECK_EQUAL(statsd::TimingBucket(3), 3U);
+    BOOST_CHECK_EQUAL(statsd::TimingBucket(std::numeric_limits<int64_t>::max()), statsd::TIMING_BUCKETS - 1);
+    // values stay within ~12% of what is reported for their bucket
+    for (int64_t v : {10, 100, 1000, 123456, 9876543}) {
+        int64_t reported = statsd::TimingBucketValue(statsd::TimingBucket(v));
+        BOOST_CHECK(std::abs(reported - v) * 8 <= v);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(aggregate_and_batch)
+{
+    statsd::StatsdClient client;
+
+    statsd::MetricHandle counter = client.intern("test.counter", statsd::MetricType::COUNTER);
+    BOOST_CHECK(counter.IsValid());
+    // interning is idempotent
+    BOOST_CHECK(client.intern("test.counter", statsd::MetricType::COUNTER).IsValid());
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&] {
+            for (int j = 0; j < 1000; ++j) client.count(counter, 2);
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    statsd::MetricHandle gauge = client.intern("test.gauge", statsd::MetricType::GAUGE);
+    client.gauge(gauge, 5);
+    client.gauge(gauge, 7);
+
+    statsd::MetricHandle timing = client.intern("test.timing", statsd::MetricType::TIMING);
+    client.timing(timing, 1);
+    client.timing(timing, 1);
+    client.timing(timing, 1);
+    client.timing(timing, 1000);
+
+    // one summary per timer: 3 of the 4 samples are 1, so p50 stays there while p95 and p99 hit the slow one
+    const int64_t nSlow = statsd::TimingBucketValue(statsd::TimingBucket(1000));
+    const std::string strTiming = strprintf("test.timing.count:4|g\ntest.timing.mean:%d|g\ntest.timing.p50:1|g\ntest.timing.p95:%d|g\ntest.timing.p99:%d|g",
+                                            (3 + nSlow) / 4, nSlow, nSlow);
+    std::vector<std::string> datagrams = client.collect();
+    BOOST_REQUIRE_EQUAL(datagrams.size(), 1U);
+    BOOST_CHECK_EQUAL(datagrams[0], "test.counter:8000|c\ntest.gauge:7|g\n" + strTiming);
+
+    // everything was reset
+    BOOST_CHECK(client.collect().empty());
+
+    // many metrics are split over several datagrams
+    for (int i = 0; i < 500; ++i) {
+        client.count(client.intern(strprintf("test.many.%d", i), statsd::MetricType::COUNTER), 1);
+    }
+    datagrams = client.collect();
+    BOOST_CHECK(datagrams.size() > 1);
+    size_t nLines = 0;
+    for (const auto& datagram : datagrams) {
+        BOOST_CHECK(datagram.size() <= statsd::MAX_DATAGRAM_SIZE);
+        nLines += std::count(datagram.begin(), datagram.end(), '\n') + 1;
+    }
+    BOOST_CHECK_EQUAL(nLines, 500U);
+}
+
+BOOST_AUTO_TEST_CASE(metric_family)
+{
+    statsd::StatsdClient client;
+    statsd::MetricFamily family(client, "msg.", {"a", "b"}, ".bytes", statsd::MetricType::COUNTER, "other");
+    client.count(family.get("a"), 10);
+    client.count(family.get("unknown"), 3);
+    client.count(family.get("unknown2"), 4);
+
+    std::vector<std::string> datagrams = client.collect();
+    BOOST_REQUIRE_EQUAL(datagrams.size(), 1U);
+    BOOST_CHECK_EQUAL(datagrams[0], "msg.a.bytes:10|c\nmsg.other.bytes:7|c");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
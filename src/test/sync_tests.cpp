@@ -5,6 +5,8 @@
 #include <sync.h>
 #include <test/util/setup_common.h>
 
+#include <algorithm>
+
 #include <boost/test/unit_test.hpp>
 
 namespace {
@@ -55,4 +57,53 @@ BOOST_AUTO_TEST_CASE(potential_deadlock_detected)
     #endif
 }
 
+BOOST_AUTO_TEST_CASE(lock_contention_stats)
+{
+    const bool prev_profiling = g_lock_profiling.exchange(true);
+    ResetLockContentionStats();
+
+    Mutex contended_mutex;
+    int holder_line;
+    LockSite holder;
+    {
+        LOCK(contended_mutex); holder_line = __LINE__;
+        holder = contended_mutex.GetHolderSite();
+    }
+    BOOST_CHECK_EQUAL(holder.line, holder_line);
+
+    // Two waits of another site for the lock taken above, as a contended LOCK() records them
+    const int waiter_line = __LINE__;
+    RecordLockWait("contended_mutex", __FILE__, waiter_line, 100, holder);
+    RecordLockWait("contended_mutex", __FILE__, waiter_line, 300, holder);
+    auto find_stats = [](const std::vector<LockContentionStats>& all_stats) {
+        return std::find_if(all_stats.begin(), all_stats.end(), [](const LockContentionStats& s) { return s.name == "contended_mutex"; });
+    };
+    // nothing is merged while the waiter still holds the lock, or an outer one it waited for
+    const std::vector<LockContentionStats> held_stats = GetLockContentionStats();
+    BOOST_CHECK(find_stats(held_stats) == held_stats.end());
+    FlushLockWaits();
+    const std::vector<LockContentionStats> outer_stats = GetLockContentionStats();
+    BOOST_CHECK(find_stats(outer_stats) == outer_stats.end());
+    FlushLockWaits();
+
+    const std::vector<LockContentionStats> all_stats = GetLockContentionStats();
+    auto it = find_stats(all_stats);
+    BOOST_REQUIRE(it != all_stats.end());
+    const LockContentionStats& stats = *it;
+    BOOST_CHECK_EQUAL(stats.site, strprintf("%s:%d", __FILE__, waiter_line));
+    BOOST_CHECK_EQUAL(stats.nContentions, 2U);
+    BOOST_CHECK_EQUAL(stats.nTotalWaitMicros, 400);
+    BOOST_CHECK_EQUAL(stats.nMaxWaitMicros, 300);
+    BOOST_REQUIRE_EQUAL(stats.vWaitHistogram.size(), LOCK_WAIT_BUCKETS);
+    BOOST_CHECK_EQUAL(stats.vWaitHistogram[7], 1U); // [64, 128) us
+    BOOST_CHECK_EQUAL(stats.vWaitHistogram[9], 1U); // [256, 512) us
+    BOOST_REQUIRE_EQUAL(stats.vHolders.size(), 1U);
+    BOOST_CHECK_EQUAL(stats.vHolders[0].first, strprintf("%s:%d", __FILE__, holder_line));
+    BOOST_CHECK_EQUAL(stats.vHolders[0].second, 2U);
+
+    ResetLockContentionStats();
+    BOOST_CHECK(GetLockContentionStats().empty());
+    g_lock_profiling = prev_profiling;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
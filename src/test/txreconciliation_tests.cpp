@@ -0,0 +1,249 @@
+// Copyright (c) 2023 datos
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <txreconciliation.h>
+#include <random.h>
+#include <streams.h>
+#include <test/util/setup_common.h>
+#include <version.h>
+
+#include <algorithm>
+#include <set>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txreconciliation_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(sketch_decode)
+{
+    FastRandomContext rng(true);
+    for (size_t nDiff : {0, 1, 5, 50, 500}) {
+        const size_t nCells = CReconSketch::CellsForCapacity(nDiff);
+        BOOST_CHECK_EQUAL(nCells % CReconSketch::NUM_HASHES, 0U);
+        CReconSketch a(nCells), b(nCells);
+
+        // a large common part cancels out
+        for (int i = 0; i < 1000; i++) {
+            const uint32_t id = rng.rand32();
+            a.Add(id);
+            b.Add(id);
+        }
+        std::set<uint32_t> setOnlyA, setOnlyB;
+        for (size_t i = 0; i < nDiff; i++) {
+            const uint32_t id = rng.rand32();
+            if (i % 3 == 0) {
+                b.Add(id);
+                setOnlyB.insert(id);
+            } else {
+                a.Add(id);
+                setOnlyA.insert(id);
+            }
+        }
+
+        // the sketch goes over the wire
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << b;
+        CReconSketch received;
+        ss >> received;
+        BOOST_CHECK_EQUAL(received.GetCells(), nCells);
+
+        BOOST_CHECK(a.Subtract(received));
+        std::vector<uint32_t> vPositive, vNegative;
+        BOOST_CHECK(a.Decode(vPositive, vNegative));
+        BOOST_CHECK(std::set<uint32_t>(vPositive.begin(), vPositive.end()) == setOnlyA);
+        BOOST_CHECK(std::set<uint32_t>(vNegative.begin(), vNegative.end()) == setOnlyB);
+    }
+
+    // a difference much larger than the sketch was sized for fails to decode
+    CReconSketch small(CReconSketch::CellsForCapacity(1));
+    for (int i = 0; i < 100; i++) {
+        small.Add(rng.rand32());
+    }
+    std::vector<uint32_t> vPositive, vNegative;
+    BOOST_CHECK(!small.Decode(vPositive, vNegative));
+
+    // sketches of different sizes can't be combined
+    CReconSketch other(CReconSketch::CellsForCapacity(100));
+    BOOST_CHECK(!small.Subtract(other));
+}
+
+static CInv RandomTxInv(FastRandomContext& rng)
+{
+    return CInv(MSG_TX, rng.rand256());
+}
+
+BOOST_AUTO_TEST_CASE(reconciliation_round)
+{
+    FastRandomContext rng(true);
+    // the initiator opened the connection (outbound), the responder sees it as inbound
+    TxReconciliationTracker initiator, responder;
+    const NodeId nodeAtInitiator = 1, nodeAtResponder = 2;
+
+    // not offered to the peer, its sendrecon is ignored
+    BOOST_CHECK(initiator.RegisterPeer(nodeAtInitiator, false, 1, 0) == ReconciliationRegisterResult::NOT_FOUND);
+
+    const uint64_t nSaltInitiator = initiator.PreRegisterPeer(nodeAtInitiator);
+    const uint64_t nSaltResponder = responder.PreRegisterPeer(nodeAtResponder);
+    BOOST_CHECK(!initiator.IsPeerRegistered(nodeAtInitiator));
+    BOOST_CHECK(!initiator.AddToSet(nodeAtInitiator, RandomTxInv(rng)));
+    BOOST_CHECK(initiator.RegisterPeer(nodeAtInitiator, false, TXRECONCILIATION_VERSION, nSaltResponder) == ReconciliationRegisterResult::SUCCESS);
+    BOOST_CHECK(responder.RegisterPeer(nodeAtResponder, true, TXRECONCILIATION_VERSION, nSaltInitiator) == ReconciliationRegisterResult::SUCCESS);
+    BOOST_CHECK(initiator.RegisterPeer(nodeAtInitiator, false, TXRECONCILIATION_VERSION, nSaltResponder) == ReconciliationRegisterResult::ALREADY_REGISTERED);
+
+    // the first outbound peers still get announcements flooded, inbound ones never
+    BOOST_CHECK(initiator.ShouldFloodTo(nodeAtInitiator));
+    BOOST_CHECK(!responder.ShouldFloodTo(nodeAtResponder));
+    BOOST_CHECK(responder.ShouldFloodTo(42));
+
+    std::vector<CInv> vCommon, vOnlyInitiator, vOnlyResponder;
+    for (int i = 0; i < 100; i++) vCommon.push_back(RandomTxInv(rng));
+    for (int i = 0; i < 7; i++) vOnlyInitiator.push_back(RandomTxInv(rng));
+    for (int i = 0; i < 5; i++) vOnlyResponder.push_back(CInv(MSG_ISDLOCK, rng.rand256()));
+    for (const CInv& inv : vCommon) {
+        BOOST_CHECK(initiator.AddToSet(nodeAtInitiator, inv));
+        BOOST_CHECK(responder.AddToSet(nodeAtResponder, inv));
+    }
+    for (const CInv& inv : vOnlyInitiator) BOOST_CHECK(initiator.AddToSet(nodeAtInitiator, inv));
+    for (const CInv& inv : vOnlyResponder) BOOST_CHECK(responder.AddToSet(nodeAtResponder, inv));
+    // the peer announced one of them itself
+    responder.RemoveFromSet(nodeAtResponder, vOnlyResponder.back());
+    vOnlyResponder.pop_back();
+    BOOST_CHECK_EQUAL(responder.GetLocalSetSize(nodeAtResponder), vCommon.size() + vOnlyResponder.size());
+
+    // only the initiator requests, and only once per interval
+    const std::chrono::microseconds now{1000000000};
+    BOOST_CHECK(!responder.MaybeRequestReconciliation(nodeAtResponder, now));
+    const auto request = initiator.MaybeRequestReconciliation(nodeAtInitiator, now);
+    BOOST_REQUIRE(request);
+    BOOST_CHECK_EQUAL(request->first, vCommon.size() + vOnlyInitiator.size());
+    BOOST_CHECK(!initiator.MaybeRequestReconciliation(nodeAtInitiator, now + RECON_REQUEST_INTERVAL * 2));
+
+    CReconSketch sketch;
+    BOOST_CHECK(!initiator.HandleReconciliationRequest(nodeAtInitiator, request->first, request->second, now, sketch));
+    BOOST_CHECK(responder.HandleReconciliationRequest(nodeAtResponder, request->first, request->second, now, sketch));
+    BOOST_CHECK(!sketch.IsEmpty());
+    BOOST_CHECK_EQUAL(responder.GetLocalSetSize(nodeAtResponder), 0U);
+
+    std::vector<CInv> vAnnounceByInitiator;
+    std::vector<uint32_t> vAskFor;
+    bool fSuccess;
+    BOOST_CHECK(initiator.HandleSketch(nodeAtInitiator, sketch, vAnnounceByInitiator, vAskFor, fSuccess));
+    BOOST_CHECK(fSuccess);
+    BOOST_CHECK_EQUAL(vAskFor.size(), vOnlyResponder.size());
+    BOOST_CHECK_EQUAL(initiator.GetLocalSetSize(nodeAtInitiator), 0U);
+    // a second sketch wasn't asked for
+    std::vector<CInv> vUnused;
+    std::vector<uint32_t> vUnusedIds;
+    BOOST_CHECK(!initiator.HandleSketch(nodeAtInitiator, sketch, vUnused, vUnusedIds, fSuccess));
+
+    std::vector<CInv> vAnnounceByResponder;
+    BOOST_CHECK(responder.HandleReconciliationDiff(nodeAtResponder, true, vAskFor, vAnnounceByResponder));
+    BOOST_CHECK(!responder.HandleReconciliationDiff(nodeAtResponder, true, vAskFor, vUnused));
+
+    // both sides end up announcing exactly what the other one lacks
+    auto toSet = [](const std::vector<CInv>& v) {
+        std::set<std::pair<int, uint256>> set;
+        for (const CInv& inv : v) set.emplace(inv.type, inv.hash);
+        return set;
+    };
+    BOOST_CHECK(toSet(vAnnounceByInitiator) == toSet(vOnlyInitiator));
+    BOOST_CHECK(toSet(vAnnounceByResponder) == toSet(vOnlyResponder));
+
+    // the next request is allowed after the interval
+    BOOST_CHECK(initiator.MaybeRequestReconciliation(nodeAtInitiator, now + RECON_REQUEST_INTERVAL));
+
+    initiator.ForgetPeer(nodeAtInitiator);
+    BOOST_CHECK(!initiator.IsPeerRegistered(nodeAtInitiator));
+}
+
+BOOST_AUTO_TEST_CASE(reconciliation_fallback)
+{
+    FastRandomContext rng(true);
+    TxReconciliationTracker initiator, responder;
+    // occupy the outbound flooding slots, so the initiator reconciles with the next peer
+    for (NodeId id = 10; id < 10 + (NodeId)MAX_OUTBOUND_FLOOD_TO; id++) {
+        initiator.PreRegisterPeer(id);
+        BOOST_CHECK(initiator.RegisterPeer(id, false, TXRECONCILIATION_VERSION, 0) == ReconciliationRegisterResult::SUCCESS);
+    }
+    const uint64_t nSaltInitiator = initiator.PreRegisterPeer(1);
+    const uint64_t nSaltResponder = responder.PreRegisterPeer(2);
+    initiator.RegisterPeer(1, false, TXRECONCILIATION_VERSION, nSaltResponder);
+    responder.RegisterPeer(2, true, TXRECONCILIATION_VERSION, nSaltInitiator);
+    BOOST_CHECK(!initiator.ShouldFloodTo(1));
+
+    // the responder has nothing queued, so the initiator announces everything without a sketch
+    std::vector<CInv> vInitiator;
+    for (int i = 0; i < 20; i++) {
+        vInitiator.push_back(RandomTxInv(rng));
+        BOOST_CHECK(initiator.AddToSet(1, vInitiator.back()));
+    }
+    const auto request = initiator.MaybeRequestReconciliation(1, std::chrono::microseconds{1});
+    BOOST_REQUIRE(request);
+    CReconSketch sketch;
+    BOOST_CHECK(responder.HandleReconciliationRequest(2, request->first, request->second, std::chrono::microseconds{1}, sketch));
+    BOOST_CHECK(sketch.IsEmpty());
+
+    std::vector<CInv> vAnnounce;
+    std::vector<uint32_t> vAskFor;
+    bool fSuccess;
+    BOOST_CHECK(initiator.HandleSketch(1, sketch, vAnnounce, vAskFor, fSuccess));
+    BOOST_CHECK(!fSuccess);
+    BOOST_CHECK(vAskFor.empty());
+    BOOST_CHECK_EQUAL(vAnnounce.size(), vInitiator.size());
+
+    std::vector<CInv> vAnnounceByResponder;
+    BOOST_CHECK(responder.HandleReconciliationDiff(2, false, {}, vAnnounceByResponder));
+    BOOST_CHECK(vAnnounceByResponder.empty());
+
+    // the set size is bounded, overflowing announcements are flooded
+    for (size_t i = 0; i < MAX_RECON_SET_SIZE; i++) {
+        BOOST_CHECK(initiator.AddToSet(1, RandomTxInv(rng)));
+    }
+    BOOST_CHECK(!initiator.AddToSet(1, RandomTxInv(rng)));
+}
+
+BOOST_AUTO_TEST_CASE(reconciliation_timeout)
+{
+    FastRandomContext rng(true);
+    TxReconciliationTracker initiator, responder;
+    for (NodeId id = 10; id < 10 + (NodeId)MAX_OUTBOUND_FLOOD_TO; id++) {
+        initiator.PreRegisterPeer(id);
+        BOOST_CHECK(initiator.RegisterPeer(id, false, TXRECONCILIATION_VERSION, 0) == ReconciliationRegisterResult::SUCCESS);
+    }
+    const uint64_t nSaltInitiator = initiator.PreRegisterPeer(1);
+    const uint64_t nSaltResponder = responder.PreRegisterPeer(2);
+    initiator.RegisterPeer(1, false, TXRECONCILIATION_VERSION, nSaltResponder);
+    responder.RegisterPeer(2, true, TXRECONCILIATION_VERSION, nSaltInitiator);
+
+    std::vector<CInv> vInitiator, vResponder;
+    for (int i = 0; i < 10; i++) {
+        vInitiator.push_back(RandomTxInv(rng));
+        BOOST_CHECK(initiator.AddToSet(1, vInitiator.back()));
+        vResponder.push_back(RandomTxInv(rng));
+        BOOST_CHECK(responder.AddToSet(2, vResponder.back()));
+    }
+
+    // the sketch never arrives
+    const std::chrono::microseconds now{1000000000};
+    const auto request = initiator.MaybeRequestReconciliation(1, now);
+    BOOST_REQUIRE(request);
+    std::vector<CInv> vAnnounce;
+    BOOST_CHECK(!initiator.ExpireReconciliation(1, now + RECON_RESPONSE_TIMEOUT - std::chrono::microseconds{1}, vAnnounce));
+    BOOST_CHECK(initiator.ExpireReconciliation(1, now + RECON_RESPONSE_TIMEOUT, vAnnounce));
+    BOOST_CHECK_EQUAL(vAnnounce.size(), vInitiator.size());
+    BOOST_CHECK(initiator.ShouldFloodTo(1));
+    BOOST_CHECK(!initiator.AddToSet(1, RandomTxInv(rng)));
+    BOOST_CHECK(!initiator.MaybeRequestReconciliation(1, now + RECON_REQUEST_INTERVAL * 10));
+
+    // the diff never arrives
+    CReconSketch sketch;
+    BOOST_CHECK(responder.HandleReconciliationRequest(2, request->first, request->second, now, sketch));
+    BOOST_CHECK(!responder.ExpireReconciliation(2, now, vAnnounce));
+    BOOST_CHECK(responder.ExpireReconciliation(2, now + RECON_RESPONSE_TIMEOUT, vAnnounce));
+    BOOST_CHECK_EQUAL(vAnnounce.size(), vResponder.size());
+    BOOST_CHECK(responder.ShouldFloodTo(2));
+    BOOST_CHECK(!responder.ExpireReconciliation(2, now + RECON_RESPONSE_TIMEOUT * 2, vAnnounce));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,7 +5,9 @@
 #include <validation.h>
 #include <consensus/validation.h>
 #include <primitives/transaction.h>
+#include <random.h>
 #include <script/script.h>
+#include <script/sign.h>
 #include <test/util/setup_common.h>
 
 #include <boost/test/unit_test.hpp>
@@ -55,4 +57,66 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_reject_coinbase, TestChain100Setup)
     BOOST_CHECK_EQUAL(nDoS, 100);
 }
 
+/**
+ * Ensure that a batch accepts independent and dependent transactions and
+ * rejects the invalid ones with the same reasons as AcceptToMemoryPool.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_mempool_accept_batch, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    auto spend = [&](const uint256& prevHash, CAmount nValue) {
+        CMutableTransaction tx;
+        tx.nVersion = 1;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(prevHash, 0);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = nValue;
+        tx.vout[0].scriptPubKey = scriptPubKey;
+
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[0].scriptSig << vchSig;
+        return MakeTransactionRef(tx);
+    };
+
+    std::vector<CTransactionRef> txs;
+    txs.push_back(spend(m_coinbase_txns[0]->GetHash(), 11 * CENT));
+    txs.push_back(spend(m_coinbase_txns[1]->GetHash(), 11 * CENT));
+    // double spend of the first one
+    txs.push_back(spend(m_coinbase_txns[0]->GetHash(), 12 * CENT));
+    // spends the first one
+    txs.push_back(spend(txs[0]->GetHash(), 10 * CENT));
+    // bad signature
+    CMutableTransaction badSig(*spend(m_coinbase_txns[2]->GetHash(), 11 * CENT));
+    badSig.vin[0].scriptSig = CScript() << std::vector<unsigned char>(72, 0x30);
+    txs.push_back(MakeTransactionRef(badSig));
+    // parent unknown
+    txs.push_back(spend(GetRandHash(), 10 * CENT));
+    txs.push_back(spend(m_coinbase_txns[3]->GetHash(), 11 * CENT));
+
+    LOCK(cs_main);
+    unsigned int initialPoolSize = mempool.size();
+    const std::vector<MempoolAcceptResult> results = AcceptToMemoryPoolBatch(mempool, txs, {}, true /* bypass_limits */);
+    BOOST_REQUIRE_EQUAL(results.size(), txs.size());
+
+    BOOST_CHECK(results[0].fAccepted);
+    BOOST_CHECK(results[1].fAccepted);
+    BOOST_CHECK(!results[2].fAccepted);
+    BOOST_CHECK_EQUAL(results[2].state.GetRejectReason(), "txn-mempool-conflict");
+    BOOST_CHECK(results[3].fAccepted);
+    BOOST_CHECK(!results[4].fAccepted);
+    BOOST_CHECK(results[4].state.IsInvalid());
+    BOOST_CHECK(!results[5].fAccepted);
+    BOOST_CHECK(results[5].fMissingInputs);
+    BOOST_CHECK(!results[5].state.IsInvalid());
+    BOOST_CHECK(results[6].fAccepted);
+
+    BOOST_CHECK_EQUAL(mempool.size(), initialPoolSize + 4);
+    for (size_t i : {0, 1, 3, 6}) {
+        BOOST_CHECK(mempool.exists(txs[i]->GetHash()));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
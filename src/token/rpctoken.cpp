@@ -253,68 +253,48 @@ UniValue tokenbalance(const JSONRPCRequest& request)
     {
         auto locked_chain = pwallet->chain().lock();
 
-        std::map<uint256, CWalletTx> walletInst;
-        {
-            LOCK(pwallet->cs_wallet);
-            walletInst = pwallet->mapWallet;
-        }
-
-        for (auto it : walletInst) {
-
-            const CWalletTx& wtx = it.second;
-            if (wtx.IsCoinBase())
-                continue;
+        LOCK(pwallet->cs_wallet);
 
-            //! covers conflicted wtx's
-            if (!wtx.IsTrusted(*locked_chain)) {
+        //! only the wallet's unspent token outputs, by name
+        for (const auto& entry : pwallet->GetTokenUTXOs()) {
+            std::string name = entry.first;
+            if (use_filter && !CompareTokenName(filter_name, name)) {
                 continue;
             }
+            for (const COutPoint& outpoint : entry.second) {
+                const auto wit = pwallet->mapWallet.find(outpoint.hash);
+                if (wit == pwallet->mapWallet.end()) {
+                    continue;
+                }
+                const CWalletTx& wtx = wit->second;
+                if (wtx.IsCoinBase())
+                    continue;
 
-            uint256 txHash = wtx.tx->GetHash();
-            for (int n = 0; n < wtx.tx->vout.size(); n++) {
-                CTxOut out = wtx.tx->vout[n];
-                CScript pk = out.scriptPubKey;
-                CAmount nValue = out.nValue;
-
-                //! dont count checksum output value
-                if (pk.IsChecksumData()) {
+                //! covers conflicted wtx's
+                if (!wtx.IsTrusted(*locked_chain)) {
                     continue;
                 }
 
                 //! wallet may show existing spent entries
-                if (pwallet->IsSpent(*locked_chain, wtx.tx->GetHash(), n)) {
+                if (pwallet->IsSpent(*locked_chain, outpoint.hash, outpoint.n)) {
                     continue;
                 }
 
-                //! account for token in mempool, but not stale wallet sends
-                bool inMempool = false;
+                //! unconfirmed tokens are counted from the mempool below, stale wallet sends not at all
                 if (wtx.GetDepthInMainChain(*locked_chain) == 0) {
-                    if (IsInMempool(txHash)) {
-                        inMempool = true;
-                    } else {
-                        continue;
-                    }
+                    continue;
                 }
 
-                if (pk.IsPayToToken()) {
-                    CToken token;
-                    if (!BuildTokenFromScript(pk, token)) {
-                        continue;
-                    }
-                    CTxDestination address;
-                    ExtractDestination(pk, address);
+                const CTxOut& out = wtx.tx->vout[outpoint.n];
+                CTxDestination address;
+                ExtractDestination(out.scriptPubKey, address);
 
-                    //! make sure we only display items 'to' us
-                    if (!IsMine(*pwallet, address)) {
-                        continue;
-                    }
-
-                    //! create and fill entry
-                    std::string name = token.getName();
-                    if (!inMempool) {
-                        TokenBalancesConfirmed[name] += nValue;
-                    }
+                //! make sure we only display items 'to' us
+                if (!IsMine(*pwallet, address)) {
+                    continue;
                 }
+
+                TokenBalancesConfirmed[name] += out.nValue;
             }
         }
     }
@@ -114,24 +114,19 @@ bool IsOutputInMempool(const COutPoint& out)
 {
     LOCK(mempool.cs);
 
-    //! build quick vin cache
-    std::vector<COutPoint> MempoolOutputs;
-    for (const auto& l : mempool.mapTx) {
-        const CTransaction& mtx = l.GetTx();
-        if (mtx.HasTokenOutput()) {
-            for (unsigned int i = 0; i < mtx.vin.size(); i++) {
-                MempoolOutputs.push_back(mtx.vin[i].prevout);
-            }
-        }
-    }
+    //! only spends by token transactions count
+    const auto it = mempool.mapNextTx.find(out);
+    return it != mempool.mapNextTx.end() && it->second->HasTokenOutput();
+}
 
-    //! then see if our output is in this cache
-    const auto& it = std::find(MempoolOutputs.begin(), MempoolOutputs.end(), out);
-    if (it != MempoolOutputs.end()) {
-        return true;
+bool IsTokenOnlyTx(const CTransaction& tx)
+{
+    for (const auto& out : tx.vout) {
+        if (out.IsStandardOutput()) {
+            return false;
+        }
     }
-
-    return false;
+    return true;
 }
 
 int TokentxInMempool()
@@ -140,14 +135,7 @@ int TokentxInMempool()
 
     int TokenTotal = 0;
     for (const auto& l : mempool.mapTx) {
-        const CTransaction& mtx = l.GetTx();
-        bool is_token_tx = true;
-        for (const auto& m : mtx.vout) {
-            if (m.IsStandardOutput()) {
-                is_token_tx = false;
-            }
-        }
-        if (is_token_tx) {
+        if (IsTokenOnlyTx(l.GetTx())) {
             TokenTotal++;
         }
     }
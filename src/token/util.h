@@ -33,6 +33,7 @@ bool IsInMempool(uint256& txhash);
 void RemoveFromMempool(CTransaction& tx);
 bool IsOutputUnspent(const COutPoint& out);
 bool IsOutputInMempool(const COutPoint& out);
+bool IsTokenOnlyTx(const CTransaction& tx);
 int TokentxInMempool();
 void PrintTxinFunds(std::vector<CTxIn>& FundsRet);
 opcodetype GetOpcode(int n);
@@ -4,10 +4,42 @@
 
 #include <token/verify.h>
 
-bool CheckTokenMempool(CTxMemPool& pool, const CTransactionRef& tx, std::string& strError)
+bool GetTokenIssuanceNames(const CTransaction& tx, std::set<std::string>& setNames, std::string& strError)
 {
-    LOCK(mempool.cs);
+    for (unsigned int i = 0; i < tx.vout.size(); i++) {
+        if (tx.vout[i].scriptPubKey.IsPayToToken()) {
+            CToken token;
+            CScript TokenScript = tx.vout[i].scriptPubKey;
+            if (!ContextualCheckToken(TokenScript, token, strError)) {
+                LogPrint(BCLog::TOKEN, "ContextualCheckToken returned with error '%s'\n", strError);
+                return false;
+            }
+            if (token.getType() == CToken::ISSUANCE) {
+                setNames.insert(token.getName());
+            }
+        }
+    }
+    return true;
+}
 
+bool GetMempoolTokenIssuanceNames(CTxMemPool& pool, std::set<std::string>& setNames, std::string& strError)
+{
+    LOCK(pool.cs);
+
+    //! build issuance name list from mempool
+    for (const auto& l : pool.mapTx) {
+        const CTransaction& mtx = l.GetTx();
+        if (mtx.HasTokenOutput() && !GetTokenIssuanceNames(mtx, setNames, strError)) {
+            strError = "corrupt-invalid-existing-mempool";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CheckTokenMempool(const CTransactionRef& tx, const std::set<std::string>& setMempoolNames, std::string& strError)
+{
     // we are checking and ensuring that all token inputs have minimum confirms,
     // and also if any duplicate issuance token names exist (before they get committed to KnownIssuances via connectblock)
 
@@ -18,31 +50,6 @@ bool CheckTokenMempool(CTxMemPool& pool, const CTransactionRef& tx, std::string&
         return false;
     }
 
-    //! build issuance name list from mempool
-    std::vector<std::string> MempoolNames;
-    for (const auto& l : pool.mapTx) {
-        const CTransaction& mtx = l.GetTx();
-        if (mtx.HasTokenOutput()) {
-            for (unsigned int i = 0; i < mtx.vout.size(); i++) {
-                if (mtx.vout[i].scriptPubKey.IsPayToToken()) {
-                    CToken token;
-                    CScript TokenScript = mtx.vout[i].scriptPubKey;
-                    if (!ContextualCheckToken(TokenScript, token, strError)) {
-                        LogPrint(BCLog::TOKEN, "ContextualCheckToken returned with error '%s'\n", strError);
-                        strError = "corrupt-invalid-existing-mempool";
-                        return false;
-                    }
-                    std::string name = token.getName();
-                    if (token.getType() == CToken::ISSUANCE) {
-                        if (std::find(MempoolNames.begin(), MempoolNames.end(), name) == MempoolNames.end()) {
-                            MempoolNames.push_back(name);
-                        }
-                    }
-                }
-            }
-        }
-    }
-
     //! check if our new issuance already exists in this pool
     for (unsigned int i = 0; i < tx->vout.size(); i++) {
         CToken token;
@@ -53,12 +60,9 @@ bool CheckTokenMempool(CTxMemPool& pool, const CTransactionRef& tx, std::string&
                 strError = "corrupt-invalid-tokentx-mempool";
                 return false;
             }
-            std::string name = token.getName();
-            if (token.getType() == CToken::ISSUANCE) {
-                if (std::find(MempoolNames.begin(), MempoolNames.end(), name) != MempoolNames.end()) {
-                    strError = "token-issuance-exists-mempool";
-                    return false;
-                }
+            if (token.getType() == CToken::ISSUANCE && setMempoolNames.count(token.getName())) {
+                strError = "token-issuance-exists-mempool";
+                return false;
             }
         }
     }
@@ -66,6 +70,17 @@ bool CheckTokenMempool(CTxMemPool& pool, const CTransactionRef& tx, std::string&
     return true;
 }
 
+bool CheckTokenMempool(CTxMemPool& pool, const CTransactionRef& tx, std::string& strError)
+{
+    LOCK(pool.cs);
+
+    std::set<std::string> setMempoolNames;
+    if (!GetMempoolTokenIssuanceNames(pool, setMempoolNames, strError)) {
+        return false;
+    }
+    return CheckTokenMempool(tx, setMempoolNames, strError);
+}
+
 bool IsIdentifierInRange(uint64_t& identifier)
 {
     bool inRange = (identifier > ISSUANCE_ID_BEGIN) && (identifier < (std::numeric_limits<uint64_t>::max() - ISSUANCE_ID_BEGIN));
@@ -18,6 +18,10 @@
 class CToken;
 
 bool CheckTokenMempool(CTxMemPool& pool, const CTransactionRef& tokenTx, std::string& strError);
+//! Same as above, against the issuance names of the mempool collected by GetMempoolTokenIssuanceNames
+bool CheckTokenMempool(const CTransactionRef& tokenTx, const std::set<std::string>& setMempoolNames, std::string& strError);
+bool GetMempoolTokenIssuanceNames(CTxMemPool& pool, std::set<std::string>& setNames, std::string& strError);
+bool GetTokenIssuanceNames(const CTransaction& tx, std::set<std::string>& setNames, std::string& strError);
 bool CheckTokenIssuance(const CTransactionRef& tx, std::string& strError, bool onlyCheck);
 bool CheckTokenInputs(const CTransactionRef& tx, const CBlockIndex* pindex, const CCoinsViewCache& view, std::string& strError);
 bool ContextualCheckToken(CScript& TokenScript, CToken& token, std::string& strError, bool debug = false);
@@ -63,59 +63,48 @@ bool CWallet::FundTokenTransaction(std::string& tokenname, CAmount& amountMin, C
 {
     amountFound = 0;
 
-    std::map<uint256, CWalletTx> walletInst;
+    //! only the unspent outputs of this token are looked at, chain state is checked without cs_wallet
+    std::vector<std::pair<COutPoint, CTxOut>> vCandidates;
     {
-         LOCK(cs_wallet);
-         walletInst = mapWallet;
-    }
-
-    for (auto out : walletInst) {
-        const auto& tx = out.second;
-        uint256 txHash = tx.tx->GetHash();
-        for (int n = 0; n < tx.tx->vout.size(); n++) {
-            CTxOut out = tx.tx->vout[n];
-            COutPoint wtx_out(txHash, n);
-            if (!out.IsTokenOutput()) {
-                LogPrint(BCLog::TOKEN, "%s: pass because not a token output (%s)\n", __func__, out.ToString());
-                continue;
-            }
-            if (IsInMempool(txHash)) {
-                LogPrint(BCLog::TOKEN, "%s: pass because tx is in mempool (%s)\n", __func__, out.ToString());
-                continue;
-            }
-            if (!IsOutputUnspent(wtx_out)) {
-                LogPrint(BCLog::TOKEN, "%s: pass because output is spent (%s)\n", __func__, out.ToString());
-                continue;
-            }
-            if (!IsMine(out)) {
-                LogPrint(BCLog::TOKEN, "%s: pass because output is not mine (%s)\n", __func__, out.ToString());
-                continue;
-            }
-            if (GetUTXOConfirmations(wtx_out) < TOKEN_MINCONFS + 1) {
-                LogPrint(BCLog::TOKEN, "%s: pass because insufficient confirms (%s)\n", __func__, out.ToString());
-                continue;
-            }
-            if (IsOutputInMempool(wtx_out)) {
-                LogPrint(BCLog::TOKEN, "%s: pass because output is in a mempool tx (%s)\n", __func__, out.ToString());
+        LOCK(cs_wallet);
+        const auto it = mapTokenUTXO.find(tokenname);
+        if (it == mapTokenUTXO.end()) {
+            return false;
+        }
+        for (const COutPoint& outpoint : it->second) {
+            const auto wit = mapWallet.find(outpoint.hash);
+            if (wit == mapWallet.end()) {
                 continue;
             }
-            CScript pk = out.scriptPubKey;
-            CAmount inputValue = out.nValue;
-            if (!pk.IsChecksumData()) {
-                CToken token;
-                if (!BuildTokenFromScript(pk, token)) {
-                    continue;
-                }
-                LogPrint(BCLog::TOKEN, "%s: found %llu of %s\n", __func__, inputValue, token.getName());
-                if (tokenname == token.getName()) {
-                    amountFound += inputValue;
-                    CTxIn inputFound(COutPoint(txHash, n));
-                    ret.push_back(inputFound);
-                    if (amountFound >= amountMin) {
-                        return true;
-                    }
-                }
-            }
+            vCandidates.emplace_back(outpoint, wit->second.tx->vout[outpoint.n]);
+        }
+    }
+
+    for (const auto& candidate : vCandidates) {
+        const COutPoint& wtx_out = candidate.first;
+        const CTxOut& out = candidate.second;
+        uint256 txHash = wtx_out.hash;
+        if (IsInMempool(txHash)) {
+            LogPrint(BCLog::TOKEN, "%s: pass because tx is in mempool (%s)\n", __func__, out.ToString());
+            continue;
+        }
+        if (!IsOutputUnspent(wtx_out)) {
+            LogPrint(BCLog::TOKEN, "%s: pass because output is spent (%s)\n", __func__, out.ToString());
+            continue;
+        }
+        if (GetUTXOConfirmations(wtx_out) < TOKEN_MINCONFS + 1) {
+            LogPrint(BCLog::TOKEN, "%s: pass because insufficient confirms (%s)\n", __func__, out.ToString());
+            continue;
+        }
+        if (IsOutputInMempool(wtx_out)) {
+            LogPrint(BCLog::TOKEN, "%s: pass because output is in a mempool tx (%s)\n", __func__, out.ToString());
+            continue;
+        }
+        LogPrint(BCLog::TOKEN, "%s: found %llu of %s\n", __func__, out.nValue, tokenname);
+        amountFound += out.nValue;
+        ret.push_back(CTxIn(wtx_out));
+        if (amountFound >= amountMin) {
+            return true;
         }
     }
     return false;
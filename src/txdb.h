@@ -12,6 +12,7 @@
 #include <primitives/block.h>
 #include <spentindex.h>
 
+#include <array>
 #include <memory>
 #include <string>
 #include <utility>
@@ -39,6 +40,16 @@ static const int64_t nMaxTxIndexCache = 1024;
 static const int64_t max_filter_index_cache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! Max memory allocated to the evo and LLMQ database caches combined (MiB)
+static const int64_t nMaxAuxDbCache = 1024;
+//! Cache of an evo or LLMQ database: a percentage of their -dbcache budget, and the cache (MiB) it
+//! had before that budget existed, which it keeps outside of -dbcache when its share is smaller
+struct AuxDbCacheShare {
+    const char* name;
+    int nPercent;
+    int64_t nMinCache;
+};
+static const std::array<AuxDbCacheShare, 4> AUX_DB_CACHE_SHARES{{{"evodb", 50, 64}, {"isdb", 30, 32}, {"recsigdb", 15, 8}, {"dkgdb", 5, 1}}};
 
 /** CCoinsView backed by the coin database (chainstate/) */
 class CCoinsViewDB final : public CCoinsView
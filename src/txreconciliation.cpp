@@ -0,0 +1,418 @@
+// Copyright (c) 2023 datos
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <txreconciliation.h>
+
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+#include <crypto/siphash.h>
+#include <logging.h>
+#include <random.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/** Tag for the SHA256 which combines both peers' salts into the short id key */
+static const std::string RECON_SALT_TAG = "Tx Relay Salting";
+
+static inline uint32_t Mix32(uint32_t h)
+{
+    // murmur3 finalizer
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline uint32_t CheckHash(uint32_t nShortId)
+{
+    return Mix32(nShortId ^ 0x5bd1e995) | 1;
+}
+
+static inline bool SameInv(const CInv& a, const CInv& b)
+{
+    return a.type == b.type && a.hash == b.hash;
+}
+
+bool IsReconcilableInv(const CInv& inv)
+{
+    return inv.type == MSG_TX || inv.type == MSG_DSTX || inv.type == MSG_ISLOCK || inv.type == MSG_ISDLOCK;
+}
+
+CReconSketch::CReconSketch(size_t nCells) : vCells(nCells)
+{
+    assert(nCells % NUM_HASHES == 0);
+}
+
+size_t CReconSketch::CellsForCapacity(size_t nCapacity)
+{
+    // An IBLT with three hash functions decodes reliably with ~1.3 cells per
+    // element for large differences, small ones need some more headroom.
+    const size_t nCells = nCapacity + nCapacity / 2 + 12;
+    return (nCells + NUM_HASHES - 1) / NUM_HASHES * NUM_HASHES;
+}
+
+size_t CReconSketch::CellIndex(uint32_t nShortId, size_t nHash) const
+{
+    // every hash function gets its own part of the table, so an id never hits the same cell twice
+    const size_t nPartSize = vCells.size() / NUM_HASHES;
+    const uint32_t h = Mix32(nShortId + 0x9e3779b9 * (uint32_t)(nHash + 1));
+    return nHash * nPartSize + (size_t)(((uint64_t)h * nPartSize) >> 32);
+}
+
+void CReconSketch::Toggle(uint32_t nShortId, int nDirection)
+{
+    const uint32_t nCheck = CheckHash(nShortId);
+    for (size_t i = 0; i < NUM_HASHES; i++) {
+        Cell& cell = vCells[CellIndex(nShortId, i)];
+        cell.nCount = (uint8_t)(cell.nCount + nDirection);
+        cell.nKeySum ^= nShortId;
+        cell.nCheckSum ^= nCheck;
+    }
+}
+
+void CReconSketch::Add(uint32_t nShortId)
+{
+    Toggle(nShortId, 1);
+}
+
+bool CReconSketch::Subtract(const CReconSketch& other)
+{
+    if (other.vCells.size() != vCells.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < vCells.size(); i++) {
+        vCells[i].nCount = (uint8_t)(vCells[i].nCount - other.vCells[i].nCount);
+        vCells[i].nKeySum ^= other.vCells[i].nKeySum;
+        vCells[i].nCheckSum ^= other.vCells[i].nCheckSum;
+    }
+    return true;
+}
+
+bool CReconSketch::Decode(std::vector<uint32_t>& vPositive, std::vector<uint32_t>& vNegative) const
+{
+    vPositive.clear();
+    vNegative.clear();
+    if (vCells.empty()) {
+        return true;
+    }
+
+    CReconSketch work(*this);
+    auto isPure = [&work](size_t i) {
+        const Cell& cell = work.vCells[i];
+        return (cell.nCount == 1 || cell.nCount == 0xff) && cell.nCheckSum == CheckHash(cell.nKeySum);
+    };
+
+    std::vector<size_t> vPure;
+    for (size_t i = 0; i < work.vCells.size(); i++) {
+        if (isPure(i)) vPure.push_back(i);
+    }
+    // every peeled id clears at least one cell, more iterations means a corrupt sketch
+    size_t nRemaining = work.vCells.size();
+    while (!vPure.empty() && nRemaining > 0) {
+        const size_t i = vPure.back();
+        vPure.pop_back();
+        if (!isPure(i)) continue;
+
+        const uint32_t nShortId = work.vCells[i].nKeySum;
+        const bool fPositive = work.vCells[i].nCount == 1;
+        (fPositive ? vPositive : vNegative).push_back(nShortId);
+        work.Toggle(nShortId, fPositive ? -1 : 1);
+        nRemaining--;
+        for (size_t j = 0; j < NUM_HASHES; j++) {
+            const size_t nIndex = work.CellIndex(nShortId, j);
+            if (isPure(nIndex)) vPure.push_back(nIndex);
+        }
+    }
+
+    for (const Cell& cell : work.vCells) {
+        if (cell.nCount != 0 || cell.nKeySum != 0 || cell.nCheckSum != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t TxReconciliationTracker::PeerState::ShortId(const CInv& inv) const
+{
+    return (uint32_t)CSipHasher(k0, k1).Write(inv.type).Write(inv.hash.begin(), inv.hash.size()).Finalize();
+}
+
+uint64_t TxReconciliationTracker::PreRegisterPeer(NodeId nodeId)
+{
+    const uint64_t nSalt = GetRand(std::numeric_limits<uint64_t>::max());
+    LOCK(cs);
+    mapPeers[nodeId] = PeerState();
+    mapPeers[nodeId].nLocalSalt = nSalt;
+    return nSalt;
+}
+
+ReconciliationRegisterResult TxReconciliationTracker::RegisterPeer(NodeId nodeId, bool fInbound, uint32_t nPeerVersion, uint64_t nPeerSalt)
+{
+    LOCK(cs);
+    auto it = mapPeers.find(nodeId);
+    if (it == mapPeers.end()) {
+        return ReconciliationRegisterResult::NOT_FOUND;
+    }
+    PeerState& state = it->second;
+    if (state.fRegistered) {
+        return ReconciliationRegisterResult::ALREADY_REGISTERED;
+    }
+    if (std::min(nPeerVersion, TXRECONCILIATION_VERSION) < 1) {
+        return ReconciliationRegisterResult::PROTOCOL_VIOLATION;
+    }
+
+    // both peers derive the same key from their salts, no matter who sent which
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    unsigned char salt[8];
+    CSHA256 hasher;
+    hasher.Write((const unsigned char*)RECON_SALT_TAG.data(), RECON_SALT_TAG.size());
+    WriteLE64(salt, std::min(state.nLocalSalt, nPeerSalt));
+    hasher.Write(salt, sizeof(salt));
+    WriteLE64(salt, std::max(state.nLocalSalt, nPeerSalt));
+    hasher.Write(salt, sizeof(salt));
+    hasher.Finalize(hash);
+    state.k0 = ReadLE64(hash);
+    state.k1 = ReadLE64(hash + 8);
+
+    state.fRegistered = true;
+    state.fInitiator = !fInbound;
+    if (!fInbound && nOutboundFlooding < MAX_OUTBOUND_FLOOD_TO) {
+        state.fFlood = true;
+        nOutboundFlooding++;
+    }
+    LogPrint(BCLog::NET, "Registered peer=%d for transaction reconciliation (%s, %s)\n", nodeId,
+             state.fInitiator ? "initiator" : "responder", state.fFlood ? "flooding" : "not flooding");
+    return ReconciliationRegisterResult::SUCCESS;
+}
+
+void TxReconciliationTracker::ForgetPeer(NodeId nodeId)
+{
+    LOCK(cs);
+    auto it = mapPeers.find(nodeId);
+    if (it == mapPeers.end()) {
+        return;
+    }
+    if (it->second.fFlood) {
+        nOutboundFlooding--;
+    }
+    mapPeers.erase(it);
+}
+
+bool TxReconciliationTracker::IsPeerRegistered(NodeId nodeId) const
+{
+    LOCK(cs);
+    auto it = mapPeers.find(nodeId);
+    return it != mapPeers.end() && it->second.fRegistered;
+}
+
+bool TxReconciliationTracker::ShouldFloodTo(NodeId nodeId) const
+{
+    LOCK(cs);
+    auto it = mapPeers.find(nodeId);
+    return it == mapPeers.end() || !it->second.fRegistered || it->second.fFlood || it->second.fUnresponsive;
+}
+
+bool TxReconciliationTracker::AddToSet(NodeId nodeId, const CInv& inv)
+{
+    LOCK(cs);
+    auto it = mapPeers.find(nodeId);
+    if (it == mapPeers.end() || !it->second.fRegistered) {
+        return false;
+    }
+    PeerState& state = it->second;
+    if (state.fUnresponsive || state.mapLocalSet.size() >= MAX_RECON_SET_SIZE) {
+        return false;
+    }
+    // a short id collision can't be reconciled, flood the second one
+    const auto ret = state.mapLocalSet.emplace(state.ShortId(inv), inv);
+    return ret.second || SameInv(ret.first->second, inv);
+}
+
+void TxReconciliationTracker::RemoveFromSet(NodeId nodeId, const CInv& inv)
+{
+    LOCK(cs);
+    auto it = mapPeers.find(nodeId);
+    if (it == mapPeers.end() || !it->second.fRegistered) {
+        return;
+    }
+    PeerState& state = it->second;
+    auto setIt = state.mapLocalSet.find(state.ShortId(inv));
+    if (setIt != state.mapLocalSet.end() && SameInv(setIt->second, inv)) {
+        state.mapLocalSet.erase(setIt);
+    }
+}
+
+std::optional<std::pair<uint16_t, uint16_t>> TxReconciliationTracker::MaybeRequestReconciliation(NodeId nodeId, std::chrono::microseconds now)
+{
+    LOCK(cs);
+    auto it = mapPeers.find(nodeId);
+    if (it == mapPeers.end() || !it->second.fRegistered || !it->second.fInitiator) {
+        return std::nullopt;
+    }
+    PeerState& state = it->second;
+    if (state.fUnresponsive || state.fAwaitingSketch || now < state.nNextRequest) {
+        return std::nullopt;
+    }
+    state.fAwaitingSketch = true;
+    state.nResponseDeadline = now + RECON_RESPONSE_TIMEOUT;
+    state.nNextRequest = now + RECON_REQUEST_INTERVAL;
+    const uint16_t nSetSize = std::min<size_t>(state.mapLocalSet.size(), std::numeric_limits<uint16_t>::max());
+    const uint16_t nQ = (uint16_t)(state.q * RECON_Q_PRECISION);
+    return std::make_pair(nSetSize, nQ);
+}
+
+bool TxReconciliationTracker::HandleReconciliationRequest(NodeId nodeId, uint16_t nPeerSetSize, uint16_t nPeerQ, std::chrono::microseconds now, CReconSketch& sketchOut)
+{
+    LOCK(cs);
+    auto it = mapPeers.find(nodeId);
+    if (it == mapPeers.end() || !it->second.fRegistered || it->second.fInitiator || it->second.fAwaitingDiff) {
+        return false;
+    }
+    PeerState& state = it->second;
+
+    // Expected size of the difference: the difference of the set sizes plus a
+    // share q (estimated by the initiator) of the smaller set.
+    const size_t nLocalSize = state.mapLocalSet.size();
+    const double q = (double)nPeerQ / RECON_Q_PRECISION;
+    const size_t nCapacity = (nLocalSize > nPeerSetSize ? nLocalSize - nPeerSetSize : nPeerSetSize - nLocalSize) +
+                             (size_t)(q * std::min<size_t>(nLocalSize, nPeerSetSize)) + 1;
+
+    // With nothing to announce the initiator's whole set is the difference,
+    // announcing it without a sketch is cheapest. Too large differences aren't
+    // worth a sketch either.
+    if (nLocalSize == 0 || nCapacity > MAX_SKETCH_CAPACITY) {
+        sketchOut = CReconSketch();
+    } else {
+        sketchOut = CReconSketch(CReconSketch::CellsForCapacity(nCapacity));
+        for (const auto& item : state.mapLocalSet) {
+            sketchOut.Add(item.first);
+        }
+    }
+
+    state.mapSnapshot = std::move(state.mapLocalSet);
+    state.mapLocalSet.clear();
+    state.fAwaitingDiff = true;
+    state.nResponseDeadline = now + RECON_RESPONSE_TIMEOUT;
+    return true;
+}
+
+bool TxReconciliationTracker::HandleSketch(NodeId nodeId, const CReconSketch& sketch, std::vector<CInv>& vAnnounce, std::vector<uint32_t>& vAskFor, bool& fSuccess)
+{
+    vAnnounce.clear();
+    vAskFor.clear();
+    fSuccess = false;
+
+    LOCK(cs);
+    auto it = mapPeers.find(nodeId);
+    if (it == mapPeers.end() || !it->second.fRegistered || !it->second.fInitiator || !it->second.fAwaitingSketch) {
+        return false;
+    }
+    if (sketch.GetCells() > CReconSketch::CellsForCapacity(MAX_SKETCH_CAPACITY) || sketch.GetCells() % CReconSketch::NUM_HASHES != 0) {
+        return false;
+    }
+    PeerState& state = it->second;
+    state.fAwaitingSketch = false;
+
+    if (!sketch.IsEmpty()) {
+        CReconSketch local(sketch.GetCells());
+        for (const auto& item : state.mapLocalSet) {
+            local.Add(item.first);
+        }
+        std::vector<uint32_t> vLocalOnly;
+        if (local.Subtract(sketch) && local.Decode(vLocalOnly, vAskFor)) {
+            fSuccess = true;
+            for (uint32_t nShortId : vLocalOnly) {
+                auto setIt = state.mapLocalSet.find(nShortId);
+                if (setIt != state.mapLocalSet.end()) {
+                    vAnnounce.push_back(setIt->second);
+                }
+            }
+            // refine the estimate of how much of the smaller set differs
+            const size_t nLocalSize = state.mapLocalSet.size();
+            const size_t nRemoteSize = nLocalSize + vAskFor.size() - std::min(nLocalSize, vLocalOnly.size());
+            const size_t nMinSize = std::min(nLocalSize, nRemoteSize);
+            if (nMinSize > 0) {
+                const double nSizeDiff = std::abs((double)nLocalSize - (double)nRemoteSize);
+                state.q = std::max(0.0, std::min(2.0, ((double)(vLocalOnly.size() + vAskFor.size()) - nSizeDiff) / nMinSize));
+            }
+        } else {
+            vAskFor.clear();
+            LogPrint(BCLog::NET, "Transaction reconciliation with peer=%d failed, falling back to announcing everything\n", nodeId);
+        }
+    }
+
+    if (!fSuccess) {
+        for (const auto& item : state.mapLocalSet) {
+            vAnnounce.push_back(item.second);
+        }
+    }
+    state.mapLocalSet.clear();
+    return true;
+}
+
+bool TxReconciliationTracker::HandleReconciliationDiff(NodeId nodeId, bool fSuccess, const std::vector<uint32_t>& vAskFor, std::vector<CInv>& vAnnounce)
+{
+    vAnnounce.clear();
+
+    LOCK(cs);
+    auto it = mapPeers.find(nodeId);
+    if (it == mapPeers.end() || !it->second.fRegistered || it->second.fInitiator || !it->second.fAwaitingDiff) {
+        return false;
+    }
+    PeerState& state = it->second;
+    if (fSuccess) {
+        for (uint32_t nShortId : vAskFor) {
+            auto setIt = state.mapSnapshot.find(nShortId);
+            if (setIt != state.mapSnapshot.end()) {
+                vAnnounce.push_back(setIt->second);
+            }
+        }
+    } else {
+        for (const auto& item : state.mapSnapshot) {
+            vAnnounce.push_back(item.second);
+        }
+    }
+    state.mapSnapshot.clear();
+    state.fAwaitingDiff = false;
+    return true;
+}
+
+bool TxReconciliationTracker::ExpireReconciliation(NodeId nodeId, std::chrono::microseconds now, std::vector<CInv>& vAnnounce)
+{
+    vAnnounce.clear();
+
+    LOCK(cs);
+    auto it = mapPeers.find(nodeId);
+    if (it == mapPeers.end() || !it->second.fRegistered) {
+        return false;
+    }
+    PeerState& state = it->second;
+    if ((!state.fAwaitingSketch && !state.fAwaitingDiff) || now < state.nResponseDeadline) {
+        return false;
+    }
+    for (const auto& item : state.mapSnapshot) {
+        vAnnounce.push_back(item.second);
+    }
+    for (const auto& item : state.mapLocalSet) {
+        vAnnounce.push_back(item.second);
+    }
+    state.mapSnapshot.clear();
+    state.mapLocalSet.clear();
+    state.fAwaitingSketch = false;
+    state.fAwaitingDiff = false;
+    state.fUnresponsive = true;
+    LogPrint(BCLog::NET, "Transaction reconciliation with peer=%d timed out, flooding to it from now on\n", nodeId);
+    return true;
+}
+
+size_t TxReconciliationTracker::GetLocalSetSize(NodeId nodeId) const
+{
+    LOCK(cs);
+    auto it = mapPeers.find(nodeId);
+    return it == mapPeers.end() ? 0 : it->second.mapLocalSet.size();
+}
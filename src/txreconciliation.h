@@ -0,0 +1,176 @@
+// Copyright (c) 2023 datos
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TXRECONCILIATION_H
+#define BITCOIN_TXRECONCILIATION_H
+
+#include <net.h>
+#include <protocol.h>
+#include <serialize.h>
+#include <sync.h>
+
+#include <chrono>
+#include <map>
+#include <optional>
+#include <vector>
+
+/** Whether transaction reconciliation is offered to peers by default */
+static const bool DEFAULT_TXRECONCILIATION_ENABLE = false;
+/** Version of the reconciliation protocol we speak, sent in SENDRECON */
+static constexpr uint32_t TXRECONCILIATION_VERSION = 1;
+/** Number of outbound reconciling peers which still get every announcement flooded to them */
+static constexpr size_t MAX_OUTBOUND_FLOOD_TO = 2;
+/** How often we ask each outbound reconciling peer for a reconciliation */
+static constexpr std::chrono::seconds RECON_REQUEST_INTERVAL{8};
+/** How long we wait for the peer's sketch or diff before giving up and flooding to it instead */
+static constexpr std::chrono::seconds RECON_RESPONSE_TIMEOUT{30};
+/** Announcements waiting for reconciliation per peer, further ones are flooded */
+static constexpr size_t MAX_RECON_SET_SIZE = 3000;
+/** Largest set difference a sketch is built for, larger differences fall back to flooding */
+static constexpr size_t MAX_SKETCH_CAPACITY = 2000;
+/** Fixed point precision of the q coefficient sent in REQRECON */
+static constexpr uint16_t RECON_Q_PRECISION = (1 << 14) - 1;
+/** Initial estimate of the share of the smaller set that differs, refined after each reconciliation */
+static constexpr double RECON_DEFAULT_Q = 0.25;
+
+enum class ReconciliationRegisterResult {
+    NOT_FOUND,
+    SUCCESS,
+    ALREADY_REGISTERED,
+    PROTOCOL_VIOLATION,
+};
+
+/** Inventory types which are reconciled instead of announced one by one */
+bool IsReconcilableInv(const CInv& inv);
+
+/**
+ * An invertible Bloom lookup table of 32 bit short ids. Two peers each build a
+ * sketch of their set with the same number of cells, the difference of the two
+ * sketches decodes to the ids only one of them has, as long as there are not
+ * much more of those than the sketch was sized for.
+ *
+ * Counts are kept modulo 256, the per cell check hash tells pure cells apart.
+ */
+class CReconSketch
+{
+public:
+    static constexpr size_t NUM_HASHES = 3;
+
+    struct Cell {
+        uint8_t nCount{0};
+        uint32_t nKeySum{0};
+        uint32_t nCheckSum{0};
+
+        SERIALIZE_METHODS(Cell, obj) { READWRITE(obj.nCount, obj.nKeySum, obj.nCheckSum); }
+    };
+
+    CReconSketch() = default;
+    explicit CReconSketch(size_t nCells);
+
+    /** Number of cells needed to decode a difference of up to nCapacity ids with high probability */
+    static size_t CellsForCapacity(size_t nCapacity);
+
+    size_t GetCells() const { return vCells.size(); }
+    bool IsEmpty() const { return vCells.empty(); }
+
+    void Add(uint32_t nShortId);
+    /** Remove the ids of another sketch of the same size, leaving the symmetric difference */
+    bool Subtract(const CReconSketch& other);
+    /**
+     * Recover the ids of the difference, vPositive are the ones which were
+     * added to this sketch, vNegative the ones added to the subtracted one.
+     */
+    bool Decode(std::vector<uint32_t>& vPositive, std::vector<uint32_t>& vNegative) const;
+
+    SERIALIZE_METHODS(CReconSketch, obj) { READWRITE(obj.vCells); }
+
+private:
+    std::vector<Cell> vCells;
+
+    size_t CellIndex(uint32_t nShortId, size_t nHash) const;
+    void Toggle(uint32_t nShortId, int nDirection);
+};
+
+/**
+ * Keeps track of the peers we reconcile transaction and InstantSend
+ * announcements with (an Erlay-like protocol).
+ *
+ * The side which opened the connection requests a reconciliation every
+ * RECON_REQUEST_INTERVAL. The other side answers with a sketch of the
+ * announcements it has queued for the initiator, which decodes the difference
+ * against its own queue, announces what the responder lacks and asks for the
+ * short ids it lacks itself in RECONCILDIFF. A small number of outbound peers
+ * and all peers not supporting reconciliation still get announcements flooded,
+ * as do peers which left a reconciliation unanswered for RECON_RESPONSE_TIMEOUT.
+ */
+class TxReconciliationTracker
+{
+public:
+    TxReconciliationTracker() = default;
+
+    /** Start the negotiation with a peer, returns the salt to send in SENDRECON */
+    uint64_t PreRegisterPeer(NodeId nodeId);
+    /** Complete the negotiation after the peer's SENDRECON, NOT_FOUND if we didn't offer reconciliation to it */
+    ReconciliationRegisterResult RegisterPeer(NodeId nodeId, bool fInbound, uint32_t nPeerVersion, uint64_t nPeerSalt);
+    void ForgetPeer(NodeId nodeId);
+
+    bool IsPeerRegistered(NodeId nodeId) const;
+    /** Whether announcements to a peer should be sent right away instead of being reconciled */
+    bool ShouldFloodTo(NodeId nodeId) const;
+
+    /** Queue an announcement for reconciliation, returns false if it has to be flooded instead */
+    bool AddToSet(NodeId nodeId, const CInv& inv);
+    /** Forget an announcement the peer told us about itself */
+    void RemoveFromSet(NodeId nodeId, const CInv& inv);
+
+    /** Initiator: if it is time, returns the set size and q coefficient to send in REQRECON */
+    std::optional<std::pair<uint16_t, uint16_t>> MaybeRequestReconciliation(NodeId nodeId, std::chrono::microseconds now);
+    /** Responder: build the sketch answering a REQRECON, an empty sketch asks the initiator to fall back to flooding */
+    bool HandleReconciliationRequest(NodeId nodeId, uint16_t nPeerSetSize, uint16_t nPeerQ, std::chrono::microseconds now, CReconSketch& sketchOut);
+    /**
+     * Initiator: decode the responder's sketch. Fills in what we have to
+     * announce to the peer and the short ids we ask it to announce to us.
+     */
+    bool HandleSketch(NodeId nodeId, const CReconSketch& sketch, std::vector<CInv>& vAnnounce, std::vector<uint32_t>& vAskFor, bool& fSuccess);
+    /** Responder: the initiator's answer to our sketch, fills in what to announce to it */
+    bool HandleReconciliationDiff(NodeId nodeId, bool fSuccess, const std::vector<uint32_t>& vAskFor, std::vector<CInv>& vAnnounce);
+    /**
+     * Give up on a reconciliation the peer didn't answer within
+     * RECON_RESPONSE_TIMEOUT. Fills in everything queued for the peer, which
+     * has to be announced right away, and floods to the peer from then on.
+     */
+    bool ExpireReconciliation(NodeId nodeId, std::chrono::microseconds now, std::vector<CInv>& vAnnounce);
+
+    size_t GetLocalSetSize(NodeId nodeId) const;
+
+private:
+    struct PeerState {
+        uint64_t nLocalSalt{0};
+        bool fRegistered{false};
+        bool fInitiator{false};
+        bool fFlood{false};
+        //! A reconciliation with the peer timed out, announcements are flooded to it instead
+        bool fUnresponsive{false};
+        uint64_t k0{0}, k1{0};
+        //! Announcements queued for this peer, by short id
+        std::map<uint32_t, CInv> mapLocalSet;
+        //! Responder: the set we sent a sketch of, until the initiator answers
+        std::map<uint32_t, CInv> mapSnapshot;
+        bool fAwaitingDiff{false};
+        //! Initiator: a request is outstanding
+        bool fAwaitingSketch{false};
+        //! When we give up waiting for the sketch or diff
+        std::chrono::microseconds nResponseDeadline{0};
+        std::chrono::microseconds nNextRequest{0};
+        double q{RECON_DEFAULT_Q};
+
+        uint32_t ShortId(const CInv& inv) const;
+    };
+
+    mutable Mutex cs;
+    std::map<NodeId, PeerState> mapPeers GUARDED_BY(cs);
+    size_t nOutboundFlooding GUARDED_BY(cs){0};
+};
+
+#endif // BITCOIN_TXRECONCILIATION_H
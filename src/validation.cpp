@@ -47,6 +47,7 @@
 #include <util/translation.h>
 #include <util/validation.h>
 #include <util/system.h>
+#include <util/trace.h>
 #include <validationinterface.h>
 #include <versionbitsinfo.h>
 #include <warnings.h>
@@ -62,6 +63,7 @@
 
 #include <statsd_client.h>
 
+#include <optional>
 #include <string>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -216,6 +218,9 @@ static FILE* OpenUndoFile(const FlatFilePos &pos, bool fReadOnly = false);
 static FlatFileSeq BlockFileSeq();
 static FlatFileSeq UndoFileSeq();
 
+/** Script checks of blocks being connected and of mempool transaction batches */
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+
 bool CheckFinalTx(const CTransaction &tx, int flags)
 {
     AssertLockHeld(cs_main);
@@ -514,25 +519,87 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
     return CheckInputs(tx, state, view, true, flags, cacheSigStore, true, txdata);
 }
 
+namespace {
 /**
- * @param[out] coins_to_uncache   Return any outpoints which were not previously present in the
- *                                coins cache, but were added as a result of validating the tx
- *                                for mempool acceptance. This allows the caller to optionally
- *                                remove the cache additions if the associated transaction ends
- *                                up being rejected by the mempool.
+ * A transaction on its way into the mempool, carried through the stages of
+ * acceptance. AcceptToMemoryPoolWorker runs all stages for one transaction,
+ * AcceptToMemoryPoolBatch runs each stage for a group of independent
+ * transactions before moving on to the next one.
  */
-static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx,
-                                     bool* pfMissingInputs, int64_t nAcceptTime, bool bypass_limits,
-                                     const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache, bool test_accept) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+struct MemPoolAcceptWork {
+    MemPoolAcceptWork(const CTransactionRef& ptxIn, const CAmount& nAbsurdFeeIn, CValidationState& stateIn) :
+        ptx(ptxIn), hash(ptxIn->GetHash()), nAbsurdFee(nAbsurdFeeIn), state(stateIn) {}
+
+    const CTransactionRef ptx;
+    const uint256 hash;
+    const CAmount nAbsurdFee;
+    CValidationState& state;
+    bool fMissingInputs{false};
+
+    /**
+     * Outpoints which were not present in the coins cache, but were added as
+     * a result of validating the tx for mempool acceptance. This allows the
+     * caller to optionally remove the cache additions if the associated
+     * transaction ends up being rejected by the mempool.
+     */
+    std::vector<COutPoint> coins_to_uncache;
+
+    //! The coins spent by the transaction, detached from the mempool once fetched
+    CCoinsView dummy;
+    CCoinsViewCache view{&dummy};
+    LockPoints lp;
+    std::unique_ptr<CTxMemPoolEntry> entry;
+    CTxMemPool::setEntries setAncestors;
+    CAmount nFees{0};
+    PrecomputedTransactionData txdata;
+};
+} // namespace
+
+/** Calculate in-mempool ancestors, up to a limit. */
+static bool MemPoolCalculateAncestors(CTxMemPool& pool, MemPoolAcceptWork& work) EXCLUSIVE_LOCKS_REQUIRED(pool.cs)
 {
-    boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
-    const CTransaction& tx = *ptx;
-    const uint256 hash = tx.GetHash();
-    AssertLockHeld(cs_main);
-    LOCK(pool.cs); // mempool "read lock" (held through GetMainSignals().TransactionAddedToMempool())
-    if (pfMissingInputs) {
-        *pfMissingInputs = false;
+    work.setAncestors.clear();
+    size_t nLimitAncestors = gArgs.GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT);
+    size_t nLimitAncestorSize = gArgs.GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT)*1000;
+    size_t nLimitDescendants = gArgs.GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT);
+    size_t nLimitDescendantSize = gArgs.GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT)*1000;
+    std::string errString;
+    if (!pool.CalculateMemPoolAncestors(*work.entry, work.setAncestors, nLimitAncestors, nLimitAncestorSize, nLimitDescendants, nLimitDescendantSize, errString)) {
+        work.setAncestors.clear();
+        // If CalculateMemPoolAncestors fails second time, we want the original error string.
+        std::string dummy_err_string;
+        // If the new transaction is relatively small (up to 40k weight)
+        // and has at most one ancestor (ie ancestor limit of 2, including
+        // the new transaction), allow it if its parent has exactly the
+        // descendant limit descendants.
+        //
+        // This allows protocols which rely on distrusting counterparties
+        // being able to broadcast descendants of an unconfirmed transaction
+        // to be secure by simply only having two immediately-spendable
+        // outputs - one for each counterparty. For more info on the uses for
+        // this, see https://lists.linuxfoundation.org/pipermail/bitcoin-dev/2018-November/016518.html
+        if (work.entry->GetTxSize() >  EXTRA_DESCENDANT_TX_SIZE_LIMIT ||
+                !pool.CalculateMemPoolAncestors(*work.entry, work.setAncestors, 2, nLimitAncestorSize, nLimitDescendants + 1, nLimitDescendantSize + EXTRA_DESCENDANT_TX_SIZE_LIMIT, dummy_err_string)) {
+            return work.state.DoS(0, false, REJECT_NONSTANDARD, "too-long-mempool-chain", false, errString);
+        }
     }
+    return true;
+}
+
+/**
+ * All checks of a transaction except for its scripts, fetches the coins it
+ * spends into work.view and creates its mempool entry.
+ *
+ * @param[in] viewMemPool          Coins view of the chain tip and the mempool
+ * @param[in] pMempoolTokenNames   Issuance names in the mempool, collected from it when nullptr
+ */
+static bool MemPoolPreChecks(const CChainParams& chainparams, CTxMemPool& pool, CCoinsViewMemPool& viewMemPool, MemPoolAcceptWork& work,
+                             int64_t nAcceptTime, bool bypass_limits, const std::set<std::string>* pMempoolTokenNames) EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs)
+{
+    const CTransactionRef& ptx = work.ptx;
+    const CTransaction& tx = *ptx;
+    const uint256& hash = work.hash;
+    CValidationState& state = work.state;
 
     if (!CheckTransaction(tx, state))
         return false; // state filled in by CheckTransaction
@@ -583,7 +650,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
             return error("%s: CheckToken: token layer is not currently active", __func__);
         }
         std::string strError;
-        if (!CheckTokenMempool(pool, ptx, strError)) {
+        if (pMempoolTokenNames ? !CheckTokenMempool(ptx, *pMempoolTokenNames, strError) : !CheckTokenMempool(pool, ptx, strError)) {
             LogPrint(BCLog::TOKEN, "%s: CheckTokenMempool returned with %s\n", __func__, strError);
             return error("%s: CheckTokenMempool: %s", __func__, strError);
         }
@@ -623,214 +690,238 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         }
     }
 
-    {
-        CCoinsView dummy;
-        CCoinsViewCache view(&dummy);
-
-        LockPoints lp;
-        CCoinsViewCache& coins_cache = ::ChainstateActive().CoinsTip();
-        CCoinsViewMemPool viewMemPool(&coins_cache, pool);
-        view.SetBackend(viewMemPool);
-
-        // do all inputs exist?
-        for (const CTxIn& txin : tx.vin) {
-            if (!coins_cache.HaveCoinInCache(txin.prevout)) {
-                coins_to_uncache.push_back(txin.prevout);
-            }
+    CCoinsViewCache& view = work.view;
+    CCoinsViewCache& coins_cache = ::ChainstateActive().CoinsTip();
+    view.SetBackend(viewMemPool);
 
-            // Note: this call may add txin.prevout to the coins cache
-            // (pcoinsTip.cacheCoins) by way of FetchCoin(). It should be removed
-            // later (via coins_to_uncache) if this tx turns out to be invalid.
-            if (!view.HaveCoin(txin.prevout)) {
-                // Are inputs missing because we already have the tx?
-                for (size_t out = 0; out < tx.vout.size(); out++) {
-                    // Optimistically just do efficient check of cache for outputs
-                    if (coins_cache.HaveCoinInCache(COutPoint(hash, out))) {
-                        return state.Invalid(false, REJECT_DUPLICATE, "txn-already-known");
-                    }
-                }
-                // Otherwise assume this might be an orphan tx for which we just haven't seen parents yet
-                if (pfMissingInputs) {
-                    *pfMissingInputs = true;
+    // do all inputs exist?
+    for (const CTxIn& txin : tx.vin) {
+        if (!coins_cache.HaveCoinInCache(txin.prevout)) {
+            work.coins_to_uncache.push_back(txin.prevout);
+        }
+
+        // Note: this call may add txin.prevout to the coins cache
+        // (pcoinsTip.cacheCoins) by way of FetchCoin(). It should be removed
+        // later (via coins_to_uncache) if this tx turns out to be invalid.
+        if (!view.HaveCoin(txin.prevout)) {
+            // Are inputs missing because we already have the tx?
+            for (size_t out = 0; out < tx.vout.size(); out++) {
+                // Optimistically just do efficient check of cache for outputs
+                if (coins_cache.HaveCoinInCache(COutPoint(hash, out))) {
+                    return state.Invalid(false, REJECT_DUPLICATE, "txn-already-known");
                 }
-                return false; // fMissingInputs and !state.IsInvalid() is used to detect this condition, don't set state.Invalid()
             }
+            // Otherwise assume this might be an orphan tx for which we just haven't seen parents yet
+            work.fMissingInputs = true;
+            return false; // fMissingInputs and !state.IsInvalid() is used to detect this condition, don't set state.Invalid()
         }
+    }
 
-        // Bring the best block into scope
-        view.GetBestBlock();
+    // Bring the best block into scope
+    view.GetBestBlock();
 
-        // we have all inputs cached now, so switch back to dummy, so we don't need to keep lock on mempool
-        view.SetBackend(dummy);
+    // we have all inputs cached now, so switch back to dummy, so we don't need to keep lock on mempool
+    view.SetBackend(work.dummy);
 
-        // Only accept BIP68 sequence locked transactions that can be mined in the next
-        // block; we don't want our mempool filled up with transactions that can't
-        // be mined yet.
-        // Must keep pool.cs for this unless we change CheckSequenceLocks to take a
-        // CoinsViewCache instead of create its own
-        if (!CheckSequenceLocks(pool, tx, STANDARD_LOCKTIME_VERIFY_FLAGS, &lp))
-            return state.DoS(0, false, REJECT_NONSTANDARD, "non-BIP68-final");
+    // Only accept BIP68 sequence locked transactions that can be mined in the next
+    // block; we don't want our mempool filled up with transactions that can't
+    // be mined yet.
+    // Must keep pool.cs for this unless we change CheckSequenceLocks to take a
+    // CoinsViewCache instead of create its own
+    if (!CheckSequenceLocks(pool, tx, STANDARD_LOCKTIME_VERIFY_FLAGS, &work.lp))
+        return state.DoS(0, false, REJECT_NONSTANDARD, "non-BIP68-final");
 
-        CAmount nFees = 0;
-        if (!Consensus::CheckTxInputs(tx, state, view, GetSpendHeight(view), nFees)) {
-            return error("%s: Consensus::CheckTxInputs: %s, %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
-        }
+    CAmount& nFees = work.nFees;
+    if (!Consensus::CheckTxInputs(tx, state, view, GetSpendHeight(view), nFees)) {
+        return error("%s: Consensus::CheckTxInputs: %s, %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
+    }
 
-        // Check for non-standard pay-to-script-hash in inputs
-        if (fRequireStandard && !AreInputsStandard(tx, view))
-            return state.Invalid(false, REJECT_NONSTANDARD, "bad-txns-nonstandard-inputs");
+    // Check for non-standard pay-to-script-hash in inputs
+    if (fRequireStandard && !AreInputsStandard(tx, view))
+        return state.Invalid(false, REJECT_NONSTANDARD, "bad-txns-nonstandard-inputs");
 
-        unsigned int nSigOps = GetTransactionSigOpCount(tx, view, STANDARD_SCRIPT_VERIFY_FLAGS);
+    unsigned int nSigOps = GetTransactionSigOpCount(tx, view, STANDARD_SCRIPT_VERIFY_FLAGS);
 
-        // nModifiedFees includes any fee deltas from PrioritiseTransaction
-        CAmount nModifiedFees = nFees;
-        pool.ApplyDelta(hash, nModifiedFees);
+    // nModifiedFees includes any fee deltas from PrioritiseTransaction
+    CAmount nModifiedFees = nFees;
+    pool.ApplyDelta(hash, nModifiedFees);
 
-        // Keep track of transactions that spend a coinbase, which we re-scan
-        // during reorgs to ensure COINBASE_MATURITY is still met.
-        bool fSpendsCoinbase = false;
-        for (const CTxIn &txin : tx.vin) {
-            const Coin &coin = view.AccessCoin(txin.prevout);
-            if (coin.IsCoinBase() || coin.IsCoinStake()) {
-                fSpendsCoinbase = true;
-                break;
-            }
+    // Keep track of transactions that spend a coinbase, which we re-scan
+    // during reorgs to ensure COINBASE_MATURITY is still met.
+    bool fSpendsCoinbase = false;
+    for (const CTxIn &txin : tx.vin) {
+        const Coin &coin = view.AccessCoin(txin.prevout);
+        if (coin.IsCoinBase() || coin.IsCoinStake()) {
+            fSpendsCoinbase = true;
+            break;
         }
+    }
 
-        CTxMemPoolEntry entry(ptx, nFees, nAcceptTime, ::ChainActive().Height(),
-                              fSpendsCoinbase, nSigOps, lp);
-        unsigned int nSize = entry.GetTxSize();
-
-        // Check that the transaction doesn't have an excessive number of
-        // sigops, making it impossible to mine. Since the coinbase transaction
-        // itself can contain sigops MAX_STANDARD_TX_SIGOPS is less than
-        // MAX_BLOCK_SIGOPS; we still consider this an invalid rather than
-        // merely non-standard transaction.
-        if (nSigOps > MAX_STANDARD_TX_SIGOPS)
-            return state.DoS(0, false, REJECT_NONSTANDARD, "bad-txns-too-many-sigops", false,
-                strprintf("%d", nSigOps));
-
-        CAmount mempoolRejectFee = pool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
-        if (!bypass_limits && mempoolRejectFee > 0 && nModifiedFees < mempoolRejectFee) {
-            return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool min fee not met", false, strprintf("%d < %d", nModifiedFees, mempoolRejectFee));
-        }
-
-        //! token transfer doesnt incur fee restrictions
-        bool isTokenTx = ptx->HasTokenOutput();
-
-        // No transactions are allowed below minRelayTxFee except from disconnected blocks
-        if (!isTokenTx && !bypass_limits && nModifiedFees < ::minRelayTxFee.GetFee(nSize)) {
-            return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "min relay fee not met", false, strprintf("%d < %d", nModifiedFees, ::minRelayTxFee.GetFee(nSize)));
-        }
-
-        if (!isTokenTx && nAbsurdFee && nFees > nAbsurdFee)
-            return state.Invalid(false,
-                REJECT_HIGHFEE, "absurdly-high-fee",
-                strprintf("%d > %d", nFees, nAbsurdFee));
-
-        // Calculate in-mempool ancestors, up to a limit.
-        CTxMemPool::setEntries setAncestors;
-        size_t nLimitAncestors = gArgs.GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT);
-        size_t nLimitAncestorSize = gArgs.GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT)*1000;
-        size_t nLimitDescendants = gArgs.GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT);
-        size_t nLimitDescendantSize = gArgs.GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT)*1000;
-        std::string errString;
-        if (!pool.CalculateMemPoolAncestors(entry, setAncestors, nLimitAncestors, nLimitAncestorSize, nLimitDescendants, nLimitDescendantSize, errString)) {
-            setAncestors.clear();
-            // If CalculateMemPoolAncestors fails second time, we want the original error string.
-            std::string dummy_err_string;
-            // If the new transaction is relatively small (up to 40k weight)
-            // and has at most one ancestor (ie ancestor limit of 2, including
-            // the new transaction), allow it if its parent has exactly the
-            // descendant limit descendants.
-            //
-            // This allows protocols which rely on distrusting counterparties
-            // being able to broadcast descendants of an unconfirmed transaction
-            // to be secure by simply only having two immediately-spendable
-            // outputs - one for each counterparty. For more info on the uses for
-            // this, see https://lists.linuxfoundation.org/pipermail/bitcoin-dev/2018-November/016518.html
-            if (nSize >  EXTRA_DESCENDANT_TX_SIZE_LIMIT ||
-                    !pool.CalculateMemPoolAncestors(entry, setAncestors, 2, nLimitAncestorSize, nLimitDescendants + 1, nLimitDescendantSize + EXTRA_DESCENDANT_TX_SIZE_LIMIT, dummy_err_string)) {
-                return state.DoS(0, false, REJECT_NONSTANDARD, "too-long-mempool-chain", false, errString);
-            }
-        }
+    work.entry = MakeUnique<CTxMemPoolEntry>(ptx, nFees, nAcceptTime, ::ChainActive().Height(),
+                                             fSpendsCoinbase, nSigOps, work.lp);
+    unsigned int nSize = work.entry->GetTxSize();
 
-        // check special TXs after all the other checks. If we'd do this before the other checks, we might end up
-        // DoS scoring a node for non-critical errors, e.g. duplicate keys because a TX is received that was already
-        // mined
-        // NOTE: we use UTXO here and do NOT allow mempool txes as masternode collaterals
-        if (!CheckSpecialTx(tx, ::ChainActive().Tip(), state, ::ChainstateActive().CoinsTip(), true))
-            return false;
+    // Check that the transaction doesn't have an excessive number of
+    // sigops, making it impossible to mine. Since the coinbase transaction
+    // itself can contain sigops MAX_STANDARD_TX_SIGOPS is less than
+    // MAX_BLOCK_SIGOPS; we still consider this an invalid rather than
+    // merely non-standard transaction.
+    if (nSigOps > MAX_STANDARD_TX_SIGOPS)
+        return state.DoS(0, false, REJECT_NONSTANDARD, "bad-txns-too-many-sigops", false,
+            strprintf("%d", nSigOps));
 
-        if (pool.existsProviderTxConflict(tx)) {
-            return state.DoS(0, false, REJECT_DUPLICATE, "protx-dup");
-        }
+    CAmount mempoolRejectFee = pool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
+    if (!bypass_limits && mempoolRejectFee > 0 && nModifiedFees < mempoolRejectFee) {
+        return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool min fee not met", false, strprintf("%d < %d", nModifiedFees, mempoolRejectFee));
+    }
 
-        constexpr unsigned int scriptVerifyFlags = STANDARD_SCRIPT_VERIFY_FLAGS;
+    //! token transfer doesnt incur fee restrictions
+    bool isTokenTx = ptx->HasTokenOutput();
 
-        // Check against previous transactions
-        // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-        PrecomputedTransactionData txdata;
-        if (!CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata))
-            return false; // state filled in by CheckInputs
+    // No transactions are allowed below minRelayTxFee except from disconnected blocks
+    if (!isTokenTx && !bypass_limits && nModifiedFees < ::minRelayTxFee.GetFee(nSize)) {
+        return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "min relay fee not met", false, strprintf("%d < %d", nModifiedFees, ::minRelayTxFee.GetFee(nSize)));
+    }
 
-        // Check again against the current block tip's script verification
-        // flags to cache our script execution flags. This is, of course,
-        // useless if the next block has different script flags from the
-        // previous one, but because the cache tracks script flags for us it
-        // will auto-invalidate and we'll just have a few blocks of extra
-        // misses on soft-fork activation.
-        //
-        // This is also useful in case of bugs in the standard flags that cause
-        // transactions to pass as valid when they're actually invalid. For
-        // instance the STRICTENC flag was incorrectly allowing certain
-        // CHECKSIG NOT scripts to pass, even though they were invalid.
-        //
-        // There is a similar check in CreateNewBlock() to prevent creating
-        // invalid blocks (using TestBlockValidity), however allowing such
-        // transactions into the mempool can be exploited as a DoS attack.
-        unsigned int currentBlockScriptVerifyFlags = GetBlockScriptFlags(::ChainActive().Tip(), chainparams.GetConsensus());
-        if (!CheckInputsFromMempoolAndCache(tx, state, view, pool, currentBlockScriptVerifyFlags, true, txdata)) {
-            return error("%s: BUG! PLEASE REPORT THIS! CheckInputs failed against latest-block but not STANDARD flags %s, %s",
-                    __func__, hash.ToString(), FormatStateMessage(state));
-        }
+    if (!isTokenTx && work.nAbsurdFee && nFees > work.nAbsurdFee)
+        return state.Invalid(false,
+            REJECT_HIGHFEE, "absurdly-high-fee",
+            strprintf("%d > %d", nFees, work.nAbsurdFee));
 
-        if (test_accept) {
-            // Tx was accepted, but not added
-            return true;
-        }
+    if (!MemPoolCalculateAncestors(pool, work)) {
+        return false;
+    }
 
-        // This transaction should only count for fee estimation if:
-        // - it's not being re-added during a reorg which bypasses typical mempool fee limits
-        // - the node is not behind
-        // - the transaction is not dependent on any other transactions in the mempool
-        // - the transaction is not a zero fee transaction
-        bool validForFeeEstimation = (nFees !=0) && !bypass_limits && IsCurrentForFeeEstimation() && pool.HasNoInputsOf(tx);
+    // check special TXs after all the other checks. If we'd do this before the other checks, we might end up
+    // DoS scoring a node for non-critical errors, e.g. duplicate keys because a TX is received that was already
+    // mined
+    // NOTE: we use UTXO here and do NOT allow mempool txes as masternode collaterals
+    if (!CheckSpecialTx(tx, ::ChainActive().Tip(), state, ::ChainstateActive().CoinsTip(), true))
+        return false;
 
-        // Store transaction in memory
-        pool.addUnchecked(entry, setAncestors, validForFeeEstimation);
-        CAmount nValueOut = tx.GetValueOut();
-        statsClient.count("transactions.sizeBytes", nSize, 1.0f);
-        statsClient.count("transactions.fees", nFees, 1.0f);
-        statsClient.count("transactions.inputValue", nValueOut - nFees, 1.0f);
-        statsClient.count("transactions.outputValue", nValueOut, 1.0f);
-        statsClient.count("transactions.sigOps", nSigOps, 1.0f);
+    if (pool.existsProviderTxConflict(tx)) {
+        return state.DoS(0, false, REJECT_DUPLICATE, "protx-dup");
+    }
 
-        // Add memory address index
-        if (fAddressIndex) {
-            pool.addAddressIndex(entry, view);
-        }
+    return true;
+}
 
-        // Add memory spent index
-        if (fSpentIndex) {
-            pool.addSpentIndex(entry, view);
-        }
+/** Check the scripts of a transaction against the standard (policy) script flags. */
+static bool MemPoolPolicyScriptChecks(MemPoolAcceptWork& work) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    constexpr unsigned int scriptVerifyFlags = STANDARD_SCRIPT_VERIFY_FLAGS;
 
-        if (!bypass_limits) {
-            LimitMempoolSize(pool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
-            if (!pool.exists(hash))
-                return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
-        }
+    // Check against previous transactions
+    // This is done last to help prevent CPU exhaustion denial-of-service attacks.
+    return CheckInputs(*work.ptx, work.state, work.view, true, scriptVerifyFlags, true, false, work.txdata); // state filled in by CheckInputs
+}
+
+/** Check the scripts of a transaction which passed MemPoolPolicyScriptChecks against the current block flags. */
+static bool MemPoolConsensusScriptChecks(const CChainParams& chainparams, CTxMemPool& pool, MemPoolAcceptWork& work) EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs)
+{
+    // Check again against the current block tip's script verification
+    // flags to cache our script execution flags. This is, of course,
+    // useless if the next block has different script flags from the
+    // previous one, but because the cache tracks script flags for us it
+    // will auto-invalidate and we'll just have a few blocks of extra
+    // misses on soft-fork activation.
+    //
+    // This is also useful in case of bugs in the standard flags that cause
+    // transactions to pass as valid when they're actually invalid. For
+    // instance the STRICTENC flag was incorrectly allowing certain
+    // CHECKSIG NOT scripts to pass, even though they were invalid.
+    //
+    // There is a similar check in CreateNewBlock() to prevent creating
+    // invalid blocks (using TestBlockValidity), however allowing such
+    // transactions into the mempool can be exploited as a DoS attack.
+    unsigned int currentBlockScriptVerifyFlags = GetBlockScriptFlags(::ChainActive().Tip(), chainparams.GetConsensus());
+    if (!CheckInputsFromMempoolAndCache(*work.ptx, work.state, work.view, pool, currentBlockScriptVerifyFlags, true, work.txdata)) {
+        return error("%s: BUG! PLEASE REPORT THIS! CheckInputs failed against latest-block but not STANDARD flags %s, %s",
+                __func__, work.hash.ToString(), FormatStateMessage(work.state));
+    }
+    return true;
+}
+
+/**
+ * Store a fully checked transaction in the mempool. The caller trims the
+ * mempool afterwards, which may evict the transaction again.
+ */
+static void MemPoolFinalize(CTxMemPool& pool, MemPoolAcceptWork& work, bool bypass_limits) EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs)
+{
+    const CTransaction& tx = *work.ptx;
+    const CTxMemPoolEntry& entry = *work.entry;
+    const CAmount nFees = work.nFees;
+
+    // This transaction should only count for fee estimation if:
+    // - it's not being re-added during a reorg which bypasses typical mempool fee limits
+    // - the node is not behind
+    // - the transaction is not dependent on any other transactions in the mempool
+    // - the transaction is not a zero fee transaction
+    bool validForFeeEstimation = (nFees !=0) && !bypass_limits && IsCurrentForFeeEstimation() && pool.HasNoInputsOf(tx);
+
+    // Store transaction in memory
+    pool.addUnchecked(entry, work.setAncestors, validForFeeEstimation);
+    CAmount nValueOut = tx.GetValueOut();
+    statsClient.count("transactions.sizeBytes", entry.GetTxSize(), 1.0f);
+    statsClient.count("transactions.fees", nFees, 1.0f);
+    statsClient.count("transactions.inputValue", nValueOut - nFees, 1.0f);
+    statsClient.count("transactions.outputValue", nValueOut, 1.0f);
+    statsClient.count("transactions.sigOps", entry.GetSigOpCount(), 1.0f);
+    TRACE4(mempool, added,
+        tx.GetHash().data(),
+        (uint64_t)entry.GetTxSize(),
+        nFees,
+        entry.GetSigOpCount());
+
+    // Add memory address index
+    if (fAddressIndex) {
+        pool.addAddressIndex(entry, work.view);
+    }
+
+    // Add memory spent index
+    if (fSpentIndex) {
+        pool.addSpentIndex(entry, work.view);
+    }
+}
+
+static void MemPoolAcceptedStats(const CTransaction& tx)
+{
+    statsClient.inc("transactions.accepted", 1.0f);
+    statsClient.count("transactions.inputs", tx.vin.size(), 1.0f);
+    statsClient.count("transactions.outputs", tx.vout.size(), 1.0f);
+}
+
+static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx,
+                                     bool* pfMissingInputs, int64_t nAcceptTime, bool bypass_limits,
+                                     const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache, bool test_accept) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+    AssertLockHeld(cs_main);
+    LOCK(pool.cs); // mempool "read lock" (held through GetMainSignals().TransactionAddedToMempool())
+
+    MemPoolAcceptWork work(ptx, nAbsurdFee, state);
+    CCoinsViewMemPool viewMemPool(&::ChainstateActive().CoinsTip(), pool);
+    const bool fValid = MemPoolPreChecks(chainparams, pool, viewMemPool, work, nAcceptTime, bypass_limits, nullptr) &&
+                        MemPoolPolicyScriptChecks(work) &&
+                        MemPoolConsensusScriptChecks(chainparams, pool, work);
+    coins_to_uncache = std::move(work.coins_to_uncache);
+    if (pfMissingInputs) {
+        *pfMissingInputs = work.fMissingInputs;
+    }
+    if (!fValid) {
+        return false;
+    }
+
+    if (test_accept) {
+        // Tx was accepted, but not added
+        return true;
+    }
+
+    MemPoolFinalize(pool, work, bypass_limits);
+    if (!bypass_limits) {
+        LimitMempoolSize(pool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+        if (!pool.exists(work.hash))
+            return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
     }
 
     GetMainSignals().TransactionAddedToMempool(ptx, nAcceptTime);
@@ -838,29 +929,36 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
     boost::posix_time::ptime finish = boost::posix_time::microsec_clock::local_time();
     boost::posix_time::time_duration diff = finish - start;
     statsClient.timing("AcceptToMemoryPool_ms", diff.total_milliseconds(), 1.0f);
-    statsClient.inc("transactions.accepted", 1.0f);
-    statsClient.count("transactions.inputs", tx.vin.size(), 1.0f);
-    statsClient.count("transactions.outputs", tx.vout.size(), 1.0f);
+    MemPoolAcceptedStats(*ptx);
 
     return true;
 }
 
+/** Remove coins that were not present in the coins cache before validating a rejected transaction */
+static void UncacheRejectedCoins(const std::vector<COutPoint>& coins_to_uncache) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    // this is to prevent memory DoS in case we receive a large number of
+    // invalid transactions that attempt to overrun the in-memory coins cache
+    // (`CCoinsViewCache::cacheCoins`).
+    for (const COutPoint& hashTx : coins_to_uncache)
+        ::ChainstateActive().CoinsTip().Uncache(hashTx);
+}
+
 /** (try to) add transaction to memory pool with a specified acceptance time **/
 static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPool& pool, CValidationState &state, const CTransactionRef &tx,
                         bool* pfMissingInputs, int64_t nAcceptTime, bool bypass_limits,
                         const CAmount nAbsurdFee, bool test_accept) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     std::vector<COutPoint> coins_to_uncache;
+    TRACE1(validation, mempool_accept_start, tx->GetHash().data());
     bool res = AcceptToMemoryPoolWorker(chainparams, pool, state, tx, pfMissingInputs, nAcceptTime, bypass_limits, nAbsurdFee, coins_to_uncache, test_accept);
+    TRACE2(validation, mempool_accept_done, tx->GetHash().data(), res);
     if (!res || test_accept) {
-        if(!res) LogPrint(BCLog::MEMPOOL, "%s: %s %s (%s)\n", __func__, tx->GetHash().ToString(), state.GetRejectReason(), state.GetDebugMessage());
-           // Remove coins that were not present in the coins cache before calling ATMPW;
-           // this is to prevent memory DoS in case we receive a large number of
-           // invalid transactions that attempt to overrun the in-memory coins cache
-           // (`CCoinsViewCache::cacheCoins`).
-
-        for (const COutPoint& hashTx : coins_to_uncache)
-            ::ChainstateActive().CoinsTip().Uncache(hashTx);
+        if (!res) {
+            LogPrint(BCLog::MEMPOOL, "%s: %s %s (%s)\n", __func__, tx->GetHash().ToString(), state.GetRejectReason(), state.GetDebugMessage());
+            TRACE2(mempool, rejected, tx->GetHash().data(), state.GetRejectReason().c_str());
+        }
+        UncacheRejectedCoins(coins_to_uncache);
     }
     // After we've (potentially) uncached entries, ensure our coins cache is still within its size limits
     CValidationState stateDummy;
@@ -875,6 +973,174 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, pfMissingInputs, GetTime(), bypass_limits, nAbsurdFee, test_accept);
 }
 
+std::vector<MempoolAcceptResult> AcceptToMemoryPoolBatch(CTxMemPool& pool, const std::vector<CTransactionRef>& txs,
+                                                         const std::vector<CAmount>& vAbsurdFee, bool bypass_limits,
+                                                         const std::vector<int64_t>& vAcceptTime)
+{
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+    AssertLockHeld(cs_main);
+    assert(vAbsurdFee.empty() || vAbsurdFee.size() == txs.size());
+    assert(vAcceptTime.empty() || vAcceptTime.size() == txs.size());
+    const CChainParams& chainparams = Params();
+    const int64_t nNow = GetTime();
+    auto acceptTime = [&](size_t nIndex) { return vAcceptTime.empty() ? nNow : vAcceptTime[nIndex]; };
+
+    std::vector<MempoolAcceptResult> results(txs.size());
+    std::vector<std::unique_ptr<MemPoolAcceptWork>> vRejected;
+    {
+    LOCK(pool.cs); // held through GetMainSignals().TransactionAddedToMempool() of the whole batch
+
+    CCoinsViewMemPool viewMemPool(&::ChainstateActive().CoinsTip(), pool);
+    // only collected once the first token transaction shows up
+    std::optional<std::set<std::string>> setMempoolTokenNames;
+
+    // Transactions which passed MemPoolPreChecks but are not in the mempool
+    // yet. None of them spends an output of, or conflicts with, another one.
+    std::vector<std::pair<size_t, std::unique_ptr<MemPoolAcceptWork>>> vGroup;
+    std::set<uint256> setGroupHashes;
+    std::set<COutPoint> setGroupSpent;
+
+    auto reject = [&](size_t nIndex, std::unique_ptr<MemPoolAcceptWork> work) {
+        results[nIndex].fMissingInputs = work->fMissingInputs;
+        vRejected.push_back(std::move(work));
+    };
+
+    auto finishGroup = [&]() EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs) {
+        if (vGroup.empty()) {
+            return;
+        }
+
+        // Run the policy script checks of the whole group on the script check
+        // workers. This also fills the signature cache, so the consensus flags
+        // check below and the per transaction fallback are cheap.
+        bool fGroupValid = false;
+        // transactions CheckInputs already failed, with the reject reason in their state
+        std::vector<bool> vPolicyFailed(vGroup.size(), false);
+        if (g_parallel_script_checks && vGroup.size() > 1) {
+            CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+            for (size_t j = 0; j < vGroup.size(); j++) {
+                MemPoolAcceptWork& work = *vGroup[j].second;
+                std::vector<CScriptCheck> vChecks;
+                if (!CheckInputs(*work.ptx, work.state, work.view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true, false, work.txdata, &vChecks)) {
+                    vPolicyFailed[j] = true;
+                    continue;
+                }
+                control.Add(vChecks);
+            }
+            fGroupValid = control.Wait();
+        }
+
+        bool fAdded = false;
+        for (size_t j = 0; j < vGroup.size(); j++) {
+            auto& item = vGroup[j];
+            MemPoolAcceptWork& work = *item.second;
+            // A failure in the group doesn't tell which transaction failed,
+            // find it (and the reject reason) by checking one by one.
+            if (vPolicyFailed[j] ||
+                (!fGroupValid && !MemPoolPolicyScriptChecks(work)) ||
+                !MemPoolConsensusScriptChecks(chainparams, pool, work) ||
+                // earlier transactions of the group may have used up the descendant limits of an ancestor
+                (fAdded && !MemPoolCalculateAncestors(pool, work))) {
+                reject(item.first, std::move(item.second));
+                continue;
+            }
+            MemPoolFinalize(pool, work, bypass_limits);
+            results[item.first].fAccepted = true;
+            fAdded = true;
+            if (setMempoolTokenNames && work.ptx->HasTokenOutput()) {
+                std::string strError;
+                GetTokenIssuanceNames(*work.ptx, *setMempoolTokenNames, strError);
+            }
+        }
+
+        if (fAdded && !bypass_limits) {
+            const size_t nPoolSize = pool.size();
+            LimitMempoolSize(pool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+            // evicted issuances free their names again, collect them anew for the next token transaction
+            if (pool.size() < nPoolSize) {
+                setMempoolTokenNames.reset();
+            }
+        }
+        for (auto& item : vGroup) {
+            if (!item.second) {
+                continue;
+            }
+            if (!pool.exists(item.second->hash)) {
+                item.second->state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
+                results[item.first].fAccepted = false;
+                reject(item.first, std::move(item.second));
+                continue;
+            }
+            GetMainSignals().TransactionAddedToMempool(item.second->ptx, acceptTime(item.first));
+            MemPoolAcceptedStats(*item.second->ptx);
+        }
+
+        vGroup.clear();
+        setGroupHashes.clear();
+        setGroupSpent.clear();
+    };
+
+    for (size_t i = 0; i < txs.size(); i++) {
+        const CTransactionRef& ptx = txs[i];
+
+        // Special and token transactions are checked against other mempool
+        // transactions of their kind, so they are added on their own. A
+        // transaction spending from or conflicting with the group has to wait
+        // for the group to be added first.
+        const bool fAlone = ptx->nType != TRANSACTION_NORMAL || ptx->HasTokenOutput();
+        bool fDependsOnGroup = false;
+        for (const CTxIn& txin : ptx->vin) {
+            if (setGroupHashes.count(txin.prevout.hash) || setGroupSpent.count(txin.prevout)) {
+                fDependsOnGroup = true;
+                break;
+            }
+        }
+        if (fAlone || fDependsOnGroup) {
+            finishGroup();
+        }
+
+        auto work = MakeUnique<MemPoolAcceptWork>(ptx, vAbsurdFee.empty() ? 0 : vAbsurdFee[i], results[i].state);
+        if (ptx->HasTokenOutput() && !setMempoolTokenNames) {
+            std::string strError;
+            std::set<std::string> setNames;
+            if (GetMempoolTokenIssuanceNames(pool, setNames, strError)) {
+                setMempoolTokenNames = std::move(setNames);
+            }
+        }
+        if (!MemPoolPreChecks(chainparams, pool, viewMemPool, *work, acceptTime(i), bypass_limits, setMempoolTokenNames ? &*setMempoolTokenNames : nullptr)) {
+            reject(i, std::move(work));
+            continue;
+        }
+
+        setGroupHashes.insert(work->hash);
+        for (const CTxIn& txin : ptx->vin) {
+            setGroupSpent.insert(txin.prevout);
+        }
+        vGroup.emplace_back(i, std::move(work));
+        if (fAlone) {
+            finishGroup();
+        }
+    }
+    finishGroup();
+    }
+
+    for (const auto& work : vRejected) {
+        LogPrint(BCLog::MEMPOOL, "%s: %s %s (%s)\n", __func__, work->hash.ToString(), work->state.GetRejectReason(), work->state.GetDebugMessage());
+        TRACE2(mempool, rejected, work->hash.data(), work->state.GetRejectReason().c_str());
+        UncacheRejectedCoins(work->coins_to_uncache);
+    }
+    // After we've (potentially) uncached entries, ensure our coins cache is still within its size limits
+    CValidationState stateDummy;
+    ::ChainstateActive().FlushStateToDisk(chainparams, stateDummy, FlushStateMode::PERIODIC);
+
+    boost::posix_time::ptime finish = boost::posix_time::microsec_clock::local_time();
+    boost::posix_time::time_duration diff = finish - start;
+    statsClient.timing("AcceptToMemoryPoolBatch_ms", diff.total_milliseconds(), 1.0f);
+    statsClient.count("transactions.batchSize", txs.size(), 1.0f);
+
+    return results;
+}
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes)
 {
     if (!fTimestampIndex)
@@ -1791,8 +2057,6 @@ static bool WriteUndoDataForBlock(const CBlockUndo& blockundo, CValidationState&
     return true;
 }
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
-
 void StartScriptCheckWorkerThreads(int threads_num)
 {
     scriptcheckqueue.StartWorkerThreads(threads_num);
@@ -2411,6 +2675,26 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     int64_t nTime7 = GetTimeMicros(); nTimeCallbacks += nTime7 - nTime6;
     LogPrint(BCLog::BENCHMARK, "    - Callbacks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime7 - nTime6), nTimeCallbacks * MICRO, nTimeCallbacks * MILLI / nBlocksTotal);
 
+    // Stage durations in microseconds, matching the BCLog::BENCHMARK timers
+    // above except that verify excludes the connect stage
+    TRACE9(validation, connect_block_stages,
+        pindex->phashBlock->data(),
+        pindex->nHeight,
+        nTime1 - nTimeStart, // sanity checks
+        nTime2 - nTime1,     // fork checks
+        nTime3 - nTime2,     // connect transactions
+        nTime4 - nTime3,     // verify inputs
+        nTime5 - nTime4,     // datos specific
+        nTime6 - nTime5,     // index writing
+        nTime7 - nTime6);    // callbacks
+    TRACE6(validation, block_connected,
+        pindex->phashBlock->data(),
+        pindex->nHeight,
+        (uint64_t)block.vtx.size(),
+        nInputs,
+        nSigOps,
+        nTime7 - nTimeStart);
+
     // score all nodes
     const CNetworkProof& in = block.netProof;
     scoreManager.AddProof(in);
@@ -2827,6 +3111,8 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
         std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
         if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus()))
             return AbortNode(state, "Failed to read block");
+        // ReadBlockFromDisk checked the hash against pindexNew already
+        pblockNew->hashMemo.Set(pindexNew->GetBlockHash());
         pthisBlock = pblockNew;
     } else {
         pthisBlock = pblock;
@@ -2870,6 +3156,14 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
     LogPrint(BCLog::BENCHMARK, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
     LogPrint(BCLog::BENCHMARK, "- Connect block: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime1) * MILLI, nTimeTotal * MICRO, nTimeTotal * MILLI / nBlocksTotal);
+    TRACE7(validation, connect_tip,
+        pindexNew->phashBlock->data(),
+        pindexNew->nHeight,
+        nTime2 - nTime1, // load block from disk
+        nTime3 - nTime2, // ConnectBlock
+        nTime4 - nTime3, // flush
+        nTime5 - nTime4, // writing chainstate
+        nTime6 - nTime5); // postprocess
 
     boost::posix_time::ptime finish = boost::posix_time::microsec_clock::local_time();
     boost::posix_time::time_duration diff = finish - start;
@@ -5038,6 +5332,7 @@ void LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFi
                 std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
                 CBlock& block = *pblock;
                 blkdat >> block;
+                block.Memoize();
                 nRewind = blkdat.GetPos();
 
                 uint256 hash = block.GetHash();
@@ -5335,6 +5630,8 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::D
 }
 
 static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+//! Transactions from mempool.dat accepted per cs_main acquisition
+static const size_t MEMPOOL_LOAD_BATCH_SIZE = 1000;
 
 bool LoadMempool(CTxMemPool& pool)
 {
@@ -5352,6 +5649,41 @@ bool LoadMempool(CTxMemPool& pool)
     int64_t failed = 0;
     int64_t already_there = 0;
     int64_t nNow = GetTime();
+    int64_t nStart = GetTimeMillis();
+
+    // The dump is in dependency order, so every batch only spends from the
+    // mempool and from earlier transactions of the same batch.
+    std::vector<CTransactionRef> vBatch;
+    std::vector<int64_t> vBatchTime;
+    auto acceptBatch = [&]() {
+        if (vBatch.empty()) {
+            return;
+        }
+        std::vector<MempoolAcceptResult> results;
+        {
+            // cs_main is released in between batches, so the node keeps
+            // serving peers and RPC while the rest is still loading
+            LOCK(cs_main);
+            results = AcceptToMemoryPoolBatch(pool, vBatch, {} /* vAbsurdFee */, false /* bypass_limits */, vBatchTime);
+        }
+        for (size_t i = 0; i < vBatch.size(); i++) {
+            if (results[i].fAccepted) {
+                ++count;
+            } else {
+                // mempool may contain the transaction already, e.g. from
+                // wallet(s) having loaded it while we were processing
+                // mempool transactions; consider these as valid, instead of
+                // failed, but mark them as 'already there'
+                if (pool.exists(vBatch[i]->GetHash())) {
+                    ++already_there;
+                } else {
+                    ++failed;
+                }
+            }
+        }
+        vBatch.clear();
+        vBatchTime.clear();
+    };
 
     try {
         uint64_t version;
@@ -5374,30 +5706,19 @@ bool LoadMempool(CTxMemPool& pool)
             if (amountdelta) {
                 pool.PrioritiseTransaction(tx->GetHash(), amountdelta);
             }
-            CValidationState state;
             if (nTime + nExpiryTimeout > nNow) {
-                LOCK(cs_main);
-                AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, nullptr /* pfMissingInputs */, nTime,
-                                           false /* bypass_limits */, 0 /* nAbsurdFee */, false /* test_accept */);
-                if (state.IsValid()) {
-                    ++count;
-                } else {
-                    // mempool may contain the transaction already, e.g. from
-                    // wallet(s) having loaded it while we were processing
-                    // mempool transactions; consider these as valid, instead of
-                    // failed, but mark them as 'already there'
-                    if (pool.exists(tx->GetHash())) {
-                        ++already_there;
-                    } else {
-                        ++failed;
-                    }
-                }
+                vBatch.push_back(std::move(tx));
+                vBatchTime.push_back(nTime);
             } else {
                 ++expired;
             }
+            if (vBatch.size() >= MEMPOOL_LOAD_BATCH_SIZE) {
+                acceptBatch();
+            }
             if (ShutdownRequested())
                 return false;
         }
+        acceptBatch();
         std::map<uint256, CAmount> mapDeltas;
         file >> mapDeltas;
 
@@ -5409,7 +5730,7 @@ bool LoadMempool(CTxMemPool& pool)
         return false;
     }
 
-    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there\n", count, failed, expired, already_there);
+    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there (%dms)\n", count, failed, expired, already_there, GetTimeMillis() - nStart);
     return true;
 }
 
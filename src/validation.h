@@ -13,6 +13,7 @@
 
 #include <amount.h>
 #include <coins.h>
+#include <consensus/validation.h>
 #include <crypto/common.h> // for ReadLE64
 #include <fs.h>
 #include <policy/feerate.h>
@@ -258,6 +259,29 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
                         bool* pfMissingInputs, bool bypass_limits,
                         const CAmount nAbsurdFee, bool test_accept=false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/** Outcome of AcceptToMemoryPoolBatch for one transaction */
+struct MempoolAcceptResult {
+    CValidationState state;
+    bool fAccepted{false};
+    bool fMissingInputs{false};
+};
+
+/**
+ * (try to) add a batch of transactions to memory pool, with the same checks as
+ * AcceptToMemoryPool. Transactions which neither spend from nor conflict with
+ * each other are checked together under one mempool lock: their script checks
+ * run in parallel on the script check workers and the mempool is trimmed once
+ * per group. Transactions spending from earlier ones in the batch are accepted
+ * after them.
+ *
+ * @param[in] vAbsurdFee  Empty, or the absurd fee limit of each transaction
+ * @param[in] vAcceptTime Empty, or the mempool entry time of each transaction (now if empty)
+ * @return The outcome for each transaction, in the order of txs
+ */
+std::vector<MempoolAcceptResult> AcceptToMemoryPoolBatch(CTxMemPool& pool, const std::vector<CTransactionRef>& txs,
+                                                         const std::vector<CAmount>& vAbsurdFee, bool bypass_limits,
+                                                         const std::vector<int64_t>& vAcceptTime = {}) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 bool GetUTXOCoin(const COutPoint& outpoint, Coin& coin);
 int GetUTXOHeight(const COutPoint& outpoint);
 int GetUTXOConfirmations(const COutPoint& outpoint);
@@ -87,11 +87,11 @@ void StartWallets(CScheduler& scheduler)
     }
 
     // Schedule periodic wallet flushes and tx rebroadcasts
-    scheduler.scheduleEvery(MaybeCompactWalletDB, 500);
-    scheduler.scheduleEvery(MaybeResendWalletTxs, 1000);
+    scheduler.scheduleEvery(MaybeCompactWalletDB, 500, CScheduler::Priority::LOW, "walletflush");
+    scheduler.scheduleEvery(MaybeResendWalletTxs, 1000, CScheduler::Priority::NORMAL, "walletresend");
 
     if (!fMasternodeMode && CCoinJoinClientOptions::IsEnabled()) {
-        scheduler.scheduleEvery(std::bind(&DoCoinJoinMaintenance, std::ref(*g_connman)), 1 * 1000);
+        scheduler.scheduleEvery(std::bind(&DoCoinJoinMaintenance, std::ref(*g_connman)), 1 * 1000, CScheduler::Priority::NORMAL, "coinjoin");
     }
 }
 
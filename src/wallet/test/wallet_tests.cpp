@@ -9,11 +9,16 @@
 #include <stdint.h>
 #include <vector>
 
+#include <coinjoin/coinjoin.h>
+#include <index/blockfilterindex.h>
+#include <index/txindex.h>
 #include <interfaces/chain.h>
 #include <key_io.h>
 #include <policy/policy.h>
 #include <rpc/server.h>
 #include <test/util/setup_common.h>
+#include <token/issuances.h>
+#include <token/token.h>
 #include <util/translation.h>
 #include <validation.h>
 #include <wallet/coincontrol.h>
@@ -114,6 +119,86 @@ BOOST_FIXTURE_TEST_CASE(scan_for_wallet_transactions, TestChain100Setup)
     }
 }
 
+static CScript TokenScript(const std::string& tokenName, const CScript& owner)
+{
+    CScript script;
+    uint64_t id = 1000;
+    std::string name = tokenName;
+    CScript scriptPubKey = owner;
+    BuildTokenScript(script, CToken::CURRENT_VERSION, CToken::ISSUANCE, id, name, scriptPubKey);
+    return script;
+}
+
+BOOST_FIXTURE_TEST_CASE(rescan_block_filter, TestChain100Setup)
+{
+    // CheckToken looks up the inputs of an issuance in the transaction index
+    g_txindex = MakeUnique<TxIndex>(1 << 20, true /* f_memory */);
+    g_txindex->Start();
+    const int64_t txindex_start = GetTimeMillis();
+    while (!g_txindex->BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(txindex_start + 10 * 1000 > GetTimeMillis());
+        UninterruptibleSleep(std::chrono::milliseconds{100});
+    }
+
+    // blocks paying elsewhere, which the block filter lets the rescan skip
+    for (int i = 0; i < 5; ++i) {
+        CreateAndProcessBlock({}, CScript() << OP_TRUE);
+    }
+    CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+
+    // a token issued to one of our keys, in a block paying elsewhere
+    CMutableTransaction issuance;
+    issuance.vin.emplace_back(m_coinbase_txns[0]->GetHash(), 0);
+    issuance.vout.emplace_back(1 * COIN, TokenScript("RESCANTOKEN", GetScriptForDestination(coinbaseKey.GetPubKey().GetID())));
+    issuance.vout.emplace_back(m_coinbase_txns[0]->vout[0].nValue - 2 * COIN, CScript() << OP_TRUE);
+    {
+        std::vector<unsigned char> vchSig;
+        const uint256 hash = SignatureHash(m_coinbase_txns[0]->vout[0].scriptPubKey, issuance, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        issuance.vin[0].scriptSig << vchSig;
+    }
+    const CBlock token_block = CreateAndProcessBlock({issuance}, CScript() << OP_TRUE);
+    BOOST_REQUIRE_EQUAL(WITH_LOCK(cs_main, return ::ChainActive().Tip()->GetBlockHash()), token_block.GetHash());
+
+    BOOST_REQUIRE(InitBlockFilterIndex(BlockFilterType::BASIC_FILTER, 1 << 20, true /* f_memory */));
+    BlockFilterIndex* filter_index = GetBlockFilterIndex(BlockFilterType::BASIC_FILTER);
+    filter_index->Start();
+    const int64_t time_start = GetTimeMillis();
+    while (!filter_index->BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + 10 * 1000 > GetTimeMillis());
+        UninterruptibleSleep(std::chrono::milliseconds{100});
+    }
+
+    auto chain = interfaces::MakeChain();
+    auto Scan = [&](bool fBlockFilter) {
+        gArgs.ForceSetArg("-rescanblockfilter", fBlockFilter ? "1" : "0");
+        CWallet wallet(*chain, WalletLocation(), CreateDummyWalletDatabase());
+        AddKey(wallet, coinbaseKey);
+        WalletRescanReserver reserver(&wallet);
+        reserver.reserve();
+        CWallet::ScanResult result = wallet.ScanForWalletTransactions(::ChainActive().Genesis()->GetBlockHash(), {} /* stop_block */, reserver, false /* update */);
+        BOOST_CHECK_EQUAL(result.status, CWallet::ScanResult::SUCCESS);
+        BOOST_CHECK(result.last_failed_block.IsNull());
+        BOOST_CHECK_EQUAL(result.last_scanned_block, WITH_LOCK(cs_main, return ::ChainActive().Tip()->GetBlockHash()));
+        LOCK(wallet.cs_wallet);
+        BOOST_CHECK(wallet.GetWalletTx(issuance.GetHash()));
+        return wallet.mapWallet.size();
+    };
+
+    // matching the filters finds the same transactions as reading every block
+    const size_t nAllBlocks = Scan(false);
+    BOOST_CHECK_GE(nAllBlocks, 101U);
+    BOOST_CHECK_EQUAL(Scan(true), nAllBlocks);
+
+    gArgs.ForceSetArg("-rescanblockfilter", "0");
+    filter_index->Stop();
+    DestroyBlockFilterIndex(BlockFilterType::BASIC_FILTER);
+    g_txindex->Stop();
+    g_txindex.reset();
+    KnownIssuances.clear();
+}
+
 BOOST_FIXTURE_TEST_CASE(importmulti_rescan, TestChain100Setup)
 {
     // Cap last block file size, and mine new block in a new block file.
@@ -337,6 +422,36 @@ BOOST_AUTO_TEST_CASE(LoadReceiveRequests)
     BOOST_CHECK_EQUAL(values[1], "val_rr1");
 }
 
+BOOST_AUTO_TEST_CASE(LoadWalletTxRecords)
+{
+    // enough records to be decoded on several threads
+    const size_t nCount = 3 * WALLET_LOAD_TX_PER_THREAD;
+    std::vector<uint256> vHashes;
+    {
+        WalletBatch batch(m_wallet.GetDBHandle());
+        for (size_t i = 0; i < nCount; ++i) {
+            CMutableTransaction mtx;
+            mtx.vin.emplace_back(InsecureRand256(), 0);
+            mtx.vout.emplace_back(i + 1, CScript() << OP_TRUE);
+            CWalletTx wtx(&m_wallet, MakeTransactionRef(mtx));
+            wtx.nOrderPos = i;
+            BOOST_CHECK(batch.WriteTx(wtx));
+            vHashes.push_back(wtx.GetHash());
+        }
+    }
+
+    BOOST_CHECK(WalletBatch(m_wallet.GetDBHandle()).LoadWallet(&m_wallet) == DBErrors::LOAD_OK);
+
+    LOCK(m_wallet.cs_wallet);
+    BOOST_CHECK_EQUAL(m_wallet.mapWallet.size(), nCount);
+    for (size_t i = 0; i < nCount; ++i) {
+        const auto it = m_wallet.mapWallet.find(vHashes[i]);
+        BOOST_REQUIRE(it != m_wallet.mapWallet.end());
+        BOOST_CHECK_EQUAL(it->second.nOrderPos, (int64_t)i);
+        BOOST_CHECK_EQUAL(it->second.tx->vout.at(0).nValue, (CAmount)(i + 1));
+    }
+}
+
 class ListCoinsTestingSetup : public TestChain100Setup
 {
 public:
@@ -963,4 +1078,250 @@ BOOST_FIXTURE_TEST_CASE(wallet_disableprivkeys, TestChain100Setup)
     BOOST_CHECK(!wallet->GetKeyFromPool(pubkey, false));
 }
 
+BOOST_AUTO_TEST_CASE(hdchain_derive_child_ext_keys)
+{
+    std::vector<unsigned char> seed(64);
+    GetRandBytes(seed.data(), seed.size());
+    CHDChain hdChain;
+    BOOST_CHECK(hdChain.SetSeed(SecureVector(seed.begin(), seed.end()), true));
+
+    const uint32_t nFirstChildIndex = 7;
+    const size_t nCount = 50;
+    for (bool fInternal : {false, true}) {
+        std::vector<CExtKey> vExtKeys;
+        std::vector<CExtPubKey> vExtPubKeys;
+        std::vector<CKeyMetadata> vMetadata(nCount);
+        hdChain.DeriveChildExtKeys(1, fInternal, nFirstChildIndex, nCount, vExtKeys, vExtPubKeys, vMetadata);
+        BOOST_CHECK_EQUAL(vExtKeys.size(), nCount);
+        BOOST_CHECK_EQUAL(vExtPubKeys.size(), nCount);
+
+        // every key matches the one derived on its own
+        for (size_t i = 0; i < nCount; i++) {
+            CExtKey extKey;
+            CKeyMetadata metadata;
+            hdChain.DeriveChildExtKey(1, fInternal, nFirstChildIndex + i, extKey, metadata);
+            BOOST_CHECK(vExtKeys[i] == extKey);
+            BOOST_CHECK(vExtPubKeys[i] == extKey.Neuter());
+            BOOST_CHECK(vMetadata[i].has_key_origin);
+            BOOST_CHECK(vMetadata[i].key_origin.path == metadata.key_origin.path);
+            BOOST_CHECK(std::equal(std::begin(metadata.key_origin.fingerprint), std::end(metadata.key_origin.fingerprint), std::begin(vMetadata[i].key_origin.fingerprint)));
+        }
+    }
+}
+
+class WalletUTXOTestingSetup : public TestChain100Setup
+{
+public:
+    WalletUTXOTestingSetup()
+    {
+        wallet = MakeUnique<CWallet>(*m_chain, WalletLocation(), CreateMockWalletDatabase());
+        bool firstRun;
+        wallet->LoadWallet(firstRun);
+        AddKey(*wallet, coinbaseKey);
+    }
+
+    ~WalletUTXOTestingSetup()
+    {
+        wallet.reset();
+    }
+
+    //! Add a transaction spending vin to the wallet, confirmed in the tip block if fConfirmed
+    uint256 AddWalletTx(const std::vector<COutPoint>& vin, const std::vector<CTxOut>& vout, bool fConfirmed)
+    {
+        CMutableTransaction mtx;
+        for (const COutPoint& prevout : vin) {
+            mtx.vin.emplace_back(prevout);
+        }
+        mtx.vout = vout;
+        CWalletTx wtx(wallet.get(), MakeTransactionRef(mtx));
+        LOCK(cs_main);
+        if (fConfirmed) {
+            wtx.SetMerkleBranch(::ChainActive().Tip()->GetBlockHash(), 0);
+        }
+        wallet->AddToWallet(wtx);
+        return wtx.GetHash();
+    }
+
+    bool AbandonTransaction(const uint256& hash)
+    {
+        auto locked_chain = m_chain->lock();
+        return wallet->AbandonTransaction(*locked_chain, hash);
+    }
+
+    //! Connect the tip block again with only tx in it, so wallet transactions spending its inputs are conflicted
+    void ConnectConflict(const CMutableTransaction& tx)
+    {
+        CBlock block;
+        {
+            LOCK(cs_main);
+            BOOST_CHECK(ReadBlockFromDisk(block, ::ChainActive().Tip(), Params().GetConsensus()));
+        }
+        block.vtx = {MakeTransactionRef(tx)};
+        wallet->BlockConnected(block, {});
+    }
+
+    //! Invalidate the tip block and disconnect it from the wallet with only tx in it, undoing ConnectConflict
+    void DisconnectConflict(const CMutableTransaction& tx)
+    {
+        CBlock block;
+        {
+            LOCK(cs_main);
+            BOOST_CHECK(ReadBlockFromDisk(block, ::ChainActive().Tip(), Params().GetConsensus()));
+        }
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(state, Params(), WITH_LOCK(cs_main, return ::ChainActive().Tip())));
+        block.vtx = {MakeTransactionRef(tx)};
+        wallet->BlockDisconnected(block);
+    }
+
+    std::unique_ptr<interfaces::Chain> m_chain = interfaces::MakeChain();
+    std::unique_ptr<CWallet> wallet;
+};
+
+BOOST_FIXTURE_TEST_CASE(token_utxo_index, WalletUTXOTestingSetup)
+{
+    const CScript owner = GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+    auto HasTokenUTXO = [&](const COutPoint& outpoint) {
+        LOCK(wallet->cs_wallet);
+        const auto& utxos = wallet->GetTokenUTXOs();
+        const auto it = utxos.find("TESTTOKEN");
+        return it != utxos.end() && it->second.count(outpoint) > 0;
+    };
+
+    const COutPoint tokenOut(AddWalletTx({COutPoint(InsecureRand256(), 0)}, {CTxOut(1 * COIN, TokenScript("TESTTOKEN", owner))}, true), 0);
+    BOOST_CHECK(HasTokenUTXO(tokenOut));
+
+    // spending the token takes it out of the index...
+    const uint256 spend1 = AddWalletTx({tokenOut}, {CTxOut(1 * COIN, CScript() << OP_TRUE)}, false);
+    BOOST_CHECK(!HasTokenUTXO(tokenOut));
+
+    // ...abandoning the spend puts it back
+    BOOST_CHECK(AbandonTransaction(spend1));
+    BOOST_CHECK(HasTokenUTXO(tokenOut));
+
+    // and so does the spend being conflicted by a block
+    const COutPoint foreign(InsecureRand256(), 0);
+    AddWalletTx({tokenOut, foreign}, {CTxOut(1 * COIN, CScript() << OP_TRUE)}, false);
+    BOOST_CHECK(!HasTokenUTXO(tokenOut));
+
+    CMutableTransaction conflict;
+    conflict.vin.emplace_back(foreign);
+    conflict.vout.emplace_back(1 * COIN, CScript() << OP_TRUE);
+    ConnectConflict(conflict);
+    BOOST_CHECK(HasTokenUTXO(tokenOut));
+}
+
+BOOST_FIXTURE_TEST_CASE(utxo_by_value_index, WalletUTXOTestingSetup)
+{
+    const CScript owner = GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+    const CAmount nValue = 12345;
+    auto AvailableOfValue = [&](CAmount nMin, CAmount nMax, uint64_t nMaximumCount) {
+        auto locked_chain = m_chain->lock();
+        LOCK(wallet->cs_wallet);
+        std::vector<COutput> vCoins;
+        wallet->AvailableCoins(*locked_chain, vCoins, true, nullptr, nMin, nMax, MAX_MONEY, nMaximumCount);
+        std::vector<COutPoint> vOutpoints;
+        for (const COutput& out : vCoins) {
+            vOutpoints.emplace_back(out.tx->GetHash(), out.i);
+        }
+        return vOutpoints;
+    };
+    auto IsAvailable = [&](const COutPoint& outpoint) {
+        const std::vector<COutPoint> vOutpoints = AvailableOfValue(nValue, nValue, 0);
+        return std::find(vOutpoints.begin(), vOutpoints.end(), outpoint) != vOutpoints.end();
+    };
+
+    const COutPoint coin(AddWalletTx({COutPoint(InsecureRand256(), 0)}, {CTxOut(nValue, owner)}, true), 0);
+    BOOST_CHECK(IsAvailable(coin));
+
+    // spending the output takes it out of the index, zapping the spend puts it back
+    const uint256 spend1 = AddWalletTx({coin}, {CTxOut(nValue, CScript() << OP_TRUE)}, false);
+    BOOST_CHECK(!IsAvailable(coin));
+    {
+        auto locked_chain = m_chain->lock();
+        LOCK(wallet->cs_wallet);
+        std::vector<uint256> vHashIn{spend1}, vHashOut;
+        BOOST_CHECK(wallet->ZapSelectTx(*locked_chain, vHashIn, vHashOut) == DBErrors::LOAD_OK);
+        BOOST_CHECK_EQUAL(vHashOut.size(), 1U);
+    }
+    BOOST_CHECK(IsAvailable(coin));
+
+    // and so does abandoning the spend
+    const uint256 spend2 = AddWalletTx({coin}, {CTxOut(nValue, CScript() << OP_TRUE)}, false);
+    BOOST_CHECK(!IsAvailable(coin));
+    BOOST_CHECK(AbandonTransaction(spend2));
+    BOOST_CHECK(IsAvailable(coin));
+
+    // outputs are visited smallest first, which decides what an early cutoff returns
+    const COutPoint larger(AddWalletTx({COutPoint(InsecureRand256(), 0)}, {CTxOut(nValue + 1, owner)}, true), 0);
+    const std::vector<COutPoint> vFirst = AvailableOfValue(nValue, nValue + 1, 1);
+    BOOST_CHECK_EQUAL(vFirst.size(), 1U);
+    BOOST_CHECK(vFirst.at(0) == coin);
+    BOOST_CHECK_EQUAL(AvailableOfValue(nValue, nValue + 1, 0).size(), 2U);
+    BOOST_CHECK(AvailableOfValue(nValue + 1, nValue + 1, 0) == std::vector<COutPoint>{larger});
+}
+
+BOOST_FIXTURE_TEST_CASE(count_inputs_with_amount, WalletUTXOTestingSetup)
+{
+    const CScript owner = GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+    const CAmount nDenom = CCoinJoin::GetSmallestDenomination();
+    const CAmount nOtherDenom = CCoinJoin::GetStandardDenominations().front();
+
+    const uint256 funding = AddWalletTx({COutPoint(InsecureRand256(), 0)}, {CTxOut(nDenom, owner), CTxOut(nDenom, owner), CTxOut(nOtherDenom, owner), CTxOut(nDenom + 1, owner)}, true);
+    BOOST_CHECK_EQUAL(wallet->CountInputsWithAmount(nDenom), 2);
+    BOOST_CHECK_EQUAL(wallet->CountInputsWithAmount(nOtherDenom), 1);
+    BOOST_CHECK_EQUAL(wallet->CountInputsWithAmount(nDenom + 1), 1);
+
+    // only the outputs of that exact amount that are still unspent count
+    const uint256 spend = AddWalletTx({COutPoint(funding, 0)}, {CTxOut(nDenom, CScript() << OP_TRUE)}, false);
+    BOOST_CHECK_EQUAL(wallet->CountInputsWithAmount(nDenom), 1);
+    BOOST_CHECK(AbandonTransaction(spend));
+    BOOST_CHECK_EQUAL(wallet->CountInputsWithAmount(nDenom), 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(pending_coinstakes, WalletUTXOTestingSetup)
+{
+    const CScript owner = GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+    auto AddCoinStake = [&](const COutPoint& kernel, bool fConfirmed) {
+        return AddWalletTx({kernel}, {CTxOut(0, CScript()), CTxOut(1 * COIN, owner)}, fConfirmed);
+    };
+    auto IsPending = [&](const uint256& hash) {
+        LOCK(wallet->cs_wallet);
+        return wallet->IsPendingCoinStake(hash);
+    };
+    auto IsAbandoned = [&](const uint256& hash) {
+        LOCK(wallet->cs_wallet);
+        return wallet->mapWallet.at(hash).isAbandoned();
+    };
+
+    const uint256 confirmed = AddCoinStake(COutPoint(InsecureRand256(), 0), true);
+    const uint256 orphaned = AddCoinStake(COutPoint(InsecureRand256(), 0), false);
+    const COutPoint kernel(InsecureRand256(), 0);
+    const uint256 conflicted = AddCoinStake(kernel, false);
+    BOOST_CHECK(IsPending(confirmed));
+    BOOST_CHECK(IsPending(orphaned));
+    BOOST_CHECK(IsPending(conflicted));
+
+    CMutableTransaction conflict;
+    conflict.vin.emplace_back(kernel);
+    conflict.vout.emplace_back(1 * COIN, CScript() << OP_TRUE);
+    ConnectConflict(conflict);
+
+    // the unconfirmed coinstake is abandoned, all of them leave the set
+    wallet->AbandonOrphanedCoinstakes();
+    BOOST_CHECK(!IsPending(confirmed));
+    BOOST_CHECK(!IsPending(orphaned));
+    BOOST_CHECK(!IsPending(conflicted));
+    BOOST_CHECK(!IsAbandoned(confirmed));
+    BOOST_CHECK(IsAbandoned(orphaned));
+    BOOST_CHECK(!IsAbandoned(conflicted));
+
+    // a reorg takes the conflict out of the chain, the coinstake it conflicted is orphaned now
+    DisconnectConflict(conflict);
+    BOOST_CHECK(IsPending(conflicted));
+    wallet->AbandonOrphanedCoinstakes();
+    BOOST_CHECK(!IsPending(conflicted));
+    BOOST_CHECK(IsAbandoned(conflicted));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -11,6 +11,7 @@
 #include <consensus/consensus.h>
 #include <consensus/validation.h>
 #include <crypto/common.h>
+#include <ctpl_stl.h>
 #include <fs.h>
 #include <interfaces/chain.h>
 #include <interfaces/wallet.h>
@@ -412,6 +413,74 @@ void CWallet::DeriveNewChildKey(WalletBatch &batch, CKeyMetadata& metadata, CKey
         throw std::runtime_error(std::string(__func__) + ": AddHDPubKey failed");
 }
 
+void CWallet::DeriveNewChildKeys(WalletBatch& batch, uint32_t nAccountIndex, bool fInternal, size_t nCount, std::vector<CPubKey>& vPubKeysRet)
+{
+    AssertLockHeld(cs_wallet);
+
+    CHDChain hdChainTmp;
+    if (!GetHDChain(hdChainTmp)) {
+        throw std::runtime_error(std::string(__func__) + ": GetHDChain failed");
+    }
+
+    if (!DecryptHDChain(hdChainTmp))
+        throw std::runtime_error(std::string(__func__) + ": DecryptHDChain failed");
+    // make sure seed matches this chain
+    if (hdChainTmp.GetID() != hdChainTmp.GetSeedHash())
+        throw std::runtime_error(std::string(__func__) + ": Wrong HD chain!");
+
+    CHDAccount acc;
+    if (!hdChainTmp.GetAccount(nAccountIndex, acc))
+        throw std::runtime_error(std::string(__func__) + ": Wrong HD account!");
+
+    const int64_t nCreationTime = GetTime();
+    uint32_t nChildIndex = fInternal ? acc.nInternalChainCounter : acc.nExternalChainCounter;
+    vPubKeysRet.clear();
+    while (vPubKeysRet.size() < nCount) {
+        const size_t nDerive = nCount - vPubKeysRet.size();
+        std::vector<CExtKey> vChildKeys;
+        std::vector<CExtPubKey> vChildPubKeys;
+        std::vector<CKeyMetadata> vMetadata(nDerive, CKeyMetadata(nCreationTime));
+        hdChainTmp.DeriveChildExtKeys(nAccountIndex, fInternal, nChildIndex, nDerive, vChildKeys, vChildPubKeys, vMetadata);
+        nChildIndex += nDerive;
+
+        for (size_t i = 0; i < nDerive; i++) {
+            const CPubKey& pubkey = vChildPubKeys[i].pubkey;
+            // skip keys already known to the wallet
+            if (HaveKey(pubkey.GetID())) {
+                continue;
+            }
+            mapKeyMetadata[pubkey.GetID()] = vMetadata[i];
+            if (!AddHDPubKey(batch, vChildPubKeys[i], fInternal))
+                throw std::runtime_error(std::string(__func__) + ": AddHDPubKey failed");
+            vPubKeysRet.push_back(pubkey);
+        }
+    }
+    UpdateTimeFirstKey(nCreationTime);
+
+    // update the chain model in the database
+    CHDChain hdChainCurrent;
+    GetHDChain(hdChainCurrent);
+
+    if (fInternal) {
+        acc.nInternalChainCounter = nChildIndex;
+    }
+    else {
+        acc.nExternalChainCounter = nChildIndex;
+    }
+
+    if (!hdChainCurrent.SetAccount(nAccountIndex, acc))
+        throw std::runtime_error(std::string(__func__) + ": SetAccount failed");
+
+    if (IsCrypted()) {
+        if (!SetCryptedHDChain(batch, hdChainCurrent, false))
+            throw std::runtime_error(std::string(__func__) + ": SetCryptedHDChain failed");
+    }
+    else {
+        if (!SetHDChain(batch, hdChainCurrent, false))
+            throw std::runtime_error(std::string(__func__) + ": SetHDChain failed");
+    }
+}
+
 bool CWallet::GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const
 {
     LOCK(cs_wallet);
@@ -466,6 +535,7 @@ bool CWallet::HaveKey(const CKeyID &address) const
 bool CWallet::LoadHDPubKey(const CHDPubKey &hdPubKey)
 {
     AssertLockHeld(cs_wallet);
+    ++nKeyGeneration;
 
     mapHdPubKeys[hdPubKey.extPubKey.pubkey.GetID()] = hdPubKey;
     return true;
@@ -474,6 +544,7 @@ bool CWallet::LoadHDPubKey(const CHDPubKey &hdPubKey)
 bool CWallet::AddHDPubKey(WalletBatch &batch, const CExtPubKey &extPubKey, bool fInternal)
 {
     AssertLockHeld(cs_wallet);
+    ++nKeyGeneration;
 
     CHDChain hdChainCurrent;
     GetHDChain(hdChainCurrent);
@@ -503,6 +574,7 @@ bool CWallet::AddHDPubKey(WalletBatch &batch, const CExtPubKey &extPubKey, bool
 bool CWallet::AddKeyPubKeyWithDB(WalletBatch& batch, const CKey& secret, const CPubKey& pubkey)
 {
     AssertLockHeld(cs_wallet);
+    ++nKeyGeneration;
 
     // Make sure we aren't adding private keys to private key disabled wallets
     assert(!IsWalletFlagSet(WALLET_FLAG_DISABLE_PRIVATE_KEYS));
@@ -550,6 +622,7 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
 bool CWallet::AddCryptedKey(const CPubKey &vchPubKey,
                             const std::vector<unsigned char> &vchCryptedSecret)
 {
+    ++nKeyGeneration;
     if (!CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret))
         return false;
     {
@@ -638,6 +711,7 @@ void CWallet::UpgradeKeyMetadata()
 
 bool CWallet::LoadCryptedKey(const CPubKey &vchPubKey, const std::vector<unsigned char> &vchCryptedSecret)
 {
+    ++nKeyGeneration;
     return CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret);
 }
 
@@ -671,6 +745,7 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 
 bool CWallet::AddCScriptWithDB(WalletBatch& batch, const CScript& redeemScript)
 {
+    ++nKeyGeneration;
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
     if (batch.WriteCScript(Hash160(redeemScript), redeemScript)) {
@@ -682,6 +757,7 @@ bool CWallet::AddCScriptWithDB(WalletBatch& batch, const CScript& redeemScript)
 
 bool CWallet::LoadCScript(const CScript& redeemScript)
 {
+    ++nKeyGeneration;
     /* A sanity check was added in pull #3843 to avoid adding redeemScripts
      * that never can be redeemed. However, old wallets may still contain
      * these. Do not add them to the wallet and warn. */
@@ -697,6 +773,7 @@ bool CWallet::LoadCScript(const CScript& redeemScript)
 
 bool CWallet::AddWatchOnlyWithDB(WalletBatch &batch, const CScript& dest)
 {
+    ++nKeyGeneration;
     if (!CCryptoKeyStore::AddWatchOnly(dest))
         return false;
     const CKeyMetadata& meta = m_script_metadata[CScriptID(dest)];
@@ -730,6 +807,8 @@ bool CWallet::AddWatchOnly(const CScript& dest, int64_t nCreateTime)
 bool CWallet::RemoveWatchOnly(const CScript &dest)
 {
     AssertLockHeld(cs_wallet);
+    ++nKeyGeneration;
+    ++nKeyRemovalGeneration;
     if (!CCryptoKeyStore::RemoveWatchOnly(dest))
         return false;
     if (!HaveWatchOnly())
@@ -742,6 +821,7 @@ bool CWallet::RemoveWatchOnly(const CScript &dest)
 
 bool CWallet::LoadWatchOnly(const CScript &dest)
 {
+    ++nKeyGeneration;
     return CCryptoKeyStore::AddWatchOnly(dest);
 }
 
@@ -960,10 +1040,61 @@ bool CWallet::IsSpent(interfaces::Chain::Lock& locked_chain, const uint256& hash
     return false;
 }
 
+//! The name of the token in a wallet token output, or an empty string
+static std::string GetWalletTokenName(const CTxOut& txout)
+{
+    if (!txout.scriptPubKey.IsPayToToken()) {
+        return std::string();
+    }
+    CScript script = txout.scriptPubKey;
+    CToken token;
+    if (!BuildTokenFromScript(script, token)) {
+        return std::string();
+    }
+    return token.getName();
+}
+
+bool CWallet::AddWalletUTXO(const COutPoint& outpoint, const CTxOut& txout)
+{
+    AssertLockHeld(cs_wallet);
+    if (!setWalletUTXO.insert(outpoint).second) {
+        return false;
+    }
+    setWalletUTXOByValue.emplace(txout.nValue, outpoint);
+    const std::string name = GetWalletTokenName(txout);
+    if (!name.empty()) {
+        mapTokenUTXO[name].insert(outpoint);
+    }
+    return true;
+}
+
+void CWallet::RemoveWalletUTXO(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs_wallet);
+    if (!setWalletUTXO.erase(outpoint)) {
+        return;
+    }
+    mapCoinOutStates.erase(outpoint);
+    auto wit = mapWallet.find(outpoint.hash);
+    if (wit == mapWallet.end() || outpoint.n >= wit->second.tx->vout.size()) {
+        return;
+    }
+    const CTxOut& txout = wit->second.tx->vout[outpoint.n];
+    setWalletUTXOByValue.erase(std::make_pair(txout.nValue, outpoint));
+    const std::string name = GetWalletTokenName(txout);
+    auto it = mapTokenUTXO.find(name);
+    if (it != mapTokenUTXO.end()) {
+        it->second.erase(outpoint);
+        if (it->second.empty()) {
+            mapTokenUTXO.erase(it);
+        }
+    }
+}
+
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(std::make_pair(outpoint, wtxid));
-    setWalletUTXO.erase(outpoint);
+    RemoveWalletUTXO(outpoint);
 
     setLockedCoins.erase(outpoint);
 
@@ -985,6 +1116,21 @@ void CWallet::AddToSpends(const uint256& wtxid)
         AddToSpends(txin.prevout, wtxid);
 }
 
+void CWallet::RestoreWalletUTXOs(interfaces::Chain::Lock& locked_chain, const CTransaction& tx)
+{
+    AssertLockHeld(cs_wallet);
+    for (const CTxIn& txin : tx.vin) {
+        auto it = mapWallet.find(txin.prevout.hash);
+        if (it == mapWallet.end() || txin.prevout.n >= it->second.tx->vout.size()) {
+            continue;
+        }
+        const CTxOut& txout = it->second.tx->vout[txin.prevout.n];
+        if (IsMine(txout) && !IsSpent(locked_chain, txin.prevout.hash, txin.prevout.n)) {
+            AddWalletUTXO(txin.prevout, txout);
+        }
+    }
+}
+
 bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
 {
     if (IsCrypted())
@@ -1180,6 +1326,7 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
+        InvalidateCoinTxStates();
     }
 
     fAnonymizableTallyCached = false;
@@ -1210,7 +1357,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         auto mnList = deterministicMNManager->GetListAtChainTip();
         for(unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
             if (IsMine(wtx.tx->vout[i]) && !IsSpent(*chain().lock(), hash, i)) {
-                setWalletUTXO.insert(COutPoint(hash, i));
+                AddWalletUTXO(COutPoint(hash, i), wtx.tx->vout[i]);
                 if (deterministicMNManager->IsProTxWithCollateral(wtx.tx, i) || mnList.HasMNByCollateral(COutPoint(hash, i))) {
                     LockCoin(COutPoint(hash, i));
                 }
@@ -1247,7 +1394,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         auto mnList = deterministicMNManager->GetListAtChainTip();
         for (unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
             if (IsMine(wtx.tx->vout[i]) && !IsSpent(*chain().lock(), hash, i)) {
-                bool new_utxo = setWalletUTXO.insert(COutPoint(hash, i)).second;
+                bool new_utxo = AddWalletUTXO(COutPoint(hash, i), wtx.tx->vout[i]);
                 if (new_utxo && (deterministicMNManager->IsProTxWithCollateral(wtx.tx, i) || mnList.HasMNByCollateral(COutPoint(hash, i)))) {
                     LockCoin(COutPoint(hash, i));
                 }
@@ -1256,6 +1403,11 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         }
     }
 
+    // The block of a coinstake may have been disconnected, look at it again
+    if (wtx.IsCoinStake() && !wtx.isAbandoned()) {
+        setPendingCoinStakes.insert(hash);
+    }
+
     //// debug print
     WalletLogPrintf("AddToWallet %s  %s%s\n", wtxIn.GetHash().ToString(), (fInsertedNew ? "new" : ""), (fUpdated ? "update" : ""));
 
@@ -1282,19 +1434,24 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    InvalidateCoinTxState(*wtxIn.tx);
 
     return true;
 }
 
-void CWallet::LoadToWallet(const CWalletTx& wtxIn)
+void CWallet::LoadToWallet(CWalletTx&& wtxIn)
 {
     uint256 hash = wtxIn.GetHash();
-    const auto& ins = mapWallet.emplace(hash, wtxIn);
+    const auto& ins = mapWallet.emplace(hash, std::move(wtxIn));
     CWalletTx& wtx = ins.first->second;
     wtx.BindWallet(this);
     if (/* insertion took place */ ins.second) {
         wtx.m_it_wtxOrdered = wtxOrdered.insert(std::make_pair(wtx.nOrderPos, &wtx));
     }
+    InvalidateCoinTxState(*wtx.tx);
+    if (wtx.IsCoinStake() && !wtx.isAbandoned()) {
+        setPendingCoinStakes.insert(hash);
+    }
     AddToSpends(hash);
     for (const CTxIn& txin : wtx.tx->vin) {
         auto it = mapWallet.find(txin.prevout.hash);
@@ -1450,6 +1607,9 @@ bool CWallet::AbandonTransaction(interfaces::Chain::Lock& locked_chain, const ui
             // If a transaction changes 'conflicted' state, that changes the balance
             // available of the outputs it spends. So force those to be recomputed
             MarkInputsDirty(wtx.tx);
+            InvalidateCoinTxState(*wtx.tx);
+            // and they are unspent again unless something else spends them
+            RestoreWalletUTXOs(locked_chain, *wtx.tx);
         }
     }
 
@@ -1507,6 +1667,9 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             // If a transaction changes 'conflicted' state, that changes the balance
             // available of the outputs it spends. So force those to be recomputed
             MarkInputsDirty(wtx.tx);
+            InvalidateCoinTxState(*wtx.tx);
+            // and they are unspent again unless something else spends them
+            RestoreWalletUTXOs(*locked_chain, *wtx.tx);
         }
     }
 
@@ -1522,6 +1685,7 @@ void CWallet::SyncTransaction(const CTransactionRef& ptx, const uint256& block_h
     // available of the outputs it spends. So force those to be
     // recomputed, also:
     MarkInputsDirty(ptx);
+    InvalidateCoinTxState(*ptx);
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
@@ -1570,10 +1734,14 @@ void CWallet::BlockConnected(const CBlock& block, const std::vector<CTransaction
         // MANUAL because it's a manual removal, not using mempool logic
         TransactionRemovedFromMempool(block.vtx[i], MemPoolRemovalReason::MANUAL);
     }
+    if (block.IsProofOfStake()) {
+        setPendingCoinStakes.erase(block.vtx[1]->GetHash());
+    }
 
     m_last_block_processed = block_hash;
 
     // reset cache to make sure no longer immature coins are included
+    // (mapCoinTxStates follows the tip by itself)
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
 }
@@ -1585,9 +1753,22 @@ void CWallet::BlockDisconnected(const CBlock& block) {
     for (const CTransactionRef& ptx : block.vtx) {
         // NOTE: do NOT pass pindex here
         SyncTransaction(ptx, {} /* block hash */, 0 /* position in block */);
+        // coinstakes this block conflicted may be orphaned now, look at them again
+        if (ptx->IsCoinBase()) continue;
+        for (const CTxIn& txin : ptx->vin) {
+            const auto range = mapTxSpends.equal_range(txin.prevout);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second == ptx->GetHash()) continue;
+                auto wit = mapWallet.find(it->second);
+                if (wit != mapWallet.end() && wit->second.IsCoinStake() && !wit->second.isAbandoned()) {
+                    setPendingCoinStakes.insert(it->second);
+                }
+            }
+        }
     }
 
     // reset cache to make sure no longer mature coins are excluded
+    // (mapCoinTxStates follows the tip by itself)
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
 }
@@ -1744,6 +1925,17 @@ int CWallet::GetCappedOutpointCoinJoinRounds(const COutPoint& outpoint) const
     return realCoinJoinRounds > CCoinJoinClientOptions::GetRounds() ? CCoinJoinClientOptions::GetRounds() : realCoinJoinRounds;
 }
 
+void CWallet::ForEachDenominatedUTXO(const std::function<void(const COutPoint&, CAmount)>& func) const
+{
+    AssertLockHeld(cs_wallet);
+    for (const CAmount nDenom : CCoinJoin::GetStandardDenominations()) {
+        for (auto it = setWalletUTXOByValue.lower_bound(std::make_pair(nDenom, COutPoint(uint256(), 0)));
+             it != setWalletUTXOByValue.end() && it->first == nDenom; ++it) {
+            func(it->second, nDenom);
+        }
+    }
+}
+
 bool CWallet::IsDenominated(const COutPoint& outpoint) const
 {
     LOCK(cs_wallet);
@@ -2374,6 +2566,110 @@ int64_t CWallet::RescanFromTime(int64_t startTime, const WalletRescanReserver& r
     return startTime;
 }
 
+GCSFilter::ElementSet CWallet::GetScriptsForBlockFilter() const
+{
+    GCSFilter::ElementSet elements;
+    auto add = [&elements](const CScript& script) {
+        elements.emplace(script.begin(), script.end());
+    };
+    auto add_key = [&](const CPubKey& pubkey) {
+        add(GetScriptForDestination(pubkey.GetID()));
+        add(GetScriptForRawPubKey(pubkey));
+    };
+
+    LOCK2(cs_wallet, cs_KeyStore);
+    for (const CKeyID& keyid : GetKeys()) {
+        CPubKey pubkey;
+        if (GetPubKey(keyid, pubkey)) {
+            add_key(pubkey);
+        }
+    }
+    for (const auto& entry : mapHdPubKeys) {
+        add_key(entry.second.extPubKey.pubkey);
+    }
+    for (const auto& entry : mapScripts) {
+        add(entry.second);
+        add(GetScriptForDestination(CScriptID(entry.second)));
+    }
+    for (const CScript& script : setWatchOnly) {
+        add(script);
+    }
+    return elements;
+}
+
+//! Read the blocks from block_height on ahead of the rescan, on read_pool and the calling thread.
+//! Blocks whose filter matches none of filter_set are in covered_out but not in blocks_out.
+static void ReadRescanBlocks(interfaces::Chain& chain, ctpl::thread_pool& read_pool, int block_height, const uint256& stop_block, const GCSFilter::ElementSet* filter_set,
+                             std::set<uint256>& covered_out, std::map<uint256, std::shared_ptr<CBlock>>& blocks_out)
+{
+    covered_out.clear();
+    blocks_out.clear();
+
+    std::vector<uint256> hashes;
+    {
+        auto locked_chain = chain.lock();
+        const Optional<int> tip_height = locked_chain->getHeight();
+        const int nMaxBlocks = filter_set ? RESCAN_FILTER_AHEAD : RESCAN_READ_AHEAD;
+        for (int height = block_height; tip_height && height <= *tip_height && (int)hashes.size() < nMaxBlocks; height++) {
+            hashes.push_back(locked_chain->getBlockHash(height));
+            if (hashes.back() == stop_block) break;
+        }
+    }
+    if (hashes.empty()) {
+        return;
+    }
+
+    auto run = [&read_pool](size_t count, const std::function<void(size_t)>& func) {
+        std::atomic<size_t> next{0};
+        auto worker = [&]() {
+            for (size_t i = next++; i < count; i = next++) {
+                func(i);
+            }
+        };
+        std::vector<std::future<void>> futures;
+        const size_t nTasks = count > 1 ? std::min<size_t>(read_pool.size(), count - 1) : 0;
+        for (size_t i = 0; i < nTasks; i++) {
+            futures.emplace_back(read_pool.push([&](int threadId) { worker(); }));
+        }
+        worker();
+        for (auto& future : futures) {
+            future.get();
+        }
+    };
+
+    // Blocks without a filter yet are read anyway. So are the blocks from the token activation
+    // height on: a pay-to-token scriptPubKey carries the token name and identifier in front of
+    // the P2PKH, so no script of ours can match it in the filter.
+    const int nTokenHeight = Params().GetConsensus().nTokenHeight;
+    std::vector<char> vMatch(hashes.size(), 1);
+    if (filter_set) {
+        run(hashes.size(), [&](size_t i) {
+            if (block_height + (int)i >= nTokenHeight) return;
+            const Optional<bool> match = chain.blockFilterMatchesAny(BlockFilterType::BASIC_FILTER, hashes[i], *filter_set);
+            vMatch[i] = !match || *match;
+        });
+    }
+
+    std::vector<uint256> to_read;
+    for (size_t i = 0; i < hashes.size() && (int)to_read.size() < RESCAN_READ_AHEAD; i++) {
+        if (vMatch[i]) {
+            to_read.push_back(hashes[i]);
+        }
+        covered_out.insert(hashes[i]);
+    }
+
+    std::vector<std::shared_ptr<CBlock>> vBlocks(to_read.size());
+    run(to_read.size(), [&](size_t i) {
+        vBlocks[i] = std::make_shared<CBlock>();
+        if (!chain.findBlock(to_read[i], vBlocks[i].get())) {
+            vBlocks[i]->SetNull();
+        }
+    });
+    for (size_t i = 0; i < to_read.size(); i++) {
+        blocks_out.emplace(to_read[i], std::move(vBlocks[i]));
+    }
+}
+
 /**
  * Scan the block chain (starting in start_block) for transactions
  * from or to us. If fUpdate is true, found transactions that already
@@ -2424,6 +2720,24 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
         progress_end = chain().guessVerificationProgress(stop_block.IsNull() ? tip_hash : stop_block);
     }
     double progress_current = progress_begin;
+
+    // With -rescanblockfilter only the blocks whose filter matches one of our scripts are read
+    std::unique_ptr<GCSFilter::ElementSet> filter_set;
+    int nFilterKeyGeneration = nKeyGeneration;
+    if (gArgs.GetBoolArg("-rescanblockfilter", DEFAULT_RESCAN_BLOCK_FILTER)) {
+        if (chain().hasBlockFilterIndex(BlockFilterType::BASIC_FILTER)) {
+            filter_set = MakeUnique<GCSFilter::ElementSet>(GetScriptsForBlockFilter());
+        } else {
+            WalletLogPrintf("Rescan: -rescanblockfilter requires -blockfilterindex, reading all blocks\n");
+        }
+    }
+    std::set<uint256> setReadAhead;
+    std::map<uint256, std::shared_ptr<CBlock>> mapReadAhead;
+    int nSkipped = 0;
+    // the calling thread reads along with the pool
+    ctpl::thread_pool readPool(RESCAN_READ_THREADS - 1);
+    RenameThreadPool(readPool, "rescan-read");
+
     while (block_height && !fAbortRescan && !chain().shutdownRequested()) {
         m_scanning_progress = (progress_current - progress_begin) / (progress_end - progress_begin);
         if (*block_height % 100 == 0 && progress_end - progress_begin > 0.0) {
@@ -2434,8 +2748,36 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
             WalletLogPrintf("Still rescanning. At block %d. Progress=%f\n", *block_height, progress_current);
         }
 
-        CBlock block;
-        if (chain().findBlock(block_hash, &block) && !block.IsNull()) {
+        if (filter_set && nKeyGeneration != nFilterKeyGeneration) {
+            // the keypool was topped up by found transactions, match the new keys too
+            nFilterKeyGeneration = nKeyGeneration;
+            *filter_set = GetScriptsForBlockFilter();
+            setReadAhead.clear();
+            mapReadAhead.clear();
+        }
+        if (!setReadAhead.count(block_hash)) {
+            ReadRescanBlocks(chain(), readPool, *block_height, stop_block, filter_set.get(), setReadAhead, mapReadAhead);
+        }
+        std::shared_ptr<CBlock> pblock;
+        auto ra = mapReadAhead.find(block_hash);
+        if (ra != mapReadAhead.end()) {
+            pblock = std::move(ra->second);
+            mapReadAhead.erase(ra);
+        } else if (!setReadAhead.count(block_hash)) {
+            // the chain changed under the read ahead, read the block here
+            pblock = std::make_shared<CBlock>();
+            if (!chain().findBlock(block_hash, pblock.get())) {
+                pblock->SetNull();
+            }
+        }
+
+        if (!pblock) {
+            // the block filter matches none of our scripts
+            nSkipped++;
+            result.last_scanned_block = block_hash;
+            result.last_scanned_height = *block_height;
+        } else if (!pblock->IsNull()) {
+            const CBlock& block = *pblock;
             auto locked_chain = chain().lock();
             LOCK(cs_wallet);
             if (!locked_chain->getBlockHeight(block_hash)) {
@@ -2491,6 +2833,9 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
         WalletLogPrintf("Rescan interrupted by shutdown request at block %d. Progress=%f\n", *block_height, progress_current);
         result.status = ScanResult::USER_ABORT;
     } else {
+        if (filter_set) {
+            WalletLogPrintf("Rescan skipped %d blocks not matching the wallet's block filter scripts\n", nSkipped);
+        }
         WalletLogPrintf("Rescan completed in %15dms\n", GetTimeMillis() - start_time);
     }
     return result;
@@ -2534,15 +2879,29 @@ void CWallet::AbandonOrphanedCoinstakes()
     auto locked_chain = chain().lock();
     LOCK(cs_wallet);
 
-    for (std::pair<const uint256, CWalletTx>& item : mapWallet) {
-        const uint256& wtxid = item.first;
-        CWalletTx& wtx = item.second;
-        assert(wtx.GetHash() == wtxid);
-        if (wtx.GetDepthInMainChain(*locked_chain) == 0 && !wtx.isAbandoned() && wtx.IsCoinStake()) {
+    // Coinstakes enter the set when added to the wallet or when their block, or
+    // the block conflicting them, is disconnected, and leave it once they are
+    // confirmed, conflicted or abandoned
+    for (auto it = setPendingCoinStakes.begin(); it != setPendingCoinStakes.end(); ) {
+        const uint256 wtxid = *it;
+        auto wit = mapWallet.find(wtxid);
+        if (wit == mapWallet.end()) {
+            it = setPendingCoinStakes.erase(it);
+            continue;
+        }
+        CWalletTx& wtx = wit->second;
+        const int nDepth = wtx.GetDepthInMainChain(*locked_chain);
+        if (nDepth == 0 && !wtx.isAbandoned()) {
+            LogPrint(BCLog::POS, "%s: abandoning coinstake tx %s\n", __func__, wtxid.ToString());
             if (!AbandonTransaction(*locked_chain, wtxid)) {
-                LogPrint(BCLog::POS, "%s: failed to abandon coinstake tx %s\n", __func__, wtx.GetHash().ToString());
+                LogPrint(BCLog::POS, "%s: failed to abandon coinstake tx %s\n", __func__, wtxid.ToString());
             }
         }
+        if (nDepth != 0 || wtx.isAbandoned()) {
+            it = setPendingCoinStakes.erase(it);
+        } else {
+            ++it;
+        }
     }
 }
 
@@ -2979,12 +3338,10 @@ float CWallet::GetAverageAnonymizedRounds() const
     int nCount = 0;
 
     LOCK2(cs_main, cs_wallet);
-    for (const auto& outpoint : setWalletUTXO) {
-        if(!IsDenominated(outpoint)) continue;
-
+    ForEachDenominatedUTXO([&](const COutPoint& outpoint, CAmount nValue) {
         nTotal += GetCappedOutpointCoinJoinRounds(outpoint);
         nCount++;
-    }
+    });
 
     if(nCount == 0) return 0;
 
@@ -3001,17 +3358,14 @@ CAmount CWallet::GetNormalizedAnonymizedBalance() const
 
     auto locked_chain = chain().lock();
     LOCK(cs_wallet);
-    for (const auto& outpoint : setWalletUTXO) {
+    ForEachDenominatedUTXO([&](const COutPoint& outpoint, CAmount nValue) {
         const auto it = mapWallet.find(outpoint.hash);
-        if (it == mapWallet.end()) continue;
-
-        CAmount nValue = it->second.tx->vout[outpoint.n].nValue;
-        if (!CCoinJoin::IsDenominatedAmount(nValue)) continue;
-        if (it->second.GetDepthInMainChain(*locked_chain) < 0) continue;
+        if (it == mapWallet.end()) return;
+        if (GetCoinTxState(*locked_chain, it->second).nDepth < 0) return;
 
         int nRounds = GetCappedOutpointCoinJoinRounds(outpoint);
         nTotal += nValue * nRounds / CCoinJoinClientOptions::GetRounds();
-    }
+    });
 
     return nTotal;
 }
@@ -3032,6 +3386,65 @@ CAmount CWallet::GetAvailableBalance(const CCoinControl* coinControl) const
     return balance;
 }
 
+CWallet::CoinTxState CWallet::GetCoinTxState(interfaces::Chain::Lock& locked_chain, const CWalletTx& wtx) const
+{
+    AssertLockHeld(cs_wallet);
+
+    const Optional<int> tip_height = locked_chain.getHeight();
+    const uint256 hashTip = tip_height ? locked_chain.getBlockHash(*tip_height) : uint256();
+    if (hashTip != hashCoinTxStatesTip) {
+        mapCoinTxStates.clear();
+        hashCoinTxStatesTip = hashTip;
+    }
+
+    auto it = mapCoinTxStates.find(wtx.GetHash());
+    if (it == mapCoinTxStates.end()) {
+        CoinTxState state;
+        state.nDepth = wtx.GetDepthInMainChain(locked_chain);
+        state.fFinal = locked_chain.checkFinalTx(*wtx.tx);
+        state.fImmature = wtx.IsImmatureCoinBase(locked_chain);
+        state.fTrusted = wtx.IsTrusted(locked_chain);
+        it = mapCoinTxStates.emplace(wtx.GetHash(), state).first;
+    }
+    CoinTxState state = it->second;
+    // Finality and trust of unconfirmed transactions also depend on time, the mempool and InstantSend
+    if (state.nDepth == 0) {
+        state.fFinal = locked_chain.checkFinalTx(*wtx.tx);
+        state.fTrusted = wtx.IsTrusted(locked_chain);
+    }
+    return state;
+}
+
+void CWallet::InvalidateCoinTxState(const CTransaction& tx)
+{
+    AssertLockHeld(cs_wallet);
+
+    // A spend changes how the outputs it consumes are seen, like MarkInputsDirty
+    mapCoinTxStates.erase(tx.GetHash());
+    for (const CTxIn& txin : tx.vin) {
+        mapCoinTxStates.erase(txin.prevout.hash);
+    }
+}
+
+const CWallet::CoinOutState& CWallet::GetCoinOutState(const COutPoint& outpoint, const CTxOut& txout) const
+{
+    AssertLockHeld(cs_wallet);
+
+    const int nGeneration = nKeyGeneration;
+    const int nRemovalGeneration = nKeyRemovalGeneration;
+    auto it = mapCoinOutStates.find(outpoint);
+    if (it == mapCoinOutStates.end() || it->second.nKeyRemovalGeneration != nRemovalGeneration ||
+        (it->second.nKeyGeneration != nGeneration && (it->second.mine != ISMINE_SPENDABLE || !it->second.fSolvable))) {
+        CoinOutState& state = mapCoinOutStates[outpoint];
+        state.nKeyGeneration = nGeneration;
+        state.nKeyRemovalGeneration = nRemovalGeneration;
+        state.mine = IsMine(txout);
+        state.fSolvable = IsSolvable(*this, txout.scriptPubKey);
+        return state;
+    }
+    return it->second;
+}
+
 void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<COutput> &vCoins, bool fOnlySafe, const CCoinControl *coinControl, const CAmount &nMinimumAmount, const CAmount &nMaximumAmount, const CAmount &nMinimumSumAmount, const uint64_t nMaximumCount, const int nMinDepth, const int nMaxDepth) const
 {
     AssertLockHeld(cs_wallet);
@@ -3043,23 +3456,37 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
 
     CAmount nTotal = 0;
 
-    for (auto pcoin : GetSpendableTXs()) {
-        const uint256& wtxid = pcoin->GetHash();
+    // Only the unspent outputs in the requested amount range, smallest first.
+    // That order also decides which outputs are returned when
+    // nMinimumSumAmount or nMaximumCount cut the scan short.
+    for (auto it = setWalletUTXOByValue.lower_bound(std::make_pair(nMinimumAmount, COutPoint(uint256(), 0)));
+         it != setWalletUTXOByValue.end() && it->first <= nMaximumAmount; ++it) {
+        const COutPoint& outpoint = it->second;
+        const uint256& wtxid = outpoint.hash;
+        const unsigned int i = outpoint.n;
+        const auto jt = mapWallet.find(wtxid);
+        if (jt == mapWallet.end()) {
+            continue;
+        }
+        const CWalletTx* pcoin = &jt->second;
+        const CTxOut& txout = pcoin->tx->vout[i];
+
+        const CoinTxState tx_state = GetCoinTxState(locked_chain, *pcoin);
 
-        if (!locked_chain.checkFinalTx(*pcoin->tx))
+        if (!tx_state.fFinal)
             continue;
 
-        if (pcoin->IsImmatureCoinBase(locked_chain))
+        if (tx_state.fImmature)
             continue;
 
-        int nDepth = pcoin->GetDepthInMainChain(locked_chain);
+        int nDepth = tx_state.nDepth;
 
         // We should not consider coins which aren't at least in our mempool
         // It's possible for these to be conflicted via ancestors which we may never be able to detect
         if (nDepth == 0 && !pcoin->InMempool())
             continue;
 
-        bool safeTx = pcoin->IsTrusted(locked_chain);
+        bool safeTx = tx_state.fTrusted;
 
         if (fOnlySafe && !safeTx) {
             continue;
@@ -3068,67 +3495,63 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
         if (nDepth < nMinDepth || nDepth > nMaxDepth)
             continue;
 
-        for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
-            // pass on existing token outputs
-            if (pcoin->tx->vout[i].IsTokenOutput()) {
-                continue;
-            }
-            bool found = false;
-            if (nCoinType == CoinType::ONLY_FULLY_MIXED) {
-                if (!CCoinJoin::IsDenominatedAmount(pcoin->tx->vout[i].nValue)) continue;
-                found = IsFullyMixed(COutPoint(wtxid, i));
-            } else if(nCoinType == CoinType::ONLY_READY_TO_MIX) {
-                if (!CCoinJoin::IsDenominatedAmount(pcoin->tx->vout[i].nValue)) continue;
-                found = !IsFullyMixed(COutPoint(wtxid, i));
-            } else if(nCoinType == CoinType::ONLY_NONDENOMINATED) {
-                if (CCoinJoin::IsCollateralAmount(pcoin->tx->vout[i].nValue)) continue; // do not use collateral amounts
-                found = !CCoinJoin::IsDenominatedAmount(pcoin->tx->vout[i].nValue);
-            } else if(nCoinType == CoinType::ONLY_MASTERNODE_COLLATERAL) {
-                found = pcoin->tx->vout[i].nValue == params.mnCollateral;
-            } else if(nCoinType == CoinType::ONLY_COINJOIN_COLLATERAL) {
-                found = CCoinJoin::IsCollateralAmount(pcoin->tx->vout[i].nValue);
-            } else {
-                found = true;
-            }
-            if(!found) continue;
-
-            if (pcoin->tx->vout[i].nValue < nMinimumAmount || pcoin->tx->vout[i].nValue > nMaximumAmount)
-                continue;
-
-            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(wtxid, i)))
-                continue;
+        // pass on existing token outputs
+        if (txout.IsTokenOutput()) {
+            continue;
+        }
+        bool found = false;
+        if (nCoinType == CoinType::ONLY_FULLY_MIXED) {
+            if (!CCoinJoin::IsDenominatedAmount(txout.nValue)) continue;
+            found = IsFullyMixed(outpoint);
+        } else if(nCoinType == CoinType::ONLY_READY_TO_MIX) {
+            if (!CCoinJoin::IsDenominatedAmount(txout.nValue)) continue;
+            found = !IsFullyMixed(outpoint);
+        } else if(nCoinType == CoinType::ONLY_NONDENOMINATED) {
+            if (CCoinJoin::IsCollateralAmount(txout.nValue)) continue; // do not use collateral amounts
+            found = !CCoinJoin::IsDenominatedAmount(txout.nValue);
+        } else if(nCoinType == CoinType::ONLY_MASTERNODE_COLLATERAL) {
+            found = txout.nValue == params.mnCollateral;
+        } else if(nCoinType == CoinType::ONLY_COINJOIN_COLLATERAL) {
+            found = CCoinJoin::IsCollateralAmount(txout.nValue);
+        } else {
+            found = true;
+        }
+        if(!found) continue;
 
-            if (IsLockedCoin(wtxid, i))
-                continue;
+        if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(outpoint))
+            continue;
 
-            if (IsSpent(locked_chain, wtxid, i))
-                continue;
+        if (IsLockedCoin(wtxid, i))
+            continue;
 
-            isminetype mine = IsMine(pcoin->tx->vout[i]);
+        if (IsSpent(locked_chain, wtxid, i))
+            continue;
 
-            if (mine == ISMINE_NO) {
-                continue;
-            }
+        const CoinOutState& out_state = GetCoinOutState(outpoint, txout);
+        isminetype mine = out_state.mine;
 
-            bool solvable = IsSolvable(*this, pcoin->tx->vout[i].scriptPubKey);
-            bool spendable = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) || (((mine & ISMINE_WATCH_ONLY) != ISMINE_NO) && (coinControl && coinControl->fAllowWatchOnly && solvable));
+        if (mine == ISMINE_NO) {
+            continue;
+        }
 
-            vCoins.push_back(COutput(pcoin, i, nDepth, spendable, solvable, safeTx, (coinControl && coinControl->fAllowWatchOnly)));
+        bool solvable = out_state.fSolvable;
+        bool spendable = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) || (((mine & ISMINE_WATCH_ONLY) != ISMINE_NO) && (coinControl && coinControl->fAllowWatchOnly && solvable));
 
-            // Checks the sum amount of all UTXO's.
-            if (nMinimumSumAmount != MAX_MONEY) {
-                nTotal += pcoin->tx->vout[i].nValue;
+        vCoins.push_back(COutput(pcoin, i, nDepth, spendable, solvable, safeTx, (coinControl && coinControl->fAllowWatchOnly)));
 
-                if (nTotal >= nMinimumSumAmount) {
-                    return;
-                }
-            }
+        // Checks the sum amount of all UTXO's.
+        if (nMinimumSumAmount != MAX_MONEY) {
+            nTotal += txout.nValue;
 
-            // Checks the maximum number of UTXO's.
-            if (nMaximumCount > 0 && vCoins.size() >= nMaximumCount) {
+            if (nTotal >= nMinimumSumAmount) {
                 return;
             }
         }
+
+        // Checks the maximum number of UTXO's.
+        if (nMaximumCount > 0 && vCoins.size() >= nMaximumCount) {
+            return;
+        }
     }
 }
 
@@ -3456,7 +3879,8 @@ bool CWallet::SelectTxDSInsByDenomination(int nDenom, CAmount nValueMax, std::ve
 
     CCoinControl coin_control;
     coin_control.nCoinType = CoinType::ONLY_READY_TO_MIX;
-    AvailableCoins(*locked_chain, vCoins, true, &coin_control);
+    // only the outputs of this denomination
+    AvailableCoins(*locked_chain, vCoins, true, &coin_control, nDenomAmount, nDenomAmount);
     LogPrint(BCLog::COINJOIN, "CWallet::%s -- vCoins.size(): %d\n", __func__, vCoins.size());
 
     Shuffle(vCoins.rbegin(), vCoins.rend(), FastRandomContext());
@@ -3580,9 +4004,10 @@ std::vector<CompactTallyItem> CWallet::SelectCoinsGroupedByAddresses(bool fSkipD
 
         const CWalletTx& wtx = (*it).second;
 
-        if(wtx.IsCoinBase() && wtx.GetBlocksToMaturity(*locked_chain) > 0) continue;
-        if(fSkipUnconfirmed && !wtx.IsTrusted(*locked_chain)) continue;
-        if (wtx.GetDepthInMainChain(*locked_chain) < 0) continue;
+        const CoinTxState tx_state = GetCoinTxState(*locked_chain, wtx);
+        if(tx_state.fImmature) continue;
+        if(fSkipUnconfirmed && !tx_state.fTrusted) continue;
+        if (tx_state.nDepth < 0) continue;
 
         for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
             CTxDestination txdest;
@@ -3660,7 +4085,12 @@ bool CWallet::SelectDenominatedAmounts(CAmount nValueMax, std::set<CAmount>& set
     std::vector<COutput> vCoins;
     CCoinControl coin_control;
     coin_control.nCoinType = CoinType::ONLY_READY_TO_MIX;
-    AvailableCoins(*locked_chain, vCoins, true, &coin_control);
+    // only the outputs between the smallest and the largest denomination that could fit
+    const CAmount nMaxAmount = std::min(nValueMax, CCoinJoin::GetStandardDenominations().front());
+    if (nMaxAmount < CCoinJoin::GetSmallestDenomination()) {
+        return false;
+    }
+    AvailableCoins(*locked_chain, vCoins, true, &coin_control, CCoinJoin::GetSmallestDenomination(), nMaxAmount);
     // larger denoms first
     std::sort(vCoins.rbegin(), vCoins.rend(), CompareByPriority());
 
@@ -3682,11 +4112,11 @@ int CWallet::CountInputsWithAmount(CAmount nInputAmount) const
     auto locked_chain = chain().lock();
     LOCK(cs_wallet);
 
-    for (const auto& outpoint : setWalletUTXO) {
-        const auto it = mapWallet.find(outpoint.hash);
-        if (it == mapWallet.end()) continue;
-        if (it->second.tx->vout[outpoint.n].nValue != nInputAmount) continue;
-        if (it->second.GetDepthInMainChain(*locked_chain) < 0) continue;
+    for (auto it = setWalletUTXOByValue.lower_bound(std::make_pair(nInputAmount, COutPoint(uint256(), 0)));
+         it != setWalletUTXOByValue.end() && it->first == nInputAmount; ++it) {
+        const auto jt = mapWallet.find(it->second.hash);
+        if (jt == mapWallet.end()) continue;
+        if (GetCoinTxState(*locked_chain, jt->second).nDepth < 0) continue;
 
         nTotal++;
     }
@@ -4190,7 +4620,7 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
     for (auto& pair : mapWallet) {
         for(unsigned int i = 0; i < pair.second.tx->vout.size(); ++i) {
             if (IsMine(pair.second.tx->vout[i]) && !IsSpent(*locked_chain, pair.first, i)) {
-                setWalletUTXO.insert(COutPoint(pair.first, i));
+                AddWalletUTXO(COutPoint(pair.first, i), pair.second.tx->vout[i]);
             }
         }
     }
@@ -4222,16 +4652,27 @@ void CWallet::AutoLockMasternodeCollaterals()
     }
 }
 
-DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256>& vHashOut)
+DBErrors CWallet::ZapSelectTx(interfaces::Chain::Lock& locked_chain, std::vector<uint256>& vHashIn, std::vector<uint256>& vHashOut)
 {
     AssertLockHeld(cs_wallet);
     DBErrors nZapSelectTxRet = WalletBatch(*database, "cr+").ZapSelectTx(vHashIn, vHashOut);
+    std::vector<CTransactionRef> vZapped;
     for (uint256 hash : vHashOut) {
         const auto& it = mapWallet.find(hash);
+        for (unsigned int i = 0; i < it->second.tx->vout.size(); i++) {
+            RemoveWalletUTXO(COutPoint(hash, i));
+        }
+        vZapped.push_back(it->second.tx);
+        InvalidateCoinTxState(*it->second.tx);
         wtxOrdered.erase(it->second.m_it_wtxOrdered);
+        setPendingCoinStakes.erase(hash);
         mapWallet.erase(it);
         NotifyTransactionChanged(this, hash, CT_DELETED);
     }
+    // The outputs the removed transactions spent are unspent again
+    for (const CTransactionRef& tx : vZapped) {
+        RestoreWalletUTXOs(locked_chain, *tx);
+    }
 
     if (nZapSelectTxRet == DBErrors::NEED_REWRITE)
     {
@@ -4437,6 +4878,64 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         }
         bool fInternal = false;
         WalletBatch batch(*database);
+        if (IsHDEnabled()) {
+            // Derive the keys on several threads, and write them in a few db transactions
+            // instead of one per record. External keys first, like below.
+            int64_t nAdded = 0;
+            for (const bool fInternalChain : {false, true}) {
+                int64_t nMissing = fInternalChain ? missingInternal : missingExternal;
+                while (nMissing > 0) {
+                    const int64_t nChunk = std::min(nMissing, KEYPOOL_TOPUP_BATCH_SIZE);
+                    if (!batch.TxnBegin()) {
+                        throw std::runtime_error(std::string(__func__) + ": TxnBegin failed");
+                    }
+                    CHDChain hdChainBefore;
+                    GetHDChain(hdChainBefore);
+                    const int64_t nMaxKeypoolIndexBefore = m_max_keypool_index;
+                    std::vector<CPubKey> vPubKeys;
+                    try {
+                        DeriveNewChildKeys(batch, 0, fInternalChain, nChunk, vPubKeys);
+                        for (const CPubKey& pubkey : vPubKeys) {
+                            AddKeypoolPubkeyWithDB(pubkey, fInternalChain, batch);
+                        }
+                        if (!batch.TxnCommit()) {
+                            throw std::runtime_error(std::string(__func__) + ": TxnCommit failed");
+                        }
+                    } catch (...) {
+                        // Nothing of this chunk reached the database, forget it in memory too
+                        batch.TxnAbort();
+                        std::set<int64_t>& setKeyPool = fInternalChain ? setInternalKeyPool : setExternalKeyPool;
+                        for (int64_t nIndex = nMaxKeypoolIndexBefore + 1; nIndex <= m_max_keypool_index; ++nIndex) {
+                            setKeyPool.erase(nIndex);
+                        }
+                        m_max_keypool_index = nMaxKeypoolIndexBefore;
+                        for (const CPubKey& pubkey : vPubKeys) {
+                            m_pool_key_to_index.erase(pubkey.GetID());
+                            mapHdPubKeys.erase(pubkey.GetID());
+                            mapKeyMetadata.erase(pubkey.GetID());
+                        }
+                        if (IsCrypted()) {
+                            SetCryptedHDChain(batch, hdChainBefore, true);
+                        } else {
+                            SetHDChain(batch, hdChainBefore, true);
+                        }
+                        throw;
+                    }
+                    nMissing -= nChunk;
+                    nAdded += nChunk;
+
+                    double dProgress = 100.f * nAdded / (missingInternal + missingExternal);
+                    std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)").translated, dProgress);
+                    uiInterface.InitMessage(strMsg);
+                }
+            }
+            if (nAdded > 0) {
+                WalletLogPrintf("keypool added %d keys (%d internal), size=%u (%u internal)\n",
+                          missingInternal + missingExternal, missingInternal,
+                          setInternalKeyPool.size() + setExternalKeyPool.size(), setInternalKeyPool.size());
+            }
+            missingInternal = missingExternal = 0;
+        }
         for (int64_t i = missingInternal + missingExternal; i--;)
         {
             if (i < missingInternal) {
@@ -30,6 +30,7 @@
 #include <algorithm>
 #include <atomic>
 #include <deque>
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
@@ -64,6 +65,8 @@ enum class WalletCreationStatus {
 WalletCreationStatus CreateWallet(interfaces::Chain& chain, const SecureString& passphrase, uint64_t wallet_creation_flags, const std::string& name, bilingual_str& error, std::vector<bilingual_str>& warnings, std::shared_ptr<CWallet>& result);
 
 static const unsigned int DEFAULT_KEYPOOL_SIZE = 1000;
+//! Number of HD keys written per wallet db transaction when topping up the keypool
+static const int64_t KEYPOOL_TOPUP_BATCH_SIZE = 1000;
 //! -paytxfee default
 constexpr CAmount DEFAULT_PAY_TX_FEE = 0;
 //! -fallbackfee default
@@ -83,6 +86,14 @@ static const bool DEFAULT_AVOIDPARTIALSPENDS = false;
 //! -txconfirmtarget default
 static const unsigned int DEFAULT_TX_CONFIRM_TARGET = 6;
 static const bool DEFAULT_WALLETBROADCAST = true;
+//! Default for -rescanblockfilter
+static const bool DEFAULT_RESCAN_BLOCK_FILTER = false;
+//! Number of threads reading blocks ahead of a rescan
+static const int RESCAN_READ_THREADS = 4;
+//! Maximum number of blocks read ahead of a rescan
+static const int RESCAN_READ_AHEAD = 64;
+//! Maximum number of block filters matched ahead of a rescan
+static const int RESCAN_FILTER_AHEAD = 1000;
 static const bool DEFAULT_DISABLE_WALLET = false;
 //! -maxtxfee default
 static const CAmount DEFAULT_TRANSACTION_MAXFEE = COIN / 10;
@@ -639,8 +650,49 @@ private:
     void AddToSpends(const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     std::set<COutPoint> setWalletUTXO;
+    //! The token outputs in setWalletUTXO, by token name
+    std::map<std::string, std::set<COutPoint>> mapTokenUTXO GUARDED_BY(cs_wallet);
     mutable std::map<COutPoint, int> mapOutpointRoundsCache;
 
+    //! setWalletUTXO ordered by value, for the amount range of AvailableCoins
+    std::set<std::pair<CAmount, COutPoint>> setWalletUTXOByValue GUARDED_BY(cs_wallet);
+
+    /** Add an unspent output to setWalletUTXO, and to mapTokenUTXO if it is a token output. Returns false if it was there already. */
+    bool AddWalletUTXO(const COutPoint& outpoint, const CTxOut& txout) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void RemoveWalletUTXO(const COutPoint& outpoint) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    //! Put the wallet outputs spent by tx back into setWalletUTXO once tx was abandoned or conflicted
+    void RestoreWalletUTXOs(interfaces::Chain::Lock& locked_chain, const CTransaction& tx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    //! Call func for the unspent outputs of each CoinJoin denomination, by looking them up in setWalletUTXOByValue
+    void ForEachDenominatedUTXO(const std::function<void(const COutPoint&, CAmount)>& func) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
+    //! Chain state of a wallet transaction as seen by AvailableCoins
+    struct CoinTxState {
+        int nDepth;
+        bool fFinal;
+        bool fImmature;
+        bool fTrusted;
+    };
+    //! Ownership of a wallet output as seen by AvailableCoins
+    struct CoinOutState {
+        int nKeyGeneration;
+        int nKeyRemovalGeneration;
+        isminetype mine;
+        bool fSolvable;
+    };
+    //! Valid for the tip in hashCoinTxStatesTip, until the wallet transaction or one spending it changes
+    mutable std::map<uint256, CoinTxState> mapCoinTxStates GUARDED_BY(cs_wallet);
+    mutable uint256 hashCoinTxStatesTip GUARDED_BY(cs_wallet);
+    //! Adding keys or scripts (nKeyGeneration) can only make more outputs ours, so it invalidates
+    //! just the outputs that were not fully ours; removing them (nKeyRemovalGeneration) invalidates all
+    mutable std::map<COutPoint, CoinOutState> mapCoinOutStates GUARDED_BY(cs_wallet);
+    std::atomic<int> nKeyGeneration{0};
+    std::atomic<int> nKeyRemovalGeneration{0};
+
+    CoinTxState GetCoinTxState(interfaces::Chain::Lock& locked_chain, const CWalletTx& wtx) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    const CoinOutState& GetCoinOutState(const COutPoint& outpoint, const CTxOut& txout) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void InvalidateCoinTxStates() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet) { mapCoinTxStates.clear(); }
+    void InvalidateCoinTxState(const CTransaction& tx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     /**
      * Add a transaction to the wallet, or update it.  pIndex and posInBlock should
      * be set when the transaction was known to be included in a block.  When
@@ -670,6 +722,8 @@ private:
 
     /* HD derive new child key (on internal or external chain) */
     void DeriveNewChildKey(WalletBatch& batch, CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal /*= false*/) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    //! Derive nCount new child keys at once, the HD chain is written only once
+    void DeriveNewChildKeys(WalletBatch& batch, uint32_t nAccountIndex, bool fInternal, size_t nCount, std::vector<CPubKey>& vPubKeysRet) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     std::set<int64_t> setInternalKeyPool GUARDED_BY(cs_wallet);
     std::set<int64_t> setExternalKeyPool GUARDED_BY(cs_wallet);
@@ -817,6 +871,8 @@ public:
 
     /**
      * populate vCoins with vector of available COutputs.
+     * Outputs are visited by ascending value, so when nMinimumSumAmount or
+     * nMaximumCount stop the scan early, the smallest outputs are returned.
      */
     void AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<COutput>& vCoins, bool fOnlySafe=true, const CCoinControl *coinControl = nullptr, const CAmount& nMinimumAmount = 1, const CAmount& nMaximumAmount = MAX_MONEY, const CAmount& nMinimumSumAmount = MAX_MONEY, const uint64_t nMaximumCount = 0, const int nMinDepth = 0, const int nMaxDepth = 9999999) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
@@ -892,7 +948,7 @@ public:
     //! Adds a key to the store, and saves it to disk.
     bool AddKeyPubKey(const CKey& key, const CPubKey &pubkey) override EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     //! Adds a key to the store, without saving it to disk (used by LoadWallet)
-    bool LoadKey(const CKey& key, const CPubKey &pubkey) { return CCryptoKeyStore::AddKeyPubKey(key, pubkey); }
+    bool LoadKey(const CKey& key, const CPubKey &pubkey) { ++nKeyGeneration; return CCryptoKeyStore::AddKeyPubKey(key, pubkey); }
     //! Load metadata (used by LoadWallet)
     void LoadKeyMetadata(const CKeyID& keyID, const CKeyMetadata &metadata) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void LoadScriptMetadata(const CScriptID& script_id, const CKeyMetadata &metadata) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
@@ -954,6 +1010,11 @@ public:
      */
     bool FundMintTransaction(CAmount& amountMin, CAmount& amountFound, std::vector<CTxIn>& ret) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /**
+     * return the unspent token outputs of the wallet, by token name
+     */
+    const std::map<std::string, std::set<COutPoint>>& GetTokenUTXOs() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet) { return mapTokenUTXO; }
+
     /**
      * return suitable inputs via ret for given token name and value
      */
@@ -983,7 +1044,7 @@ public:
 
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose=true);
-    void LoadToWallet(const CWalletTx& wtxIn) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void LoadToWallet(CWalletTx&& wtxIn) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void TransactionAddedToMempool(const CTransactionRef& tx, int64_t nAcceptTime) override;
     void BlockConnected(const CBlock& block, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const CBlock& block) override;
@@ -1006,6 +1067,8 @@ public:
         uint256 last_failed_block;
     };
     ScanResult ScanForWalletTransactions(const uint256& first_block, const uint256& last_block, const WalletRescanReserver& reserver, bool fUpdate);
+    //! The scripts of the wallet's keys, scripts and watch-only entries, to match against block filters
+    GCSFilter::ElementSet GetScriptsForBlockFilter() const;
     void TransactionRemovedFromMempool(const CTransactionRef &ptx, MemPoolRemovalReason reason) override;
     void ReacceptWalletTransactions(interfaces::Chain::Lock& locked_chain) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void ResendWalletTransactions();
@@ -1144,7 +1207,7 @@ public:
     DBErrors LoadWallet(bool& fFirstRunRet);
     void AutoLockMasternodeCollaterals();
     DBErrors ZapWalletTx(std::vector<CWalletTx>& vWtx);
-    DBErrors ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256>& vHashOut) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    DBErrors ZapSelectTx(interfaces::Chain::Lock& locked_chain, std::vector<uint256>& vHashIn, std::vector<uint256>& vHashOut) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     bool SetAddressBook(const CTxDestination& address, const std::string& strName, const std::string& purpose);
 
@@ -1244,7 +1307,10 @@ public:
     mutable std::atomic_bool m_have_cached_stakeable_coins{false};
     mutable std::vector<COutput> m_cached_stakeable_coins;
     mutable int m_greatest_txn_depth = 0;
+    //! Coinstakes that may be unconfirmed, the only ones AbandonOrphanedCoinstakes has to look at
+    std::set<uint256> setPendingCoinStakes GUARDED_BY(cs_wallet);
     void AbandonOrphanedCoinstakes();
+    bool IsPendingCoinStake(const uint256& hash) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet) { return setPendingCoinStakes.count(hash) > 0; }
 
     /**
      * Wallet post-init setup
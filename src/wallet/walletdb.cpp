@@ -22,6 +22,7 @@
 
 #include <atomic>
 #include <string>
+#include <thread>
 
 namespace DBKeys {
 const std::string ACENTRY{"acentry"};
@@ -215,11 +216,107 @@ public:
     bool fIsEncrypted{false};
     bool fAnyUnordered{false};
     std::vector<uint256> vWalletUpgrade;
+    //! Queue transaction records for LoadWalletTxBatch instead of loading them one by one
+    bool fDeferTx{false};
+    std::vector<std::pair<uint256, CDataStream>> vPendingTx;
 
     CWalletScanState() {
     }
 };
 
+//! Deserialize and check a wallet transaction record. Touches no wallet state, so
+//! it is safe to run for several records concurrently.
+static bool ReadWalletTx(const uint256& hash, CDataStream& ssValue, CWalletTx& wtx)
+{
+    ssValue >> wtx;
+    CValidationState state;
+    return CheckTransaction(*wtx.tx, state) && wtx.GetHash() == hash && state.IsValid();
+}
+
+static void LoadWalletTx(CWallet* pwallet, const uint256& hash, CDataStream& ssValue, CWalletTx&& wtx,
+                         CWalletScanState& wss, std::string& strErr) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet)
+{
+    // Undo serialize changes in 31600
+    if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
+    {
+        if (!ssValue.empty())
+        {
+            char fTmp;
+            char fUnused;
+            std::string unused_string;
+            ssValue >> fTmp >> fUnused >> unused_string;
+            strErr = strprintf("LoadWallet() upgrading tx ver=%d %d %s",
+                               wtx.fTimeReceivedIsTxTime, fTmp, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = fTmp;
+        }
+        else
+        {
+            strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = 0;
+        }
+        wss.vWalletUpgrade.push_back(hash);
+    }
+
+    if (wtx.nOrderPos == -1)
+        wss.fAnyUnordered = true;
+
+    pwallet->LoadToWallet(std::move(wtx));
+}
+
+/**
+ * Decode the transaction records queued by ReadKeyValue on all cores, then add
+ * them to the wallet in cursor order. Returns false if any record was corrupt.
+ */
+static bool LoadWalletTxBatch(CWallet* pwallet, CWalletScanState& wss) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet)
+{
+    const size_t nCount = wss.vPendingTx.size();
+    if (nCount == 0) return true;
+
+    std::vector<CWalletTx> vWtx(nCount, CWalletTx(nullptr /* pwallet */, MakeTransactionRef()));
+    std::vector<char> vValid(nCount, 0);
+    std::atomic<size_t> nNext{0};
+    auto worker = [&]() {
+        for (size_t i = nNext++; i < nCount; i = nNext++) {
+            try {
+                vValid[i] = ReadWalletTx(wss.vPendingTx[i].first, wss.vPendingTx[i].second, vWtx[i]);
+            } catch (...) {
+                vValid[i] = 0;
+            }
+        }
+    };
+
+    const size_t nThreads = std::min<size_t>(std::max(GetNumCores(), 1), (nCount + WALLET_LOAD_TX_PER_THREAD - 1) / WALLET_LOAD_TX_PER_THREAD);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < nThreads; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+    bool fAllValid = true;
+    for (size_t i = 0; i < nCount; ++i) {
+        const uint256& hash = wss.vPendingTx[i].first;
+        if (!vValid[i]) {
+            pwallet->WalletLogPrintf("Error reading wallet database: tx %s corrupt\n", hash.ToString());
+            fAllValid = false;
+            continue;
+        }
+        std::string strErr;
+        try {
+            LoadWalletTx(pwallet, hash, wss.vPendingTx[i].second, std::move(vWtx[i]), wss, strErr);
+        } catch (const std::exception& e) {
+            strErr = e.what();
+            fAllValid = false;
+        }
+        if (!strErr.empty())
+            pwallet->WalletLogPrintf("%s\n", strErr);
+    }
+    wss.vPendingTx.clear();
+    return fAllValid;
+}
+
 static bool
 ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
              CWalletScanState &wss, std::string& strType, std::string& strErr) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet)
@@ -240,37 +337,15 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         } else if (strType == DBKeys::TX) {
             uint256 hash;
             ssKey >> hash;
+            if (wss.fDeferTx) {
+                // Decoded in batches by LoadWalletTxBatch
+                wss.vPendingTx.emplace_back(hash, std::move(ssValue));
+                return true;
+            }
             CWalletTx wtx(nullptr /* pwallet */, MakeTransactionRef());
-            ssValue >> wtx;
-            CValidationState state;
-            if (!(CheckTransaction(*wtx.tx, state) && (wtx.GetHash() == hash) && state.IsValid()))
+            if (!ReadWalletTx(hash, ssValue, wtx))
                 return false;
-
-            // Undo serialize changes in 31600
-            if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
-            {
-                if (!ssValue.empty())
-                {
-                    char fTmp;
-                    char fUnused;
-                    std::string unused_string;
-                    ssValue >> fTmp >> fUnused >> unused_string;
-                    strErr = strprintf("LoadWallet() upgrading tx ver=%d %d %s",
-                                       wtx.fTimeReceivedIsTxTime, fTmp, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = fTmp;
-                }
-                else
-                {
-                    strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = 0;
-                }
-                wss.vWalletUpgrade.push_back(hash);
-            }
-
-            if (wtx.nOrderPos == -1)
-                wss.fAnyUnordered = true;
-
-            pwallet->LoadToWallet(wtx);
+            LoadWalletTx(pwallet, hash, ssValue, std::move(wtx), wss, strErr);
         } else if (strType == DBKeys::WATCHS) {
             wss.nWatchKeys++;
             CScript script;
@@ -506,6 +581,7 @@ bool WalletBatch::IsKeyType(const std::string& strType)
 DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
 {
     CWalletScanState wss;
+    wss.fDeferTx = true;
     bool fNoncriticalErrors = false;
     DBErrors result = DBErrors::LOAD_OK;
 
@@ -565,6 +641,16 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
             }
             if (!strErr.empty())
                 pwallet->WalletLogPrintf("%s\n", strErr);
+
+            if (wss.vPendingTx.size() >= WALLET_LOAD_TX_BATCH_SIZE && !LoadWalletTxBatch(pwallet, wss)) {
+                fNoncriticalErrors = true;
+                // Rescan if there is a bad transaction record:
+                gArgs.SoftSetBoolArg("-rescan", true);
+            }
+        }
+        if (!LoadWalletTxBatch(pwallet, wss)) {
+            fNoncriticalErrors = true;
+            gArgs.SoftSetBoolArg("-rescan", true);
         }
 
         // Store initial external keypool size since we mostly use external keys in mixing
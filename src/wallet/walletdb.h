@@ -29,6 +29,10 @@
  */
 
 static const bool DEFAULT_FLUSHWALLET = true;
+//! Number of transaction records decoded together while loading a wallet
+static const size_t WALLET_LOAD_TX_BATCH_SIZE = 10000;
+//! Minimum number of transaction records per decoding thread while loading a wallet
+static const size_t WALLET_LOAD_TX_PER_THREAD = 500;
 
 struct CBlockLocator;
 class CGovernanceObject;
@@ -67,6 +67,7 @@ class NetTest(DashTestFramework):
         self._test_getpeerinfo()
         self.test_service_flags()
         self._test_getnodeaddresses()
+        self._test_getnetmsgstats()
 
     def _test_connection_count(self):
         # connect_nodes connects each node to the other
@@ -201,6 +202,20 @@ class NetTest(DashTestFramework):
         node_addresses = self.nodes[0].getnodeaddresses(LARGE_REQUEST_COUNT)
         assert_greater_than(LARGE_REQUEST_COUNT, len(node_addresses))
 
+    def _test_getnetmsgstats(self):
+        self.nodes[0].ping()
+        wait_until(lambda: 'pong' in self.nodes[0].getnetmsgstats()['messages'])
+        stats = self.nodes[0].getnetmsgstats('pong', True)
+        assert_equal(list(stats['messages'].keys()), ['pong'])
+        pong = stats['messages']['pong']
+        assert_greater_than_or_equal(pong['count'], 1)
+        assert_equal(pong['count'], sum(c['count'] for c in pong['peers'].values()))
+        assert_equal(pong['count'], sum(pong['process_time_histogram'].values()))
+        assert_greater_than_or_equal(stats['handler']['busy_time'], 0)
+
+        # stats were reset
+        assert 'pong' not in self.nodes[0].getnetmsgstats('pong')['messages']
+
 
 if __name__ == '__main__':
     NetTest().main()
@@ -8,6 +8,7 @@ Test the following RPCs:
    - createrawtransaction
    - signrawtransactionwithwallet
    - sendrawtransaction
+   - sendrawtransactions
    - decoderawtransaction
    - getrawtransaction
 """
@@ -392,6 +393,38 @@ class RawTransactionsTest(BitcoinTestFramework):
         assert_equal(testres['allowed'], True)
         self.nodes[2].sendrawtransaction(hexstring=rawTxSigned['hex'], maxfeerate=0.00007000)
 
+        self.log.info('sendrawtransactions')
+        txId = self.nodes[0].sendtoaddress(self.nodes[2].getnewaddress(), 2.0)
+        rawTx = self.nodes[0].getrawtransaction(txId, True)
+        vout = next(o for o in rawTx['vout'] if o['value'] == Decimal('2.00000000'))
+        self.sync_all()
+        # a parent and its child, a double spend of the parent and a transaction with a missing input
+        parent = self.nodes[2].signrawtransactionwithwallet(self.nodes[2].createrawtransaction(
+            [{"txid": txId, "vout": vout['n']}], {self.nodes[2].getnewaddress(): Decimal("1.9999")}))['hex']
+        parentId = self.nodes[2].decoderawtransaction(parent)['txid']
+        child = self.nodes[2].signrawtransactionwithwallet(self.nodes[2].createrawtransaction(
+            [{"txid": parentId, "vout": 0}], {self.nodes[0].getnewaddress(): Decimal("1.9998")}),
+            [{"txid": parentId, "vout": 0, "scriptPubKey": self.nodes[2].decoderawtransaction(parent)['vout'][0]['scriptPubKey']['hex'], "amount": Decimal("1.9999")}])['hex']
+        doubleSpend = self.nodes[2].signrawtransactionwithwallet(self.nodes[2].createrawtransaction(
+            [{"txid": txId, "vout": vout['n']}], {self.nodes[0].getnewaddress(): Decimal("1.9999")}))['hex']
+        missing = self.nodes[2].createrawtransaction([{"txid": "ff" * 32, "vout": 0}], {self.nodes[0].getnewaddress(): 1})
+        res = self.nodes[2].sendrawtransactions([parent, child, doubleSpend, missing])
+        assert_equal([r['accepted'] for r in res], [True, True, False, False])
+        assert_equal(res[0]['txid'], parentId)
+        assert 'txn-mempool-conflict' in res[2]['error']
+        assert_equal(res[3]['error'], 'Missing inputs')
+        assert 'error' not in res[0]
+        self.sync_all()
+        assert parentId in self.nodes[0].getrawmempool()
+        assert res[1]['txid'] in self.nodes[0].getrawmempool()
+        # already in the mempool
+        assert_equal(self.nodes[2].sendrawtransactions([child])[0]['accepted'], True)
+        # a transaction listed twice is submitted once, both entries report its result
+        res = self.nodes[2].sendrawtransactions([child, child])
+        assert_equal([r['accepted'] for r in res], [True, True])
+        assert_equal(res[0]['txid'], res[1]['txid'])
+        assert_raises_rpc_error(-22, "TX decode failed for transaction 1", self.nodes[2].sendrawtransactions, [child, "00"])
+
 
 if __name__ == '__main__':
     RawTransactionsTest().main()